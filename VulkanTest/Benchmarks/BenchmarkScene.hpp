@@ -0,0 +1,209 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <cmath>
+
+#include "VulkanBaseGLFW.hpp"
+
+// Headless scene of drawCount small triangles, one draw each, shared by the benchmarks.
+// Shaders are read from shaderDirectory as SPIR-V, compile them first with:
+//   glslc Benchmarks/shaders/draw.vert -o draw.vert.spv
+//   glslc Benchmarks/shaders/draw.frag -o draw.frag.spv
+//   glslc Benchmarks/shaders/grid.vert -o grid.vert.spv (VulkanBaseBenchmark and PipelineCompileBenchmark only)
+//   glslc Benchmarks/shaders/instanced.vert -o instanced.vert.spv (GpuCullingBenchmark only)
+//   glslc shaders/cull.comp -o cull.comp.spv (GpuCullingBenchmark only)
+
+struct DrawPushConstants {
+	float offsetScale[4];
+	float color[4];
+};
+
+static std::vector<char> readFile(const std::string& filename) {
+	std::ifstream file(filename, std::ios::ate | std::ios::binary);
+
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open file " + filename);
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	std::vector<char> buffer(fileSize);
+
+	file.seekg(0);
+	file.read(buffer.data(), fileSize);
+
+	return buffer;
+}
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+class BenchmarkScene : public VulkanBaseGLFW
+{
+public:
+	BenchmarkScene(const char* name, uint32_t width, uint32_t height, uint32_t drawCount, const std::string& shaderDirectory)
+		: VulkanBaseGLFW(name, width, height, true), drawCount(drawCount) {
+		createPipelineLayout();
+		this->pipeline = createPipeline(shaderDirectory + "/draw.vert.spv", shaderDirectory + "/draw.frag.spv");
+	}
+
+	~BenchmarkScene() {
+		vkDeviceWaitIdle(this->device);
+		for (VkPipeline pipeline : this->pipelines) {
+			vkDestroyPipeline(this->device, pipeline, nullptr);
+		}
+		vkDestroyPipelineLayout(this->device, this->pipelineLayout, nullptr);
+	}
+
+protected:
+	uint32_t drawCount;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE; // DrawPushConstants in the vertex stage, shared by every pipeline
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	// Binds the pipeline, sets the dynamic state and draws triangles [begin, end), valid in primary and secondary buffers
+	void recordDraws(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) {
+		bindPipeline(commandBuffer, this->pipeline);
+
+		// Triangles on a grid covering the screen
+		const uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(this->drawCount))));
+		const float cellSize = 2.0f / columns;
+		for (uint32_t i = begin; i < end; i++) {
+			const uint32_t column = i % columns;
+			const uint32_t row = i / columns;
+
+			DrawPushConstants pushConstants = {
+				{ -1.0f + (column + 0.5f) * cellSize, -1.0f + (row + 0.5f) * cellSize, cellSize * 0.4f, cellSize * 0.4f },
+				{ static_cast<float>(column) / columns, static_cast<float>(row) / columns, 0.5f, 1.0f }
+			};
+			vkCmdPushConstants(commandBuffer, this->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+			vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+		}
+	}
+
+	// Binds pipeline and sets the viewport and scissor to the whole frame, at the render scale
+	void bindPipeline(VkCommandBuffer commandBuffer, VkPipeline pipeline) {
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+		VkViewport viewport{};
+		viewport.width = static_cast<float>(this->renderExtent.width);
+		viewport.height = static_cast<float>(this->renderExtent.height);
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor{};
+		scissor.extent = this->renderExtent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	}
+
+	// Pipelines for the main render pass using layout (pipelineLayout by default), destroyed with the scene.
+	// Without depthTest every fragment is shaded, with blend they are also all blended, which is what fill rate tests want.
+	VkPipeline createPipeline(const std::string& vertexShaderPath, const std::string& fragmentShaderPath, bool depthTest = true, bool blend = false, VkPipelineLayout layout = VK_NULL_HANDLE) {
+		VkShaderModule vertShaderModule = createShaderModule(readFile(vertexShaderPath));
+		VkShaderModule fragShaderModule = createShaderModule(readFile(fragmentShaderPath));
+
+		VkPipelineShaderStageCreateInfo shaderStages[2]{};
+		shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		shaderStages[0].module = vertShaderModule;
+		shaderStages[0].pName = "main";
+		shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		shaderStages[1].module = fragShaderModule;
+		shaderStages[1].pName = "main";
+
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+		VkPipelineViewportStateCreateInfo viewportState{};
+		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportState.viewportCount = 1;
+		viewportState.scissorCount = 1;
+
+		VkPipelineRasterizationStateCreateInfo rasterizer{};
+		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterizer.lineWidth = 1.0f;
+		rasterizer.cullMode = VK_CULL_MODE_NONE;
+		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+		VkPipelineMultisampleStateCreateInfo multisampling{};
+		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		multisampling.rasterizationSamples = this->msaaSamples;
+
+		VkPipelineDepthStencilStateCreateInfo depthStencil{};
+		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthStencil.depthTestEnable = depthTest ? VK_TRUE : VK_FALSE;
+		depthStencil.depthWriteEnable = depthTest ? VK_TRUE : VK_FALSE;
+		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+		VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		if (blend) {
+			colorBlendAttachment.blendEnable = VK_TRUE;
+			colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+			colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+			colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+			colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+			colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+			colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+		}
+
+		VkPipelineColorBlendStateCreateInfo colorBlending{};
+		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		colorBlending.attachmentCount = 1;
+		colorBlending.pAttachments = &colorBlendAttachment;
+
+		VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = 2;
+		dynamicState.pDynamicStates = dynamicStates;
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = shaderStages;
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pViewportState = &viewportState;
+		pipelineInfo.pRasterizationState = &rasterizer;
+		pipelineInfo.pMultisampleState = &multisampling;
+		pipelineInfo.pDepthStencilState = &depthStencil;
+		pipelineInfo.pColorBlendState = &colorBlending;
+		pipelineInfo.pDynamicState = &dynamicState;
+		pipelineInfo.layout = layout != VK_NULL_HANDLE ? layout : this->pipelineLayout;
+		pipelineInfo.renderPass = this->renderPass;
+		pipelineInfo.subpass = 0;
+
+		VkPipeline pipeline;
+		if (vkCreateGraphicsPipelines(this->device, this->pipelineCache.getHandle(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create graphics pipeline");
+		}
+		this->pipelines.push_back(pipeline);
+		return pipeline;
+	}
+
+private:
+	std::vector<VkPipeline> pipelines;
+
+	void createPipelineLayout() {
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRange.size = sizeof(DrawPushConstants);
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(this->device, &pipelineLayoutInfo, nullptr, &this->pipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create pipeline layout");
+		}
+	}
+};
@@ -0,0 +1,198 @@
+#include <iostream>
+#include <iomanip>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BenchmarkScene.hpp"
+#include "GpuCulling.hpp"
+#include "SceneTransforms.hpp"
+
+// Usage: GpuCullingBenchmark [objectCount] [shaderDirectory]
+// Draws a grid of objectCount objects seen from its center, so that roughly an eighth of them are in the frustum, first
+// culled on the CPU by SceneTransforms with one vkCmdDrawIndexed per visible object, then culled by GpuCulling with one indirect draw per
+// batch. Reports the CPU time spent recording and the GPU time of each path.
+
+class GpuCullingBenchmark : public BenchmarkScene
+{
+public:
+	static constexpr uint32_t BATCH_COUNT = 4;
+
+	GpuCullingBenchmark(uint32_t objectCount, const std::string& shaderDirectory)
+		: BenchmarkScene("GpuCullingBenchmark", 1280, 720, objectCount, shaderDirectory) {
+		createScene();
+
+		// Both paths read the transforms from gpuCulling, which throws without drawIndirectFirstInstance
+		VkShaderModule cullShader = createShaderModule(readFile(shaderDirectory + "/cull.comp.spv"));
+		this->gpuCulling.init(this->device, this->deviceProfile, this->enabledFeatures, this->drawIndirectCountEnabled, this->memoryAllocator,
+			this->pipelineCache.getHandle(), cullShader, MAX_FRAMES_IN_FLIGHT, objectCount, BATCH_COUNT);
+		this->gpuCulling.setScene(this->meshes, this->objects, BATCH_COUNT);
+		for (uint32_t frameIndex = 0; frameIndex < MAX_FRAMES_IN_FLIGHT; frameIndex++) {
+			std::copy(this->sceneTransforms.getWorldMatrices(), this->sceneTransforms.getWorldMatrices() + objectCount, this->gpuCulling.getTransforms(frameIndex));
+		}
+
+		createInstancedPipeline(shaderDirectory);
+	}
+
+	~GpuCullingBenchmark() {
+		vkDeviceWaitIdle(this->device);
+		this->gpuCulling.cleanup();
+		vkDestroyPipelineLayout(this->device, this->instancedPipelineLayout, nullptr);
+		destroyBuffer(this->indexBuffer, this->indexBufferAllocation);
+	}
+
+	bool usesDrawIndirectCount() const { return this->gpuCulling.usesDrawIndirectCount(); }
+
+	size_t getVisibleCount() const { return this->visible.size(); }
+
+	// Average recording time per frame in milliseconds
+	double measure(bool gpu, uint32_t frameCount) {
+		this->gpu = gpu;
+		run(frameCount / 4);
+
+		this->recordMilliseconds = 0.0;
+		run(frameCount);
+		return this->recordMilliseconds / frameCount;
+	}
+
+	// Median GPU time of the path, culling included, 0 when the queue has no timestamps
+	double getGpuMilliseconds(bool gpu) const {
+		auto stats = this->gpuProfiler.getStats();
+		double milliseconds = 0.0;
+		for (const char* name : gpu ? std::vector<const char*>{ "GPU cull", "GPU draws" } : std::vector<const char*>{ "CPU draws" }) {
+			auto found = stats.find(name);
+			milliseconds += found != stats.end() ? found->second.p50 : 0.0;
+		}
+		return milliseconds;
+	}
+
+protected:
+	void recordCommandBuffer(FrameResources& frame, uint32_t imageIndex) override {
+		auto start = std::chrono::steady_clock::now();
+
+		if (this->gpu) {
+			GpuScope scope(this->gpuProfiler, frame.commandBuffer, "GPU cull");
+			this->gpuCulling.cull(frame.commandBuffer, this->currentFrame, this->frustum);
+		}
+
+		GpuScope scope(this->gpuProfiler, frame.commandBuffer, this->gpu ? "GPU draws" : "CPU draws");
+		beginRenderPass(frame.commandBuffer, imageIndex);
+		bindPipeline(frame.commandBuffer, this->instancedPipeline);
+		vkCmdBindIndexBuffer(frame.commandBuffer, this->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdPushConstants(frame.commandBuffer, this->instancedPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &this->viewProjection);
+		this->gpuCulling.bindDescriptorSet(frame.commandBuffer, this->instancedPipelineLayout, 0, this->currentFrame);
+
+		if (this->gpu) {
+			for (uint32_t batch = 0; batch < BATCH_COUNT; batch++) {
+				this->gpuCulling.drawBatch(frame.commandBuffer, batch);
+			}
+		}
+		else {
+			// Every batch uses the same pipeline here, so the visible list is drawn in index order
+			this->sceneTransforms.cull(this->frustum, this->visible);
+			for (uint32_t i : this->visible) {
+				const GpuMesh& mesh = this->meshes[this->objects[i].meshIndex];
+				vkCmdDrawIndexed(frame.commandBuffer, mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, i);
+			}
+		}
+
+		vkCmdEndRenderPass(frame.commandBuffer);
+		this->recordMilliseconds += millisecondsSince(start);
+	}
+
+private:
+	bool gpu = false;
+	GpuCulling gpuCulling;
+	std::vector<GpuMesh> meshes;
+	std::vector<GpuObject> objects; // Object i is in batch i % BATCH_COUNT
+	SceneTransforms sceneTransforms;
+	std::vector<uint32_t> visible;
+	glm::mat4 viewProjection;
+	Frustum frustum;
+	VkBuffer indexBuffer = VK_NULL_HANDLE;
+	MemoryAllocation indexBufferAllocation;
+	VkPipelineLayout instancedPipelineLayout = VK_NULL_HANDLE;
+	VkPipeline instancedPipeline = VK_NULL_HANDLE;
+	double recordMilliseconds = 0.0;
+
+	void createScene() {
+		// A triangle and a quad, matching the positions of instanced.vert
+		const uint32_t indices[] = { 0, 1, 2, 3, 4, 5, 3, 5, 6 };
+		createBuffer(sizeof(indices), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			this->indexBuffer, this->indexBufferAllocation);
+		memcpy(this->indexBufferAllocation.mappedData, indices, sizeof(indices));
+		this->meshes = { { 3, 0, 0 }, { 6, 3, 0 } };
+
+		const uint32_t side = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(this->drawCount))));
+		const float spacing = 2.0f;
+		const float halfExtent = side * spacing * 0.5f;
+		for (uint32_t i = 0; i < this->drawCount; i++) {
+			const glm::vec3 position(
+				(i % side) * spacing - halfExtent,
+				(i / side % side) * spacing - halfExtent,
+				(i / (side * side)) * spacing - halfExtent);
+
+			GpuObject object;
+			object.boundingSphere = glm::vec4(0.0f, 0.0f, 0.0f, 0.75f);
+			object.meshIndex = i % 2;
+			object.batchIndex = i % BATCH_COUNT;
+			this->objects.push_back(object);
+			this->sceneTransforms.addNode(SceneTransforms::NO_PARENT, position, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), 1.0f, object.boundingSphere);
+		}
+		this->sceneTransforms.updateWorld();
+
+		const float aspect = static_cast<float>(this->swapChainExtent.width) / this->swapChainExtent.height;
+		glm::mat4 projection = glm::perspective(glm::radians(60.0f), aspect, 0.1f, halfExtent * 4.0f);
+		projection[1][1] *= -1.0f;
+		this->viewProjection = projection * glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		this->frustum = Frustum::fromViewProjection(this->viewProjection);
+	}
+
+	void createInstancedPipeline(const std::string& shaderDirectory) {
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRange.size = sizeof(glm::mat4);
+
+		VkDescriptorSetLayout setLayout = this->gpuCulling.getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &setLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		if (vkCreatePipelineLayout(this->device, &pipelineLayoutInfo, nullptr, &this->instancedPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create pipeline layout");
+		}
+
+		this->instancedPipeline = createPipeline(shaderDirectory + "/instanced.vert.spv", shaderDirectory + "/draw.frag.spv", true, false, this->instancedPipelineLayout);
+	}
+};
+
+int main(int argc, char** argv) {
+	uint32_t objectCount = argc > 1 ? std::stoul(argv[1]) : 100000;
+	std::string shaderDirectory = argc > 2 ? argv[2] : "shaders";
+
+	try {
+		GpuCullingBenchmark benchmark(objectCount, shaderDirectory);
+
+		std::cout << objectCount << " objects in " << GpuCullingBenchmark::BATCH_COUNT << " batches" << std::endl;
+		std::cout << "path  record ms  GPU ms" << std::endl;
+
+		double cpuMilliseconds = benchmark.measure(false, 200);
+		std::cout << "CPU " << std::setw(11) << std::fixed << std::setprecision(3) << cpuMilliseconds
+			<< std::setw(8) << benchmark.getGpuMilliseconds(false)
+			<< "  (" << benchmark.getVisibleCount() << " draws)" << std::endl;
+
+		double gpuMilliseconds = benchmark.measure(true, 200);
+		std::cout << "GPU " << std::setw(11) << gpuMilliseconds
+			<< std::setw(8) << benchmark.getGpuMilliseconds(true)
+			<< "  (" << GpuCullingBenchmark::BATCH_COUNT << (benchmark.usesDrawIndirectCount() ? " indirect count draws)" : " indirect draws)") << std::endl;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "MeshIndexer.hpp"
+
+// Usage: MeshIndexerBenchmark [gridSize] [threadCount]
+// Builds a gridSize x gridSize quad mesh as an unindexed triangle list with shuffled triangles, the worst case for the
+// vertex cache, then indexes and optimizes it
+
+namespace {
+	double secondsSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::vector<Vertex> buildGrid(uint32_t gridSize) {
+		auto gridVertex = [gridSize](uint32_t x, uint32_t y) {
+			Vertex vertex{};
+			float u = static_cast<float>(x) / gridSize;
+			float v = static_cast<float>(y) / gridSize;
+			vertex.pos = { u * 2.0f - 1.0f, 0.0f, v * 2.0f - 1.0f };
+			vertex.normal = { 0.0f, 1.0f, 0.0f };
+			vertex.color = { u, v, 1.0f };
+			vertex.texCoord = { u, v };
+			return vertex;
+		};
+
+		std::vector<std::array<Vertex, 3>> triangles;
+		triangles.reserve(static_cast<size_t>(gridSize) * gridSize * 2);
+		for (uint32_t y = 0; y < gridSize; y++) {
+			for (uint32_t x = 0; x < gridSize; x++) {
+				triangles.push_back({ gridVertex(x, y), gridVertex(x, y + 1), gridVertex(x + 1, y) });
+				triangles.push_back({ gridVertex(x + 1, y), gridVertex(x, y + 1), gridVertex(x + 1, y + 1) });
+			}
+		}
+
+		std::mt19937 random(1234);
+		std::shuffle(triangles.begin(), triangles.end(), random);
+
+		std::vector<Vertex> vertices;
+		vertices.reserve(triangles.size() * 3);
+		for (const auto& triangle : triangles) {
+			vertices.insert(vertices.end(), triangle.begin(), triangle.end());
+		}
+		return vertices;
+	}
+
+	void report(const char* name, double seconds, size_t vertexCount) {
+		std::cout << name << ": " << seconds * 1000.0 << " ms, " << vertexCount / seconds / 1e6 << " Mvertices/s" << std::endl;
+	}
+}
+
+int main(int argc, char** argv) {
+	uint32_t gridSize = argc > 1 ? std::stoul(argv[1]) : 1024;
+	uint32_t threadCount = argc > 2 ? std::stoul(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<Vertex> input = buildGrid(gridSize);
+	std::cout << input.size() / 3 << " triangles, " << input.size() << " input vertices" << std::endl;
+
+	// What the samples did so far
+	auto start = std::chrono::steady_clock::now();
+	std::unordered_map<Vertex, uint32_t> uniqueVertices;
+	std::vector<uint32_t> mapIndices;
+	mapIndices.reserve(input.size());
+	for (const auto& vertex : input) {
+		auto inserted = uniqueVertices.emplace(vertex, static_cast<uint32_t>(uniqueVertices.size()));
+		mapIndices.push_back(inserted.first->second);
+	}
+	report("unordered_map", secondsSince(start), input.size());
+
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	start = std::chrono::steady_clock::now();
+	MeshIndexer::buildIndexed(input, vertices, indices, 1);
+	report("buildIndexed, 1 thread", secondsSince(start), input.size());
+
+	start = std::chrono::steady_clock::now();
+	MeshIndexer::buildIndexed(input, vertices, indices, threadCount);
+	std::string name = "buildIndexed, " + std::to_string(threadCount) + " threads";
+	report(name.c_str(), secondsSince(start), input.size());
+
+	if (vertices.size() != uniqueVertices.size()) {
+		std::cerr << "Unique vertex count mismatch: " << vertices.size() << " vs " << uniqueVertices.size() << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << vertices.size() << " unique vertices" << std::endl;
+
+	std::cout << "ACMR before: " << MeshIndexer::computeACMR(indices, vertices.size()) << std::endl;
+
+	start = std::chrono::steady_clock::now();
+	MeshIndexer::optimizeVertexCache(indices, vertices.size());
+	report("optimizeVertexCache", secondsSince(start), indices.size());
+	std::cout << "ACMR after: " << MeshIndexer::computeACMR(indices, vertices.size()) << std::endl;
+
+	start = std::chrono::steady_clock::now();
+	MeshIndexer::optimizeVertexFetch(vertices, indices);
+	report("optimizeVertexFetch", secondsSince(start), indices.size());
+
+	return EXIT_SUCCESS;
+}
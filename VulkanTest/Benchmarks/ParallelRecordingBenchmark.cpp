@@ -0,0 +1,78 @@
+#include <iostream>
+#include <iomanip>
+
+#include "BenchmarkScene.hpp"
+
+// Usage: ParallelRecordingBenchmark [drawCount] [chunkSize] [shaderDirectory]
+// Records the same frame of drawCount draws on 1..N threads and reports the CPU time spent recording
+
+class ParallelRecordingBenchmark : public BenchmarkScene
+{
+public:
+	ParallelRecordingBenchmark(uint32_t drawCount, uint32_t chunkSize, const std::string& shaderDirectory)
+		: BenchmarkScene("ParallelRecordingBenchmark", 1280, 720, drawCount, shaderDirectory), chunkSize(chunkSize) {
+	}
+
+	uint32_t getThreadCount() const { return this->threadPool.getThreadCount(); }
+
+	// Average recording time per frame in milliseconds
+	double measure(uint32_t threadCount, uint32_t frameCount) {
+		this->threadLimit = threadCount;
+		run(frameCount / 4); // Warm up, secondaries get allocated once and are reused afterwards
+
+		this->recordMilliseconds = 0.0;
+		run(frameCount);
+		return this->recordMilliseconds / frameCount;
+	}
+
+protected:
+	void recordCommandBuffer(FrameResources& frame, uint32_t imageIndex) override {
+		auto start = std::chrono::steady_clock::now();
+
+		beginRenderPass(frame.commandBuffer, imageIndex, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		this->parallelRecorder.record(frame.commandBuffer, this->renderPass, 0, this->swapChainFramebuffers[imageIndex], this->drawCount, this->chunkSize,
+			[this](VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end) {
+				recordDraws(commandBuffer, begin, end);
+			}, this->threadLimit);
+		vkCmdEndRenderPass(frame.commandBuffer);
+
+		this->recordMilliseconds += millisecondsSince(start);
+	}
+
+private:
+	uint32_t chunkSize;
+	uint32_t threadLimit = 1;
+	double recordMilliseconds = 0.0;
+};
+
+int main(int argc, char** argv) {
+	uint32_t drawCount = argc > 1 ? std::stoul(argv[1]) : 50000;
+	uint32_t chunkSize = argc > 2 ? std::stoul(argv[2]) : 1024;
+	std::string shaderDirectory = argc > 3 ? argv[3] : "shaders";
+
+	try {
+		ParallelRecordingBenchmark benchmark(drawCount, chunkSize, shaderDirectory);
+
+		std::cout << drawCount << " draws, chunks of " << chunkSize << std::endl;
+		std::cout << "threads  ms/frame  speedup  draws/ms" << std::endl;
+
+		double singleThreaded = 0.0;
+		for (uint32_t threads = 1; threads <= benchmark.getThreadCount(); threads++) {
+			double milliseconds = benchmark.measure(threads, 200);
+			if (threads == 1) {
+				singleThreaded = milliseconds;
+			}
+
+			std::cout << std::setw(7) << threads
+				<< std::setw(10) << std::fixed << std::setprecision(3) << milliseconds
+				<< std::setw(9) << std::setprecision(2) << singleThreaded / milliseconds
+				<< std::setw(10) << std::setprecision(0) << drawCount / milliseconds << std::endl;
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
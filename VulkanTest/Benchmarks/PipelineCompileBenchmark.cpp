@@ -0,0 +1,157 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#include "BenchmarkScene.hpp"
+
+// Usage: PipelineCompileBenchmark [shaderDirectory]
+// Introduces one new pipeline variant per frame, compiled on the recording thread first, then requested from
+// pipelineManager and drawn with the scene pipeline until ready, and reports the recording times of both.
+// Run it with no pipeline cache file for cold numbers, a warm cache hides most of the compile time.
+
+class PipelineCompileBenchmark : public BenchmarkScene
+{
+public:
+	struct Result {
+		double averageMilliseconds;
+		double worstMilliseconds;
+		uint64_t framesUntilReady; // Frames until every variant was drawn with its own pipeline
+	};
+
+	PipelineCompileBenchmark(const std::string& shaderDirectory)
+		: BenchmarkScene("PipelineCompileBenchmark", 1280, 720, 64, shaderDirectory) {
+		this->pipelineManager.registerLayout("scene", this->pipelineLayout);
+	}
+
+	~PipelineCompileBenchmark() {
+		// Compiles still queued use pipelineLayout, which BenchmarkScene destroys
+		this->pipelineManager.waitIdle();
+	}
+
+	Result measure(const std::vector<GraphicsPipelineKey>& keys, bool async) {
+		this->keys = &keys;
+		this->async = async;
+		this->introduced = 0;
+		this->frame = 0;
+		this->readyFrame = 0;
+		this->frameMilliseconds.clear();
+
+		while (this->readyFrame == 0 && this->frame < 100000) {
+			run(1);
+		}
+
+		Result result{};
+		for (double milliseconds : this->frameMilliseconds) {
+			result.averageMilliseconds += milliseconds;
+			result.worstMilliseconds = std::max(result.worstMilliseconds, milliseconds);
+		}
+		result.averageMilliseconds /= this->frameMilliseconds.size();
+		result.framesUntilReady = this->readyFrame;
+		return result;
+	}
+
+	PipelineManagerStats getPipelineStats() { return this->pipelineManager.getStats(); }
+
+	bool usesGraphicsPipelineLibrary() const { return this->pipelineManager.usesGraphicsPipelineLibrary(); }
+
+protected:
+	void recordCommandBuffer(FrameResources& frame, uint32_t imageIndex) override {
+		auto start = std::chrono::steady_clock::now();
+		this->frame++;
+		this->introduced = std::min(this->introduced + 1, static_cast<uint32_t>(this->keys->size()));
+
+		beginRenderPass(frame.commandBuffer, imageIndex);
+		uint32_t pending = 0;
+		for (uint32_t i = 0; i < this->introduced; i++) {
+			const GraphicsPipelineKey& key = (*this->keys)[i];
+			VkPipeline pipeline = this->async ? this->pipelineManager.getGraphics(key, this->pipeline) : this->pipelineManager.compileGraphics(key);
+			if (pipeline == this->pipeline) {
+				pending++;
+			}
+			bindPipeline(frame.commandBuffer, pipeline);
+
+			// grid.vert, used by the asynchronous run, reads offsetScale.x as its column count
+			const float x = this->async ? 8.0f : -0.9f + 1.8f * (i % 8) / 7.0f;
+			const float y = -0.9f + 1.8f * (i / 8 % 8) / 7.0f;
+			DrawPushConstants pushConstants = { { x, y, 0.1f, 0.1f }, { 1.0f, 0.5f, 0.25f, 0.5f } };
+			vkCmdPushConstants(frame.commandBuffer, this->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+			vkCmdDraw(frame.commandBuffer, 3, 1, 0, 0);
+		}
+		vkCmdEndRenderPass(frame.commandBuffer);
+
+		if (this->introduced == this->keys->size() && pending == 0 && this->readyFrame == 0) {
+			this->readyFrame = this->frame;
+		}
+		this->frameMilliseconds.push_back(millisecondsSince(start));
+	}
+
+private:
+	const std::vector<GraphicsPipelineKey>* keys = nullptr;
+	bool async = false;
+	uint32_t introduced = 0;
+	uint64_t frame = 0;
+	uint64_t readyFrame = 0;
+	std::vector<double> frameMilliseconds;
+};
+
+// Every cull mode, depth mode and blend combination of one vertex shader with draw.frag
+static std::vector<GraphicsPipelineKey> makeVariants(const std::string& vertexShader, const std::string& shaderDirectory) {
+	std::vector<GraphicsPipelineKey> keys;
+	const VkCullModeFlags cullModes[] = { VK_CULL_MODE_NONE, VK_CULL_MODE_BACK_BIT, VK_CULL_MODE_FRONT_BIT };
+	const VkPrimitiveTopology topologies[] = { VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP };
+	for (VkPrimitiveTopology topology : topologies) {
+		for (VkCullModeFlags cullMode : cullModes) {
+			for (uint32_t depth = 0; depth < 3; depth++) {
+				for (bool blend : { false, true }) {
+					GraphicsPipelineKey key;
+					key.vertexShader = shaderDirectory + "/" + vertexShader;
+					key.fragmentShader = shaderDirectory + "/draw.frag.spv";
+					key.layout = "scene";
+					key.renderPass = "main";
+					key.topology = topology;
+					key.cullMode = cullMode;
+					key.depthTest = depth > 0;
+					key.depthWrite = depth > 1;
+					key.blend = blend;
+					keys.push_back(key);
+				}
+			}
+		}
+	}
+	return keys;
+}
+
+int main(int argc, char** argv) {
+	std::string shaderDirectory = argc > 1 ? argv[1] : "shaders";
+
+	try {
+		PipelineCompileBenchmark benchmark(shaderDirectory);
+
+		// Distinct vertex shaders, so the asynchronous run does not find the variants of the synchronous one compiled
+		std::vector<GraphicsPipelineKey> synchronousKeys = makeVariants("draw.vert.spv", shaderDirectory);
+		std::vector<GraphicsPipelineKey> asynchronousKeys = makeVariants("grid.vert.spv", shaderDirectory);
+
+		std::cout << synchronousKeys.size() << " variants, graphics pipeline library "
+			<< (benchmark.usesGraphicsPipelineLibrary() ? "enabled" : "not available") << std::endl;
+		std::cout << "mode          avg ms  worst ms  frames until ready" << std::endl;
+
+		PipelineCompileBenchmark::Result synchronous = benchmark.measure(synchronousKeys, false);
+		PipelineCompileBenchmark::Result asynchronous = benchmark.measure(asynchronousKeys, true);
+		for (const auto& [name, result] : { std::make_pair("synchronous ", synchronous), std::make_pair("asynchronous", asynchronous) }) {
+			std::cout << name
+				<< std::setw(9) << std::fixed << std::setprecision(3) << result.averageMilliseconds
+				<< std::setw(10) << result.worstMilliseconds
+				<< std::setw(20) << result.framesUntilReady << std::endl;
+		}
+
+		PipelineManagerStats stats = benchmark.getPipelineStats();
+		std::cout << stats.compiled << " pipelines in " << std::setprecision(1) << stats.compileMilliseconds << " ms of compile threads, "
+			<< stats.libraries << " libraries, " << stats.fastLinked << " fast links, " << stats.fallbacks << " fallback draws" << std::endl;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
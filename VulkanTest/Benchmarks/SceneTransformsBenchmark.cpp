@@ -0,0 +1,125 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "SceneTransforms.hpp"
+
+// Usage: SceneTransformsBenchmark [maxObjectCount] [runCount]
+// Builds scenes of 10k, 100k and 1M objects (up to maxObjectCount) made of a root and three children, scattered in a
+// cube seen from its center, then times updateWorld and cull with every instruction set the machine supports, next to
+// the AoS glm code of the samples: one mat4 per object, a matrix product per level and a sphere test per object.
+
+namespace {
+	constexpr uint32_t CHILDREN_PER_ROOT = 3;
+
+	double millisecondsSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	template <typename Function>
+	double median(uint32_t runCount, Function function) {
+		std::vector<double> times;
+		for (uint32_t run = 0; run < runCount; run++) {
+			auto start = std::chrono::steady_clock::now();
+			function();
+			times.push_back(millisecondsSince(start));
+		}
+		std::sort(times.begin(), times.end());
+		return times[times.size() / 2];
+	}
+
+	struct AosObject {
+		uint32_t parent;
+		glm::vec3 position;
+		glm::quat rotation;
+		float scale;
+		glm::vec4 boundingSphere;
+	};
+
+	std::vector<AosObject> buildScene(uint32_t objectCount) {
+		std::mt19937 random(1234);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		const float halfExtent = std::cbrt(static_cast<float>(objectCount)) * 2.0f;
+
+		std::vector<AosObject> objects;
+		objects.reserve(objectCount);
+		uint32_t root = 0;
+		for (uint32_t i = 0; i < objectCount; i++) {
+			AosObject object;
+			const bool isRoot = i % (CHILDREN_PER_ROOT + 1) == 0;
+			root = isRoot ? i : root;
+			object.parent = isRoot ? SceneTransforms::NO_PARENT : root;
+			object.position = isRoot ? glm::vec3(unit(random), unit(random), unit(random)) * halfExtent : glm::vec3(unit(random), unit(random), unit(random)) * 2.0f;
+			object.rotation = glm::normalize(glm::quat(unit(random), unit(random), unit(random), unit(random)));
+			object.scale = isRoot ? 1.0f : 0.5f;
+			object.boundingSphere = glm::vec4(0.0f, 0.0f, 0.0f, 0.75f);
+			objects.push_back(object);
+		}
+		return objects;
+	}
+}
+
+int main(int argc, char** argv) {
+	uint32_t maxObjectCount = argc > 1 ? std::stoul(argv[1]) : 1000000;
+	uint32_t runCount = argc > 2 ? std::stoul(argv[2]) : 21;
+
+	std::cout << "Best instruction set: " << SceneTransforms::getSimdLevelName(SceneTransforms::detectSimdLevel()) << std::endl;
+
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	const Frustum frustum = Frustum::fromViewProjection(projection * view);
+
+	for (uint32_t objectCount : { 10000u, 100000u, 1000000u }) {
+		if (objectCount > maxObjectCount) break;
+
+		std::vector<AosObject> objects = buildScene(objectCount);
+		std::cout << std::endl << objectCount << " objects" << std::endl;
+		std::cout << "path     update ms  cull ms  visible" << std::endl;
+
+		// What the samples do: a full matrix per object, composed with glm
+		std::vector<glm::mat4> worldMatrices(objectCount);
+		std::vector<uint32_t> visible;
+		visible.reserve(objectCount);
+		double updateMilliseconds = median(runCount, [&]() {
+			for (uint32_t i = 0; i < objectCount; i++) {
+				const AosObject& object = objects[i];
+				glm::mat4 local = glm::translate(glm::mat4(1.0f), object.position) * glm::mat4_cast(object.rotation) * glm::scale(glm::mat4(1.0f), glm::vec3(object.scale));
+				worldMatrices[i] = object.parent == SceneTransforms::NO_PARENT ? local : worldMatrices[object.parent] * local;
+			}
+		});
+		double cullMilliseconds = median(runCount, [&]() {
+			visible.clear();
+			for (uint32_t i = 0; i < objectCount; i++) {
+				const glm::vec3 center = glm::vec3(worldMatrices[i] * glm::vec4(glm::vec3(objects[i].boundingSphere), 1.0f));
+				const float scale = glm::length(glm::vec3(worldMatrices[i][0]));
+				if (frustum.intersectsSphere(center, objects[i].boundingSphere.w * scale)) {
+					visible.push_back(i);
+				}
+			}
+		});
+		std::cout << "AoS glm " << std::fixed << std::setprecision(3) << std::setw(10) << updateMilliseconds
+			<< std::setw(9) << cullMilliseconds << std::setw(9) << visible.size() << std::endl;
+
+		SceneTransforms scene;
+		scene.reserve(objectCount);
+		for (const auto& object : objects) {
+			scene.addNode(object.parent, object.position, object.rotation, object.scale, object.boundingSphere);
+		}
+
+		for (SimdLevel level : { SimdLevel::Scalar, SimdLevel::Sse2, SimdLevel::Avx2, SimdLevel::Neon }) {
+			if (scene.setSimdLevel(level) != level) continue;
+
+			updateMilliseconds = median(runCount, [&]() { scene.updateWorld(); });
+			cullMilliseconds = median(runCount, [&]() { scene.cull(frustum, visible); });
+			std::cout << "SoA " << std::left << std::setw(6) << SceneTransforms::getSimdLevelName(level) << std::right
+				<< std::setw(8) << updateMilliseconds << std::setw(9) << cullMilliseconds << std::setw(9) << visible.size() << std::endl;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,404 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <map>
+#include <cstring>
+#include <memory>
+
+#include "BenchmarkScene.hpp"
+
+// Usage: VulkanBaseBenchmark [--shaders dir] [--output results.json] [--baseline baseline.json] [--tolerance 0.15] [--quick]
+//
+// Headless suite measuring the base itself: instance/device init, offscreen recreation, image allocation through
+// createImage and frame times of three synthetic scenes (draw call, vertex and fill rate bound). Every run does the
+// same work in the same order, so results are comparable between runs on the same machine. It runs on any Vulkan
+// implementation, to force lavapipe point the loader at it:
+//   VK_DRIVER_FILES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./VulkanBaseBenchmark --output results.json
+//
+// Results are written as flat metrics, "_ms" ones are better when lower and "_per_s" ones when higher. With --baseline,
+// the mean and median of every metric present in both files are compared and the exit code is 2 when any of them
+// regressed by more than the tolerance. Tail percentiles are reported but not compared, they are too noisy.
+// Compile the shaders listed in BenchmarkScene.hpp into the shader directory first, and build with NDEBUG: validation
+// layers dominate every measurement otherwise.
+
+namespace {
+	constexpr int EXIT_REGRESSION = 2;
+
+	struct Options {
+		std::string shaderDirectory = "shaders";
+		std::string outputPath;
+		std::string baselinePath;
+		double tolerance = 0.15;
+		bool quick = false;
+	};
+
+	using Metrics = std::map<std::string, double>;
+
+	void addDistribution(Metrics& metrics, const std::string& name, std::vector<double> samples) {
+		if (samples.empty()) return;
+		std::sort(samples.begin(), samples.end());
+
+		auto percentile = [&samples](double fraction) {
+			size_t index = static_cast<size_t>(fraction * (samples.size() - 1) + 0.5);
+			return samples[std::min(index, samples.size() - 1)];
+		};
+
+		double mean = 0.0;
+		for (double sample : samples) {
+			mean += sample;
+		}
+		mean /= samples.size();
+
+		metrics[name + ".mean_ms"] = mean;
+		metrics[name + ".p50_ms"] = percentile(0.50);
+		metrics[name + ".p95_ms"] = percentile(0.95);
+		metrics[name + ".p99_ms"] = percentile(0.99);
+		metrics[name + ".max_ms"] = samples.back();
+	}
+
+	std::string escapeJson(const std::string& text) {
+		std::string escaped;
+		for (char c : text) {
+			if (c == '"' || c == '\\') {
+				escaped += '\\';
+			}
+			escaped += c;
+		}
+		return escaped;
+	}
+
+	// Only reads back what writeResults writes: the flat "metrics" object of name/number pairs
+	Metrics readMetrics(const std::string& path) {
+		std::ifstream file(path);
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open baseline " + path);
+		}
+		std::stringstream stream;
+		stream << file.rdbuf();
+		const std::string text = stream.str();
+
+		Metrics metrics;
+		size_t position = text.find("\"metrics\"");
+		if (position == std::string::npos) {
+			throw std::runtime_error("No metrics in baseline " + path);
+		}
+		position = text.find('{', position);
+		const size_t end = text.find('}', position);
+		while (position != std::string::npos && position < end) {
+			const size_t keyBegin = text.find('"', position);
+			if (keyBegin == std::string::npos || keyBegin > end) break;
+			const size_t keyEnd = text.find('"', keyBegin + 1);
+			const size_t colon = text.find(':', keyEnd);
+
+			char* valueEnd = nullptr;
+			const double value = std::strtod(text.c_str() + colon + 1, &valueEnd);
+			metrics[text.substr(keyBegin + 1, keyEnd - keyBegin - 1)] = value;
+			position = valueEnd - text.c_str();
+		}
+		return metrics;
+	}
+
+	bool endsWith(const std::string& text, const std::string& suffix) {
+		return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	// Returns the number of regressions
+	uint32_t compareWithBaseline(const Metrics& metrics, const Metrics& baseline, double tolerance) {
+		uint32_t regressions = 0;
+
+		std::cout << std::endl << "metric                                      baseline     current   change" << std::endl;
+		for (const auto& entry : metrics) {
+			const std::string& name = entry.first;
+			const bool higherIsBetter = endsWith(name, "_per_s");
+			if (!higherIsBetter && !endsWith(name, ".mean_ms") && !endsWith(name, ".p50_ms")) continue;
+
+			auto found = baseline.find(name);
+			if (found == baseline.end() || found->second <= 0.0) continue;
+
+			const double change = entry.second / found->second - 1.0;
+			const bool regressed = higherIsBetter ? change < -tolerance : change > tolerance;
+			if (regressed) {
+				regressions++;
+			}
+
+			std::cout << std::left << std::setw(42) << name << std::right
+				<< std::setw(10) << std::fixed << std::setprecision(3) << found->second
+				<< std::setw(12) << entry.second
+				<< std::setw(8) << std::setprecision(1) << change * 100.0 << "%"
+				<< (regressed ? "  REGRESSION" : "") << std::endl;
+		}
+
+		return regressions;
+	}
+}
+
+// Nothing but the base, to time its construction and destruction
+class InitProbe : public VulkanBaseGLFW
+{
+public:
+	InitProbe() : VulkanBaseGLFW("VulkanBaseBenchmark", 256, 256, true) {
+	}
+
+	const VkPhysicalDeviceProperties& getDeviceProperties() const { return this->deviceProfile.getProperties(); }
+};
+
+class SyntheticScene : public BenchmarkScene
+{
+public:
+	enum class Workload {
+		DrawCalls, // drawCount draws of one tiny triangle each
+		Vertices, // A single draw of VERTEX_TRIANGLES tiny triangles
+		FillRate // FILL_LAYERS blended triangles covering the whole frame
+	};
+
+	static constexpr uint32_t VERTEX_TRIANGLES = 1 << 20;
+	static constexpr uint32_t FILL_LAYERS = 32;
+
+	SyntheticScene(uint32_t drawCount, const std::string& shaderDirectory)
+		: BenchmarkScene("VulkanBaseBenchmark", 1280, 720, drawCount, shaderDirectory) {
+		this->gridPipeline = createPipeline(shaderDirectory + "/grid.vert.spv", shaderDirectory + "/draw.frag.spv");
+		this->fillPipeline = createPipeline(shaderDirectory + "/draw.vert.spv", shaderDirectory + "/draw.frag.spv", false, true);
+	}
+
+	// Wall time of every drawFrame call after warmUpFrames. Frames are throttled by framesInFlight, so once
+	// the pipeline is full this is the time per frame of whichever of the CPU and the GPU is slower.
+	std::vector<double> measureFrames(Workload workload, uint32_t warmUpFrames, uint32_t frameCount) {
+		this->workload = workload;
+		run(warmUpFrames);
+
+		std::vector<double> samples;
+		samples.reserve(frameCount);
+		for (uint32_t i = 0; i < frameCount; i++) {
+			auto start = std::chrono::steady_clock::now();
+			drawFrame();
+			samples.push_back(millisecondsSince(start));
+		}
+		vkDeviceWaitIdle(this->device);
+		return samples;
+	}
+
+	// Median GPU time of the workload's pass, 0 when the queue has no timestamps
+	double getGpuMilliseconds(Workload workload) const {
+		auto stats = this->gpuProfiler.getStats();
+		auto found = stats.find(getScopeName(workload));
+		return found != stats.end() ? found->second.p50 : 0.0;
+	}
+
+	// Recreates the offscreen images, alternating between two sizes like a window being resized, drawing a frame in
+	// between so retired resources get destroyed as they would be
+	std::vector<double> measureRecreation(uint32_t count) {
+		const VkExtent2D originalExtent = this->swapChainExtent;
+		this->workload = Workload::DrawCalls;
+
+		std::vector<double> samples;
+		samples.reserve(count);
+		for (uint32_t i = 0; i < count; i++) {
+			this->swapChainExtent = i % 2 == 0 ? VkExtent2D{ 1024, 768 } : originalExtent;
+
+			auto start = std::chrono::steady_clock::now();
+			recreateSwapChain();
+			samples.push_back(millisecondsSince(start));
+
+			drawFrame();
+		}
+		vkDeviceWaitIdle(this->device);
+		return samples;
+	}
+
+	// Creates imageCount sampled images through createImage, then destroys them, rounds times.
+	// Returns the creation and destruction time of each round.
+	void measureImageAllocation(uint32_t rounds, uint32_t imageCount, uint32_t size, std::vector<double>& createSamples, std::vector<double>& destroySamples) {
+		std::vector<VkImage> images(imageCount);
+		std::vector<MemoryAllocation> allocations(imageCount);
+
+		for (uint32_t round = 0; round < rounds; round++) {
+			auto start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < imageCount; i++) {
+				createImage(size, size, 1, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+					VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, images[i], allocations[i]);
+			}
+			createSamples.push_back(millisecondsSince(start));
+
+			start = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < imageCount; i++) {
+				destroyImage(images[i], allocations[i]);
+			}
+			destroySamples.push_back(millisecondsSince(start));
+		}
+	}
+
+protected:
+	void recordCommandBuffer(FrameResources& frame, uint32_t imageIndex) override {
+		GpuScope scope(this->gpuProfiler, frame.commandBuffer, getScopeName(this->workload));
+		beginRenderPass(frame.commandBuffer, imageIndex);
+
+		switch (this->workload) {
+		case Workload::DrawCalls:
+			recordDraws(frame.commandBuffer, 0, this->drawCount);
+			break;
+		case Workload::Vertices: {
+			const uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(VERTEX_TRIANGLES))));
+			DrawPushConstants pushConstants = { { static_cast<float>(columns), 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } };
+			bindPipeline(frame.commandBuffer, this->gridPipeline);
+			vkCmdPushConstants(frame.commandBuffer, this->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+			vkCmdDraw(frame.commandBuffer, VERTEX_TRIANGLES * 3, 1, 0, 0);
+			break;
+		}
+		case Workload::FillRate:
+			bindPipeline(frame.commandBuffer, this->fillPipeline);
+			for (uint32_t layer = 0; layer < FILL_LAYERS; layer++) {
+				// Scaled by 4 the triangle of draw.vert covers the whole frame
+				const float shade = static_cast<float>(layer) / FILL_LAYERS;
+				DrawPushConstants pushConstants = { { 0.0f, 0.0f, 4.0f, 4.0f }, { shade, 1.0f - shade, 0.5f, 0.1f } };
+				vkCmdPushConstants(frame.commandBuffer, this->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+				vkCmdDraw(frame.commandBuffer, 3, 1, 0, 0);
+			}
+			break;
+		}
+
+		vkCmdEndRenderPass(frame.commandBuffer);
+	}
+
+private:
+	Workload workload = Workload::DrawCalls;
+	VkPipeline gridPipeline = VK_NULL_HANDLE;
+	VkPipeline fillPipeline = VK_NULL_HANDLE;
+
+	static const char* getScopeName(Workload workload) {
+		switch (workload) {
+		case Workload::DrawCalls: return "Draw calls";
+		case Workload::Vertices: return "Vertices";
+		case Workload::FillRate: return "Fill rate";
+		}
+		return "";
+	}
+};
+
+namespace {
+	Options parseOptions(int argc, char** argv) {
+		Options options;
+		for (int i = 1; i < argc; i++) {
+			auto value = [&]() -> std::string {
+				if (i + 1 >= argc) {
+					throw std::runtime_error(std::string("Missing value for ") + argv[i]);
+				}
+				return argv[++i];
+			};
+
+			if (std::strcmp(argv[i], "--shaders") == 0) options.shaderDirectory = value();
+			else if (std::strcmp(argv[i], "--output") == 0) options.outputPath = value();
+			else if (std::strcmp(argv[i], "--baseline") == 0) options.baselinePath = value();
+			else if (std::strcmp(argv[i], "--tolerance") == 0) options.tolerance = std::stod(value());
+			else if (std::strcmp(argv[i], "--quick") == 0) options.quick = true;
+			else throw std::runtime_error(std::string("Unknown option ") + argv[i]);
+		}
+		return options;
+	}
+
+	void writeResults(std::ostream& stream, const VkPhysicalDeviceProperties& properties, const Metrics& metrics) {
+		stream << "{\n";
+		stream << "\t\"device\": \"" << escapeJson(properties.deviceName) << "\",\n";
+		stream << "\t\"driverVersion\": " << properties.driverVersion << ",\n";
+		stream << "\t\"apiVersion\": \"" << VK_VERSION_MAJOR(properties.apiVersion) << "." << VK_VERSION_MINOR(properties.apiVersion) << "." << VK_VERSION_PATCH(properties.apiVersion) << "\",\n";
+		stream << "\t\"validation\": " << (enableValidationLayers ? "true" : "false") << ",\n";
+		stream << "\t\"metrics\": {";
+
+		stream << std::fixed << std::setprecision(4);
+		bool first = true;
+		for (const auto& entry : metrics) {
+			stream << (first ? "\n" : ",\n") << "\t\t\"" << entry.first << "\": " << entry.second;
+			first = false;
+		}
+		stream << "\n\t}\n}\n";
+	}
+}
+
+int main(int argc, char** argv) {
+	try {
+		const Options options = parseOptions(argc, argv);
+		if (enableValidationLayers) {
+			std::cerr << "Warning: validation layers are enabled, build with NDEBUG for meaningful numbers" << std::endl;
+		}
+
+		const uint32_t initRuns = options.quick ? 2 : 5;
+		const uint32_t warmUpFrames = options.quick ? 10 : 30;
+		const uint32_t frameCount = options.quick ? 60 : 300;
+		const uint32_t recreations = options.quick ? 10 : 50;
+		const uint32_t allocationRounds = options.quick ? 4 : 16;
+		const uint32_t imagesPerRound = 256;
+
+		Metrics metrics;
+		VkPhysicalDeviceProperties properties{};
+
+		std::cout << "Init..." << std::endl;
+		{
+			std::vector<double> createSamples;
+			std::vector<double> destroySamples;
+			for (uint32_t i = 0; i < initRuns; i++) {
+				auto start = std::chrono::steady_clock::now();
+				auto probe = std::make_unique<InitProbe>();
+				createSamples.push_back(millisecondsSince(start));
+				properties = probe->getDeviceProperties();
+
+				start = std::chrono::steady_clock::now();
+				probe.reset();
+				destroySamples.push_back(millisecondsSince(start));
+			}
+			addDistribution(metrics, "init.create", createSamples);
+			addDistribution(metrics, "init.destroy", destroySamples);
+		}
+
+		SyntheticScene scene(20000, options.shaderDirectory);
+
+		std::cout << "Offscreen recreation..." << std::endl;
+		addDistribution(metrics, "recreate", scene.measureRecreation(recreations));
+
+		std::cout << "Image allocation..." << std::endl;
+		{
+			std::vector<double> createSamples;
+			std::vector<double> destroySamples;
+			scene.measureImageAllocation(allocationRounds, imagesPerRound, 512, createSamples, destroySamples);
+			addDistribution(metrics, "images.create_256", createSamples);
+			addDistribution(metrics, "images.destroy_256", destroySamples);
+			metrics["images.create_per_s"] = imagesPerRound * 1000.0 / metrics["images.create_256.mean_ms"];
+		}
+
+		const std::pair<SyntheticScene::Workload, const char*> workloads[] = {
+			{ SyntheticScene::Workload::DrawCalls, "frame.draw_calls" },
+			{ SyntheticScene::Workload::Vertices, "frame.vertices" },
+			{ SyntheticScene::Workload::FillRate, "frame.fill_rate" },
+		};
+		for (const auto& workload : workloads) {
+			std::cout << "Scene " << workload.second << "..." << std::endl;
+			addDistribution(metrics, workload.second, scene.measureFrames(workload.first, warmUpFrames, frameCount));
+
+			const double gpuMilliseconds = scene.getGpuMilliseconds(workload.first);
+			if (gpuMilliseconds > 0.0) {
+				metrics[std::string(workload.second) + ".gpu.p50_ms"] = gpuMilliseconds;
+			}
+		}
+
+		writeResults(std::cout, properties, metrics);
+		if (!options.outputPath.empty()) {
+			std::ofstream file(options.outputPath, std::ios::trunc);
+			if (!file.is_open()) {
+				throw std::runtime_error("Failed to open " + options.outputPath);
+			}
+			writeResults(file, properties, metrics);
+		}
+
+		if (!options.baselinePath.empty()) {
+			const uint32_t regressions = compareWithBaseline(metrics, readMetrics(options.baselinePath), options.tolerance);
+			if (regressions > 0) {
+				std::cout << regressions << " metric(s) regressed by more than " << options.tolerance * 100.0 << "%" << std::endl;
+				return EXIT_REGRESSION;
+			}
+		}
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,20 @@
+#version 450
+
+// One small triangle per draw, placed by push constants, so the CPU side is all that is measured
+layout(push_constant) uniform PushConstants {
+	vec4 offsetScale;
+	vec4 color;
+} pushConstants;
+
+layout(location = 0) out vec4 fragColor;
+
+vec2 positions[3] = vec2[](
+	vec2(0.0, -1.0),
+	vec2(1.0, 1.0),
+	vec2(-1.0, 1.0)
+);
+
+void main() {
+	gl_Position = vec4(positions[gl_VertexIndex] * pushConstants.offsetScale.zw + pushConstants.offsetScale.xy, 0.0, 1.0);
+	fragColor = pushConstants.color;
+}
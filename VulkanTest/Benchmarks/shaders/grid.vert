@@ -0,0 +1,26 @@
+#version 450
+
+// Dense grid of tiny triangles generated from gl_VertexIndex, so a single draw is bound by vertex processing.
+// offsetScale.x holds the number of columns of the grid.
+layout(push_constant) uniform PushConstants {
+	vec4 offsetScale;
+	vec4 color;
+} pushConstants;
+
+layout(location = 0) out vec4 fragColor;
+
+vec2 corners[3] = vec2[](
+	vec2(0.0, 0.0),
+	vec2(1.0, 0.0),
+	vec2(0.0, 1.0)
+);
+
+void main() {
+	uint columns = uint(pushConstants.offsetScale.x);
+	uint triangle = uint(gl_VertexIndex) / 3u;
+	vec2 cell = vec2(triangle % columns, triangle / columns);
+	vec2 position = (cell + corners[gl_VertexIndex % 3] * 0.5) / float(columns);
+
+	gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+	fragColor = vec4(position, 0.5, 1.0) * pushConstants.color;
+}
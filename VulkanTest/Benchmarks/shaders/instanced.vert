@@ -0,0 +1,29 @@
+#version 450
+
+// Objects of GpuCullingBenchmark: every draw passes its object index as firstInstance, both on the CPU path and in the
+// commands written by shaders/cull.comp
+layout(set = 0, binding = 2) readonly buffer Transforms {
+	mat4 transforms[];
+};
+
+layout(push_constant) uniform PushConstants {
+	mat4 viewProjection;
+} pushConstants;
+
+layout(location = 0) out vec4 fragColor;
+
+// Triangle mesh (vertices 0 to 2) then quad mesh (vertices 3 to 6)
+vec3 positions[7] = vec3[](
+	vec3(0.0, -0.5, 0.0),
+	vec3(0.5, 0.5, 0.0),
+	vec3(-0.5, 0.5, 0.0),
+	vec3(-0.5, -0.5, 0.0),
+	vec3(0.5, -0.5, 0.0),
+	vec3(0.5, 0.5, 0.0),
+	vec3(-0.5, 0.5, 0.0)
+);
+
+void main() {
+	gl_Position = pushConstants.viewProjection * transforms[gl_InstanceIndex] * vec4(positions[gl_VertexIndex], 1.0);
+	fragColor = vec4(fract(vec3(gl_InstanceIndex) * vec3(0.13, 0.37, 0.71)), 1.0);
+}
@@ -0,0 +1,178 @@
+#include "BlockDecoder.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+	void expand565(uint16_t color, uint8_t* rgb) {
+		const uint32_t r = (color >> 11) & 0x1f;
+		const uint32_t g = (color >> 5) & 0x3f;
+		const uint32_t b = color & 0x1f;
+		rgb[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+		rgb[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+		rgb[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+	}
+
+	// Color block shared by BC1, BC2 and BC3. BC2 and BC3 always use the 4 color mode, BC1 switches to 3 colors and
+	// transparent black when the first endpoint is not greater than the second.
+	void decodeColorBlock(const uint8_t* block, bool allowTransparent, uint8_t pixels[16][4]) {
+		const uint16_t color0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+		const uint16_t color1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+		const uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+
+		uint8_t palette[4][4];
+		expand565(color0, palette[0]);
+		expand565(color1, palette[1]);
+		palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+		const bool fourColors = !allowTransparent || color0 > color1;
+		for (int c = 0; c < 3; c++) {
+			if (fourColors) {
+				palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c] + 1) / 3);
+				palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+			}
+			else {
+				palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c] + 1) / 2);
+				palette[3][c] = 0;
+			}
+		}
+		if (!fourColors) {
+			palette[3][3] = 0;
+		}
+
+		for (int i = 0; i < 16; i++) {
+			memcpy(pixels[i], palette[(indices >> (2 * i)) & 3], 4);
+		}
+	}
+
+	// Single channel block of BC3 alpha, BC4 and BC5: two endpoints and 3 bit indices
+	void decodeChannelBlock(const uint8_t* block, uint8_t pixels[16][4], int channel) {
+		uint8_t palette[8];
+		palette[0] = block[0];
+		palette[1] = block[1];
+		if (palette[0] > palette[1]) {
+			for (int i = 1; i < 7; i++) {
+				palette[i + 1] = static_cast<uint8_t>(((7 - i) * palette[0] + i * palette[1] + 3) / 7);
+			}
+		}
+		else {
+			for (int i = 1; i < 5; i++) {
+				palette[i + 1] = static_cast<uint8_t>(((5 - i) * palette[0] + i * palette[1] + 2) / 5);
+			}
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		uint64_t indices = 0;
+		for (int i = 0; i < 6; i++) {
+			indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+		}
+		for (int i = 0; i < 16; i++) {
+			pixels[i][channel] = palette[(indices >> (3 * i)) & 7];
+		}
+	}
+}
+
+bool BlockDecoder::canDecode(VkFormat format) {
+	return getBlockSize(format) != 0;
+}
+
+VkFormat BlockDecoder::getDecodedFormat(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+		return VK_FORMAT_R8G8B8A8_SRGB;
+	default:
+		return VK_FORMAT_R8G8B8A8_UNORM;
+	}
+}
+
+uint32_t BlockDecoder::getBlockSize(VkFormat format) {
+	switch (format) {
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+		return 8;
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+size_t BlockDecoder::getLevelSize(VkFormat format, uint32_t width, uint32_t height) {
+	return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+}
+
+void BlockDecoder::decode(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba) {
+	const uint32_t blockSize = getBlockSize(format);
+	if (blockSize == 0) {
+		throw std::runtime_error("No CPU decoder for this texture format");
+	}
+
+	const uint32_t blocksX = (width + 3) / 4;
+	const uint32_t blocksY = (height + 3) / 4;
+	for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+		for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+			const uint8_t* block = blocks + (static_cast<size_t>(blockY) * blocksX + blockX) * blockSize;
+			uint8_t pixels[16][4];
+
+			switch (format) {
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+				decodeColorBlock(block, true, pixels);
+				// No alpha in these formats, the transparent index is plain black
+				for (auto& pixel : pixels) {
+					pixel[3] = 255;
+				}
+				break;
+			case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+				decodeColorBlock(block, true, pixels);
+				break;
+			case VK_FORMAT_BC2_UNORM_BLOCK:
+			case VK_FORMAT_BC2_SRGB_BLOCK:
+				decodeColorBlock(block + 8, false, pixels);
+				for (int i = 0; i < 16; i++) {
+					const uint32_t alpha = (block[i / 2] >> (4 * (i % 2))) & 0xf;
+					pixels[i][3] = static_cast<uint8_t>(alpha * 17);
+				}
+				break;
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+			case VK_FORMAT_BC3_SRGB_BLOCK:
+				decodeColorBlock(block + 8, false, pixels);
+				decodeChannelBlock(block, pixels, 3);
+				break;
+			case VK_FORMAT_BC4_UNORM_BLOCK:
+				memset(pixels, 0, sizeof(pixels));
+				decodeChannelBlock(block, pixels, 0);
+				for (auto& pixel : pixels) {
+					pixel[3] = 255;
+				}
+				break;
+			default: // BC5
+				memset(pixels, 0, sizeof(pixels));
+				decodeChannelBlock(block, pixels, 0);
+				decodeChannelBlock(block + 8, pixels, 1);
+				for (auto& pixel : pixels) {
+					pixel[3] = 255;
+				}
+				break;
+			}
+
+			// Blocks overhanging the edges of the level are clipped
+			for (uint32_t y = 0; y < 4 && blockY * 4 + y < height; y++) {
+				for (uint32_t x = 0; x < 4 && blockX * 4 + x < width; x++) {
+					memcpy(rgba + ((static_cast<size_t>(blockY) * 4 + y) * width + blockX * 4 + x) * 4, pixels[y * 4 + x], 4);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// CPU decoding of block compressed formats, for devices that cannot sample them. Decoded images are
+// R8G8B8A8, sRGB when the source is; channels missing from the source are 0, alpha 255.
+class BlockDecoder
+{
+public:
+	// BC1 to BC5, the formats every desktop tool chain emits and mobile GPUs usually lack
+	static bool canDecode(VkFormat format);
+
+	// R8G8B8A8_SRGB or R8G8B8A8_UNORM
+	static VkFormat getDecodedFormat(VkFormat format);
+
+	// Bytes of one 4x4 block
+	static uint32_t getBlockSize(VkFormat format);
+
+	// Bytes of a width x height level, partial blocks at the edges included
+	static size_t getLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+	// Decodes a width x height level into width * height * 4 bytes
+	static void decode(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba);
+};
@@ -0,0 +1,211 @@
+#include "CpuTrace.hpp"
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CPU_TRACE_HAS_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CPU_TRACE_HAS_TSC
+#endif
+
+std::atomic<bool> CpuTrace::active{ false };
+
+namespace {
+	struct TraceEvent {
+		const char* name;
+		uint64_t beginTicks;
+		uint64_t endTicks;
+	};
+
+	// Single producer (the owning thread), single consumer (the flusher)
+	struct ThreadRing {
+		alignas(64) std::atomic<uint32_t> head{ 0 };
+		alignas(64) std::atomic<uint32_t> tail{ 0 };
+		std::atomic<uint64_t> dropped{ 0 };
+		uint32_t threadId = 0;
+		std::string threadName; // Guarded by TraceState::mutex
+		bool threadNameWritten = false;
+		TraceEvent events[CpuTrace::RING_CAPACITY];
+	};
+
+	struct TraceState {
+		std::mutex mutex; // Guards everything below but the ring contents
+		std::vector<std::unique_ptr<ThreadRing>> rings; // Never freed, threads keep a pointer to theirs
+		std::thread flusher;
+		std::condition_variable wake;
+		bool stopping = false;
+		std::ofstream file;
+		uint64_t calibrationTicks = 0;
+		double calibrationMicroseconds = 0.0;
+		double ticksPerMicrosecond = 1.0;
+	};
+
+	TraceState& getState() {
+		static TraceState state;
+		return state;
+	}
+
+	thread_local ThreadRing* threadRing = nullptr;
+
+	double steadyMicroseconds() {
+		return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	ThreadRing& registerThread() {
+		TraceState& state = getState();
+		std::lock_guard<std::mutex> lock(state.mutex);
+
+		state.rings.push_back(std::make_unique<ThreadRing>());
+		threadRing = state.rings.back().get();
+		threadRing->threadId = static_cast<uint32_t>(state.rings.size() - 1);
+		return *threadRing;
+	}
+
+	// The TSC rate is measured over the whole trace so far, which gets more precise as the trace goes on
+	void recalibrate(TraceState& state) {
+		uint64_t ticks = CpuTrace::now();
+		double microseconds = steadyMicroseconds();
+		if (microseconds - state.calibrationMicroseconds > 1000.0) {
+			state.ticksPerMicrosecond = (ticks - state.calibrationTicks) / (microseconds - state.calibrationMicroseconds);
+		}
+	}
+
+	double toMicroseconds(const TraceState& state, uint64_t ticks) {
+		return state.calibrationMicroseconds + (static_cast<double>(ticks) - static_cast<double>(state.calibrationTicks)) / state.ticksPerMicrosecond;
+	}
+
+	// Called with state.mutex held
+	void drain(TraceState& state) {
+		recalibrate(state);
+
+		for (auto& ring : state.rings) {
+			if (!ring->threadNameWritten && !ring->threadName.empty()) {
+				state.file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << ring->threadId
+					<< ",\"args\":{\"name\":\"" << ring->threadName << "\"}}";
+				ring->threadNameWritten = true;
+			}
+
+			const uint32_t head = ring->head.load(std::memory_order_acquire);
+			uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+			for (; tail != head; tail++) {
+				const TraceEvent& event = ring->events[tail & (CpuTrace::RING_CAPACITY - 1)];
+				const double begin = toMicroseconds(state, event.beginTicks);
+				const double end = toMicroseconds(state, event.endTicks);
+				state.file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":0,\"tid\":" << ring->threadId
+					<< ",\"ts\":" << begin << ",\"dur\":" << end - begin << "}";
+			}
+			ring->tail.store(tail, std::memory_order_release);
+		}
+		state.file.flush();
+	}
+
+	void flusherLoop() {
+		TraceState& state = getState();
+		std::unique_lock<std::mutex> lock(state.mutex);
+		while (!state.stopping) {
+			state.wake.wait_for(lock, std::chrono::milliseconds(CpuTrace::FLUSH_INTERVAL_MS));
+			drain(state);
+		}
+		drain(state);
+	}
+}
+
+void CpuTrace::start(const std::string& path) {
+	if (isActive()) return;
+
+	TraceState& state = getState();
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+
+		state.file.open(path, std::ios::trunc);
+		if (!state.file.is_open()) {
+			return;
+		}
+		state.file << std::fixed << std::setprecision(3);
+		state.file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		state.file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"CPU\"}}";
+
+		// Anything left over from a previous trace is discarded
+		for (auto& ring : state.rings) {
+			ring->tail.store(ring->head.load(std::memory_order_acquire), std::memory_order_release);
+			ring->dropped = 0;
+			ring->threadNameWritten = false;
+		}
+
+		// Initial TSC rate estimate, refined by every flush
+		state.calibrationTicks = now();
+		state.calibrationMicroseconds = steadyMicroseconds();
+		state.ticksPerMicrosecond = 1.0;
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		state.ticksPerMicrosecond = (now() - state.calibrationTicks) / (steadyMicroseconds() - state.calibrationMicroseconds);
+
+		state.stopping = false;
+		state.flusher = std::thread(flusherLoop);
+	}
+
+	active.store(true, std::memory_order_release);
+}
+
+void CpuTrace::stop() {
+	if (!isActive()) return;
+	active.store(false, std::memory_order_release);
+
+	TraceState& state = getState();
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		state.stopping = true;
+	}
+	state.wake.notify_all();
+	state.flusher.join();
+
+	std::lock_guard<std::mutex> lock(state.mutex);
+	for (auto& ring : state.rings) {
+		if (ring->dropped > 0) {
+			state.file << ",\n{\"name\":\"Dropped zones\",\"ph\":\"C\",\"pid\":0,\"tid\":" << ring->threadId
+				<< ",\"ts\":" << steadyMicroseconds() << ",\"args\":{\"count\":" << ring->dropped.load() << "}}";
+		}
+	}
+	state.file << "\n]}\n";
+	state.file.close();
+}
+
+void CpuTrace::setThreadName(const char* name) {
+	ThreadRing& ring = threadRing != nullptr ? *threadRing : registerThread();
+
+	std::lock_guard<std::mutex> lock(getState().mutex);
+	ring.threadName = name;
+	ring.threadNameWritten = false;
+}
+
+uint64_t CpuTrace::now() {
+#ifdef CPU_TRACE_HAS_TSC
+	return __rdtsc();
+#else
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+void CpuTrace::record(const char* name, uint64_t beginTicks, uint64_t endTicks) {
+	if (!isActive()) return;
+
+	ThreadRing& ring = threadRing != nullptr ? *threadRing : registerThread();
+
+	const uint32_t head = ring.head.load(std::memory_order_relaxed);
+	const uint32_t tail = ring.tail.load(std::memory_order_acquire);
+	if (head - tail == RING_CAPACITY) {
+		ring.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ring.events[head & (RING_CAPACITY - 1)] = { name, beginTicks, endTicks };
+	ring.head.store(head + 1, std::memory_order_release);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+// Scoped CPU zones written by each thread into its own single producer ring, drained by a background flusher into a
+// Chrome trace file (chrome://tracing, Perfetto). Zones are timestamped with the TSC where available and converted to
+// microseconds of std::chrono::steady_clock when flushed, the same time base as GpuProfiler's trace.
+//
+// Everything compiles out unless VULKAN_BASE_CPU_TRACE is defined, use the macros rather than the classes:
+//   CPU_TRACE_START("cpu_trace.json");
+//   { CPU_TRACE_ZONE("Record"); ... }
+//   CPU_TRACE_STOP();
+
+class CpuTrace
+{
+public:
+	static constexpr uint32_t RING_CAPACITY = 1 << 14; // Events per thread, zones are dropped when a ring is full
+	static constexpr uint32_t FLUSH_INTERVAL_MS = 10;
+
+	static void start(const std::string& path);
+
+	// Drains every ring and closes the file
+	static void stop();
+
+	static bool isActive() { return active.load(std::memory_order_relaxed); }
+
+	// Labels the calling thread in the trace
+	static void setThreadName(const char* name);
+
+	static uint64_t now();
+
+	// name must outlive the trace, string literals are the intended use
+	static void record(const char* name, uint64_t beginTicks, uint64_t endTicks);
+
+private:
+	static std::atomic<bool> active;
+};
+
+class CpuTraceZone
+{
+public:
+	explicit CpuTraceZone(const char* name) : name(name), beginTicks(CpuTrace::isActive() ? CpuTrace::now() : 0) {
+	}
+	~CpuTraceZone() {
+		if (this->beginTicks != 0) {
+			CpuTrace::record(this->name, this->beginTicks, CpuTrace::now());
+		}
+	}
+
+private:
+	const char* name;
+	uint64_t beginTicks;
+};
+
+#ifdef VULKAN_BASE_CPU_TRACE
+#define CPU_TRACE_CONCAT_INNER(a, b) a##b
+#define CPU_TRACE_CONCAT(a, b) CPU_TRACE_CONCAT_INNER(a, b)
+#define CPU_TRACE_ZONE(name) CpuTraceZone CPU_TRACE_CONCAT(cpuTraceZone, __LINE__)(name)
+#define CPU_TRACE_START(path) CpuTrace::start(path)
+#define CPU_TRACE_STOP() CpuTrace::stop()
+#define CPU_TRACE_THREAD_NAME(name) CpuTrace::setThreadName(name)
+#else
+#define CPU_TRACE_ZONE(name) ((void)0)
+#define CPU_TRACE_START(path) ((void)0)
+#define CPU_TRACE_STOP() ((void)0)
+#define CPU_TRACE_THREAD_NAME(name) ((void)0)
+#endif
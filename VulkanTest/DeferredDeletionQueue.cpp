@@ -0,0 +1,175 @@
+#include "DeferredDeletionQueue.hpp"
+#include "CpuTrace.hpp"
+
+#include <stdexcept>
+
+void DeferredDeletionQueue::init(VkDevice device, DeviceMemoryAllocator& allocator, VkSemaphore timeline) {
+	this->device = device;
+	this->allocator = &allocator;
+	this->timeline = timeline;
+	this->retireValue = 1;
+	this->destroyedObjects = 0;
+}
+
+void DeferredDeletionQueue::cleanup() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	for (auto& batch : this->batches) {
+		destroy(batch);
+	}
+	this->batches.clear();
+}
+
+void DeferredDeletionQueue::retireFramebuffer(VkFramebuffer framebuffer) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Batch& batch = currentBatch();
+	batch.framebuffers.push_back(framebuffer);
+	batch.objectCount++;
+}
+
+void DeferredDeletionQueue::retireRenderPass(VkRenderPass renderPass) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Batch& batch = currentBatch();
+	batch.renderPasses.push_back(renderPass);
+	batch.objectCount++;
+}
+
+void DeferredDeletionQueue::retirePipeline(VkPipeline pipeline) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Batch& batch = currentBatch();
+	batch.pipelines.push_back(pipeline);
+	batch.objectCount++;
+}
+
+void DeferredDeletionQueue::retireImageView(VkImageView imageView) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Batch& batch = currentBatch();
+	batch.imageViews.push_back(imageView);
+	batch.objectCount++;
+}
+
+void DeferredDeletionQueue::retireImage(VkImage image, const MemoryAllocation& allocation) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Batch& batch = currentBatch();
+	batch.images.push_back(image);
+	batch.objectCount++;
+	if (allocation.memory != VK_NULL_HANDLE) {
+		batch.allocations.push_back(allocation);
+	}
+}
+
+void DeferredDeletionQueue::retireBuffer(VkBuffer buffer, const MemoryAllocation& allocation) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Batch& batch = currentBatch();
+	batch.buffers.push_back(buffer);
+	batch.objectCount++;
+	if (allocation.memory != VK_NULL_HANDLE) {
+		batch.allocations.push_back(allocation);
+	}
+}
+
+void DeferredDeletionQueue::retireMemory(const MemoryAllocation& allocation) {
+	if (allocation.memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Batch& batch = currentBatch();
+	batch.allocations.push_back(allocation);
+	batch.objectCount++;
+}
+
+void DeferredDeletionQueue::retireSwapchain(VkSwapchainKHR swapchain) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Batch& batch = currentBatch();
+	batch.swapchains.push_back(swapchain);
+	batch.objectCount++;
+}
+
+void DeferredDeletionQueue::retireSemaphore(VkSemaphore semaphore) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Batch& batch = currentBatch();
+	batch.semaphores.push_back(semaphore);
+	batch.objectCount++;
+}
+
+void DeferredDeletionQueue::retire(std::function<void()> release) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Batch& batch = currentBatch();
+	batch.releases.push_back(std::move(release));
+	batch.objectCount++;
+}
+
+uint32_t DeferredDeletionQueue::collect() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->batches.empty()) {
+		return 0;
+	}
+
+	uint64_t completedValue = 0;
+	if (vkGetSemaphoreCounterValue(this->device, this->timeline, &completedValue) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to read the frame timeline semaphore");
+	}
+
+	CPU_TRACE_ZONE("Collect retired objects");
+	uint32_t destroyed = 0;
+	while (!this->batches.empty() && this->batches.front().value <= completedValue) {
+		destroyed += this->batches.front().objectCount;
+		destroy(this->batches.front());
+		this->batches.pop_front();
+	}
+	return destroyed;
+}
+
+DeletionQueueStats DeferredDeletionQueue::getStats() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	DeletionQueueStats stats;
+	stats.pendingBatches = static_cast<uint32_t>(this->batches.size());
+	for (const auto& batch : this->batches) {
+		stats.pendingObjects += batch.objectCount;
+	}
+	stats.destroyedObjects = this->destroyedObjects;
+	return stats;
+}
+
+DeferredDeletionQueue::Batch& DeferredDeletionQueue::currentBatch() {
+	const uint64_t value = this->retireValue.load();
+	if (this->batches.empty() || this->batches.back().value < value) {
+		this->batches.emplace_back();
+		this->batches.back().value = value;
+	}
+	return this->batches.back();
+}
+
+void DeferredDeletionQueue::destroy(Batch& batch) {
+	for (VkFramebuffer framebuffer : batch.framebuffers) {
+		vkDestroyFramebuffer(this->device, framebuffer, nullptr);
+	}
+	for (VkRenderPass renderPass : batch.renderPasses) {
+		vkDestroyRenderPass(this->device, renderPass, nullptr);
+	}
+	for (VkPipeline pipeline : batch.pipelines) {
+		vkDestroyPipeline(this->device, pipeline, nullptr);
+	}
+	for (VkImageView imageView : batch.imageViews) {
+		vkDestroyImageView(this->device, imageView, nullptr);
+	}
+	for (VkImage image : batch.images) {
+		vkDestroyImage(this->device, image, nullptr);
+	}
+	for (VkBuffer buffer : batch.buffers) {
+		vkDestroyBuffer(this->device, buffer, nullptr);
+	}
+	for (auto& allocation : batch.allocations) {
+		this->allocator->free(allocation);
+	}
+	for (VkSwapchainKHR swapchain : batch.swapchains) {
+		vkDestroySwapchainKHR(this->device, swapchain, nullptr);
+	}
+	for (VkSemaphore semaphore : batch.semaphores) {
+		vkDestroySemaphore(this->device, semaphore, nullptr);
+	}
+	for (auto& release : batch.releases) {
+		release();
+	}
+	this->destroyedObjects += batch.objectCount;
+}
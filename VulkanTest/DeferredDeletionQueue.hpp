@@ -0,0 +1,95 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+#include "DeviceMemoryAllocator.hpp"
+
+struct DeletionQueueStats {
+	uint32_t pendingBatches = 0;
+	uint32_t pendingObjects = 0;
+	uint64_t destroyedObjects = 0; // Since init
+};
+
+// Objects that command buffers submitted or being recorded may still reference. Each is retired with the timeline
+// value the GPU signals once that work has completed, and destroyed in batches by collect once the timeline semaphore
+// has passed it, so replacing a resource mid-run never waits for the device.
+// Retiring is thread safe, collect and cleanup must be called from one thread.
+class DeferredDeletionQueue
+{
+public:
+	void init(VkDevice device, DeviceMemoryAllocator& allocator, VkSemaphore timeline);
+
+	// Destroys everything still queued, the device must be idle
+	void cleanup();
+
+	// The value the timeline reaches once the work recorded so far completes, the submitter advances it after every
+	// submit. Objects are retired with the value current at the time of the call.
+	void setRetireValue(uint64_t value) { this->retireValue.store(value); }
+
+	uint64_t getRetireValue() const { return this->retireValue.load(); }
+
+	void retireFramebuffer(VkFramebuffer framebuffer);
+
+	void retireRenderPass(VkRenderPass renderPass);
+
+	void retirePipeline(VkPipeline pipeline);
+
+	void retireImageView(VkImageView imageView);
+
+	// allocation may be empty for images bound to memory retired separately
+	void retireImage(VkImage image, const MemoryAllocation& allocation = MemoryAllocation{});
+
+	void retireBuffer(VkBuffer buffer, const MemoryAllocation& allocation = MemoryAllocation{});
+
+	void retireMemory(const MemoryAllocation& allocation);
+
+	void retireSwapchain(VkSwapchainKHR swapchain);
+
+	// Destroyed after the swapchains of its batch, a present may still be waiting on it
+	void retireSemaphore(VkSemaphore semaphore);
+
+	// For what is not a Vulkan object, a descriptor index to recycle for instance. Called from collect or cleanup
+	// after the objects of the same batch are destroyed, release must not retire anything itself.
+	void retire(std::function<void()> release);
+
+	// Destroys the batches the timeline has passed, never waits. Returns the number of objects destroyed.
+	uint32_t collect();
+
+	DeletionQueueStats getStats();
+
+private:
+	// Destroyed in member order: framebuffers before the views they use, views before their images...
+	struct Batch {
+		uint64_t value;
+		std::vector<VkFramebuffer> framebuffers;
+		std::vector<VkRenderPass> renderPasses;
+		std::vector<VkPipeline> pipelines;
+		std::vector<VkImageView> imageViews;
+		std::vector<VkImage> images;
+		std::vector<VkBuffer> buffers;
+		std::vector<MemoryAllocation> allocations;
+		std::vector<VkSwapchainKHR> swapchains;
+		std::vector<VkSemaphore> semaphores;
+		std::vector<std::function<void()>> releases;
+		uint32_t objectCount = 0;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceMemoryAllocator* allocator = nullptr;
+	VkSemaphore timeline = VK_NULL_HANDLE;
+	std::atomic<uint64_t> retireValue{ 1 };
+	std::deque<Batch> batches; // Oldest first, values never decrease
+	uint64_t destroyedObjects = 0;
+	std::mutex mutex;
+
+	// The batch of the current retire value, callers hold mutex
+	Batch& currentBatch();
+
+	void destroy(Batch& batch);
+};
@@ -0,0 +1,185 @@
+#include "DescriptorHeap.hpp"
+
+#include <array>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+void DescriptorHeap::init(VkDevice device, const DeviceProfile& profile, DeferredDeletionQueue& deletionQueue, uint32_t maxSampledImages, uint32_t maxStorageBuffers, uint32_t maxSamplers) {
+	this->device = device;
+	this->deletionQueue = &deletionQueue;
+
+	const VkPhysicalDeviceVulkan12Properties& limits = profile.getVulkan12Properties();
+	this->arrays[SAMPLED_IMAGE_BINDING].capacity = std::min({ maxSampledImages, limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSampledImages });
+	this->arrays[STORAGE_BUFFER_BINDING].capacity = std::min({ maxStorageBuffers, limits.maxDescriptorSetUpdateAfterBindStorageBuffers, limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers });
+	this->arrays[SAMPLER_BINDING].capacity = std::min({ maxSamplers, limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSamplers });
+
+	const VkDescriptorType types[] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_SAMPLER };
+	std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+	std::array<VkDescriptorBindingFlags, 3> bindingFlags{};
+	std::array<VkDescriptorPoolSize, 3> poolSizes{};
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = types[i];
+		bindings[i].descriptorCount = this->arrays[i].capacity;
+		bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+		bindingFlags[i] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+		poolSizes[i].type = types[i];
+		poolSizes[i].descriptorCount = this->arrays[i].capacity;
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(this->device, &layoutInfo, nullptr, &this->descriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create descriptor heap set layout");
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+
+	if (vkCreateDescriptorPool(this->device, &poolInfo, nullptr, &this->descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create descriptor heap pool");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &this->descriptorSetLayout;
+
+	if (vkAllocateDescriptorSets(this->device, &allocInfo, &this->descriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate descriptor heap set");
+	}
+}
+
+void DescriptorHeap::cleanup() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	vkDestroyDescriptorPool(this->device, this->descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(this->device, this->descriptorSetLayout, nullptr);
+	this->descriptorPool = VK_NULL_HANDLE;
+	this->descriptorSetLayout = VK_NULL_HANDLE;
+	this->descriptorSet = VK_NULL_HANDLE;
+	for (auto& array : this->arrays) {
+		array = Array{};
+	}
+}
+
+uint32_t DescriptorHeap::addSampledImage(VkImageView view, VkImageLayout layout) {
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageView = view;
+	imageInfo.imageLayout = layout;
+
+	VkWriteDescriptorSet write{};
+	write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	write.pImageInfo = &imageInfo;
+	return allocate(SAMPLED_IMAGE_BINDING, write);
+}
+
+uint32_t DescriptorHeap::addStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) {
+	VkDescriptorBufferInfo bufferInfo{};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = offset;
+	bufferInfo.range = range;
+
+	VkWriteDescriptorSet write{};
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	write.pBufferInfo = &bufferInfo;
+	return allocate(STORAGE_BUFFER_BINDING, write);
+}
+
+uint32_t DescriptorHeap::addSampler(VkSampler sampler) {
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.sampler = sampler;
+
+	VkWriteDescriptorSet write{};
+	write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	write.pImageInfo = &imageInfo;
+	return allocate(SAMPLER_BINDING, write);
+}
+
+void DescriptorHeap::removeSampledImage(uint32_t index) {
+	remove(SAMPLED_IMAGE_BINDING, index);
+}
+
+void DescriptorHeap::removeStorageBuffer(uint32_t index) {
+	remove(STORAGE_BUFFER_BINDING, index);
+}
+
+void DescriptorHeap::removeSampler(uint32_t index) {
+	remove(SAMPLER_BINDING, index);
+}
+
+void DescriptorHeap::bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t set) const {
+	vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, set, 1, &this->descriptorSet, 0, nullptr);
+}
+
+DescriptorHeapStats DescriptorHeap::getStats() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	DescriptorHeapStats stats;
+	stats.sampledImages = this->arrays[SAMPLED_IMAGE_BINDING].live;
+	stats.storageBuffers = this->arrays[STORAGE_BUFFER_BINDING].live;
+	stats.samplers = this->arrays[SAMPLER_BINDING].live;
+	return stats;
+}
+
+uint32_t DescriptorHeap::allocate(uint32_t binding, VkWriteDescriptorSet& write) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Array& array = this->arrays[binding];
+
+	uint32_t index;
+	if (!array.freeIndices.empty()) {
+		index = array.freeIndices.back();
+		array.freeIndices.pop_back();
+	}
+	else if (array.next < array.capacity) {
+		index = array.next++;
+		array.allocated.push_back(false);
+	}
+	else {
+		throw std::runtime_error("Descriptor heap binding " + std::to_string(binding) + " is full");
+	}
+	array.allocated[index] = true;
+	array.live++;
+
+	// Update after bind, command buffers already recorded with the set see the new entry
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = this->descriptorSet;
+	write.dstBinding = binding;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	vkUpdateDescriptorSets(this->device, 1, &write, 0, nullptr);
+	return index;
+}
+
+void DescriptorHeap::remove(uint32_t binding, uint32_t index) {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		Array& array = this->arrays[binding];
+		if (index >= array.next || !array.allocated[index]) {
+			throw std::runtime_error("Descriptor heap binding " + std::to_string(binding) + " has no entry at index " + std::to_string(index));
+		}
+		array.allocated[index] = false;
+		array.live--;
+	}
+
+	// The entry stays as is, partially bound lets it dangle once its object is destroyed. Frames in flight may still
+	// read it, so the index is only handed out again once they completed.
+	this->deletionQueue->retire([this, binding, index]() {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->arrays[binding].freeIndices.push_back(index);
+	});
+}
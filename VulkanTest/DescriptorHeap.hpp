@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <mutex>
+
+#include "DeviceProfile.hpp"
+#include "DeferredDeletionQueue.hpp"
+
+struct DescriptorHeapStats {
+	uint32_t sampledImages = 0; // Live indices of each array
+	uint32_t storageBuffers = 0;
+	uint32_t samplers = 0;
+};
+
+// One descriptor set holding large arrays of sampled images, storage buffers and samplers, bound once per command
+// buffer. Resources get a stable index in their array, which shaders receive through push constants or buffers and
+// use to index the array (nonuniformEXT where it varies within a draw):
+//   layout(set = N, binding = 0) uniform texture2D textures[];
+//   layout(set = N, binding = 1) buffer Buffers { uint data[]; } buffers[];
+//   layout(set = N, binding = 2) uniform sampler samplers[];
+// The bindings are update after bind and partially bound, so adding a resource never waits and entries no shader
+// reads may be left stale. A removed index is only reused once the frames recorded before the removal completed.
+// Thread safe.
+class DescriptorHeap
+{
+public:
+	static constexpr uint32_t SAMPLED_IMAGE_BINDING = 0;
+	static constexpr uint32_t STORAGE_BUFFER_BINDING = 1;
+	static constexpr uint32_t SAMPLER_BINDING = 2;
+
+	// Capacities are clamped to the update after bind limits of the device. deletionQueue delays the reuse of indices.
+	void init(VkDevice device, const DeviceProfile& profile, DeferredDeletionQueue& deletionQueue, uint32_t maxSampledImages = 65536, uint32_t maxStorageBuffers = 16384, uint32_t maxSamplers = 256);
+
+	void cleanup();
+
+	// Returns the index of the new entry, throws when the array is full. Views and buffers are not owned.
+	uint32_t addSampledImage(VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	uint32_t addStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+	uint32_t addSampler(VkSampler sampler);
+
+	// The object itself may be retired in the same frame, shaders of later frames must not read the index anymore.
+	// Throws for an index that is not in use.
+	void removeSampledImage(uint32_t index);
+
+	void removeStorageBuffer(uint32_t index);
+
+	void removeSampler(uint32_t index);
+
+	void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t set) const;
+
+	// Put it in the pipeline layouts of the shaders indexing the heap
+	VkDescriptorSetLayout getDescriptorSetLayout() const { return this->descriptorSetLayout; }
+
+	VkDescriptorSet getDescriptorSet() const { return this->descriptorSet; }
+
+	DescriptorHeapStats getStats();
+
+private:
+	// Index allocator of one binding
+	struct Array {
+		uint32_t capacity = 0;
+		uint32_t next = 0; // Indices at or above were never handed out
+		uint32_t live = 0;
+		std::vector<uint32_t> freeIndices;
+		std::vector<bool> allocated; // By index below next, catches removing an index twice
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	DeferredDeletionQueue* deletionQueue = nullptr;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	Array arrays[3]; // By binding
+	std::mutex mutex; // Guards arrays and the descriptor writes
+
+	// Takes a free index of binding and writes the descriptor at it, write only has its type and info set
+	uint32_t allocate(uint32_t binding, VkWriteDescriptorSet& write);
+
+	void remove(uint32_t binding, uint32_t index);
+};
@@ -0,0 +1,339 @@
+#include "DeviceMemoryAllocator.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+void DeviceMemoryAllocator::init(const DeviceProfile& profile, VkDevice device, VkDeviceSize preferredBlockSize) {
+	this->profile = &profile;
+	this->device = device;
+	this->preferredBlockSize = preferredBlockSize;
+
+	this->memoryProperties = profile.getMemoryProperties();
+	this->bufferImageGranularity = std::max<VkDeviceSize>(1, profile.getProperties().limits.bufferImageGranularity);
+}
+
+void DeviceMemoryAllocator::cleanup() {
+	for (auto& block : this->blocks) {
+		if (!block) continue;
+
+		if (block->mappedData != nullptr) {
+			vkUnmapMemory(this->device, block->memory);
+		}
+		vkFreeMemory(this->device, block->memory, nullptr);
+	}
+	this->blocks.clear();
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool optimalTiling, AllocationStrategy strategy, MemoryCategory category) {
+	uint32_t memoryTypeIndex = findMemoryType(requirements.memoryTypeBits, properties);
+
+	VkDeviceSize size = requirements.size;
+	VkDeviceSize alignment = std::max<VkDeviceSize>(1, requirements.alignment);
+	if (optimalTiling) {
+		// Optimal images start and end on a granularity boundary, so they can never share a "page" with a linear resource
+		alignment = std::max(alignment, this->bufferImageGranularity);
+		size = alignUp(size, this->bufferImageGranularity);
+	}
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	MemoryAllocation allocation;
+	if (strategy == AllocationStrategy::Dedicated || size > getBlockSize(memoryTypeIndex) / 2) {
+		allocation = allocateDedicated(requirements.size, memoryTypeIndex);
+	}
+	else {
+		bool allocated = false;
+		for (uint32_t i = 0; i < this->blocks.size() && !allocated; i++) {
+			allocated = this->blocks[i] && this->blocks[i]->memoryTypeIndex == memoryTypeIndex && this->blocks[i]->strategy == strategy
+				&& allocateFromBlock(i, size, alignment, allocation);
+		}
+
+		if (!allocated && !allocateFromBlock(createBlock(memoryTypeIndex, strategy), size, alignment, allocation)) {
+			throw std::runtime_error("Failed to sub-allocate memory from a new block");
+		}
+	}
+
+	allocation.category = category;
+	this->categoryBytes[this->memoryProperties.memoryTypes[memoryTypeIndex].heapIndex][static_cast<uint32_t>(category)] += allocation.size;
+	return allocation;
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocateForImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties, AllocationStrategy strategy, MemoryCategory category) {
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(this->device, image, &memRequirements);
+
+	MemoryAllocation allocation = allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_OPTIMAL, strategy, category);
+	vkBindImageMemory(this->device, image, allocation.memory, allocation.offset);
+
+	return allocation;
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, AllocationStrategy strategy, MemoryCategory category) {
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(this->device, buffer, &memRequirements);
+
+	MemoryAllocation allocation = allocate(memRequirements, properties, false, strategy, category);
+	vkBindBufferMemory(this->device, buffer, allocation.memory, allocation.offset);
+
+	return allocation;
+}
+
+void DeviceMemoryAllocator::free(MemoryAllocation& allocation) {
+	if (allocation.memory == VK_NULL_HANDLE) return;
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->categoryBytes[this->memoryProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex][static_cast<uint32_t>(allocation.category)] -= allocation.size;
+
+	if (allocation.blockIndex == UINT32_MAX) {
+		if (allocation.mappedData != nullptr) {
+			vkUnmapMemory(this->device, allocation.memory);
+		}
+		vkFreeMemory(this->device, allocation.memory, nullptr);
+
+		MemoryStatistics& stats = this->dedicatedStats[allocation.memoryTypeIndex];
+		stats.dedicatedAllocationCount--;
+		stats.dedicatedBytes -= allocation.size;
+
+		allocation = MemoryAllocation{};
+		return;
+	}
+
+	MemoryBlock& block = *this->blocks[allocation.blockIndex];
+	block.allocationCount--;
+	block.allocatedBytes -= allocation.size;
+
+	if (block.strategy == AllocationStrategy::Linear) {
+		if (block.allocationCount == 0) {
+			block.linearOffset = 0;
+		}
+	}
+	else {
+		addFreeRange(block, allocation.offset, allocation.size);
+	}
+
+	// Keep a single empty block per memory type and strategy around, so that alloc/free patterns don't thrash vkAllocateMemory
+	if (block.allocationCount == 0) {
+		for (uint32_t i = 0; i < this->blocks.size(); i++) {
+			const auto& other = this->blocks[i];
+			if (i != allocation.blockIndex && other && other->allocationCount == 0
+				&& other->memoryTypeIndex == block.memoryTypeIndex && other->strategy == block.strategy) {
+				if (block.mappedData != nullptr) {
+					vkUnmapMemory(this->device, block.memory);
+				}
+				vkFreeMemory(this->device, block.memory, nullptr);
+				this->blocks[allocation.blockIndex].reset();
+				break;
+			}
+		}
+	}
+
+	allocation = MemoryAllocation{};
+}
+
+uint32_t DeviceMemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const {
+	return this->profile->findMemoryType(typeFilter, properties);
+}
+
+MemoryStats DeviceMemoryAllocator::getStats() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	MemoryStats stats;
+	for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+		stats.memoryType[i] = this->dedicatedStats[i];
+	}
+
+	for (const auto& block : this->blocks) {
+		if (!block) continue;
+
+		MemoryStatistics& typeStats = stats.memoryType[block->memoryTypeIndex];
+		typeStats.blockCount++;
+		typeStats.blockBytes += block->size;
+		typeStats.allocationCount += block->allocationCount;
+		typeStats.allocatedBytes += block->allocatedBytes;
+		stats.heapFreeBlockBytes[this->memoryProperties.memoryTypes[block->memoryTypeIndex].heapIndex] += block->size - block->allocatedBytes;
+	}
+
+	for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; i++) {
+		const MemoryStatistics& typeStats = stats.memoryType[i];
+		stats.total.blockCount += typeStats.blockCount;
+		stats.total.allocationCount += typeStats.allocationCount;
+		stats.total.dedicatedAllocationCount += typeStats.dedicatedAllocationCount;
+		stats.total.blockBytes += typeStats.blockBytes;
+		stats.total.allocatedBytes += typeStats.allocatedBytes;
+		stats.total.dedicatedBytes += typeStats.dedicatedBytes;
+	}
+	stats.deviceMemoryCount = stats.total.blockCount + stats.total.dedicatedAllocationCount;
+
+	for (uint32_t i = 0; i < this->memoryProperties.memoryTypeCount; i++) {
+		const uint32_t heapIndex = this->memoryProperties.memoryTypes[i].heapIndex;
+		stats.heapBytes[heapIndex] += stats.memoryType[i].blockBytes + stats.memoryType[i].dedicatedBytes;
+	}
+	for (uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; i++) {
+		for (uint32_t category = 0; category < MEMORY_CATEGORY_COUNT; category++) {
+			stats.heapCategoryBytes[i][category] = this->categoryBytes[i][category];
+		}
+	}
+
+	return stats;
+}
+
+VkDeviceSize DeviceMemoryAllocator::getBlockSize(uint32_t memoryTypeIndex) const {
+	uint32_t heapIndex = this->memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+	VkDeviceSize heapSize = this->memoryProperties.memoryHeaps[heapIndex].size;
+
+	// Small heaps (e.g. the 256 MiB host visible device local heap on many GPUs) get proportionally smaller blocks
+	if (heapSize <= 1024ull * 1024 * 1024) {
+		return std::min(this->preferredBlockSize, heapSize / 8);
+	}
+
+	return this->preferredBlockSize;
+}
+
+VkDeviceMemory DeviceMemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mappedData) {
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(this->device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate device memory");
+	}
+
+	*mappedData = nullptr;
+	if (this->memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(this->device, memory, 0, VK_WHOLE_SIZE, 0, mappedData) != VK_SUCCESS) {
+			vkFreeMemory(this->device, memory, nullptr);
+			throw std::runtime_error("Failed to map device memory");
+		}
+	}
+
+	return memory;
+}
+
+MemoryAllocation DeviceMemoryAllocator::allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex) {
+	MemoryAllocation allocation;
+	allocation.memory = allocateDeviceMemory(size, memoryTypeIndex, &allocation.mappedData);
+	allocation.offset = 0;
+	allocation.size = size;
+	allocation.memoryTypeIndex = memoryTypeIndex;
+	allocation.blockIndex = UINT32_MAX;
+
+	MemoryStatistics& stats = this->dedicatedStats[memoryTypeIndex];
+	stats.dedicatedAllocationCount++;
+	stats.dedicatedBytes += size;
+
+	return allocation;
+}
+
+bool DeviceMemoryAllocator::allocateFromBlock(uint32_t blockIndex, VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation) {
+	MemoryBlock& block = *this->blocks[blockIndex];
+	VkDeviceSize offset = 0;
+
+	if (block.strategy == AllocationStrategy::Linear) {
+		offset = alignUp(block.linearOffset, alignment);
+		if (offset + size > block.size) {
+			return false;
+		}
+		block.linearOffset = offset + size;
+	}
+	else {
+		// Best fit: the smallest free range that still fits once its start is aligned
+		auto it = block.freeRangesBySize.lower_bound(size);
+		for (; it != block.freeRangesBySize.end(); ++it) {
+			offset = alignUp(it->second, alignment);
+			if (offset + size <= it->second + it->first) break;
+		}
+		if (it == block.freeRangesBySize.end()) {
+			return false;
+		}
+
+		VkDeviceSize rangeOffset = it->second;
+		VkDeviceSize rangeEnd = it->second + it->first;
+		removeFreeRange(block, rangeOffset, it->first);
+
+		if (offset > rangeOffset) {
+			addFreeRange(block, rangeOffset, offset - rangeOffset);
+		}
+		if (offset + size < rangeEnd) {
+			addFreeRange(block, offset + size, rangeEnd - (offset + size));
+		}
+	}
+
+	block.allocationCount++;
+	block.allocatedBytes += size;
+
+	allocation.memory = block.memory;
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.mappedData = block.mappedData != nullptr ? static_cast<char*>(block.mappedData) + offset : nullptr;
+	allocation.memoryTypeIndex = block.memoryTypeIndex;
+	allocation.blockIndex = blockIndex;
+
+	return true;
+}
+
+uint32_t DeviceMemoryAllocator::createBlock(uint32_t memoryTypeIndex, AllocationStrategy strategy) {
+	auto block = std::make_unique<MemoryBlock>();
+	block->size = getBlockSize(memoryTypeIndex);
+	block->memoryTypeIndex = memoryTypeIndex;
+	block->strategy = strategy;
+	block->memory = allocateDeviceMemory(block->size, memoryTypeIndex, &block->mappedData);
+
+	if (strategy == AllocationStrategy::FreeList) {
+		addFreeRange(*block, 0, block->size);
+	}
+
+	for (uint32_t i = 0; i < this->blocks.size(); i++) {
+		if (!this->blocks[i]) {
+			this->blocks[i] = std::move(block);
+			return i;
+		}
+	}
+
+	this->blocks.push_back(std::move(block));
+	return static_cast<uint32_t>(this->blocks.size() - 1);
+}
+
+void DeviceMemoryAllocator::addFreeRange(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size) {
+	// Coalesce with the neighbouring free ranges
+	auto next = block.freeRangesByOffset.lower_bound(offset);
+	if (next != block.freeRangesByOffset.end() && offset + size == next->first) {
+		VkDeviceSize nextOffset = next->first;
+		VkDeviceSize nextSize = next->second;
+		size += nextSize;
+		removeFreeRange(block, nextOffset, nextSize);
+		next = block.freeRangesByOffset.lower_bound(offset);
+	}
+
+	if (next != block.freeRangesByOffset.begin()) {
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset) {
+			VkDeviceSize previousOffset = previous->first;
+			VkDeviceSize previousSize = previous->second;
+			offset = previousOffset;
+			size += previousSize;
+			removeFreeRange(block, previousOffset, previousSize);
+		}
+	}
+
+	block.freeRangesByOffset[offset] = size;
+	block.freeRangesBySize.emplace(size, offset);
+}
+
+void DeviceMemoryAllocator::removeFreeRange(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size) {
+	block.freeRangesByOffset.erase(offset);
+
+	auto range = block.freeRangesBySize.equal_range(size);
+	for (auto it = range.first; it != range.second; ++it) {
+		if (it->second == offset) {
+			block.freeRangesBySize.erase(it);
+			break;
+		}
+	}
+}
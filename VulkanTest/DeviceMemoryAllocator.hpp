@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "DeviceProfile.hpp"
+
+enum class AllocationStrategy {
+	FreeList,  // Best fit inside a shared block, ranges are coalesced when freed
+	Linear,    // Bump allocation inside a shared block, the block is rewound once all of its allocations are freed
+	Dedicated  // One VkDeviceMemory per resource, used automatically for resources too large for a block
+};
+
+// What an allocation backs, tracked per heap for budgeting
+enum class MemoryCategory {
+	Attachment, // Render targets, sized with the swap chain
+	Texture,    // Sampled images, the bulk of what can be streamed out
+	Buffer
+};
+
+constexpr uint32_t MEMORY_CATEGORY_COUNT = 3;
+
+// Lightweight handle returned by the allocator, it can be copied around freely
+struct MemoryAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0;
+	void* mappedData = nullptr; // Set for host visible memory, which is persistently mapped
+	uint32_t memoryTypeIndex = 0;
+	uint32_t blockIndex = UINT32_MAX; // UINT32_MAX for dedicated allocations
+	MemoryCategory category = MemoryCategory::Buffer;
+};
+
+struct MemoryStatistics {
+	uint32_t blockCount = 0;
+	uint32_t allocationCount = 0;
+	uint32_t dedicatedAllocationCount = 0;
+	VkDeviceSize blockBytes = 0;
+	VkDeviceSize allocatedBytes = 0; // Sub-allocated bytes, including alignment and granularity padding
+	VkDeviceSize dedicatedBytes = 0;
+};
+
+struct MemoryStats {
+	MemoryStatistics total;
+	MemoryStatistics memoryType[VK_MAX_MEMORY_TYPES];
+	uint32_t deviceMemoryCount = 0; // Live VkDeviceMemory objects, to compare against maxMemoryAllocationCount
+	VkDeviceSize heapBytes[VK_MAX_MEMORY_HEAPS] = {}; // VkDeviceMemory bytes, blocks and dedicated allocations
+	VkDeviceSize heapCategoryBytes[VK_MAX_MEMORY_HEAPS][MEMORY_CATEGORY_COUNT] = {}; // Allocated bytes by category
+	VkDeviceSize heapFreeBlockBytes[VK_MAX_MEMORY_HEAPS] = {}; // Unallocated bytes inside blocks, part of heapBytes
+};
+
+class DeviceMemoryAllocator
+{
+public:
+	static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 256ull * 1024 * 1024;
+
+	// profile must outlive the allocator
+	void init(const DeviceProfile& profile, VkDevice device, VkDeviceSize preferredBlockSize = DEFAULT_BLOCK_SIZE);
+
+	void cleanup();
+
+	// optimalTiling must be true for VK_IMAGE_TILING_OPTIMAL images so that bufferImageGranularity is respected
+	MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool optimalTiling, AllocationStrategy strategy = AllocationStrategy::FreeList, MemoryCategory category = MemoryCategory::Buffer);
+
+	MemoryAllocation allocateForImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties, AllocationStrategy strategy = AllocationStrategy::FreeList, MemoryCategory category = MemoryCategory::Texture);
+
+	MemoryAllocation allocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, AllocationStrategy strategy = AllocationStrategy::FreeList, MemoryCategory category = MemoryCategory::Buffer);
+
+	void free(MemoryAllocation& allocation);
+
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+	MemoryStats getStats();
+
+private:
+	struct MemoryBlock {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+		AllocationStrategy strategy = AllocationStrategy::FreeList;
+		void* mappedData = nullptr;
+		std::map<VkDeviceSize, VkDeviceSize> freeRangesByOffset; // offset -> size
+		std::multimap<VkDeviceSize, VkDeviceSize> freeRangesBySize; // size -> offset, for best fit lookups
+		VkDeviceSize linearOffset = 0;
+		VkDeviceSize allocatedBytes = 0;
+		uint32_t allocationCount = 0;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	const DeviceProfile* profile = nullptr;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	VkDeviceSize bufferImageGranularity = 1;
+	VkDeviceSize preferredBlockSize = DEFAULT_BLOCK_SIZE;
+	std::vector<std::unique_ptr<MemoryBlock>> blocks; // Released blocks leave an empty slot so that handles stay valid
+	MemoryStatistics dedicatedStats[VK_MAX_MEMORY_TYPES];
+	VkDeviceSize categoryBytes[VK_MAX_MEMORY_HEAPS][MEMORY_CATEGORY_COUNT] = {};
+	std::mutex mutex;
+
+	VkDeviceSize getBlockSize(uint32_t memoryTypeIndex) const;
+
+	VkDeviceMemory allocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, void** mappedData);
+
+	MemoryAllocation allocateDedicated(VkDeviceSize size, uint32_t memoryTypeIndex);
+
+	bool allocateFromBlock(uint32_t blockIndex, VkDeviceSize size, VkDeviceSize alignment, MemoryAllocation& allocation);
+
+	uint32_t createBlock(uint32_t memoryTypeIndex, AllocationStrategy strategy);
+
+	void addFreeRange(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size);
+
+	void removeFreeRange(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size);
+};
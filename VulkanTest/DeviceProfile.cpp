@@ -0,0 +1,204 @@
+#include "DeviceProfile.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+
+void DeviceProfile::init(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t instanceApiVersion) {
+	this->physicalDevice = physicalDevice;
+	this->surface = surface;
+
+	vkGetPhysicalDeviceProperties(physicalDevice, &this->properties);
+	vkGetPhysicalDeviceFeatures(physicalDevice, &this->features);
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &this->memoryProperties);
+
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+	this->queueFamilyProperties.resize(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, this->queueFamilyProperties.data());
+
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+	for (const auto& extension : availableExtensions) {
+		this->extensions.insert(extension.extensionName);
+	}
+
+	this->apiVersion = std::min(this->properties.apiVersion, instanceApiVersion);
+	if (this->apiVersion >= VK_API_VERSION_1_2) {
+		this->featureChain.setApiVersion(this->apiVersion);
+		if (supportsExtension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME)) {
+			this->featureChain.add<VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT);
+		}
+		if (supportsExtensions({ VK_KHR_PRESENT_ID_EXTENSION_NAME, VK_KHR_PRESENT_WAIT_EXTENSION_NAME })) {
+			this->featureChain.add<VkPhysicalDevicePresentIdFeaturesKHR>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR);
+			this->featureChain.add<VkPhysicalDevicePresentWaitFeaturesKHR>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR);
+		}
+		this->featureChain.query(physicalDevice);
+
+		this->vulkan12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+		VkPhysicalDeviceProperties2 properties2{};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties2.pNext = &this->vulkan12Properties;
+		vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+	}
+
+	selectQueueFamilies();
+
+	if (this->surface != VK_NULL_HANDLE) {
+		querySurfaceSupport();
+	}
+}
+
+void DeviceProfile::selectQueueFamilies() {
+	this->queueFamilies = QueueFamilyIndices{};
+
+	for (uint32_t i = 0; i < this->queueFamilyProperties.size(); i++) {
+		const VkQueueFlags queueFlags = this->queueFamilyProperties[i].queueFlags;
+
+		if ((queueFlags & VK_QUEUE_GRAPHICS_BIT) && !this->queueFamilies.graphicsFamily.has_value()) {
+			this->queueFamilies.graphicsFamily = i;
+		}
+
+		// There is no surface in headless mode, the graphics queue also stands in as the "present" queue
+		VkBool32 presentSupport = false;
+		if (this->surface == VK_NULL_HANDLE) {
+			presentSupport = (queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		}
+		else {
+			vkGetPhysicalDeviceSurfaceSupportKHR(this->physicalDevice, i, this->surface, &presentSupport);
+		}
+
+		// Prefer presenting from the graphics family, which avoids sharing swap chain images between families
+		if (presentSupport && (!this->queueFamilies.presentFamily.has_value() || this->queueFamilies.graphicsFamily == i)) {
+			this->queueFamilies.presentFamily = i;
+		}
+
+		// A family with transfer but neither graphics nor compute usually maps to the DMA engines
+		if ((queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+			&& !this->queueFamilies.transferFamily.has_value()) {
+			this->queueFamilies.transferFamily = i;
+		}
+	}
+
+	if (!this->queueFamilies.transferFamily.has_value()) {
+		this->queueFamilies.transferFamily = this->queueFamilies.graphicsFamily;
+	}
+}
+
+void DeviceProfile::querySurfaceSupport() {
+	refreshSurfaceCapabilities();
+
+	uint32_t formatCount = 0;
+	vkGetPhysicalDeviceSurfaceFormatsKHR(this->physicalDevice, this->surface, &formatCount, nullptr);
+	this->swapChainSupport.formats.resize(formatCount);
+	if (formatCount != 0) {
+		vkGetPhysicalDeviceSurfaceFormatsKHR(this->physicalDevice, this->surface, &formatCount, this->swapChainSupport.formats.data());
+	}
+
+	uint32_t presentModeCount = 0;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(this->physicalDevice, this->surface, &presentModeCount, nullptr);
+	this->swapChainSupport.presentModes.resize(presentModeCount);
+	if (presentModeCount != 0) {
+		vkGetPhysicalDeviceSurfacePresentModesKHR(this->physicalDevice, this->surface, &presentModeCount, this->swapChainSupport.presentModes.data());
+	}
+}
+
+void DeviceProfile::refreshSurfaceCapabilities() {
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(this->physicalDevice, this->surface, &this->swapChainSupport.capabilities);
+}
+
+bool DeviceProfile::supportsExtension(const char* extensionName) const {
+	return this->extensions.count(extensionName) != 0;
+}
+
+bool DeviceProfile::supportsExtensions(const std::vector<const char*>& extensionNames) const {
+	for (const char* extensionName : extensionNames) {
+		if (!supportsExtension(extensionName)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+uint32_t DeviceProfile::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred) const {
+	const VkMemoryPropertyFlags wanted = required | preferred;
+	for (uint32_t i = 0; i < this->memoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1u << i)) && (this->memoryProperties.memoryTypes[i].propertyFlags & wanted) == wanted) {
+			return i;
+		}
+	}
+
+	for (uint32_t i = 0; i < this->memoryProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1u << i)) && (this->memoryProperties.memoryTypes[i].propertyFlags & required) == required) {
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Failed to find a suitable memory type");
+}
+
+const VkFormatProperties& DeviceProfile::getFormatProperties(VkFormat format) {
+	auto it = this->formatProperties.find(format);
+	if (it == this->formatProperties.end()) {
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(this->physicalDevice, format, &properties);
+		it = this->formatProperties.emplace(format, properties).first;
+	}
+	return it->second;
+}
+
+VkFormat DeviceProfile::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
+	for (VkFormat format : candidates) {
+		const VkFormatProperties& props = getFormatProperties(format);
+
+		if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
+			return format;
+		}
+		else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
+			return format;
+		}
+	}
+
+	throw std::runtime_error("Failed to find supported format");
+}
+
+VkSampleCountFlagBits DeviceProfile::getMaxUsableSampleCount() const {
+	VkSampleCountFlags counts = this->properties.limits.framebufferColorSampleCounts & this->properties.limits.framebufferDepthSampleCounts;
+
+	VkSampleCountFlagBits alternatives[6] { VK_SAMPLE_COUNT_64_BIT, VK_SAMPLE_COUNT_32_BIT, VK_SAMPLE_COUNT_16_BIT, VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT };
+	for (auto& flag : alternatives) {
+		if (counts & flag) {
+			return flag;
+		}
+	}
+
+	return VK_SAMPLE_COUNT_1_BIT;
+}
+
+VkDeviceSize DeviceProfile::getDeviceLocalMemorySize() const {
+	VkDeviceSize size = 0;
+	for (uint32_t i = 0; i < this->memoryProperties.memoryHeapCount; i++) {
+		if (this->memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+			size += this->memoryProperties.memoryHeaps[i].size;
+		}
+	}
+	return size;
+}
+
+uint64_t DeviceProfile::score() const {
+	uint64_t typeScore = 0;
+	switch (this->properties.deviceType) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: typeScore = 4; break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: typeScore = 3; break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: typeScore = 2; break;
+	case VK_PHYSICAL_DEVICE_TYPE_CPU: typeScore = 1; break;
+	default: typeScore = 0; break;
+	}
+
+	// In MiB, capped well below the weight of the device type
+	uint64_t memoryScore = std::min<uint64_t>(getDeviceLocalMemorySize() >> 20, 1000000);
+	uint64_t transferScore = this->queueFamilies.transferFamily != this->queueFamilies.graphicsFamily ? 1 : 0;
+
+	return typeScore * 10000000 + memoryScore * 2 + transferScore;
+}
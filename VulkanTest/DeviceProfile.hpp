@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <set>
+#include <unordered_map>
+
+#include "types.hpp"
+#include "FeatureChain.hpp"
+
+// Everything the renderer needs to know about a physical device, queried once. Only the surface capabilities are
+// queried again, through refreshSurfaceCapabilities(), since the current extent changes with the window.
+// Not thread safe, except for the const lookups which only read data captured by init.
+class DeviceProfile
+{
+public:
+	// Without a surface (headless) the graphics family also stands in as the present family. instanceApiVersion caps
+	// getApiVersion, the features of the newer versions are only queried up to it.
+	void init(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, uint32_t instanceApiVersion);
+
+	void refreshSurfaceCapabilities();
+
+	VkPhysicalDevice getPhysicalDevice() const { return this->physicalDevice; }
+
+	const VkPhysicalDeviceProperties& getProperties() const { return this->properties; }
+
+	const VkPhysicalDeviceFeatures& getFeatures() const { return this->features; }
+
+	// Descriptor indexing limits among others, zeroed before 1.2
+	const VkPhysicalDeviceVulkan12Properties& getVulkan12Properties() const { return this->vulkan12Properties; }
+
+	// Supported features of every version up to getApiVersion and of the extensions the renderer knows about. Empty
+	// before 1.2, which the renderer requires.
+	const FeatureChain& getFeatureChain() const { return this->featureChain; }
+
+	// Min of the device and instance versions
+	uint32_t getApiVersion() const { return this->apiVersion; }
+
+	const VkPhysicalDeviceMemoryProperties& getMemoryProperties() const { return this->memoryProperties; }
+
+	const std::vector<VkQueueFamilyProperties>& getQueueFamilyProperties() const { return this->queueFamilyProperties; }
+
+	const QueueFamilyIndices& getQueueFamilies() const { return this->queueFamilies; }
+
+	const SwapChainSupportDetails& getSwapChainSupport() const { return this->swapChainSupport; }
+
+	bool supportsExtension(const char* extensionName) const;
+
+	bool supportsExtensions(const std::vector<const char*>& extensionNames) const;
+
+	// First type allowed by typeFilter with all the required properties, preferring one that also has the preferred
+	// properties. Throws if there is none.
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0) const;
+
+	// Queried on first use for each format
+	const VkFormatProperties& getFormatProperties(VkFormat format);
+
+	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
+
+	VkSampleCountFlagBits getMaxUsableSampleCount() const;
+
+	VkDeviceSize getDeviceLocalMemorySize() const;
+
+	// Higher is better. Device type dominates, so any discrete GPU beats any integrated one and so on down to CPU
+	// implementations, then device local memory and a dedicated transfer queue break ties.
+	uint64_t score() const;
+
+private:
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties properties{};
+	VkPhysicalDeviceFeatures features{};
+	VkPhysicalDeviceVulkan12Properties vulkan12Properties{};
+	FeatureChain featureChain;
+	uint32_t apiVersion = VK_API_VERSION_1_0;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	std::vector<VkQueueFamilyProperties> queueFamilyProperties;
+	QueueFamilyIndices queueFamilies;
+	std::set<std::string> extensions;
+	SwapChainSupportDetails swapChainSupport{};
+	std::unordered_map<VkFormat, VkFormatProperties> formatProperties;
+
+	void selectQueueFamilies();
+
+	void querySurfaceSupport();
+};
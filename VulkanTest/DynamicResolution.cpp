@@ -0,0 +1,67 @@
+#include "DynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void DynamicResolution::setSettings(const DynamicResolutionSettings& settings, uint64_t frameNumber) {
+	const bool enabling = settings.enabled && !this->settings.enabled;
+	this->settings = settings;
+	this->settings.maxScale = std::clamp(settings.maxScale, MIN_SCALE, 1.0f);
+	this->settings.minScale = std::clamp(settings.minScale, MIN_SCALE, this->settings.maxScale);
+
+	this->scale = enabling ? this->settings.maxScale : std::clamp(this->scale, this->settings.minScale, this->settings.maxScale);
+	this->changeFrame = frameNumber;
+	this->sampleCount = 0;
+}
+
+void DynamicResolution::addSample(uint64_t frameNumber, double gpuMilliseconds) {
+	if (!this->settings.enabled || frameNumber < std::max(this->changeFrame, this->nextSampleFrame) || gpuMilliseconds <= 0.0) {
+		return;
+	}
+	this->nextSampleFrame = frameNumber + 1;
+
+	if (this->sampleCount == 0) {
+		this->averageMilliseconds = gpuMilliseconds;
+	}
+	else {
+		this->averageMilliseconds += (gpuMilliseconds - this->averageMilliseconds) * SMOOTHING;
+	}
+	this->sampleCount++;
+}
+
+void DynamicResolution::update(uint64_t frameNumber) {
+	if (!this->settings.enabled || this->sampleCount < std::max(this->settings.settleFrames, 1u)) {
+		return;
+	}
+
+	const double target = this->settings.targetFrameMilliseconds;
+	const double setpoint = target * 0.5 * (1.0 + this->settings.raiseThreshold);
+	const float ideal = this->scale * static_cast<float>(std::sqrt(setpoint / this->averageMilliseconds));
+
+	float next = this->scale;
+	if (this->averageMilliseconds > target) {
+		next = ideal;
+	}
+	else if (this->averageMilliseconds < target * this->settings.raiseThreshold) {
+		// Raising too far costs a missed frame, take it slowly
+		next = std::min(ideal, this->scale + MAX_RAISE);
+	}
+	next = std::clamp(next, this->settings.minScale, this->settings.maxScale);
+
+	const bool atBound = next == this->settings.minScale || next == this->settings.maxScale;
+	if (next == this->scale || (std::abs(next - this->scale) < MIN_CHANGE && !atBound)) {
+		return;
+	}
+
+	this->scale = next;
+	this->changeFrame = frameNumber;
+	this->sampleCount = 0;
+}
+
+VkExtent2D DynamicResolution::scaleExtent(VkExtent2D extent) const {
+	const float scale = getScale();
+	return {
+		std::max(1u, static_cast<uint32_t>(std::lround(extent.width * scale))),
+		std::max(1u, static_cast<uint32_t>(std::lround(extent.height * scale)))
+	};
+}
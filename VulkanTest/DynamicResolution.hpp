@@ -0,0 +1,62 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// See VulkanBaseGLFW::setDynamicResolution
+struct DynamicResolutionSettings {
+	bool enabled = false;
+	double targetFrameMilliseconds = 1000.0 / 60.0; // GPU time of a frame the scale is adjusted to hold
+	// Bounds of the scale of each axis, maxScale is at most 1: attachments are allocated at the swap chain extent
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	// The scale only goes up once the GPU time falls under this fraction of the target, so that it doesn't oscillate
+	// around it
+	double raiseThreshold = 0.85;
+	// Frames measured at a new scale before it may change again
+	uint32_t settleFrames = 8;
+};
+
+// Picks the render scale of each frame from the GPU time of the frames before it. GPU time is assumed to grow with the
+// pixel count, i.e. with the square of the scale: over the target the scale drops at once to where the frame should
+// fit, under raiseThreshold of it the scale goes up by small steps. Either way it aims at the middle of the band.
+// Not thread safe, everything is called from the frame thread.
+class DynamicResolution
+{
+public:
+	static constexpr float MIN_SCALE = 0.25f;
+
+	// Bounds are clamped to [MIN_SCALE, 1]. Enabling starts from maxScale. frameNumber is the next frame to be
+	// recorded, the first one measured with the new settings.
+	void setSettings(const DynamicResolutionSettings& settings, uint64_t frameNumber);
+
+	const DynamicResolutionSettings& getSettings() const { return this->settings; }
+
+	bool isEnabled() const { return this->settings.enabled; }
+
+	// GPU time of frame frameNumber, once read back. Frames recorded before the last scale or settings change are
+	// ignored, their time says nothing about the current scale, and so are frames already measured.
+	void addSample(uint64_t frameNumber, double gpuMilliseconds);
+
+	// Call before recording frameNumber, may change the scale it is rendered at
+	void update(uint64_t frameNumber);
+
+	// 1 when disabled
+	float getScale() const { return this->settings.enabled ? this->scale : 1.0f; }
+
+	// extent at the current scale, at least 1x1
+	VkExtent2D scaleExtent(VkExtent2D extent) const;
+
+private:
+	static constexpr double SMOOTHING = 0.2; // Weight of a new sample in the average
+	static constexpr float MAX_RAISE = 0.05f; // Per change
+	static constexpr float MIN_CHANGE = 0.01f; // Smaller changes are not worth the blur of a new scale
+
+	DynamicResolutionSettings settings;
+	float scale = 1.0f;
+	double averageMilliseconds = 0.0;
+	uint32_t sampleCount = 0; // Since the last change
+	uint64_t changeFrame = 0; // First frame recorded at the current scale
+	uint64_t nextSampleFrame = 0; // Frames before it have been measured
+};
@@ -0,0 +1,49 @@
+#include "FeatureChain.hpp"
+
+FeatureChain::FeatureChain() {
+	this->features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	this->features11.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES;
+	this->features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	this->features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+	relink();
+}
+
+FeatureChain::FeatureChain(const FeatureChain& other) {
+	*this = other;
+}
+
+FeatureChain& FeatureChain::operator=(const FeatureChain& other) {
+	this->apiVersion = other.apiVersion;
+	this->features2 = other.features2;
+	this->features11 = other.features11;
+	this->features12 = other.features12;
+	this->features13 = other.features13;
+	this->extensions = other.extensions;
+	relink();
+	return *this;
+}
+
+void FeatureChain::setApiVersion(uint32_t apiVersion) {
+	this->apiVersion = apiVersion;
+	relink();
+}
+
+void FeatureChain::query(VkPhysicalDevice physicalDevice) {
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &this->features2);
+}
+
+void FeatureChain::relink() {
+	this->features2.pNext = &this->features11;
+	this->features11.pNext = &this->features12;
+
+	VkBaseOutStructure* tail = reinterpret_cast<VkBaseOutStructure*>(&this->features12);
+	if (VK_API_VERSION_MINOR(this->apiVersion) >= 3 || VK_API_VERSION_MAJOR(this->apiVersion) > 1) {
+		tail->pNext = reinterpret_cast<VkBaseOutStructure*>(&this->features13);
+		tail = tail->pNext;
+	}
+	for (auto& storage : this->extensions) {
+		tail->pNext = reinterpret_cast<VkBaseOutStructure*>(storage.data());
+		tail = tail->pNext;
+	}
+	tail->pNext = nullptr;
+}
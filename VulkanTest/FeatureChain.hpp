@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <cstring>
+
+// VkPhysicalDeviceFeatures2 and the pNext chain hanging from it, used both to query what a device supports and to
+// enable features at device creation. The Vulkan 1.1 and 1.2 structs are always chained, the 1.3 one only for 1.3,
+// extension structs are appended with add. Copies relink their own chain.
+class FeatureChain
+{
+public:
+	FeatureChain();
+
+	FeatureChain(const FeatureChain& other);
+
+	FeatureChain& operator=(const FeatureChain& other);
+
+	// Effective version of the device, min of the instance and device versions. At least 1.2.
+	void setApiVersion(uint32_t apiVersion);
+
+	uint32_t getApiVersion() const { return this->apiVersion; }
+
+	// Fills every chained struct
+	void query(VkPhysicalDevice physicalDevice);
+
+	VkPhysicalDeviceFeatures& core() { return this->features2.features; }
+	const VkPhysicalDeviceFeatures& core() const { return this->features2.features; }
+
+	VkPhysicalDeviceVulkan11Features& vulkan11() { return this->features11; }
+	const VkPhysicalDeviceVulkan11Features& vulkan11() const { return this->features11; }
+
+	VkPhysicalDeviceVulkan12Features& vulkan12() { return this->features12; }
+	const VkPhysicalDeviceVulkan12Features& vulkan12() const { return this->features12; }
+
+	// Only chained for 1.3 devices, all false otherwise
+	VkPhysicalDeviceVulkan13Features& vulkan13() { return this->features13; }
+	const VkPhysicalDeviceVulkan13Features& vulkan13() const { return this->features13; }
+
+	// Appends an extension feature struct, zeroed, or returns the one already added with this sType
+	template<typename T>
+	T& add(VkStructureType sType) {
+		if (T* existing = find<T>(sType)) {
+			return *existing;
+		}
+
+		std::vector<uint64_t> storage((sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+		reinterpret_cast<VkBaseOutStructure*>(storage.data())->sType = sType;
+		this->extensions.push_back(std::move(storage));
+		relink();
+		return *reinterpret_cast<T*>(this->extensions.back().data());
+	}
+
+	template<typename T>
+	T* find(VkStructureType sType) {
+		return const_cast<T*>(static_cast<const FeatureChain*>(this)->find<T>(sType));
+	}
+
+	template<typename T>
+	const T* find(VkStructureType sType) const {
+		for (const auto& storage : this->extensions) {
+			if (reinterpret_cast<const VkBaseOutStructure*>(storage.data())->sType == sType) {
+				return reinterpret_cast<const T*>(storage.data());
+			}
+		}
+		return nullptr;
+	}
+
+	// Head of the chain, the pNext of VkDeviceCreateInfo (with pEnabledFeatures left null)
+	const VkPhysicalDeviceFeatures2* get() const { return &this->features2; }
+
+private:
+	uint32_t apiVersion = VK_API_VERSION_1_2;
+	VkPhysicalDeviceFeatures2 features2{};
+	VkPhysicalDeviceVulkan11Features features11{};
+	VkPhysicalDeviceVulkan12Features features12{};
+	VkPhysicalDeviceVulkan13Features features13{};
+	std::vector<std::vector<uint64_t>> extensions; // Extension structs, 8 byte aligned
+
+	void relink();
+};
@@ -0,0 +1,121 @@
+#include "FrameDescriptorAllocator.hpp"
+
+#include <stdexcept>
+
+void FrameDescriptorAllocator::init(VkDevice device, uint32_t frameCount, uint32_t setsPerPool, const std::vector<PoolSizeRatio>& poolSizes) {
+	this->device = device;
+	this->setsPerPool = setsPerPool;
+	this->poolSizes = poolSizes;
+	this->slots.resize(frameCount);
+	this->currentSlot = 0;
+	this->stats = FrameDescriptorStats{};
+}
+
+void FrameDescriptorAllocator::cleanup() {
+	for (auto& slot : this->slots) {
+		for (VkDescriptorPool pool : slot.fullPools) {
+			vkDestroyDescriptorPool(this->device, pool, nullptr);
+		}
+		if (slot.currentPool != VK_NULL_HANDLE) {
+			vkDestroyDescriptorPool(this->device, slot.currentPool, nullptr);
+		}
+	}
+	for (VkDescriptorPool pool : this->freePools) {
+		vkDestroyDescriptorPool(this->device, pool, nullptr);
+	}
+	this->slots.clear();
+	this->freePools.clear();
+}
+
+void FrameDescriptorAllocator::beginFrame(uint32_t frameIndex) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	FrameSlot& slot = this->slots[frameIndex];
+	// Resetting frees every set of the pool at once, the slot's previous frame is done with them
+	for (VkDescriptorPool pool : slot.fullPools) {
+		vkResetDescriptorPool(this->device, pool, 0);
+		this->freePools.push_back(pool);
+	}
+	slot.fullPools.clear();
+	if (slot.currentPool != VK_NULL_HANDLE) {
+		vkResetDescriptorPool(this->device, slot.currentPool, 0);
+	}
+
+	this->currentSlot = frameIndex;
+	this->stats.setsAllocated = 0;
+	this->stats.poolsInUse = slot.currentPool != VK_NULL_HANDLE ? 1 : 0;
+}
+
+VkDescriptorSet FrameDescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	FrameSlot& slot = this->slots[this->currentSlot];
+	if (slot.currentPool == VK_NULL_HANDLE) {
+		slot.currentPool = acquirePool();
+		this->stats.poolsInUse++;
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = slot.currentPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkResult result = vkAllocateDescriptorSets(this->device, &allocInfo, &descriptorSet);
+	if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+		// Out of sets or of descriptors of one type, the pool stays with the slot until it is reset
+		slot.fullPools.push_back(slot.currentPool);
+		slot.currentPool = acquirePool();
+		this->stats.poolsInUse++;
+
+		allocInfo.descriptorPool = slot.currentPool;
+		result = vkAllocateDescriptorSets(this->device, &allocInfo, &descriptorSet);
+	}
+	if (result != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate frame descriptor set");
+	}
+
+	this->stats.setsAllocated++;
+	return descriptorSet;
+}
+
+FrameDescriptorStats FrameDescriptorAllocator::getStats() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->stats;
+}
+
+std::vector<FrameDescriptorAllocator::PoolSizeRatio> FrameDescriptorAllocator::defaultPoolSizes() {
+	return {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f },
+		{ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_SAMPLER, 1.0f },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f }
+	};
+}
+
+VkDescriptorPool FrameDescriptorAllocator::acquirePool() {
+	if (!this->freePools.empty()) {
+		VkDescriptorPool pool = this->freePools.back();
+		this->freePools.pop_back();
+		return pool;
+	}
+
+	std::vector<VkDescriptorPoolSize> sizes;
+	for (const auto& poolSize : this->poolSizes) {
+		sizes.push_back({ poolSize.type, static_cast<uint32_t>(poolSize.ratio * this->setsPerPool) });
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = this->setsPerPool;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+	poolInfo.pPoolSizes = sizes.data();
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	if (vkCreateDescriptorPool(this->device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create frame descriptor pool");
+	}
+	this->stats.poolsCreated++;
+	return pool;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <mutex>
+
+struct FrameDescriptorStats {
+	uint32_t setsAllocated = 0; // During the current frame
+	uint32_t poolsInUse = 0; // By the current frame
+	uint32_t poolsCreated = 0; // Since init
+};
+
+// Descriptor sets valid for one frame, for what does not fit the descriptor heap or devices without descriptor
+// indexing. Each frame slot allocates from its own pools, which beginFrame resets wholesale once the slot's previous
+// frame completed, sets are never freed one by one. Pools are grown on demand and recycled between slots.
+// allocate may be called from several threads at once (ParallelRecorder workers), beginFrame from the frame thread only.
+class FrameDescriptorAllocator
+{
+public:
+	// Every pool holds setsPerPool sets and, for each type of poolSizes, setsPerPool * ratio descriptors
+	struct PoolSizeRatio {
+		VkDescriptorType type;
+		float ratio;
+	};
+
+	void init(VkDevice device, uint32_t frameCount, uint32_t setsPerPool = 256, const std::vector<PoolSizeRatio>& poolSizes = defaultPoolSizes());
+
+	void cleanup();
+
+	// Resets the pools of a frame slot, call after waiting on the slot and before recording
+	void beginFrame(uint32_t frameIndex);
+
+	// Valid until beginFrame recycles the current slot, write it with vkUpdateDescriptorSets before binding
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+	FrameDescriptorStats getStats();
+
+	static std::vector<PoolSizeRatio> defaultPoolSizes();
+
+private:
+	struct FrameSlot {
+		std::vector<VkDescriptorPool> fullPools;
+		VkDescriptorPool currentPool = VK_NULL_HANDLE;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t setsPerPool = 0;
+	std::vector<PoolSizeRatio> poolSizes;
+	std::vector<FrameSlot> slots;
+	uint32_t currentSlot = 0;
+	std::vector<VkDescriptorPool> freePools; // Reset, not used by any slot
+	FrameDescriptorStats stats;
+	std::mutex mutex;
+
+	// A reset pool, created when there is none, callers hold mutex
+	VkDescriptorPool acquirePool();
+};
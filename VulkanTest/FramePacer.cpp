@@ -0,0 +1,140 @@
+#include "FramePacer.hpp"
+#include "CpuTrace.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+void FramePacer::init(VkDevice device, VkSemaphore frameTimeline, bool presentWait) {
+	this->device = device;
+	this->frameTimeline = frameTimeline;
+	if (presentWait) {
+		this->waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(device, "vkWaitForPresentKHR"));
+	}
+	this->presentWait = this->waitForPresent != nullptr;
+	this->nextFrameTime = Clock::now();
+	this->inputTime = this->nextFrameTime;
+	resetLatencyStats();
+}
+
+void FramePacer::cleanup() {
+	this->pending.clear();
+}
+
+void FramePacer::setPolicy(const PresentationPolicy& policy) {
+	this->limiter = policy.limiter;
+	this->frameInterval = policy.targetFrameRate > 0.0
+		? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / policy.targetFrameRate))
+		: Clock::duration::zero();
+	this->nextFrameTime = Clock::now();
+}
+
+void FramePacer::waitForNextFrame(VkSwapchainKHR swapchain) {
+	CPU_TRACE_ZONE("Frame limiter");
+	if (this->limiter == FrameLimiter::None) {
+		return;
+	}
+
+	if (this->limiter == FrameLimiter::Present && this->presentWait && swapchain != VK_NULL_HANDLE) {
+		// The newest present, once it completed nothing is queued for presentation anymore
+		auto newest = std::find_if(this->pending.rbegin(), this->pending.rend(), [](const PendingFrame& frame) { return frame.presentId != 0; });
+		if (newest != this->pending.rend()) {
+			// Bounded, a minimized or occluded window may never present
+			VkResult result = this->waitForPresent(this->device, swapchain, newest->presentId, 100'000'000);
+			if (result != VK_SUCCESS && result != VK_TIMEOUT && result != VK_SUBOPTIMAL_KHR && result != VK_ERROR_OUT_OF_DATE_KHR) {
+				throw std::runtime_error("Failed to wait for present");
+			}
+			collect(swapchain);
+		}
+	}
+
+	if (this->frameInterval > Clock::duration::zero()) {
+		const Clock::time_point now = Clock::now();
+		// Catching up after a long frame would only burst frames, start the schedule again instead
+		if (now > this->nextFrameTime + this->frameInterval) {
+			this->nextFrameTime = now;
+		}
+		sleepUntil(this->nextFrameTime);
+		this->nextFrameTime += this->frameInterval;
+	}
+}
+
+void FramePacer::beginFrame() {
+	this->inputTime = Clock::now();
+}
+
+uint64_t FramePacer::endFrame(uint64_t timelineValue) {
+	PendingFrame frame;
+	frame.presentId = this->presentWait ? this->nextPresentId++ : 0;
+	frame.timelineValue = timelineValue;
+	frame.inputTime = this->inputTime;
+	this->pending.push_back(frame);
+	return frame.presentId;
+}
+
+void FramePacer::collect(VkSwapchainKHR swapchain) {
+	uint64_t completedValue = 0;
+	bool timelineRead = false;
+
+	while (!this->pending.empty()) {
+		const PendingFrame& frame = this->pending.front();
+		if (frame.presentId != 0) {
+			// A zero timeout only polls
+			VkResult result = this->waitForPresent(this->device, swapchain, frame.presentId, 0);
+			if (result == VK_TIMEOUT) {
+				break;
+			}
+			if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+				// Out of date, the present may never complete
+				this->pending.pop_front();
+				continue;
+			}
+		}
+		else {
+			if (!timelineRead) {
+				vkGetSemaphoreCounterValue(this->device, this->frameTimeline, &completedValue);
+				timelineRead = true;
+			}
+			if (frame.timelineValue > completedValue) {
+				break;
+			}
+		}
+
+		record(frame, Clock::now());
+		this->pending.pop_front();
+	}
+}
+
+void FramePacer::onSwapChainRecreated() {
+	for (auto& frame : this->pending) {
+		frame.presentId = 0;
+	}
+}
+
+void FramePacer::resetLatencyStats() {
+	this->latency = LatencyStats{};
+	this->latency.untilPresent = this->presentWait;
+}
+
+void FramePacer::sleepUntil(Clock::time_point time) {
+	// sleep_until overshoots by up to a scheduler tick, the last millisecond is spent yielding instead
+	const Clock::duration spin = std::chrono::milliseconds(1);
+	if (time - Clock::now() > spin) {
+		std::this_thread::sleep_until(time - spin);
+	}
+	while (Clock::now() < time) {
+		std::this_thread::yield();
+	}
+}
+
+void FramePacer::record(const PendingFrame& frame, Clock::time_point presentTime) {
+	const double milliseconds = std::chrono::duration<double, std::milli>(presentTime - frame.inputTime).count();
+	if (this->latency.frameCount == 0) {
+		this->latency.minMilliseconds = milliseconds;
+		this->latency.maxMilliseconds = milliseconds;
+	}
+	this->latency.minMilliseconds = std::min(this->latency.minMilliseconds, milliseconds);
+	this->latency.maxMilliseconds = std::max(this->latency.maxMilliseconds, milliseconds);
+	this->latency.averageMilliseconds += (milliseconds - this->latency.averageMilliseconds) / (this->latency.frameCount + 1);
+	this->latency.frameCount++;
+}
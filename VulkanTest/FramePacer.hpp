@@ -0,0 +1,101 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <chrono>
+
+enum class FrameLimiter {
+	None,    // Paced by the present mode alone, acquire blocks once every swap chain image is queued
+	Timer,   // Sleeps so frames start at most targetFrameRate times per second
+	Present  // Waits until the previous frame is on screen before starting the next one, then applies the timer if
+	         // there is a target. Needs VK_KHR_present_wait, falls back to Timer without it.
+};
+
+// How frames are presented, the trade between latency and smoothness. See VulkanBaseGLFW::setPresentationPolicy.
+struct PresentationPolicy {
+	// FIFO, FIFO_RELAXED, MAILBOX or IMMEDIATE, FIFO (the only mode always supported) when the surface lacks it.
+	// MAILBOX renders frames that are never shown as fast as it can, FIFO with the Present limiter has the lowest
+	// latency without tearing.
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+	// Swap chain images, 0 for minImageCount + 1, clamped to what the surface supports
+	uint32_t imageCount = 0;
+	// Frames the CPU records ahead of the GPU, 1 to MAX_FRAMES_IN_FLIGHT. Fewer lowers latency, more absorbs spikes.
+	uint32_t framesInFlight = 2;
+	FrameLimiter limiter = FrameLimiter::None;
+	double targetFrameRate = 0.0; // Frames per second of the Timer limiter, 0 for no limit
+};
+
+struct LatencyStats {
+	uint64_t frameCount = 0; // Measured since the last reset
+	double averageMilliseconds = 0.0;
+	double minMilliseconds = 0.0;
+	double maxMilliseconds = 0.0;
+	// Measured until the frame was presented (VK_KHR_present_wait). Otherwise until the GPU completed it, which
+	// leaves out the time spent queued for presentation.
+	bool untilPresent = false;
+};
+
+// CPU side frame pacing and input to present latency. A frame's input is considered sampled when beginFrame is
+// called, its latency ends when its present completes, read through VK_KHR_present_id/present_wait when available and
+// from the frame timeline semaphore otherwise. Completions are seen when polled, once per frame, so the figures may
+// run up to a frame long except for the present the Present limiter waited on.
+// Not thread safe, everything is called from the frame thread.
+class FramePacer
+{
+public:
+	// presentWait is whether VK_KHR_present_id and VK_KHR_present_wait are enabled on device, they are only used if
+	// vkWaitForPresentKHR can be loaded
+	void init(VkDevice device, VkSemaphore frameTimeline, bool presentWait);
+
+	void cleanup();
+
+	void setPolicy(const PresentationPolicy& policy);
+
+	// Blocks as the limiter asks, call before polling input. swapchain is VK_NULL_HANDLE when headless.
+	void waitForNextFrame(VkSwapchainKHR swapchain);
+
+	// The input of the frame about to be recorded was just sampled
+	void beginFrame();
+
+	// Call once the frame is submitted, right before presenting it. Returns the id to present it with through
+	// VkPresentIdKHR, 0 when present_wait is not used.
+	uint64_t endFrame(uint64_t timelineValue);
+
+	// Measures the frames presented since the last call, never blocks
+	void collect(VkSwapchainKHR swapchain);
+
+	// The presents still pending belong to the retired swap chain, they are measured until the GPU completed them
+	void onSwapChainRecreated();
+
+	bool usesPresentWait() const { return this->presentWait; }
+
+	const LatencyStats& getLatencyStats() const { return this->latency; }
+
+	void resetLatencyStats();
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct PendingFrame {
+		uint64_t presentId; // 0 when measured through the timeline
+		uint64_t timelineValue;
+		Clock::time_point inputTime;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkSemaphore frameTimeline = VK_NULL_HANDLE;
+	bool presentWait = false;
+	PFN_vkWaitForPresentKHR waitForPresent = nullptr;
+	FrameLimiter limiter = FrameLimiter::None;
+	Clock::duration frameInterval = Clock::duration::zero();
+	Clock::time_point nextFrameTime;
+	Clock::time_point inputTime;
+	uint64_t nextPresentId = 1; // Increasing across swap chains
+	std::deque<PendingFrame> pending; // Oldest first
+	LatencyStats latency;
+
+	void sleepUntil(Clock::time_point time);
+
+	void record(const PendingFrame& frame, Clock::time_point presentTime);
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+struct Frustum {
+	glm::vec4 planes[6]; // Normalized, pointing inwards
+
+	static Frustum fromViewProjection(const glm::mat4& viewProjection) {
+		// glm is column major, planes are combinations of the rows
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++) {
+			rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		}
+
+		Frustum frustum;
+		frustum.planes[0] = rows[3] + rows[0]; // Left
+		frustum.planes[1] = rows[3] - rows[0]; // Right
+		frustum.planes[2] = rows[3] + rows[1]; // Bottom
+		frustum.planes[3] = rows[3] - rows[1]; // Top
+		frustum.planes[4] = rows[3] + rows[2]; // Near, for [-1, 1] depth and slightly conservative for Vulkan's [0, 1]
+		frustum.planes[5] = rows[3] - rows[2]; // Far
+
+		for (auto& plane : frustum.planes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+		return frustum;
+	}
+
+	bool intersectsSphere(const glm::vec3& center, float radius) const {
+		for (const auto& plane : this->planes) {
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
@@ -0,0 +1,274 @@
+#include "GpuCulling.hpp"
+
+#include <array>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+void GpuCulling::init(VkDevice device, const DeviceProfile& profile, const VkPhysicalDeviceFeatures& enabledFeatures, bool drawIndirectCount, DeviceMemoryAllocator& allocator,
+	VkPipelineCache pipelineCache, VkShaderModule cullShader, uint32_t frameCount, uint32_t maxObjects, uint32_t maxBatches) {
+	if (!isSupported(enabledFeatures)) {
+		throw std::runtime_error("GPU culling needs the drawIndirectFirstInstance feature");
+	}
+
+	this->device = device;
+	this->allocator = &allocator;
+	this->maxObjects = maxObjects;
+	this->maxBatches = maxBatches;
+	this->multiDrawIndirect = enabledFeatures.multiDrawIndirect == VK_TRUE;
+	this->maxDrawIndirectCount = this->multiDrawIndirect ? profile.getProperties().limits.maxDrawIndirectCount : 1;
+
+	// The GPU written count can't be split over several calls, so a batch is drawn in one and needs multiDrawIndirect
+	this->drawIndirectCount = drawIndirectCount && this->multiDrawIndirect;
+
+	const VkDeviceSize alignment = std::max<VkDeviceSize>(profile.getProperties().limits.minStorageBufferOffsetAlignment, 1);
+	this->transformsFrameSize = (sizeof(glm::mat4) * maxObjects + alignment - 1) / alignment * alignment;
+
+	const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	createBuffer(this->objectsBuffer, sizeof(GpuObject) * maxObjects, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible);
+	createBuffer(this->meshesBuffer, sizeof(GpuMesh) * maxObjects, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible);
+	createBuffer(this->transformsBuffer, this->transformsFrameSize * frameCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible);
+	createBuffer(this->batchesBuffer, sizeof(uint32_t) * maxBatches, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible);
+	createBuffer(this->commandsBuffer, sizeof(VkDrawIndexedIndirectCommand) * maxObjects,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	createBuffer(this->countsBuffer, sizeof(uint32_t) * maxBatches,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	createDescriptorSet();
+	createPipeline(pipelineCache, cullShader);
+}
+
+void GpuCulling::cleanup() {
+	vkDestroyPipeline(this->device, this->pipeline, nullptr);
+	vkDestroyPipelineLayout(this->device, this->pipelineLayout, nullptr);
+	vkDestroyDescriptorPool(this->device, this->descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(this->device, this->descriptorSetLayout, nullptr);
+	this->pipeline = VK_NULL_HANDLE;
+	this->pipelineLayout = VK_NULL_HANDLE;
+	this->descriptorPool = VK_NULL_HANDLE;
+	this->descriptorSetLayout = VK_NULL_HANDLE;
+
+	for (Buffer* buffer : { &this->objectsBuffer, &this->meshesBuffer, &this->transformsBuffer, &this->batchesBuffer, &this->commandsBuffer, &this->countsBuffer }) {
+		destroyBuffer(*buffer);
+	}
+	this->batches.clear();
+	this->objectCount = 0;
+}
+
+void GpuCulling::createBuffer(Buffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = std::max<VkDeviceSize>(size, 16);
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(this->device, &bufferInfo, nullptr, &buffer.buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create GPU culling buffer");
+	}
+	buffer.allocation = this->allocator->allocateForBuffer(buffer.buffer, properties);
+}
+
+void GpuCulling::destroyBuffer(Buffer& buffer) {
+	if (buffer.buffer == VK_NULL_HANDLE) return;
+
+	vkDestroyBuffer(this->device, buffer.buffer, nullptr);
+	this->allocator->free(buffer.allocation);
+	buffer.buffer = VK_NULL_HANDLE;
+}
+
+void GpuCulling::createDescriptorSet() {
+	std::array<VkDescriptorSetLayoutBinding, 6> bindings{};
+	for (uint32_t i = 0; i < bindings.size(); i++) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i == TRANSFORMS_BINDING ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(this->device, &layoutInfo, nullptr, &this->descriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create GPU culling descriptor set layout");
+	}
+
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(bindings.size() - 1);
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	poolSizes[1].descriptorCount = 1;
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+
+	if (vkCreateDescriptorPool(this->device, &poolInfo, nullptr, &this->descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create GPU culling descriptor pool");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &this->descriptorSetLayout;
+
+	if (vkAllocateDescriptorSets(this->device, &allocInfo, &this->descriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate GPU culling descriptor set");
+	}
+
+	std::array<VkDescriptorBufferInfo, 6> bufferInfos{};
+	bufferInfos[OBJECTS_BINDING] = { this->objectsBuffer.buffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[MESHES_BINDING] = { this->meshesBuffer.buffer, 0, VK_WHOLE_SIZE };
+	// The dynamic offset selects the region of the frame slot
+	bufferInfos[TRANSFORMS_BINDING] = { this->transformsBuffer.buffer, 0, sizeof(glm::mat4) * this->maxObjects };
+	bufferInfos[BATCHES_BINDING] = { this->batchesBuffer.buffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[COMMANDS_BINDING] = { this->commandsBuffer.buffer, 0, VK_WHOLE_SIZE };
+	bufferInfos[COUNTS_BINDING] = { this->countsBuffer.buffer, 0, VK_WHOLE_SIZE };
+
+	std::array<VkWriteDescriptorSet, 6> writes{};
+	for (uint32_t i = 0; i < writes.size(); i++) {
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = this->descriptorSet;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = bindings[i].descriptorType;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(this->device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void GpuCulling::createPipeline(VkPipelineCache pipelineCache, VkShaderModule cullShader) {
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.size = sizeof(PushConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &this->descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(this->device, &pipelineLayoutInfo, nullptr, &this->pipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create GPU culling pipeline layout");
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = cullShader;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = this->pipelineLayout;
+
+	if (vkCreateComputePipelines(this->device, pipelineCache, 1, &pipelineInfo, nullptr, &this->pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create GPU culling pipeline");
+	}
+}
+
+void GpuCulling::setScene(const std::vector<GpuMesh>& meshes, std::vector<GpuObject> objects, uint32_t batchCount) {
+	if (objects.size() > this->maxObjects || meshes.size() > this->maxObjects || batchCount > this->maxBatches) {
+		throw std::runtime_error("GPU culling scene exceeds the capacity given to init");
+	}
+	// Checked before anything is written, the indices address buffers on both sides
+	std::vector<uint32_t> batchSizes(batchCount);
+	for (const auto& object : objects) {
+		if (object.batchIndex >= batchCount || object.meshIndex >= meshes.size()) {
+			throw std::runtime_error("GPU culling object references a batch or mesh out of range");
+		}
+		if (++batchSizes[object.batchIndex] > this->maxDrawIndirectCount && this->drawIndirectCount) {
+			throw std::runtime_error("GPU culling batch exceeds maxDrawIndirectCount");
+		}
+	}
+
+	// Commands are laid out batch after batch, in object order within a batch
+	this->batches.assign(batchCount, Batch());
+	for (uint32_t i = 0; i < batchCount; i++) {
+		this->batches[i].commandCount = batchSizes[i];
+	}
+	uint32_t firstCommand = 0;
+	for (auto& batch : this->batches) {
+		batch.firstCommand = firstCommand;
+		firstCommand += batch.commandCount;
+	}
+
+	std::vector<uint32_t> nextCommand(batchCount);
+	uint32_t* batchFirstCommands = static_cast<uint32_t*>(this->batchesBuffer.allocation.mappedData);
+	for (uint32_t i = 0; i < batchCount; i++) {
+		nextCommand[i] = this->batches[i].firstCommand;
+		batchFirstCommands[i] = this->batches[i].firstCommand;
+	}
+	for (auto& object : objects) {
+		object.commandIndex = nextCommand[object.batchIndex]++;
+	}
+
+	memcpy(this->objectsBuffer.allocation.mappedData, objects.data(), sizeof(GpuObject) * objects.size());
+	memcpy(this->meshesBuffer.allocation.mappedData, meshes.data(), sizeof(GpuMesh) * meshes.size());
+	this->objectCount = static_cast<uint32_t>(objects.size());
+}
+
+glm::mat4* GpuCulling::getTransforms(uint32_t frameIndex) {
+	return reinterpret_cast<glm::mat4*>(static_cast<char*>(this->transformsBuffer.allocation.mappedData) + this->transformsFrameSize * frameIndex);
+}
+
+void GpuCulling::cull(VkCommandBuffer commandBuffer, uint32_t frameIndex, const Frustum& frustum) {
+	if (this->objectCount == 0) return;
+
+	// The previous frame may still be reading the commands and counts about to be overwritten
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	if (this->drawIndirectCount) {
+		vkCmdFillBuffer(commandBuffer, this->countsBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+		VkMemoryBarrier clearBarrier{};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	PushConstants pushConstants;
+	std::copy(std::begin(frustum.planes), std::end(frustum.planes), pushConstants.planes);
+	pushConstants.objectCount = this->objectCount;
+	pushConstants.compact = this->drawIndirectCount ? 1 : 0;
+
+	const uint32_t dynamicOffset = static_cast<uint32_t>(this->transformsFrameSize * frameIndex);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->pipelineLayout, 0, 1, &this->descriptorSet, 1, &dynamicOffset);
+	vkCmdPushConstants(commandBuffer, this->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+	vkCmdDispatch(commandBuffer, (this->objectCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+
+	VkMemoryBarrier commandsBarrier{};
+	commandsBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	commandsBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	commandsBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &commandsBarrier, 0, nullptr, 0, nullptr);
+}
+
+void GpuCulling::bindDescriptorSet(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, uint32_t frameIndex) const {
+	const uint32_t dynamicOffset = static_cast<uint32_t>(this->transformsFrameSize * frameIndex);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, set, 1, &this->descriptorSet, 1, &dynamicOffset);
+}
+
+void GpuCulling::drawBatch(VkCommandBuffer commandBuffer, uint32_t batchIndex) const {
+	const Batch& batch = this->batches[batchIndex];
+	if (batch.commandCount == 0) return;
+
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+	if (this->drawIndirectCount) {
+		vkCmdDrawIndexedIndirectCount(commandBuffer, this->commandsBuffer.buffer, VkDeviceSize(batch.firstCommand) * stride,
+			this->countsBuffer.buffer, VkDeviceSize(batchIndex) * sizeof(uint32_t), batch.commandCount, stride);
+		return;
+	}
+
+	// Without multiDrawIndirect this is one call per object, still without any CPU side culling
+	for (uint32_t i = 0; i < batch.commandCount; i += this->maxDrawIndirectCount) {
+		const uint32_t drawCount = std::min(this->maxDrawIndirectCount, batch.commandCount - i);
+		vkCmdDrawIndexedIndirect(commandBuffer, this->commandsBuffer.buffer, VkDeviceSize(batch.firstCommand + i) * stride, drawCount, stride);
+	}
+}
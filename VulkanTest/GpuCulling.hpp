@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "DeviceProfile.hpp"
+#include "DeviceMemoryAllocator.hpp"
+#include "Frustum.hpp"
+
+// Range of the bound index buffer making up a mesh, layout shared with shaders/cull.comp
+struct GpuMesh {
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t padding = 0;
+};
+
+// Layout shared with shaders/cull.comp
+struct GpuObject {
+	glm::vec4 boundingSphere; // Center in object space and radius
+	uint32_t meshIndex;
+	uint32_t batchIndex; // Objects of a batch are drawn together, typically one batch per material
+	uint32_t commandIndex = 0; // Assigned by setScene
+	uint32_t padding = 0;
+};
+
+// GPU driven rendering: a compute pass frustum culls every object against its bounding sphere and writes the
+// VkDrawIndexedIndirectCommand of the visible ones, so drawing a whole batch is a single indirect call whatever the
+// object count. With drawIndirectCount and multiDrawIndirect the commands of each batch are compacted and their count
+// is read by the GPU, otherwise every object keeps its command and culled ones get an instanceCount of 0.
+// Draws use the object index as firstInstance: vertex shaders fetch their transform with gl_InstanceIndex.
+// Needs drawIndirectFirstInstance, check isSupported before use.
+class GpuCulling
+{
+public:
+	static constexpr uint32_t WORKGROUP_SIZE = 64; // local_size_x of shaders/cull.comp
+	// Bindings of the descriptor set, also bound for graphics so that vertex shaders can read the transforms
+	static constexpr uint32_t OBJECTS_BINDING = 0;
+	static constexpr uint32_t MESHES_BINDING = 1;
+	static constexpr uint32_t TRANSFORMS_BINDING = 2;
+	static constexpr uint32_t BATCHES_BINDING = 3;
+	static constexpr uint32_t COMMANDS_BINDING = 4;
+	static constexpr uint32_t COUNTS_BINDING = 5;
+
+	static bool isSupported(const VkPhysicalDeviceFeatures& enabledFeatures) { return enabledFeatures.drawIndirectFirstInstance == VK_TRUE; }
+
+	// cullShader is the SPIR-V of shaders/cull.comp. drawIndirectCount tells whether the Vulkan 1.2 drawIndirectCount
+	// feature is enabled on device.
+	void init(VkDevice device, const DeviceProfile& profile, const VkPhysicalDeviceFeatures& enabledFeatures, bool drawIndirectCount, DeviceMemoryAllocator& allocator,
+		VkPipelineCache pipelineCache, VkShaderModule cullShader, uint32_t frameCount, uint32_t maxObjects, uint32_t maxBatches);
+
+	void cleanup();
+
+	// Replaces the scene, the device must be idle (or no frame using the previous scene in flight). Throws when an object
+	// references a batch or mesh out of range.
+	void setScene(const std::vector<GpuMesh>& meshes, std::vector<GpuObject> objects, uint32_t batchCount);
+
+	// One model matrix per object, persistently mapped. Write the ones of frameIndex after waiting on its fence.
+	glm::mat4* getTransforms(uint32_t frameIndex);
+
+	// Records the culling dispatch and the barriers around it, outside of any render pass
+	void cull(VkCommandBuffer commandBuffer, uint32_t frameIndex, const Frustum& frustum);
+
+	// Binds the descriptor set at set for the graphics pipelines drawing the culled objects
+	void bindDescriptorSet(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, uint32_t frameIndex) const;
+
+	// Draws the visible objects of a batch, with the pipeline, index buffer and descriptor set already bound
+	void drawBatch(VkCommandBuffer commandBuffer, uint32_t batchIndex) const;
+
+	VkDescriptorSetLayout getDescriptorSetLayout() const { return this->descriptorSetLayout; }
+
+	uint32_t getObjectCount() const { return static_cast<uint32_t>(this->objectCount); }
+
+	bool usesDrawIndirectCount() const { return this->drawIndirectCount; }
+
+private:
+	struct PushConstants {
+		glm::vec4 planes[6];
+		uint32_t objectCount;
+		uint32_t compact;
+	};
+
+	struct Batch {
+		uint32_t firstCommand = 0;
+		uint32_t commandCount = 0;
+	};
+
+	struct Buffer {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		MemoryAllocation allocation;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceMemoryAllocator* allocator = nullptr;
+	bool drawIndirectCount = false;
+	bool multiDrawIndirect = false;
+	uint32_t maxDrawIndirectCount = 1;
+	uint32_t maxObjects = 0;
+	uint32_t maxBatches = 0;
+	uint32_t objectCount = 0;
+	VkDeviceSize transformsFrameSize = 0; // Aligned to minStorageBufferOffsetAlignment
+	std::vector<Batch> batches;
+	Buffer objectsBuffer;
+	Buffer meshesBuffer;
+	Buffer transformsBuffer; // A region of maxObjects matrices per frame slot
+	Buffer batchesBuffer; // First command of each batch
+	Buffer commandsBuffer;
+	Buffer countsBuffer; // Visible object count of each batch
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+
+	void createBuffer(Buffer& buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+
+	void destroyBuffer(Buffer& buffer);
+
+	void createDescriptorSet();
+
+	void createPipeline(VkPipelineCache pipelineCache, VkShaderModule cullShader);
+};
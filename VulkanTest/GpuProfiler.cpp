@@ -0,0 +1,217 @@
+#include "GpuProfiler.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+
+void GpuProfiler::init(VkDevice device, const DeviceProfile& profile, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t maxScopesPerFrame) {
+	this->device = device;
+	this->maxScopes = maxScopesPerFrame;
+
+	uint32_t validBits = profile.getQueueFamilyProperties()[queueFamilyIndex].timestampValidBits;
+	this->timestampPeriod = profile.getProperties().limits.timestampPeriod;
+	this->enabled = validBits > 0 && this->timestampPeriod > 0.0f;
+	if (!this->enabled) {
+		return;
+	}
+	this->timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+	this->slots.resize(frameCount);
+	for (auto& slot : this->slots) {
+		VkQueryPoolCreateInfo queryPoolInfo{};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = this->maxScopes * 2;
+
+		if (vkCreateQueryPool(this->device, &queryPoolInfo, nullptr, &slot.queryPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create timestamp query pool");
+		}
+		slot.scopes.reserve(this->maxScopes);
+	}
+	this->timestamps.resize(this->maxScopes * 2);
+}
+
+void GpuProfiler::cleanup() {
+	for (auto& slot : this->slots) {
+		vkDestroyQueryPool(this->device, slot.queryPool, nullptr);
+	}
+	this->slots.clear();
+	this->enabled = false;
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint64_t frameNumber) {
+	if (!this->enabled) return;
+
+	FrameSlot& slot = this->slots[frameIndex];
+	if (slot.pending) {
+		resolve(slot);
+	}
+
+	vkCmdResetQueryPool(commandBuffer, slot.queryPool, 0, this->maxScopes * 2);
+	slot.frameNumber = frameNumber;
+	slot.cpuMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	slot.queryCount = 0;
+	slot.scopes.clear();
+	slot.pending = true;
+
+	this->currentSlot = &slot;
+	this->openScopes.clear();
+	beginScope(commandBuffer, "Frame");
+}
+
+void GpuProfiler::endFrame(VkCommandBuffer commandBuffer) {
+	if (!this->enabled) return;
+
+	// Scopes left open by mistake are closed with the frame, so the trace stays well nested
+	while (!this->openScopes.empty()) {
+		endScope(commandBuffer);
+	}
+	this->currentSlot = nullptr;
+}
+
+void GpuProfiler::beginScope(VkCommandBuffer commandBuffer, const char* name) {
+	if (!this->enabled || this->currentSlot == nullptr) return;
+
+	FrameSlot& slot = *this->currentSlot;
+	if (slot.scopes.size() == this->maxScopes) {
+		// Out of queries, the scope is still pushed so that the matching endScope stays balanced
+		this->openScopes.push_back(UINT32_MAX);
+		return;
+	}
+
+	Scope scope;
+	scope.name = name;
+	scope.depth = static_cast<uint32_t>(this->openScopes.size());
+	scope.beginQuery = slot.queryCount++;
+	scope.endQuery = UINT32_MAX;
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.queryPool, scope.beginQuery);
+
+	this->openScopes.push_back(static_cast<uint32_t>(slot.scopes.size()));
+	slot.scopes.push_back(scope);
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer) {
+	if (!this->enabled || this->currentSlot == nullptr || this->openScopes.empty()) return;
+
+	uint32_t scopeIndex = this->openScopes.back();
+	this->openScopes.pop_back();
+	if (scopeIndex == UINT32_MAX) {
+		return;
+	}
+
+	FrameSlot& slot = *this->currentSlot;
+	Scope& scope = slot.scopes[scopeIndex];
+	scope.endQuery = slot.queryCount++;
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.queryPool, scope.endQuery);
+}
+
+void GpuProfiler::resolve(FrameSlot& slot) {
+	slot.pending = false;
+	if (slot.queryCount == 0) {
+		return;
+	}
+
+	// The slot's fence has been waited on, so this doesn't block. Without WAIT_BIT a result that is somehow not
+	// available yet makes the whole frame be dropped instead of stalling.
+	VkResult result = vkGetQueryPoolResults(this->device, slot.queryPool, 0, slot.queryCount,
+		slot.queryCount * sizeof(uint64_t), this->timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS) {
+		return;
+	}
+
+	const uint64_t frameStart = this->timestamps[slot.scopes[0].beginQuery] & this->timestampMask;
+	if (!this->hasFirstTimestamp) {
+		this->firstTimestamp = frameStart;
+		this->firstCpuMicroseconds = slot.cpuMicroseconds;
+		this->hasFirstTimestamp = true;
+	}
+
+	this->lastFrame.frameNumber = slot.frameNumber;
+	this->lastFrame.scopes.clear();
+
+	for (const Scope& scope : slot.scopes) {
+		const uint64_t begin = this->timestamps[scope.beginQuery] & this->timestampMask;
+		const uint64_t end = this->timestamps[scope.endQuery] & this->timestampMask;
+		// Differences are taken modulo the valid bits, so a counter wrapping around within a frame is harmless
+		const double durationNanoseconds = ((end - begin) & this->timestampMask) * this->timestampPeriod;
+		const double startNanoseconds = ((begin - frameStart) & this->timestampMask) * this->timestampPeriod;
+
+		GpuScopeResult scopeResult;
+		scopeResult.name = scope.name;
+		scopeResult.depth = scope.depth;
+		scopeResult.startMilliseconds = startNanoseconds * 1e-6;
+		scopeResult.durationMilliseconds = durationNanoseconds * 1e-6;
+		this->lastFrame.scopes.push_back(scopeResult);
+
+		auto& window = this->samples[scope.name];
+		window.push_back(scopeResult.durationMilliseconds);
+		if (window.size() > STATS_WINDOW) {
+			window.pop_front();
+		}
+
+		TraceEvent event;
+		event.name = scope.name;
+		event.depth = scope.depth;
+		event.frameNumber = slot.frameNumber;
+		event.startMicroseconds = this->firstCpuMicroseconds + ((begin - this->firstTimestamp) & this->timestampMask) * this->timestampPeriod * 1e-3;
+		event.durationMicroseconds = durationNanoseconds * 1e-3;
+		this->traceEvents.push_back(event);
+	}
+
+	// Drop whole frames, the oldest first
+	while (!this->traceEvents.empty() && this->traceEvents.front().frameNumber + MAX_TRACE_FRAMES <= slot.frameNumber) {
+		this->traceEvents.pop_front();
+	}
+}
+
+std::map<std::string, GpuScopeStats> GpuProfiler::getStats() const {
+	std::map<std::string, GpuScopeStats> stats;
+
+	std::vector<double> sorted;
+	for (const auto& entry : this->samples) {
+		sorted.assign(entry.second.begin(), entry.second.end());
+		if (sorted.empty()) continue;
+		std::sort(sorted.begin(), sorted.end());
+
+		auto percentile = [&sorted](double fraction) {
+			size_t index = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+			return sorted[std::min(index, sorted.size() - 1)];
+		};
+
+		GpuScopeStats scopeStats;
+		scopeStats.sampleCount = static_cast<uint32_t>(sorted.size());
+		for (double sample : sorted) {
+			scopeStats.mean += sample;
+		}
+		scopeStats.mean /= sorted.size();
+		scopeStats.p50 = percentile(0.50);
+		scopeStats.p95 = percentile(0.95);
+		scopeStats.p99 = percentile(0.99);
+		stats[entry.first] = scopeStats;
+	}
+
+	return stats;
+}
+
+bool GpuProfiler::writeChromeTrace(const std::string& path) const {
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}";
+	for (const auto& event : this->traceEvents) {
+		file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":0"
+			<< ",\"ts\":" << event.startMicroseconds << ",\"dur\":" << event.durationMicroseconds
+			<< ",\"args\":{\"frame\":" << event.frameNumber << ",\"depth\":" << event.depth << "}}";
+	}
+	file << "\n]}\n";
+
+	return file.good();
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <map>
+
+#include "DeviceProfile.hpp"
+
+struct GpuScopeResult {
+	const char* name;
+	uint32_t depth; // 0 for the frame itself, 1 for scopes directly inside it and so on
+	double startMilliseconds; // Relative to the start of the frame
+	double durationMilliseconds;
+};
+
+struct GpuFrameResult {
+	uint64_t frameNumber = 0;
+	std::vector<GpuScopeResult> scopes; // In the order the scopes were opened
+};
+
+struct GpuScopeStats {
+	uint32_t sampleCount = 0; // Within the rolling window
+	double mean = 0.0;
+	double p50 = 0.0;
+	double p95 = 0.0;
+	double p99 = 0.0;
+};
+
+// Timestamp queries around named, nestable scopes. Each frame slot has its own query pool, whose results are read
+// when the slot comes around again (its fence has been waited on by then), so reading never stalls the GPU.
+// Scopes must be recorded on the frame's primary command buffer, from the frame thread, outside of secondaries.
+class GpuProfiler
+{
+public:
+	static constexpr uint32_t DEFAULT_MAX_SCOPES = 256;
+	static constexpr uint32_t STATS_WINDOW = 256; // Samples per scope used for the percentiles
+	static constexpr uint32_t MAX_TRACE_FRAMES = 1000; // Frames kept for the trace export
+
+	void init(VkDevice device, const DeviceProfile& profile, uint32_t queueFamilyIndex, uint32_t frameCount, uint32_t maxScopesPerFrame = DEFAULT_MAX_SCOPES);
+
+	void cleanup();
+
+	// False when the queue family has no timestamp support, every other call is then a no-op
+	bool isEnabled() const { return this->enabled; }
+
+	// Resolves the results of the previous use of the slot, resets its queries and opens the "Frame" scope.
+	// Call right after vkBeginCommandBuffer, outside of any render pass.
+	void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex, uint64_t frameNumber);
+
+	// Closes the "Frame" scope, call right before vkEndCommandBuffer
+	void endFrame(VkCommandBuffer commandBuffer);
+
+	// name must outlive the profiler, string literals are the intended use
+	void beginScope(VkCommandBuffer commandBuffer, const char* name);
+
+	void endScope(VkCommandBuffer commandBuffer);
+
+	// Most recent frame whose results have been read back, as many frames behind as there are slots in use
+	const GpuFrameResult& getLastFrame() const { return this->lastFrame; }
+
+	std::map<std::string, GpuScopeStats> getStats() const;
+
+	// Chrome trace event format, load it in chrome://tracing or Perfetto. Times are in microseconds of
+	// std::chrono::steady_clock like CpuTrace's, so both traces line up when loaded together. The GPU clock is anchored
+	// to the CPU time at which the first frame read back began recording, GPU scopes therefore show up slightly early
+	// (by the record and submit latency of that frame) and may drift over very long traces.
+	bool writeChromeTrace(const std::string& path) const;
+
+private:
+	struct Scope {
+		const char* name;
+		uint32_t depth;
+		uint32_t beginQuery;
+		uint32_t endQuery;
+	};
+
+	struct FrameSlot {
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		uint64_t frameNumber = 0;
+		double cpuMicroseconds = 0.0; // steady_clock time at beginFrame
+		uint32_t queryCount = 0;
+		std::vector<Scope> scopes;
+		bool pending = false; // Recorded and submitted, results not read yet
+	};
+
+	struct TraceEvent {
+		const char* name;
+		uint32_t depth;
+		uint64_t frameNumber;
+		double startMicroseconds;
+		double durationMicroseconds;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	bool enabled = false;
+	double timestampPeriod = 1.0; // Nanoseconds per tick
+	uint64_t timestampMask = ~0ull;
+	uint32_t maxScopes = 0;
+
+	std::vector<FrameSlot> slots;
+	FrameSlot* currentSlot = nullptr;
+	std::vector<uint32_t> openScopes; // Indices into currentSlot->scopes
+	std::vector<uint64_t> timestamps;
+
+	GpuFrameResult lastFrame;
+	std::map<std::string, std::deque<double>> samples;
+	std::deque<TraceEvent> traceEvents;
+	uint64_t firstTimestamp = 0;
+	double firstCpuMicroseconds = 0.0;
+	bool hasFirstTimestamp = false;
+
+	void resolve(FrameSlot& slot);
+};
+
+// Opens a scope for the lifetime of the object
+class GpuScope
+{
+public:
+	GpuScope(GpuProfiler& profiler, VkCommandBuffer commandBuffer, const char* name) : profiler(profiler), commandBuffer(commandBuffer) {
+		this->profiler.beginScope(this->commandBuffer, name);
+	}
+	~GpuScope() {
+		this->profiler.endScope(this->commandBuffer);
+	}
+
+private:
+	GpuProfiler& profiler;
+	VkCommandBuffer commandBuffer;
+};
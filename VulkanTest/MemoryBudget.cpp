@@ -0,0 +1,90 @@
+#include "MemoryBudget.hpp"
+#include "CpuTrace.hpp"
+
+#include <algorithm>
+
+void MemoryBudget::init(const DeviceProfile& profile, DeviceMemoryAllocator& allocator, bool budgetExtension, float fallbackBudgetFraction) {
+	this->profile = &profile;
+	this->allocator = &allocator;
+	this->budgetExtension = budgetExtension;
+	this->fallbackBudgetFraction = fallbackBudgetFraction;
+	this->memoryProperties = profile.getMemoryProperties();
+
+	this->heaps.assign(this->memoryProperties.memoryHeapCount, HeapBudget{});
+	for (uint32_t i = 0; i < this->memoryProperties.memoryHeapCount; i++) {
+		this->heaps[i].size = this->memoryProperties.memoryHeaps[i].size;
+		this->heaps[i].deviceLocal = (this->memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+	}
+
+	for (uint32_t i = 0; i < this->memoryProperties.memoryTypeCount; i++) {
+		if (this->memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) {
+			this->deviceLocalHeap = this->memoryProperties.memoryTypes[i].heapIndex;
+			break;
+		}
+	}
+
+	update();
+}
+
+void MemoryBudget::cleanup() {
+	this->listeners.clear();
+	this->heaps.clear();
+}
+
+void MemoryBudget::update() {
+	CPU_TRACE_ZONE("Update memory budget");
+	MemoryStats stats = this->allocator->getStats();
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+	if (this->budgetExtension) {
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memoryProperties2.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(this->profile->getPhysicalDevice(), &memoryProperties2);
+	}
+
+	for (uint32_t i = 0; i < this->heaps.size(); i++) {
+		HeapBudget& heap = this->heaps[i];
+		if (this->budgetExtension) {
+			// Some drivers report a budget above the heap size
+			heap.budget = std::min(budgetProperties.heapBudget[i], heap.size);
+			heap.usage = budgetProperties.heapUsage[i];
+		}
+		else {
+			heap.budget = static_cast<VkDeviceSize>(heap.size * this->fallbackBudgetFraction);
+			heap.usage = stats.heapBytes[i];
+		}
+		for (uint32_t category = 0; category < MEMORY_CATEGORY_COUNT; category++) {
+			heap.categoryBytes[category] = stats.heapCategoryBytes[i][category];
+		}
+		heap.freeBlockBytes = stats.heapFreeBlockBytes[i];
+
+		const double fraction = heap.budget > 0 ? static_cast<double>(heap.usage) / heap.budget : 1.0;
+		MemoryPressure pressure = MemoryPressure::Low;
+		if (fraction >= this->criticalThreshold) {
+			pressure = MemoryPressure::Critical;
+		}
+		else if (fraction >= this->elevatedThreshold) {
+			pressure = MemoryPressure::Elevated;
+		}
+
+		if (pressure != heap.pressure) {
+			MemoryPressureEvent event = { i, heap.pressure, pressure, heap.usage, heap.budget };
+			heap.pressure = pressure;
+			for (const auto& listener : this->listeners) {
+				listener(event);
+			}
+		}
+	}
+}
+
+void MemoryBudget::addPressureListener(PressureListener listener) {
+	this->listeners.push_back(std::move(listener));
+}
+
+void MemoryBudget::setThresholds(float elevated, float critical) {
+	this->elevatedThreshold = elevated;
+	this->criticalThreshold = critical;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <functional>
+
+#include "DeviceProfile.hpp"
+#include "DeviceMemoryAllocator.hpp"
+
+enum class MemoryPressure {
+	Low,
+	Elevated, // Past elevatedThreshold of the budget, stop streaming in
+	Critical  // Past criticalThreshold, the driver may start paging soon
+};
+
+struct HeapBudget {
+	VkDeviceSize size = 0;
+	VkDeviceSize budget = 0; // What the process can use before paging, from VK_EXT_memory_budget or a fraction of size
+	VkDeviceSize usage = 0; // Of the process, from VK_EXT_memory_budget or the allocator's VkDeviceMemory bytes
+	VkDeviceSize categoryBytes[MEMORY_CATEGORY_COUNT] = {}; // Allocated through the allocator, by MemoryCategory
+	// Free space inside the allocator's blocks. It is part of usage, but freeing a suballocation only adds to it, the
+	// block stays allocated.
+	VkDeviceSize freeBlockBytes = 0;
+	bool deviceLocal = false;
+	MemoryPressure pressure = MemoryPressure::Low;
+};
+
+struct MemoryPressureEvent {
+	uint32_t heapIndex;
+	MemoryPressure previous;
+	MemoryPressure pressure;
+	VkDeviceSize usage;
+	VkDeviceSize budget;
+};
+
+// Usage and budget of every memory heap, refreshed by update. With VK_EXT_memory_budget both come from the driver and
+// account for other processes and the driver's own allocations. Without it the budget is a fraction of the heap size
+// and the usage is what the allocator holds. Listeners are told when the pressure level of a heap changes.
+// Not thread safe, update and the getters from the frame thread only.
+class MemoryBudget
+{
+public:
+	using PressureListener = std::function<void(const MemoryPressureEvent& event)>;
+
+	// budgetExtension is whether VK_EXT_memory_budget is enabled on the device
+	void init(const DeviceProfile& profile, DeviceMemoryAllocator& allocator, bool budgetExtension, float fallbackBudgetFraction = 0.8f);
+
+	void cleanup();
+
+	// Queries the budgets and notifies the listeners of the heaps whose pressure changed, once per frame is enough
+	void update();
+
+	void addPressureListener(PressureListener listener);
+
+	// Fractions of the budget where Elevated and Critical pressure start
+	void setThresholds(float elevated, float critical);
+
+	uint32_t getHeapCount() const { return static_cast<uint32_t>(this->heaps.size()); }
+
+	const HeapBudget& getHeap(uint32_t heapIndex) const { return this->heaps[heapIndex]; }
+
+	// Heap of the first DEVICE_LOCAL memory type, where textures and attachments go
+	uint32_t getDeviceLocalHeap() const { return this->deviceLocalHeap; }
+
+	uint32_t getHeapIndex(uint32_t memoryTypeIndex) const { return this->memoryProperties.memoryTypes[memoryTypeIndex].heapIndex; }
+
+	bool usesBudgetExtension() const { return this->budgetExtension; }
+
+private:
+	const DeviceProfile* profile = nullptr;
+	DeviceMemoryAllocator* allocator = nullptr;
+	VkPhysicalDeviceMemoryProperties memoryProperties{};
+	bool budgetExtension = false;
+	float fallbackBudgetFraction = 0.8f;
+	float elevatedThreshold = 0.75f;
+	float criticalThreshold = 0.9f;
+	uint32_t deviceLocalHeap = 0;
+	std::vector<HeapBudget> heaps;
+	std::vector<PressureListener> listeners;
+};
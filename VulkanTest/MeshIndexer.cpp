@@ -0,0 +1,315 @@
+#include "MeshIndexer.hpp"
+
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+	// Runs function(threadIndex) on threadCount threads, the calling thread included
+	template<typename Function>
+	void forEachThread(uint32_t threadCount, Function function) {
+		std::vector<std::thread> threads;
+		for (uint32_t i = 1; i < threadCount; i++) {
+			threads.emplace_back(function, i);
+		}
+		function(0);
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	}
+
+	// Same split for every pass, so per thread counts from one pass line up with the next
+	void threadRange(size_t count, uint32_t threadCount, uint32_t threadIndex, size_t& begin, size_t& end) {
+		size_t chunk = (count + threadCount - 1) / threadCount;
+		begin = std::min(count, threadIndex * chunk);
+		end = std::min(count, begin + chunk);
+	}
+}
+
+void MeshIndexer::buildIndexed(const std::vector<Vertex>& input, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t threadCount) {
+	const size_t count = input.size();
+	const uint32_t EMPTY = UINT32_MAX;
+
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threadCount = static_cast<uint32_t>(std::clamp<size_t>(count / MIN_VERTICES_PER_THREAD, 1, threadCount));
+
+	// Hash every vertex once and count how many fall in each shard, per thread
+	std::vector<size_t> hashes(count);
+	std::vector<size_t> shardOffsets(threadCount * SHARD_COUNT, 0);
+	forEachThread(threadCount, [&](uint32_t thread) {
+		size_t begin, end;
+		threadRange(count, threadCount, thread, begin, end);
+		size_t* counts = &shardOffsets[thread * SHARD_COUNT];
+		std::hash<Vertex> hasher;
+		for (size_t i = begin; i < end; i++) {
+			hashes[i] = hasher(input[i]);
+			counts[shardOf(hashes[i])]++;
+		}
+	});
+
+	// Shard major prefix sum, within a shard every thread writes after the threads before it so input order is kept
+	std::vector<size_t> shardBegin(SHARD_COUNT + 1);
+	size_t offset = 0;
+	for (uint32_t shard = 0; shard < SHARD_COUNT; shard++) {
+		shardBegin[shard] = offset;
+		for (uint32_t thread = 0; thread < threadCount; thread++) {
+			size_t shardCount = shardOffsets[thread * SHARD_COUNT + shard];
+			shardOffsets[thread * SHARD_COUNT + shard] = offset;
+			offset += shardCount;
+		}
+	}
+	shardBegin[SHARD_COUNT] = offset;
+
+	std::vector<uint32_t> sorted(count);
+	forEachThread(threadCount, [&](uint32_t thread) {
+		size_t begin, end;
+		threadRange(count, threadCount, thread, begin, end);
+		size_t* cursors = &shardOffsets[thread * SHARD_COUNT];
+		for (size_t i = begin; i < end; i++) {
+			sorted[cursors[shardOf(hashes[i])]++] = static_cast<uint32_t>(i);
+		}
+	});
+
+	// Deduplicate every shard independently. Unique vertices of a shard are numbered from 0 in order of first use and
+	// representatives holds, from the shard's begin, the input index of each of them
+	std::vector<uint32_t> localIndices(count);
+	std::vector<uint32_t> representatives(count);
+	std::vector<uint32_t> uniqueCounts(SHARD_COUNT);
+	std::atomic<uint32_t> nextShard{ 0 };
+	forEachThread(threadCount, [&](uint32_t /*thread*/) {
+		std::vector<uint32_t> table;
+		for (uint32_t shard = nextShard++; shard < SHARD_COUNT; shard = nextShard++) {
+			const size_t begin = shardBegin[shard];
+			const size_t end = shardBegin[shard + 1];
+
+			// Load factor of at most 0.5 keeps linear probing sequences short
+			size_t capacity = 16;
+			while (capacity < (end - begin) * 2) {
+				capacity *= 2;
+			}
+			table.assign(capacity, EMPTY);
+
+			uint32_t uniqueCount = 0;
+			for (size_t j = begin; j < end; j++) {
+				const uint32_t i = sorted[j];
+				// The top bits select the shard, the low bits are free for the table
+				size_t slot = hashes[i] & (capacity - 1);
+				while (true) {
+					const uint32_t entry = table[slot];
+					if (entry == EMPTY) {
+						table[slot] = uniqueCount;
+						representatives[begin + uniqueCount] = i;
+						localIndices[i] = uniqueCount++;
+						break;
+					}
+
+					const uint32_t candidate = representatives[begin + entry];
+					if (hashes[candidate] == hashes[i] && input[candidate] == input[i]) {
+						localIndices[i] = entry;
+						break;
+					}
+					slot = (slot + 1) & (capacity - 1);
+				}
+			}
+			uniqueCounts[shard] = uniqueCount;
+		}
+	});
+
+	std::vector<uint32_t> vertexBase(SHARD_COUNT);
+	uint32_t vertexCount = 0;
+	for (uint32_t shard = 0; shard < SHARD_COUNT; shard++) {
+		vertexBase[shard] = vertexCount;
+		vertexCount += uniqueCounts[shard];
+	}
+
+	vertices.resize(vertexCount);
+	indices.resize(count);
+	forEachThread(threadCount, [&](uint32_t thread) {
+		size_t begin, end;
+		threadRange(count, threadCount, thread, begin, end);
+		for (size_t i = begin; i < end; i++) {
+			const uint32_t shard = shardOf(hashes[i]);
+			indices[i] = vertexBase[shard] + localIndices[i];
+			// Only the first occurrence writes its vertex
+			if (representatives[shardBegin[shard] + localIndices[i]] == i) {
+				vertices[indices[i]] = input[i];
+			}
+		}
+	});
+}
+
+float MeshIndexer::vertexScore(int32_t cachePosition, uint32_t remainingTriangles) {
+	if (remainingTriangles == 0) {
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (cachePosition >= 0) {
+		if (cachePosition < 3) {
+			// The vertices of the last triangle get a fixed score so the next triangle doesn't just repeat its edge
+			score = LAST_TRIANGLE_SCORE;
+		}
+		else {
+			const float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scale, CACHE_DECAY_POWER);
+		}
+	}
+
+	// Favour vertices with few triangles left, finishing them off avoids having to come back for them later
+	score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+	return score;
+}
+
+void MeshIndexer::optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// Triangles using each vertex, the live ones are kept at the start of each vertex's range
+	std::vector<uint32_t> remaining(vertexCount, 0);
+	for (uint32_t index : indices) {
+		remaining[index]++;
+	}
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+	uint32_t offset = 0;
+	for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+		adjacencyOffsets[vertex] = offset;
+		offset += remaining[vertex];
+	}
+	adjacencyOffsets[vertexCount] = offset;
+
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++) {
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<int32_t> cachePositions(vertexCount, -1);
+	std::vector<float> vertexScores(vertexCount);
+	for (size_t vertex = 0; vertex < vertexCount; vertex++) {
+		vertexScores[vertex] = vertexScore(-1, remaining[vertex]);
+	}
+
+	std::vector<float> triangleScores(triangleCount);
+	for (size_t triangle = 0; triangle < triangleCount; triangle++) {
+		triangleScores[triangle] = vertexScores[indices[triangle * 3]]
+			+ vertexScores[indices[triangle * 3 + 1]]
+			+ vertexScores[indices[triangle * 3 + 2]];
+	}
+
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	uint32_t cache[FORSYTH_CACHE_SIZE + 3];
+	uint32_t cacheCount = 0;
+	size_t scanCursor = 0;
+
+	size_t bestTriangle = std::max_element(triangleScores.begin(), triangleScores.end()) - triangleScores.begin();
+	while (true) {
+		emitted[bestTriangle] = 1;
+		const uint32_t* triangleIndices = &indices[bestTriangle * 3];
+
+		uint32_t newCache[FORSYTH_CACHE_SIZE + 3];
+		uint32_t newCacheCount = 0;
+		for (uint32_t i = 0; i < 3; i++) {
+			const uint32_t vertex = triangleIndices[i];
+			output.push_back(vertex);
+			newCache[newCacheCount++] = vertex;
+
+			// Swap the triangle out of the live part of the vertex's adjacency
+			uint32_t* triangles = &adjacency[adjacencyOffsets[vertex]];
+			uint32_t* last = triangles + remaining[vertex] - 1;
+			*std::find(triangles, last, static_cast<uint32_t>(bestTriangle)) = *last;
+			remaining[vertex]--;
+		}
+		for (uint32_t i = 0; i < cacheCount; i++) {
+			const uint32_t vertex = cache[i];
+			if (vertex != triangleIndices[0] && vertex != triangleIndices[1] && vertex != triangleIndices[2]) {
+				newCache[newCacheCount++] = vertex;
+			}
+		}
+
+		// Rescore the cached vertices and the ones just pushed out, propagating the change to their live triangles
+		for (uint32_t i = 0; i < newCacheCount; i++) {
+			const uint32_t vertex = newCache[i];
+			cachePositions[vertex] = i < FORSYTH_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+
+			const float score = vertexScore(cachePositions[vertex], remaining[vertex]);
+			const float delta = score - vertexScores[vertex];
+			vertexScores[vertex] = score;
+
+			const uint32_t* triangles = &adjacency[adjacencyOffsets[vertex]];
+			for (uint32_t j = 0; j < remaining[vertex]; j++) {
+				triangleScores[triangles[j]] += delta;
+			}
+		}
+		cacheCount = std::min(newCacheCount, FORSYTH_CACHE_SIZE);
+		std::copy(newCache, newCache + cacheCount, cache);
+
+		// Only triangles touching the cache can have become the best candidate
+		float bestScore = -1.0f;
+		bestTriangle = triangleCount;
+		for (uint32_t i = 0; i < cacheCount; i++) {
+			const uint32_t vertex = cache[i];
+			const uint32_t* triangles = &adjacency[adjacencyOffsets[vertex]];
+			for (uint32_t j = 0; j < remaining[vertex]; j++) {
+				if (triangleScores[triangles[j]] > bestScore) {
+					bestScore = triangleScores[triangles[j]];
+					bestTriangle = triangles[j];
+				}
+			}
+		}
+
+		// Cache exhausted, restart from the next triangle not yet emitted
+		if (bestTriangle == triangleCount) {
+			while (scanCursor < triangleCount && emitted[scanCursor]) {
+				scanCursor++;
+			}
+			if (scanCursor == triangleCount) {
+				break;
+			}
+			bestTriangle = scanCursor;
+		}
+	}
+
+	indices.swap(output);
+}
+
+void MeshIndexer::optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (uint32_t& index : indices) {
+		if (remap[index] == UINT32_MAX) {
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(reordered);
+}
+
+double MeshIndexer::computeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+	if (indices.size() < 3) {
+		return 0.0;
+	}
+
+	// FIFO cache: a vertex is still cached if fewer than cacheSize misses happened since it was loaded
+	std::vector<uint64_t> loadedAt(vertexCount, 0);
+	uint64_t misses = cacheSize + 1;
+	const uint64_t firstMiss = misses;
+	for (uint32_t index : indices) {
+		if (misses - loadedAt[index] > cacheSize) {
+			loadedAt[index] = misses++;
+		}
+	}
+
+	return static_cast<double>(misses - firstMiss) / (indices.size() / 3);
+}
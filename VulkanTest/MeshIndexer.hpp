@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "types.hpp"
+
+// Turns unindexed triangle lists into indexed meshes and reorders them for the GPU's post-transform vertex cache and
+// for vertex fetch locality
+class MeshIndexer
+{
+public:
+	// Size of the FIFO cache simulated by computeACMR, in the range of what current GPUs effectively reuse
+	static constexpr uint32_t DEFAULT_CACHE_SIZE = 16;
+
+	// Deduplicates input, three vertices per triangle. Vertices are hashed and sharded across threadCount threads,
+	// each shard is deduplicated with its own open addressing table. The result does not depend on threadCount.
+	// threadCount = 0 uses every hardware thread, small inputs always run on the calling thread.
+	static void buildIndexed(const std::vector<Vertex>& input, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t threadCount = 0);
+
+	// Reorders triangles with Forsyth's linear-speed vertex cache optimization
+	static void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+	// Reorders vertices by first use in indices and drops unreferenced ones, call after optimizeVertexCache
+	static void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+	// Average cache miss ratio: transformed vertices per triangle, 0.5 is ideal for regular grids and 3 the worst
+	static double computeACMR(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = DEFAULT_CACHE_SIZE);
+
+private:
+	static constexpr uint32_t SHARD_BITS = 8;
+	static constexpr uint32_t SHARD_COUNT = 1u << SHARD_BITS;
+	static constexpr size_t MIN_VERTICES_PER_THREAD = 1 << 16;
+
+	// Forsyth's scoring, the simulated LRU cache is larger than the FIFO used by computeACMR on purpose
+	static constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+	static constexpr float CACHE_DECAY_POWER = 1.5f;
+	static constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+	static constexpr float VALENCE_BOOST_SCALE = 2.0f;
+	static constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+	static uint32_t shardOf(size_t hash) { return static_cast<uint32_t>(hash >> (sizeof(size_t) * 8 - SHARD_BITS)); }
+
+	static float vertexScore(int32_t cachePosition, uint32_t remainingTriangles);
+};
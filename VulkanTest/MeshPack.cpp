@@ -0,0 +1,168 @@
+#include "MeshPack.hpp"
+
+#include <stdexcept>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+void MeshPack::open(const std::string& path) {
+	close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to open mesh pack " + path);
+	}
+	this->fileHandle = file;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		close();
+		throw std::runtime_error("Failed to read the size of mesh pack " + path);
+	}
+	this->size = static_cast<uint64_t>(fileSize.QuadPart);
+
+	this->mappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void* mapped = this->mappingHandle != nullptr ? MapViewOfFile(this->mappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (mapped == nullptr) {
+		close();
+		throw std::runtime_error("Failed to map mesh pack " + path);
+	}
+#else
+	int file = ::open(path.c_str(), O_RDONLY);
+	if (file < 0) {
+		throw std::runtime_error("Failed to open mesh pack " + path);
+	}
+
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0) {
+		::close(file);
+		throw std::runtime_error("Failed to read the size of mesh pack " + path);
+	}
+	this->size = static_cast<uint64_t>(fileStat.st_size);
+
+	// The mapping keeps its own reference to the file
+	void* mapped = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, file, 0);
+	::close(file);
+	if (mapped == MAP_FAILED) {
+		this->size = 0;
+		throw std::runtime_error("Failed to map mesh pack " + path);
+	}
+	// Blobs are read once, front to back, by the staging copies
+	madvise(mapped, this->size, MADV_SEQUENTIAL);
+	madvise(mapped, this->size, MADV_WILLNEED);
+#endif
+	this->data = static_cast<const uint8_t*>(mapped);
+
+	try {
+		validate(path);
+	}
+	catch (...) {
+		close();
+		throw;
+	}
+}
+
+void MeshPack::close() {
+#if defined(_WIN32)
+	if (this->data != nullptr) {
+		UnmapViewOfFile(this->data);
+	}
+	if (this->mappingHandle != nullptr) {
+		CloseHandle(this->mappingHandle);
+		this->mappingHandle = nullptr;
+	}
+	if (this->fileHandle != nullptr) {
+		CloseHandle(this->fileHandle);
+		this->fileHandle = nullptr;
+	}
+#else
+	if (this->data != nullptr) {
+		munmap(const_cast<uint8_t*>(this->data), this->size);
+	}
+#endif
+	this->data = nullptr;
+	this->size = 0;
+}
+
+void MeshPack::validate(const std::string& path) const {
+	if (this->size < sizeof(MeshPackHeader)) {
+		throw std::runtime_error("Mesh pack " + path + " is truncated");
+	}
+
+	const MeshPackHeader& header = getHeader();
+	if (header.magic != MeshPackHeader::MAGIC) {
+		throw std::runtime_error(path + " is not a mesh pack");
+	}
+	if (header.version != MeshPackHeader::VERSION || header.vertexSize != sizeof(Vertex)) {
+		throw std::runtime_error("Mesh pack " + path + " was written for another version, repack it");
+	}
+
+	const MeshPackBlob* blobs[] = { &header.meshes, &header.meshlets, &header.meshletVertices, &header.meshletTriangles, &header.vertices, &header.indices };
+	for (const MeshPackBlob* blob : blobs) {
+		if (blob->offset % BLOB_ALIGNMENT != 0 || blob->offset > this->size || blob->size > this->size - blob->offset) {
+			throw std::runtime_error("Mesh pack " + path + " is corrupted");
+		}
+	}
+	if (header.meshes.size != static_cast<uint64_t>(header.meshCount) * sizeof(MeshPackMesh)) {
+		throw std::runtime_error("Mesh pack " + path + " is corrupted");
+	}
+
+	// Ranges and index values are checked once here so that draws and meshlet traversal can trust them. This reads
+	// the index and meshlet blobs through, which upload does anyway.
+	const MeshPackMesh* meshes = getMeshes();
+	const MeshPackMeshlet* meshlets = getMeshlets();
+	const uint32_t* meshletVertices = getMeshletVertices();
+	const uint8_t* meshletTriangles = getMeshletTriangles();
+	const uint32_t* indices = getIndices();
+	const uint64_t meshletVertexCount = header.meshletVertices.size / sizeof(uint32_t);
+	for (uint32_t i = 0; i < header.meshCount; i++) {
+		const MeshPackMesh& mesh = meshes[i];
+		if (static_cast<uint64_t>(mesh.firstIndex) + mesh.indexCount > getIndexCount()
+			|| mesh.vertexOffset < 0 || static_cast<uint64_t>(mesh.vertexOffset) + mesh.vertexCount > getVertexCount()
+			|| static_cast<uint64_t>(mesh.firstMeshlet) + mesh.meshletCount > getMeshletCount()) {
+			throw std::runtime_error("Mesh pack " + path + " is corrupted");
+		}
+
+		for (uint32_t index = mesh.firstIndex; index < mesh.firstIndex + mesh.indexCount; index++) {
+			if (indices[index] >= mesh.vertexCount) {
+				throw std::runtime_error("Mesh pack " + path + " is corrupted");
+			}
+		}
+
+		for (uint32_t m = mesh.firstMeshlet; m < mesh.firstMeshlet + mesh.meshletCount; m++) {
+			const MeshPackMeshlet& meshlet = meshlets[m];
+			if (meshlet.vertexCount > MeshPackMeshlet::MAX_VERTICES || meshlet.triangleCount > MeshPackMeshlet::MAX_TRIANGLES
+				|| static_cast<uint64_t>(meshlet.vertexOffset) + meshlet.vertexCount > meshletVertexCount
+				|| static_cast<uint64_t>(meshlet.triangleOffset) + meshlet.triangleCount * 3ull > header.meshletTriangles.size) {
+				throw std::runtime_error("Mesh pack " + path + " is corrupted");
+			}
+			for (uint32_t v = 0; v < meshlet.vertexCount; v++) {
+				if (meshletVertices[meshlet.vertexOffset + v] >= mesh.vertexCount) {
+					throw std::runtime_error("Mesh pack " + path + " is corrupted");
+				}
+			}
+			for (uint32_t t = 0; t < meshlet.triangleCount * 3; t++) {
+				if (meshletTriangles[meshlet.triangleOffset + t] >= meshlet.vertexCount) {
+					throw std::runtime_error("Mesh pack " + path + " is corrupted");
+				}
+			}
+		}
+	}
+}
+
+void MeshPack::upload(StagingUploader& uploader, VkBuffer vertexBuffer, VkDeviceSize vertexBufferOffset, VkBuffer indexBuffer, VkDeviceSize indexBufferOffset) const {
+	if (getVertexDataSize() > 0) {
+		uploader.uploadBuffer(vertexBuffer, vertexBufferOffset, getVertices(), getVertexDataSize());
+	}
+	if (getIndexDataSize() > 0) {
+		uploader.uploadBuffer(indexBuffer, indexBufferOffset, getIndices(), getIndexDataSize());
+	}
+}
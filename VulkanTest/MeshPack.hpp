@@ -0,0 +1,134 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <glm/glm.hpp>
+
+#include "types.hpp"
+#include "StagingUploader.hpp"
+
+// Binary mesh pack, written offline by MeshPacker. Everything is stored in its final GPU layout, loading is mapping
+// the file and copying each blob to staging memory: no parsing, no deduplication, no intermediate copy.
+//
+// File layout (little endian): MeshPackHeader, then the blobs it references, each aligned to BLOB_ALIGNMENT.
+//   meshes            MeshPackMesh[meshCount]
+//   meshlets          MeshPackMeshlet[], meshlets of each mesh are contiguous
+//   meshletVertices   uint32_t[], indices into the vertices of the mesh
+//   meshletTriangles  uint8_t[3] per triangle, indices into the meshletVertices of the meshlet
+//   vertices          Vertex[]
+//   indices           uint32_t[], relative to the vertexOffset of their mesh
+
+struct MeshPackBlob {
+	uint64_t offset; // From the start of the file
+	uint64_t size;
+};
+
+struct MeshPackHeader {
+	static constexpr uint32_t MAGIC = 0x504d4b56; // "VKMP"
+	static constexpr uint32_t VERSION = 1;
+
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vertexSize; // sizeof(Vertex) when the pack was written
+	uint32_t meshCount;
+	MeshPackBlob meshes;
+	MeshPackBlob meshlets;
+	MeshPackBlob meshletVertices;
+	MeshPackBlob meshletTriangles;
+	MeshPackBlob vertices;
+	MeshPackBlob indices;
+};
+
+// Same fields as a GpuMesh, plus the vertex range, meshlets and bounds
+struct MeshPackMesh {
+	uint32_t indexCount;
+	uint32_t firstIndex;
+	int32_t vertexOffset;
+	uint32_t vertexCount;
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	uint32_t padding[2];
+	glm::vec4 boundingSphere; // Center and radius
+	glm::vec4 boundsMin; // w is unused
+	glm::vec4 boundsMax;
+};
+
+struct MeshPackMeshlet {
+	static constexpr uint32_t MAX_VERTICES = 64;
+	static constexpr uint32_t MAX_TRIANGLES = 124;
+
+	uint32_t vertexOffset; // Into meshletVertices
+	uint32_t triangleOffset; // Into meshletTriangles, in bytes
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	glm::vec4 boundingSphere; // In mesh space
+};
+
+static_assert(sizeof(MeshPackHeader) == 112, "MeshPackHeader must not have padding");
+static_assert(sizeof(MeshPackMesh) == 80, "MeshPackMesh must not have padding");
+static_assert(sizeof(MeshPackMeshlet) == 32, "MeshPackMeshlet must not have padding");
+
+// Read only mapping of a mesh pack. The blobs point straight into the mapping and stay valid until close().
+class MeshPack
+{
+public:
+	// Page size, so blobs can also be read with unbuffered I/O
+	static constexpr uint64_t BLOB_ALIGNMENT = 4096;
+
+	MeshPack() = default;
+
+	MeshPack(const MeshPack&) = delete;
+
+	MeshPack& operator=(const MeshPack&) = delete;
+
+	~MeshPack() { close(); }
+
+	// Maps the file and validates its header, blob ranges and every index into them, throws if the pack is invalid
+	void open(const std::string& path);
+
+	void close();
+
+	uint32_t getMeshCount() const { return getHeader().meshCount; }
+
+	const MeshPackMesh* getMeshes() const { return getBlob<MeshPackMesh>(getHeader().meshes); }
+
+	const MeshPackMeshlet* getMeshlets() const { return getBlob<MeshPackMeshlet>(getHeader().meshlets); }
+
+	size_t getMeshletCount() const { return getHeader().meshlets.size / sizeof(MeshPackMeshlet); }
+
+	const uint32_t* getMeshletVertices() const { return getBlob<uint32_t>(getHeader().meshletVertices); }
+
+	const uint8_t* getMeshletTriangles() const { return getBlob<uint8_t>(getHeader().meshletTriangles); }
+
+	const Vertex* getVertices() const { return getBlob<Vertex>(getHeader().vertices); }
+
+	size_t getVertexCount() const { return getHeader().vertices.size / sizeof(Vertex); }
+
+	const uint32_t* getIndices() const { return getBlob<uint32_t>(getHeader().indices); }
+
+	size_t getIndexCount() const { return getHeader().indices.size / sizeof(uint32_t); }
+
+	VkDeviceSize getVertexDataSize() const { return getHeader().vertices.size; }
+
+	VkDeviceSize getIndexDataSize() const { return getHeader().indices.size; }
+
+	// Copies the vertex and index blobs from the mapping into the staging ring of uploader. The buffers need
+	// getVertexDataSize() and getIndexDataSize() bytes past their offsets. Call uploader.flush() afterwards.
+	void upload(StagingUploader& uploader, VkBuffer vertexBuffer, VkDeviceSize vertexBufferOffset, VkBuffer indexBuffer, VkDeviceSize indexBufferOffset) const;
+
+private:
+	const uint8_t* data = nullptr;
+	uint64_t size = 0;
+#if defined(_WIN32)
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+
+	const MeshPackHeader& getHeader() const { return *reinterpret_cast<const MeshPackHeader*>(this->data); }
+
+	template<typename T>
+	const T* getBlob(const MeshPackBlob& blob) const { return reinterpret_cast<const T*>(this->data + blob.offset); }
+
+	void validate(const std::string& path) const;
+};
@@ -0,0 +1,282 @@
+#include "MeshPacker.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+#include "MeshIndexer.hpp"
+
+namespace {
+	struct Bounds {
+		glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+		void add(const glm::vec3& point) {
+			this->min = glm::min(this->min, point);
+			this->max = glm::max(this->max, point);
+		}
+	};
+
+	// Centered on the box, tighter than the box's own bounding sphere since it only has to reach actual vertices
+	glm::vec4 boundingSphere(const std::vector<Vertex>& vertices, const Bounds& bounds, const uint32_t* vertexIndices, size_t count) {
+		const glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+		float radius = 0.0f;
+		for (size_t i = 0; i < count; i++) {
+			radius = std::max(radius, glm::length(vertices[vertexIndices[i]].pos - center));
+		}
+		return glm::vec4(center, radius);
+	}
+
+	// OBJ indices start at 1, negative ones count back from the last element read so far
+	uint32_t resolveObjIndex(long index, size_t count) {
+		long resolved = index < 0 ? static_cast<long>(count) + index : index - 1;
+		if (resolved < 0 || static_cast<size_t>(resolved) >= count) {
+			throw std::runtime_error("Invalid index in OBJ file");
+		}
+		return static_cast<uint32_t>(resolved);
+	}
+
+	uint64_t alignBlob(uint64_t offset) {
+		return (offset + MeshPack::BLOB_ALIGNMENT - 1) / MeshPack::BLOB_ALIGNMENT * MeshPack::BLOB_ALIGNMENT;
+	}
+}
+
+std::vector<Vertex> MeshPacker::loadObj(const std::string& path) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open " + path);
+	}
+
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> colors;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> texCoords;
+	std::vector<Vertex> triangles;
+
+	struct Corner {
+		uint32_t position;
+		int64_t texCoord; // -1 when absent
+		int64_t normal;
+	};
+	std::vector<Corner> polygon;
+
+	std::string line;
+	while (std::getline(file, line)) {
+		const char* cursor = line.c_str();
+		while (*cursor == ' ' || *cursor == '\t') cursor++;
+
+		char* end;
+		if (cursor[0] == 'v' && (cursor[1] == ' ' || cursor[1] == '\t')) {
+			float values[6] = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+			cursor += 2;
+			for (int i = 0; i < 6; i++) {
+				float value = std::strtof(cursor, &end);
+				if (end == cursor) break;
+				values[i] = value;
+				cursor = end;
+			}
+			positions.emplace_back(values[0], values[1], values[2]);
+			colors.emplace_back(values[3], values[4], values[5]);
+		}
+		else if (cursor[0] == 'v' && cursor[1] == 'n') {
+			float x = std::strtof(cursor + 2, &end);
+			float y = std::strtof(end, &end);
+			float z = std::strtof(end, &end);
+			normals.emplace_back(x, y, z);
+		}
+		else if (cursor[0] == 'v' && cursor[1] == 't') {
+			float u = std::strtof(cursor + 2, &end);
+			float v = std::strtof(end, &end);
+			// OBJ puts the origin of texture space at the bottom left, Vulkan at the top left
+			texCoords.emplace_back(u, 1.0f - v);
+		}
+		else if (cursor[0] == 'f' && (cursor[1] == ' ' || cursor[1] == '\t')) {
+			// Corners are v, v/vt, v//vn or v/vt/vn
+			polygon.clear();
+			cursor += 2;
+			while (true) {
+				long position = std::strtol(cursor, &end, 10);
+				if (end == cursor) break;
+				Corner corner = { resolveObjIndex(position, positions.size()), -1, -1 };
+				cursor = end;
+				if (*cursor == '/') {
+					cursor++;
+					if (*cursor != '/') {
+						corner.texCoord = resolveObjIndex(std::strtol(cursor, &end, 10), texCoords.size());
+						cursor = end;
+					}
+					if (*cursor == '/') {
+						corner.normal = resolveObjIndex(std::strtol(cursor + 1, &end, 10), normals.size());
+						cursor = end;
+					}
+				}
+				polygon.push_back(corner);
+			}
+			if (polygon.size() < 3) {
+				throw std::runtime_error("Face with less than 3 vertices in " + path);
+			}
+
+			for (size_t i = 1; i + 1 < polygon.size(); i++) {
+				const Corner* corners[3] = { &polygon[0], &polygon[i], &polygon[i + 1] };
+				const glm::vec3 edge1 = positions[corners[1]->position] - positions[corners[0]->position];
+				const glm::vec3 edge2 = positions[corners[2]->position] - positions[corners[0]->position];
+				const glm::vec3 cross = glm::cross(edge1, edge2);
+				const float crossLength = glm::length(cross);
+				const glm::vec3 faceNormal = crossLength > 0.0f ? cross / crossLength : glm::vec3(0.0f, 0.0f, 1.0f);
+
+				for (const Corner* corner : corners) {
+					Vertex vertex{};
+					vertex.pos = positions[corner->position];
+					vertex.color = colors[corner->position];
+					vertex.normal = corner->normal >= 0 ? normals[corner->normal] : faceNormal;
+					vertex.texCoord = corner->texCoord >= 0 ? texCoords[corner->texCoord] : glm::vec2(0.0f);
+					triangles.push_back(vertex);
+				}
+			}
+		}
+		// Groups, materials, smoothing groups and comments are ignored
+	}
+
+	return triangles;
+}
+
+void MeshPacker::buildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+	std::vector<MeshPackMeshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint8_t>& meshletTriangles) {
+	// Position of each vertex in the current meshlet, reset from the meshlet's own list when it is finished
+	std::vector<uint8_t> localIndex(vertices.size(), 0xff);
+	static_assert(MeshPackMeshlet::MAX_VERTICES < 0xff, "Local vertex indices must fit in a byte");
+
+	MeshPackMeshlet meshlet{};
+	meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+	meshlet.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+
+	auto finishMeshlet = [&]() {
+		Bounds bounds;
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+			uint32_t vertex = meshletVertices[meshlet.vertexOffset + i];
+			bounds.add(vertices[vertex].pos);
+			localIndex[vertex] = 0xff;
+		}
+		meshlet.boundingSphere = boundingSphere(vertices, bounds, meshletVertices.data() + meshlet.vertexOffset, meshlet.vertexCount);
+		meshlets.push_back(meshlet);
+
+		// Triangle lists start on 4 byte boundaries, so shaders can read them as uints
+		meshletTriangles.resize((meshletTriangles.size() + 3) & ~size_t(3), 0);
+
+		meshlet = MeshPackMeshlet{};
+		meshlet.vertexOffset = static_cast<uint32_t>(meshletVertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(meshletTriangles.size());
+	};
+
+	for (size_t triangle = 0; triangle + 2 < indices.size(); triangle += 3) {
+		uint32_t newVertices = 0;
+		for (size_t corner = 0; corner < 3; corner++) {
+			newVertices += localIndex[indices[triangle + corner]] == 0xff ? 1 : 0;
+		}
+		if (meshlet.vertexCount + newVertices > MeshPackMeshlet::MAX_VERTICES || meshlet.triangleCount == MeshPackMeshlet::MAX_TRIANGLES) {
+			finishMeshlet();
+		}
+
+		for (size_t corner = 0; corner < 3; corner++) {
+			uint32_t vertex = indices[triangle + corner];
+			if (localIndex[vertex] == 0xff) {
+				localIndex[vertex] = static_cast<uint8_t>(meshlet.vertexCount++);
+				meshletVertices.push_back(vertex);
+			}
+			meshletTriangles.push_back(localIndex[vertex]);
+		}
+		meshlet.triangleCount++;
+	}
+
+	if (meshlet.triangleCount > 0) {
+		finishMeshlet();
+	}
+}
+
+uint32_t MeshPacker::addMesh(const std::vector<Vertex>& triangles, uint32_t threadCount) {
+	std::vector<Vertex> meshVertices;
+	std::vector<uint32_t> meshIndices;
+	MeshIndexer::buildIndexed(triangles, meshVertices, meshIndices, threadCount);
+	MeshIndexer::optimizeVertexCache(meshIndices, meshVertices.size());
+	MeshIndexer::optimizeVertexFetch(meshVertices, meshIndices);
+	return addIndexedMesh(meshVertices, meshIndices);
+}
+
+uint32_t MeshPacker::addIndexedMesh(const std::vector<Vertex>& meshVertices, const std::vector<uint32_t>& meshIndices) {
+	MeshPackMesh mesh{};
+	mesh.indexCount = static_cast<uint32_t>(meshIndices.size());
+	mesh.firstIndex = static_cast<uint32_t>(this->indices.size());
+	mesh.vertexOffset = static_cast<int32_t>(this->vertices.size());
+	mesh.vertexCount = static_cast<uint32_t>(meshVertices.size());
+	mesh.firstMeshlet = static_cast<uint32_t>(this->meshlets.size());
+
+	if (!meshVertices.empty()) {
+		Bounds bounds;
+		for (const auto& vertex : meshVertices) {
+			bounds.add(vertex.pos);
+		}
+		const glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+		float radius = 0.0f;
+		for (const auto& vertex : meshVertices) {
+			radius = std::max(radius, glm::length(vertex.pos - center));
+		}
+		mesh.boundingSphere = glm::vec4(center, radius);
+		mesh.boundsMin = glm::vec4(bounds.min, 0.0f);
+		mesh.boundsMax = glm::vec4(bounds.max, 0.0f);
+	}
+
+	buildMeshlets(meshVertices, meshIndices, this->meshlets, this->meshletVertices, this->meshletTriangles);
+	mesh.meshletCount = static_cast<uint32_t>(this->meshlets.size()) - mesh.firstMeshlet;
+
+	this->vertices.insert(this->vertices.end(), meshVertices.begin(), meshVertices.end());
+	this->indices.insert(this->indices.end(), meshIndices.begin(), meshIndices.end());
+	this->meshes.push_back(mesh);
+	return static_cast<uint32_t>(this->meshes.size() - 1);
+}
+
+void MeshPacker::write(const std::string& path) const {
+	MeshPackHeader header{};
+	header.magic = MeshPackHeader::MAGIC;
+	header.version = MeshPackHeader::VERSION;
+	header.vertexSize = sizeof(Vertex);
+	header.meshCount = static_cast<uint32_t>(this->meshes.size());
+
+	// Blobs in file order
+	const std::pair<MeshPackBlob*, std::pair<const void*, uint64_t>> blobs[] = {
+		{ &header.meshes, { this->meshes.data(), this->meshes.size() * sizeof(MeshPackMesh) } },
+		{ &header.meshlets, { this->meshlets.data(), this->meshlets.size() * sizeof(MeshPackMeshlet) } },
+		{ &header.meshletVertices, { this->meshletVertices.data(), this->meshletVertices.size() * sizeof(uint32_t) } },
+		{ &header.meshletTriangles, { this->meshletTriangles.data(), this->meshletTriangles.size() } },
+		{ &header.vertices, { this->vertices.data(), this->vertices.size() * sizeof(Vertex) } },
+		{ &header.indices, { this->indices.data(), this->indices.size() * sizeof(uint32_t) } },
+	};
+	uint64_t offset = sizeof(MeshPackHeader);
+	for (const auto& blob : blobs) {
+		offset = alignBlob(offset);
+		blob.first->offset = offset;
+		blob.first->size = blob.second.second;
+		offset += blob.second.second;
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to create mesh pack " + path);
+	}
+
+	const std::vector<char> padding(MeshPack::BLOB_ALIGNMENT, 0);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	uint64_t written = sizeof(header);
+	for (const auto& blob : blobs) {
+		file.write(padding.data(), blob.first->offset - written);
+		file.write(static_cast<const char*>(blob.second.first), blob.second.second);
+		written = blob.first->offset + blob.second.second;
+	}
+	// The last blob is padded too, so that unbuffered reads of whole pages stay within the file
+	file.write(padding.data(), alignBlob(written) - written);
+
+	if (!file.good()) {
+		throw std::runtime_error("Failed to write mesh pack " + path);
+	}
+}
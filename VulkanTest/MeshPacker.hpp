@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+
+#include "types.hpp"
+#include "MeshPack.hpp"
+
+// Writes mesh packs, offline: meshes are indexed, optimized for the vertex cache, split into meshlets and bounded
+// once, at pack time, so that MeshPack only has to map the result
+class MeshPacker
+{
+public:
+	// Parses the v, vt, vn and f statements of a Wavefront OBJ file into an unindexed triangle list for addMesh.
+	// Polygons are triangulated as fans and every object of the file ends up in the same list. Colors come from the
+	// "v x y z r g b" extension when present, white otherwise, faces without normals get their face normal.
+	static std::vector<Vertex> loadObj(const std::string& path);
+
+	// Greedily splits indices into meshlets of at most MeshPackMeshlet::MAX_VERTICES vertices and MAX_TRIANGLES
+	// triangles, in index order, so call it after MeshIndexer::optimizeVertexCache. Offsets are relative to the
+	// start of meshletVertices and meshletTriangles, whose triangle lists are padded to 4 bytes.
+	static void buildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+		std::vector<MeshPackMeshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint8_t>& meshletTriangles);
+
+	// Indexes and optimizes an unindexed triangle list, returns the index of the mesh in the pack
+	uint32_t addMesh(const std::vector<Vertex>& triangles, uint32_t threadCount = 0);
+
+	// Adds a mesh that is already indexed and optimized, as is
+	uint32_t addIndexedMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+	void write(const std::string& path) const;
+
+	const std::vector<MeshPackMesh>& getMeshes() const { return this->meshes; }
+
+private:
+	std::vector<MeshPackMesh> meshes;
+	std::vector<MeshPackMeshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+};
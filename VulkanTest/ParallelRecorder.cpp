@@ -0,0 +1,104 @@
+#include "ParallelRecorder.hpp"
+#include "CpuTrace.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+
+void ParallelRecorder::init(VkDevice device, ThreadPool& threadPool, uint32_t queueFamilyIndex, uint32_t frameCount) {
+	this->device = device;
+	this->threadPool = &threadPool;
+	this->threadCount = threadPool.getThreadCount();
+	this->pools.resize(frameCount * this->threadCount);
+
+	for (auto& pool : this->pools) {
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // Reset as a whole every time the slot comes around
+		poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+		if (vkCreateCommandPool(this->device, &poolInfo, nullptr, &pool.commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create command pool");
+		}
+	}
+}
+
+void ParallelRecorder::cleanup() {
+	// Destroying a pool frees its command buffers
+	for (auto& pool : this->pools) {
+		vkDestroyCommandPool(this->device, pool.commandPool, nullptr);
+	}
+	this->pools.clear();
+}
+
+void ParallelRecorder::beginFrame(uint32_t frameIndex) {
+	this->frameIndex = frameIndex;
+
+	for (uint32_t thread = 0; thread < this->threadCount; thread++) {
+		ThreadCommandPool& pool = this->pools[frameIndex * this->threadCount + thread];
+		if (pool.usedCount > 0) {
+			vkResetCommandPool(this->device, pool.commandPool, 0);
+			pool.usedCount = 0;
+		}
+	}
+}
+
+VkCommandBuffer ParallelRecorder::acquireCommandBuffer(uint32_t threadIndex) {
+	ThreadCommandPool& pool = this->pools[this->frameIndex * this->threadCount + threadIndex];
+
+	if (pool.usedCount == pool.commandBuffers.size()) {
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = pool.commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		allocInfo.commandBufferCount = 1;
+
+		VkCommandBuffer commandBuffer;
+		if (vkAllocateCommandBuffers(this->device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate secondary command buffer");
+		}
+		pool.commandBuffers.push_back(commandBuffer);
+	}
+
+	return pool.commandBuffers[pool.usedCount++];
+}
+
+void ParallelRecorder::record(VkCommandBuffer primary, VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer, uint32_t itemCount, uint32_t chunkSize, const RecordFunction& function, uint32_t maxThreads) {
+	if (itemCount == 0) {
+		return;
+	}
+
+	chunkSize = std::max(1u, chunkSize);
+	const uint32_t chunkCount = (itemCount + chunkSize - 1) / chunkSize;
+	this->chunkCommandBuffers.assign(chunkCount, VK_NULL_HANDLE);
+
+	VkCommandBufferInheritanceInfo inheritanceInfo{};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.subpass = subpass;
+	inheritanceInfo.framebuffer = framebuffer;
+
+	// Chunks of the thread pool and of the recorder line up, so each parallelFor range is exactly one chunk
+	this->threadPool->parallelFor(itemCount, chunkSize, [&](uint32_t begin, uint32_t end, uint32_t threadIndex) {
+		CPU_TRACE_ZONE("Record secondary");
+		VkCommandBuffer commandBuffer = acquireCommandBuffer(threadIndex);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin recording secondary command buffer");
+		}
+
+		function(commandBuffer, begin, end);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record secondary command buffer");
+		}
+
+		this->chunkCommandBuffers[begin / chunkSize] = commandBuffer;
+	}, maxThreads);
+
+	vkCmdExecuteCommands(primary, chunkCount, this->chunkCommandBuffers.data());
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <functional>
+
+#include "ThreadPool.hpp"
+
+// Records draw lists into secondary command buffers on every thread of a ThreadPool. Each (frame slot, thread) pair
+// owns a command pool, so no pool is ever shared between threads or with a frame the GPU may still be executing.
+class ParallelRecorder
+{
+public:
+	// (secondary command buffer, first item, end item) - the buffer is already begun and must not be ended
+	typedef std::function<void(VkCommandBuffer, uint32_t, uint32_t)> RecordFunction;
+
+	void init(VkDevice device, ThreadPool& threadPool, uint32_t queueFamilyIndex, uint32_t frameCount);
+
+	void cleanup();
+
+	// Recycles the secondaries of a frame slot, call after waiting on the slot's fence and before record
+	void beginFrame(uint32_t frameIndex);
+
+	// Splits [0, itemCount) into chunks of chunkSize items, records each chunk into its own secondary inheriting
+	// renderPass/subpass/framebuffer, then executes them on primary in chunk order, so the result does not depend on
+	// scheduling. primary must be inside that subpass, begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+	// Secondaries inherit no dynamic state: function has to set viewport and scissor itself.
+	void record(VkCommandBuffer primary, VkRenderPass renderPass, uint32_t subpass, VkFramebuffer framebuffer, uint32_t itemCount, uint32_t chunkSize, const RecordFunction& function, uint32_t maxThreads = UINT32_MAX);
+
+private:
+	struct ThreadCommandPool {
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> commandBuffers;
+		uint32_t usedCount = 0;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	ThreadPool* threadPool = nullptr;
+	uint32_t threadCount = 0;
+	uint32_t frameIndex = 0;
+	std::vector<ThreadCommandPool> pools; // [frameIndex * threadCount + threadIndex]
+	std::vector<VkCommandBuffer> chunkCommandBuffers;
+
+	VkCommandBuffer acquireCommandBuffer(uint32_t threadIndex);
+};
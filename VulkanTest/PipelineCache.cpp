@@ -0,0 +1,188 @@
+#include "PipelineCache.hpp"
+
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+
+void PipelineCache::init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& directory) {
+	this->device = device;
+	vkGetPhysicalDeviceProperties(physicalDevice, &this->properties);
+
+	// One file per GPU model, so machines with several GPUs don't keep overwriting each other's cache
+	char fileName[64];
+	snprintf(fileName, sizeof(fileName), "pipeline_cache_%04x_%04x.bin", this->properties.vendorID, this->properties.deviceID);
+	this->path = (std::filesystem::path(directory) / fileName).string();
+
+	std::vector<char> initialData = loadFromDisk();
+
+	VkPipelineCacheCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = initialData.size();
+	createInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+	if (vkCreatePipelineCache(this->device, &createInfo, nullptr, &this->pipelineCache) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create pipeline cache");
+	}
+}
+
+void PipelineCache::cleanup() {
+	save();
+
+	for (auto& bucket : this->shaderModules) {
+		for (auto& entry : bucket.second) {
+			vkDestroyShaderModule(this->device, entry.module, nullptr);
+		}
+	}
+	this->shaderModules.clear();
+
+	vkDestroyPipelineCache(this->device, this->pipelineCache, nullptr);
+	this->pipelineCache = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::save() {
+	size_t dataSize = 0;
+	if (vkGetPipelineCacheData(this->device, this->pipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+		return false;
+	}
+
+	std::vector<char> data(dataSize);
+	if (vkGetPipelineCacheData(this->device, this->pipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+		return false;
+	}
+	data.resize(dataSize);
+
+	FileHeader header{};
+	header.magic = FILE_MAGIC;
+	header.version = FILE_VERSION;
+	header.vendorID = this->properties.vendorID;
+	header.deviceID = this->properties.deviceID;
+	header.driverVersion = this->properties.driverVersion;
+	memcpy(header.pipelineCacheUUID, this->properties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = data.size();
+	header.dataHash = hash(data.data(), data.size());
+
+	// Write to a temporary file first so that a crash never leaves a truncated cache behind
+	std::string temporaryPath = this->path + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(data.data(), data.size());
+		if (!file.good()) {
+			return false;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, this->path, error);
+	if (error) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->stats.savedBytes = data.size();
+	return true;
+}
+
+VkShaderModule PipelineCache::getShaderModule(const std::vector<char>& code) {
+	uint64_t codeHash = hash(code.data(), code.size());
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	auto& bucket = this->shaderModules[codeHash];
+	for (const auto& entry : bucket) {
+		if (entry.code == code) {
+			this->stats.shaderModuleHits++;
+			return entry.module;
+		}
+	}
+
+	VkShaderModuleCreateInfo createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = code.size();
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+	VkShaderModule shaderModule;
+	if (vkCreateShaderModule(this->device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create shader module");
+	}
+
+	bucket.push_back({ code, shaderModule });
+	this->stats.shaderModuleMisses++;
+
+	return shaderModule;
+}
+
+PipelineCacheStats PipelineCache::getStats() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->stats;
+}
+
+std::vector<char> PipelineCache::loadFromDisk() {
+	std::ifstream file(this->path, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		return {};
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	if (fileSize < sizeof(FileHeader)) {
+		this->stats.rejectedFromDisk = true;
+		return {};
+	}
+
+	FileHeader header;
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	std::vector<char> data(fileSize - sizeof(FileHeader));
+	file.read(data.data(), data.size());
+
+	if (!file.good() || !isHeaderValid(header, data)) {
+		this->stats.rejectedFromDisk = true;
+		return {};
+	}
+
+	this->stats.loadedFromDisk = true;
+	this->stats.loadedBytes = data.size();
+	return data;
+}
+
+bool PipelineCache::isHeaderValid(const FileHeader& header, const std::vector<char>& data) const {
+	if (header.magic != FILE_MAGIC || header.version != FILE_VERSION
+		|| header.vendorID != this->properties.vendorID
+		|| header.deviceID != this->properties.deviceID
+		|| header.driverVersion != this->properties.driverVersion
+		|| memcmp(header.pipelineCacheUUID, this->properties.pipelineCacheUUID, VK_UUID_SIZE) != 0
+		|| header.dataSize != data.size()
+		|| header.dataHash != hash(data.data(), data.size())) {
+		return false;
+	}
+
+	// The driver's own header (VkPipelineCacheHeaderVersionOne) must agree as well, drivers are not required to
+	// validate it themselves and some crash on foreign data
+	VkPipelineCacheHeaderVersionOne driverHeader;
+	if (data.size() < sizeof(driverHeader)) {
+		return false;
+	}
+	memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+
+	return driverHeader.headerSize >= sizeof(driverHeader)
+		&& driverHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+		&& driverHeader.vendorID == this->properties.vendorID
+		&& driverHeader.deviceID == this->properties.deviceID
+		&& memcmp(driverHeader.pipelineCacheUUID, this->properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+uint64_t PipelineCache::hash(const char* data, size_t size) {
+	// FNV-1a
+	uint64_t value = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < size; i++) {
+		value ^= static_cast<uint8_t>(data[i]);
+		value *= 0x100000001b3ull;
+	}
+	return value;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+
+struct PipelineCacheStats {
+	bool loadedFromDisk = false; // A valid blob for this exact device and driver was found (warm start)
+	bool rejectedFromDisk = false; // A blob was found but its header did not match, e.g. after a driver update
+	size_t loadedBytes = 0;
+	size_t savedBytes = 0;
+	uint32_t shaderModuleHits = 0;
+	uint32_t shaderModuleMisses = 0;
+};
+
+// Owns the VkPipelineCache, persisted to disk between runs, and a content addressed set of shader modules
+class PipelineCache
+{
+public:
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string& directory = "");
+
+	// Saves the cache to disk and destroys the cache and every shader module handed out
+	void cleanup();
+
+	bool save();
+
+	VkPipelineCache getHandle() const { return this->pipelineCache; }
+
+	// Modules are deduplicated by content and owned by the cache, callers must not destroy them
+	VkShaderModule getShaderModule(const std::vector<char>& code);
+
+	PipelineCacheStats getStats();
+
+private:
+	// Prepended to the driver's blob, vkGetPipelineCacheData does not include the driver version
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t vendorID;
+		uint32_t deviceID;
+		uint32_t driverVersion;
+		uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+		uint64_t dataSize;
+		uint64_t dataHash;
+	};
+
+	struct ShaderModuleEntry {
+		std::vector<char> code;
+		VkShaderModule module;
+	};
+
+	static constexpr uint32_t FILE_MAGIC = 0x48434B56; // "VKCH"
+	static constexpr uint32_t FILE_VERSION = 1;
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties properties{};
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+	std::string path;
+	std::unordered_map<uint64_t, std::vector<ShaderModuleEntry>> shaderModules;
+	PipelineCacheStats stats;
+	std::mutex mutex;
+
+	std::vector<char> loadFromDisk();
+
+	bool isHeaderValid(const FileHeader& header, const std::vector<char>& data) const;
+
+	static uint64_t hash(const char* data, size_t size);
+};
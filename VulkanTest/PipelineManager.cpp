@@ -0,0 +1,612 @@
+#include "PipelineManager.hpp"
+#include "CpuTrace.hpp"
+
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include <charconv>
+
+namespace {
+	std::vector<char> readSpirv(const std::string& path) {
+		std::ifstream file(path, std::ios::ate | std::ios::binary);
+		if (!file.is_open()) {
+			throw std::runtime_error("Failed to open shader " + path);
+		}
+
+		std::vector<char> code(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(code.data(), code.size());
+		return code;
+	}
+
+	std::vector<std::string> splitFields(const std::string& line) {
+		std::vector<std::string> fields;
+		size_t begin = 0;
+		while (true) {
+			size_t end = line.find('\t', begin);
+			fields.push_back(line.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+			if (end == std::string::npos) {
+				return fields;
+			}
+			begin = end + 1;
+		}
+	}
+
+	// False unless the whole field is a number, never throws on damaged input like std::stoul would
+	bool parseUint(const std::string& field, uint32_t& value) {
+		const char* end = field.data() + field.size();
+		auto result = std::from_chars(field.data(), end, value);
+		return result.ec == std::errc() && result.ptr == end;
+	}
+
+	const char* flagString(bool value) {
+		return value ? "1" : "0";
+	}
+}
+
+// Every state of a graphics pipeline, the library parts pick theirs from it. Not copyable, the create infos point
+// into it.
+struct PipelineManager::GraphicsState {
+	VkPipelineShaderStageCreateInfo stages[2]{};
+	std::vector<VkVertexInputBindingDescription> bindings;
+	std::vector<VkVertexInputAttributeDescription> attributes;
+	VkPipelineVertexInputStateCreateInfo vertexInput{};
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+	VkPipelineViewportStateCreateInfo viewport{};
+	VkPipelineRasterizationStateCreateInfo rasterization{};
+	VkPipelineMultisampleStateCreateInfo multisample{};
+	VkPipelineDepthStencilStateCreateInfo depthStencil{};
+	VkPipelineColorBlendAttachmentState blendAttachment{};
+	VkPipelineColorBlendStateCreateInfo colorBlend{};
+	VkDynamicState dynamicStates[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamic{};
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	uint32_t subpass = 0;
+
+	GraphicsState() = default;
+	GraphicsState(const GraphicsState&) = delete;
+	GraphicsState& operator=(const GraphicsState&) = delete;
+};
+
+std::string GraphicsPipelineKey::toString() const {
+	return std::string("graphics\t") + this->vertexShader + "\t" + this->fragmentShader + "\t" + this->vertexInput + "\t" + this->layout + "\t" + this->renderPass
+		+ "\t" + std::to_string(this->topology) + "\t" + std::to_string(this->cullMode)
+		+ "\t" + flagString(this->depthTest) + "\t" + flagString(this->depthWrite) + "\t" + flagString(this->blend);
+}
+
+std::string ComputePipelineKey::toString() const {
+	return "compute\t" + this->shader + "\t" + this->layout;
+}
+
+void PipelineManager::init(VkDevice device, PipelineCache& pipelineCache, DeferredDeletionQueue& deletionQueue, bool graphicsPipelineLibrary, uint32_t compileThreadCount) {
+	this->device = device;
+	this->pipelineCache = &pipelineCache;
+	this->deletionQueue = &deletionQueue;
+	this->graphicsPipelineLibrary = graphicsPipelineLibrary;
+	this->stopping = false;
+
+	if (compileThreadCount == 0) {
+		compileThreadCount = std::max(1u, std::thread::hardware_concurrency() / 4);
+	}
+	this->compileThreads.init(compileThreadCount);
+}
+
+void PipelineManager::cleanup() {
+	// Queued jobs see stopping and return, the pool drains them before joining
+	this->stopping = true;
+	this->compileThreads.cleanup();
+
+	for (VkPipeline pipeline : this->pipelines) {
+		vkDestroyPipeline(this->device, pipeline, nullptr);
+	}
+	this->pipelines.clear();
+	this->entries.clear();
+	this->requestOrder.clear();
+	this->libraries.clear();
+	this->shaders.clear();
+	this->layouts.clear();
+	this->renderPasses.clear();
+	this->vertexInputs.clear();
+	this->stats = {};
+}
+
+void PipelineManager::registerShader(const std::string& name, const std::vector<char>& code) {
+	VkShaderModule shaderModule = this->pipelineCache->getShaderModule(code);
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (!this->shaders.emplace(name, shaderModule).second) {
+		throw std::runtime_error("Shader " + name + " is already registered");
+	}
+}
+
+void PipelineManager::registerLayout(const std::string& name, VkPipelineLayout layout) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (!this->layouts.emplace(name, layout).second) {
+		throw std::runtime_error("Pipeline layout " + name + " is already registered");
+	}
+}
+
+void PipelineManager::registerRenderPass(const std::string& name, VkRenderPass renderPass, uint32_t subpass, VkSampleCountFlagBits samples) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (!this->renderPasses.emplace(name, RenderPassInfo{ renderPass, subpass, samples }).second) {
+		throw std::runtime_error("Render pass " + name + " is already registered");
+	}
+}
+
+void PipelineManager::registerVertexInput(const std::string& name, const std::vector<VkVertexInputBindingDescription>& bindings, const std::vector<VkVertexInputAttributeDescription>& attributes) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (!this->vertexInputs.emplace(name, VertexInputInfo{ bindings, attributes }).second) {
+		throw std::runtime_error("Vertex input " + name + " is already registered");
+	}
+}
+
+std::shared_future<VkPipeline> PipelineManager::requestGraphics(const GraphicsPipelineKey& key) {
+	return request(key.toString(), &key, nullptr).future;
+}
+
+std::shared_future<VkPipeline> PipelineManager::requestCompute(const ComputePipelineKey& key) {
+	return request(key.toString(), nullptr, &key).future;
+}
+
+VkPipeline PipelineManager::getGraphics(const GraphicsPipelineKey& key, VkPipeline fallback) {
+	VkPipeline pipeline = request(key.toString(), &key, nullptr).pipeline.load();
+	if (pipeline != VK_NULL_HANDLE) {
+		return pipeline;
+	}
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->stats.fallbacks++;
+	return fallback;
+}
+
+VkPipeline PipelineManager::getCompute(const ComputePipelineKey& key, VkPipeline fallback) {
+	VkPipeline pipeline = request(key.toString(), nullptr, &key).pipeline.load();
+	if (pipeline != VK_NULL_HANDLE) {
+		return pipeline;
+	}
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->stats.fallbacks++;
+	return fallback;
+}
+
+VkPipeline PipelineManager::compileGraphics(const GraphicsPipelineKey& key) {
+	return compile(request(key.toString(), &key, nullptr));
+}
+
+VkPipeline PipelineManager::compileCompute(const ComputePipelineKey& key) {
+	return compile(request(key.toString(), nullptr, &key));
+}
+
+uint32_t PipelineManager::prewarm(const std::string& path) {
+	std::ifstream file(path);
+	if (!file.is_open()) {
+		return 0;
+	}
+
+	// Lines this version cannot parse are skipped, the list is rewritten by the next saveKeys anyway
+	uint32_t requested = 0;
+	std::string line;
+	while (std::getline(file, line)) {
+		std::vector<std::string> fields = splitFields(line);
+		uint32_t topology = 0;
+		uint32_t cullMode = 0;
+		if (fields[0] == "graphics" && fields.size() == 11 && parseUint(fields[6], topology) && parseUint(fields[7], cullMode)) {
+			GraphicsPipelineKey key;
+			key.vertexShader = fields[1];
+			key.fragmentShader = fields[2];
+			key.vertexInput = fields[3];
+			key.layout = fields[4];
+			key.renderPass = fields[5];
+			key.topology = static_cast<VkPrimitiveTopology>(topology);
+			key.cullMode = static_cast<VkCullModeFlags>(cullMode);
+			key.depthTest = fields[8] == "1";
+			key.depthWrite = fields[9] == "1";
+			key.blend = fields[10] == "1";
+			requestGraphics(key);
+			requested++;
+		}
+		else if (fields[0] == "compute" && fields.size() == 3) {
+			ComputePipelineKey key;
+			key.shader = fields[1];
+			key.layout = fields[2];
+			requestCompute(key);
+			requested++;
+		}
+	}
+	return requested;
+}
+
+bool PipelineManager::saveKeys(const std::string& path) {
+	std::vector<std::string> keys;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		keys = this->requestOrder;
+	}
+
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open()) {
+		return false;
+	}
+	for (const auto& key : keys) {
+		file << key << '\n';
+	}
+	return file.good();
+}
+
+void PipelineManager::waitIdle() {
+	this->compileThreads.waitIdle();
+}
+
+PipelineManagerStats PipelineManager::getStats() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->stats;
+}
+
+PipelineManager::Entry& PipelineManager::request(const std::string& keyString, const GraphicsPipelineKey* graphics, const ComputePipelineKey* compute) {
+	Entry* entry;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		auto& slot = this->entries[keyString];
+		if (slot) {
+			return *slot;
+		}
+
+		slot = std::make_unique<Entry>();
+		entry = slot.get();
+		entry->isCompute = compute != nullptr;
+		if (compute != nullptr) {
+			entry->compute = *compute;
+		}
+		else {
+			entry->graphics = *graphics;
+		}
+		entry->future = entry->promise.get_future().share();
+		this->requestOrder.push_back(keyString);
+		this->stats.requested++;
+	}
+
+	this->compileThreads.submit([this, entry](uint32_t) {
+		if (!this->stopping && !entry->claimed.exchange(true)) {
+			compileEntry(*entry);
+		}
+	});
+	return *entry;
+}
+
+VkPipeline PipelineManager::compile(Entry& entry) {
+	if (!entry.claimed.exchange(true)) {
+		compileEntry(entry);
+	}
+	return entry.future.get();
+}
+
+void PipelineManager::compileEntry(Entry& entry) {
+	CPU_TRACE_ZONE("Compile pipeline");
+	auto start = std::chrono::steady_clock::now();
+	try {
+		VkPipeline pipeline = entry.isCompute ? compileComputePipeline(entry.compute) : compileGraphicsPipeline(entry);
+		VkPipeline replaced = entry.pipeline.exchange(pipeline);
+		if (replaced != VK_NULL_HANDLE && replaced != pipeline) {
+			retirePipeline(replaced);
+		}
+		entry.promise.set_value(pipeline);
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stats.compiled++;
+		this->stats.compileMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+	catch (...) {
+		// getGraphics keeps returning the fallback, the error is reported through the future
+		entry.promise.set_exception(std::current_exception());
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stats.failed++;
+	}
+}
+
+VkPipeline PipelineManager::compileGraphicsPipeline(Entry& entry) {
+	const GraphicsPipelineKey& key = entry.graphics;
+	GraphicsState state;
+	resolve(key, state);
+
+	if (this->graphicsPipelineLibrary) {
+		// Each part is keyed by the parts of the key its state comes from, so pipelines that only differ in blending
+		// share their shader libraries and only need a link
+		const std::string layoutAndPass = "\t" + key.layout + "\t" + key.renderPass;
+		VkPipeline parts[4] = {
+			getLibrary("vertexInput\t" + key.vertexInput + "\t" + std::to_string(key.topology), state, VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT),
+			getLibrary("preRasterization\t" + key.vertexShader + layoutAndPass + "\t" + std::to_string(key.cullMode), state, VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT),
+			getLibrary("fragmentShader\t" + key.fragmentShader + layoutAndPass + "\t" + flagString(key.depthTest) + flagString(key.depthWrite), state, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT),
+			getLibrary("fragmentOutput\t" + key.renderPass + "\t" + flagString(key.blend), state, VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT)
+		};
+
+		// compileEntry retires the fast linked pipeline once the optimized one replaced it
+		VkPipeline fastLinked = linkLibraries(parts, state.layout, false);
+		entry.pipeline.store(fastLinked);
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->stats.fastLinked++;
+		}
+		if (this->stopping) {
+			return fastLinked;
+		}
+
+		return linkLibraries(parts, state.layout, true);
+	}
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = 2;
+	pipelineInfo.pStages = state.stages;
+	pipelineInfo.pVertexInputState = &state.vertexInput;
+	pipelineInfo.pInputAssemblyState = &state.inputAssembly;
+	pipelineInfo.pViewportState = &state.viewport;
+	pipelineInfo.pRasterizationState = &state.rasterization;
+	pipelineInfo.pMultisampleState = &state.multisample;
+	pipelineInfo.pDepthStencilState = &state.depthStencil;
+	pipelineInfo.pColorBlendState = &state.colorBlend;
+	pipelineInfo.pDynamicState = &state.dynamic;
+	pipelineInfo.layout = state.layout;
+	pipelineInfo.renderPass = state.renderPass;
+	pipelineInfo.subpass = state.subpass;
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(this->device, this->pipelineCache->getHandle(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create graphics pipeline");
+	}
+	addPipeline(pipeline);
+	return pipeline;
+}
+
+VkPipeline PipelineManager::compileComputePipeline(const ComputePipelineKey& key) {
+	VkShaderModule shaderModule = getShader(key.shader);
+
+	VkPipelineLayout layout;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		auto it = this->layouts.find(key.layout);
+		if (it == this->layouts.end()) {
+			throw std::runtime_error("Unknown pipeline layout " + key.layout);
+		}
+		layout = it->second;
+	}
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = layout;
+
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(this->device, this->pipelineCache->getHandle(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create compute pipeline");
+	}
+	addPipeline(pipeline);
+	return pipeline;
+}
+
+void PipelineManager::resolve(const GraphicsPipelineKey& key, GraphicsState& state) {
+	VkShaderModule shaderModules[2] = { getShader(key.vertexShader), getShader(key.fragmentShader) };
+
+	VkSampleCountFlagBits samples;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		auto layout = this->layouts.find(key.layout);
+		if (layout == this->layouts.end()) {
+			throw std::runtime_error("Unknown pipeline layout " + key.layout);
+		}
+		auto renderPass = this->renderPasses.find(key.renderPass);
+		if (renderPass == this->renderPasses.end()) {
+			throw std::runtime_error("Unknown render pass " + key.renderPass);
+		}
+		if (!key.vertexInput.empty()) {
+			auto vertexInput = this->vertexInputs.find(key.vertexInput);
+			if (vertexInput == this->vertexInputs.end()) {
+				throw std::runtime_error("Unknown vertex input " + key.vertexInput);
+			}
+			state.bindings = vertexInput->second.bindings;
+			state.attributes = vertexInput->second.attributes;
+		}
+
+		state.layout = layout->second;
+		state.renderPass = renderPass->second.renderPass;
+		state.subpass = renderPass->second.subpass;
+		samples = renderPass->second.samples;
+	}
+
+	const VkShaderStageFlagBits stages[2] = { VK_SHADER_STAGE_VERTEX_BIT, VK_SHADER_STAGE_FRAGMENT_BIT };
+	for (int i = 0; i < 2; i++) {
+		state.stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		state.stages[i].stage = stages[i];
+		state.stages[i].module = shaderModules[i];
+		state.stages[i].pName = "main";
+	}
+
+	state.vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	state.vertexInput.vertexBindingDescriptionCount = static_cast<uint32_t>(state.bindings.size());
+	state.vertexInput.pVertexBindingDescriptions = state.bindings.data();
+	state.vertexInput.vertexAttributeDescriptionCount = static_cast<uint32_t>(state.attributes.size());
+	state.vertexInput.pVertexAttributeDescriptions = state.attributes.data();
+
+	state.inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	state.inputAssembly.topology = key.topology;
+
+	state.viewport.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	state.viewport.viewportCount = 1;
+	state.viewport.scissorCount = 1;
+
+	state.rasterization.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	state.rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+	state.rasterization.lineWidth = 1.0f;
+	state.rasterization.cullMode = key.cullMode;
+	state.rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	state.multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	state.multisample.rasterizationSamples = samples;
+
+	state.depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	state.depthStencil.depthTestEnable = key.depthTest ? VK_TRUE : VK_FALSE;
+	state.depthStencil.depthWriteEnable = key.depthTest && key.depthWrite ? VK_TRUE : VK_FALSE;
+	state.depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+	state.blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	if (key.blend) {
+		state.blendAttachment.blendEnable = VK_TRUE;
+		state.blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		state.blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		state.blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+		state.blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		state.blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		state.blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	}
+
+	state.colorBlend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	state.colorBlend.attachmentCount = 1;
+	state.colorBlend.pAttachments = &state.blendAttachment;
+
+	state.dynamic.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	state.dynamic.dynamicStateCount = 2;
+	state.dynamic.pDynamicStates = state.dynamicStates;
+}
+
+VkPipeline PipelineManager::getLibrary(const std::string& libraryKey, const GraphicsState& state, VkGraphicsPipelineLibraryFlagsEXT part) {
+	std::shared_future<VkPipeline> library;
+	std::promise<VkPipeline> promise;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		auto it = this->libraries.find(libraryKey);
+		if (it != this->libraries.end()) {
+			library = it->second;
+		}
+		else {
+			this->libraries.emplace(libraryKey, promise.get_future().share());
+		}
+	}
+
+	// Another compile thread is creating it, or failed to
+	if (library.valid()) {
+		return library.get();
+	}
+
+	try {
+		VkPipeline pipeline = createLibrary(state, part);
+		promise.set_value(pipeline);
+		return pipeline;
+	}
+	catch (...) {
+		promise.set_exception(std::current_exception());
+		throw;
+	}
+}
+
+VkPipeline PipelineManager::createLibrary(const GraphicsState& state, VkGraphicsPipelineLibraryFlagsEXT part) {
+	CPU_TRACE_ZONE("Create pipeline library");
+	VkGraphicsPipelineLibraryCreateInfoEXT libraryInfo{};
+	libraryInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+	libraryInfo.flags = part;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = &libraryInfo;
+	// Retaining the link time optimization info lets linkLibraries build the optimized pipeline from the same parts
+	pipelineInfo.flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+
+	switch (part) {
+	case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+		pipelineInfo.pVertexInputState = &state.vertexInput;
+		pipelineInfo.pInputAssemblyState = &state.inputAssembly;
+		break;
+	case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+		pipelineInfo.stageCount = 1;
+		pipelineInfo.pStages = &state.stages[0];
+		pipelineInfo.pViewportState = &state.viewport;
+		pipelineInfo.pRasterizationState = &state.rasterization;
+		pipelineInfo.pDynamicState = &state.dynamic;
+		pipelineInfo.layout = state.layout;
+		pipelineInfo.renderPass = state.renderPass;
+		pipelineInfo.subpass = state.subpass;
+		break;
+	case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+		pipelineInfo.stageCount = 1;
+		pipelineInfo.pStages = &state.stages[1];
+		pipelineInfo.pDepthStencilState = &state.depthStencil;
+		pipelineInfo.pMultisampleState = &state.multisample;
+		pipelineInfo.layout = state.layout;
+		pipelineInfo.renderPass = state.renderPass;
+		pipelineInfo.subpass = state.subpass;
+		break;
+	default: // Fragment output interface
+		pipelineInfo.pColorBlendState = &state.colorBlend;
+		pipelineInfo.pMultisampleState = &state.multisample;
+		pipelineInfo.renderPass = state.renderPass;
+		pipelineInfo.subpass = state.subpass;
+		break;
+	}
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(this->device, this->pipelineCache->getHandle(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create graphics pipeline library");
+	}
+	addPipeline(pipeline);
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->stats.libraries++;
+	return pipeline;
+}
+
+VkPipeline PipelineManager::linkLibraries(const VkPipeline* parts, VkPipelineLayout layout, bool optimize) {
+	CPU_TRACE_ZONE(optimize ? "Link optimized pipeline" : "Fast link pipeline");
+	VkPipelineLibraryCreateInfoKHR libraryInfo{};
+	libraryInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+	libraryInfo.libraryCount = 4;
+	libraryInfo.pLibraries = parts;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = &libraryInfo;
+	pipelineInfo.flags = optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+	pipelineInfo.layout = layout;
+
+	VkPipeline pipeline;
+	if (vkCreateGraphicsPipelines(this->device, this->pipelineCache->getHandle(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to link graphics pipeline libraries");
+	}
+	addPipeline(pipeline);
+	return pipeline;
+}
+
+VkShaderModule PipelineManager::getShader(const std::string& name) {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		auto it = this->shaders.find(name);
+		if (it != this->shaders.end()) {
+			return it->second;
+		}
+	}
+
+	// Two threads may load the same file, the pipeline cache deduplicates the module
+	VkShaderModule shaderModule = this->pipelineCache->getShaderModule(readSpirv(name));
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->shaders.emplace(name, shaderModule);
+	return shaderModule;
+}
+
+void PipelineManager::addPipeline(VkPipeline pipeline) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->pipelines.push_back(pipeline);
+}
+
+void PipelineManager::retirePipeline(VkPipeline pipeline) {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->pipelines.erase(std::remove(this->pipelines.begin(), this->pipelines.end(), pipeline), this->pipelines.end());
+	}
+	this->deletionQueue->retirePipeline(pipeline);
+}
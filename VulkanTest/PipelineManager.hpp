@@ -0,0 +1,181 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <atomic>
+
+#include "PipelineCache.hpp"
+#include "ThreadPool.hpp"
+#include "DeferredDeletionQueue.hpp"
+
+// Everything a graphics pipeline is built from. Shaders are names given to registerShader, or SPIR-V file paths
+// loaded on first use; vertexInput, layout and renderPass are names given to the matching register calls. Viewport and
+// scissor are dynamic.
+struct GraphicsPipelineKey {
+	std::string vertexShader;
+	std::string fragmentShader;
+	std::string vertexInput; // Empty for pipelines without vertex buffers
+	std::string layout;
+	std::string renderPass;
+	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+	bool depthTest = true;
+	bool depthWrite = true;
+	bool blend = false; // Alpha blending
+
+	// One tab separated line, the format of the pre-warm lists
+	std::string toString() const;
+};
+
+struct ComputePipelineKey {
+	std::string shader;
+	std::string layout;
+
+	std::string toString() const;
+};
+
+struct PipelineManagerStats {
+	uint32_t requested = 0; // Distinct keys
+	uint32_t compiled = 0; // Complete pipelines, optimized ones when linked from libraries
+	uint32_t fastLinked = 0; // Unoptimized pipelines linked from libraries while the optimized one compiles
+	uint32_t libraries = 0; // Graphics pipeline library parts
+	uint32_t failed = 0;
+	uint32_t fallbacks = 0; // get calls that returned the fallback
+	double compileMilliseconds = 0.0; // Summed over the compile threads
+};
+
+// Compiles pipelines on its own worker threads against the shared VkPipelineCache, so a material seen for the first
+// time costs a fallback draw instead of a hitch. The compile threads are separate from the base's ThreadPool, whose
+// parallelFor would otherwise wait behind long compile jobs.
+//
+// With VK_EXT_graphics_pipeline_library, graphics pipelines are built from four libraries (vertex input, pre-raster
+// shaders, fragment shader, fragment output) cached separately, so a new combination of known parts is a quick link.
+// The fast linked pipeline is handed out at once and replaced by a link time optimized one compiled in the background,
+// the deletion queue destroys it once the frames that may have drawn with it completed.
+//
+// Every key requested is recorded, saveKeys writes them out and prewarm requests them again on the next run.
+// Pipelines are owned by the manager and destroyed in cleanup.
+class PipelineManager
+{
+public:
+	// compileThreadCount = 0 uses a quarter of the hardware threads, at least one
+	void init(VkDevice device, PipelineCache& pipelineCache, DeferredDeletionQueue& deletionQueue, bool graphicsPipelineLibrary, uint32_t compileThreadCount = 0);
+
+	// Drops the compiles that have not started, waits for the others and destroys every pipeline
+	void cleanup();
+
+	// Registered objects are not owned and must outlive the manager, names cannot be registered twice
+	void registerShader(const std::string& name, const std::vector<char>& code);
+
+	void registerLayout(const std::string& name, VkPipelineLayout layout);
+
+	void registerRenderPass(const std::string& name, VkRenderPass renderPass, uint32_t subpass, VkSampleCountFlagBits samples);
+
+	void registerVertexInput(const std::string& name, const std::vector<VkVertexInputBindingDescription>& bindings, const std::vector<VkVertexInputAttributeDescription>& attributes);
+
+	// Queues the compile if key was never requested. The future holds the final pipeline, or the compile error.
+	std::shared_future<VkPipeline> requestGraphics(const GraphicsPipelineKey& key);
+
+	std::shared_future<VkPipeline> requestCompute(const ComputePipelineKey& key);
+
+	// The best pipeline compiled so far for key, fallback while there is none. Never blocks.
+	VkPipeline getGraphics(const GraphicsPipelineKey& key, VkPipeline fallback);
+
+	VkPipeline getCompute(const ComputePipelineKey& key, VkPipeline fallback);
+
+	// Compiles on the calling thread unless a worker already started, for fallbacks and loading screens
+	VkPipeline compileGraphics(const GraphicsPipelineKey& key);
+
+	VkPipeline compileCompute(const ComputePipelineKey& key);
+
+	// Requests every key listed in path, a missing file is not an error. Returns the number of keys requested.
+	uint32_t prewarm(const std::string& path);
+
+	// Writes every key requested so far, in request order
+	bool saveKeys(const std::string& path);
+
+	// Waits until every queued compile has completed
+	void waitIdle();
+
+	bool usesGraphicsPipelineLibrary() const { return this->graphicsPipelineLibrary; }
+
+	PipelineManagerStats getStats();
+
+private:
+	struct RenderPassInfo {
+		VkRenderPass renderPass;
+		uint32_t subpass;
+		VkSampleCountFlagBits samples;
+	};
+
+	struct VertexInputInfo {
+		std::vector<VkVertexInputBindingDescription> bindings;
+		std::vector<VkVertexInputAttributeDescription> attributes;
+	};
+
+	struct Entry {
+		bool isCompute = false;
+		GraphicsPipelineKey graphics;
+		ComputePipelineKey compute;
+		std::atomic<VkPipeline> pipeline{ VK_NULL_HANDLE }; // Best variant so far
+		std::atomic<bool> claimed{ false }; // Set by the thread compiling it
+		std::promise<VkPipeline> promise;
+		std::shared_future<VkPipeline> future;
+	};
+
+	struct GraphicsState;
+
+	VkDevice device = VK_NULL_HANDLE;
+	PipelineCache* pipelineCache = nullptr;
+	DeferredDeletionQueue* deletionQueue = nullptr;
+	bool graphicsPipelineLibrary = false;
+	ThreadPool compileThreads;
+	std::atomic<bool> stopping{ false };
+
+	std::mutex mutex; // Guards everything below
+	std::unordered_map<std::string, VkShaderModule> shaders;
+	std::unordered_map<std::string, VkPipelineLayout> layouts;
+	std::unordered_map<std::string, RenderPassInfo> renderPasses;
+	std::unordered_map<std::string, VertexInputInfo> vertexInputs;
+	std::unordered_map<std::string, std::unique_ptr<Entry>> entries; // By key string
+	std::vector<std::string> requestOrder;
+	std::unordered_map<std::string, std::shared_future<VkPipeline>> libraries; // By the state each part depends on
+	std::vector<VkPipeline> pipelines; // Everything created and not retired, libraries included
+	PipelineManagerStats stats;
+
+	// Finds or creates the entry of keyString, queueing its compile when created
+	Entry& request(const std::string& keyString, const GraphicsPipelineKey* graphics, const ComputePipelineKey* compute);
+
+	// Compiles entry if no other thread did, then waits for it
+	VkPipeline compile(Entry& entry);
+
+	void compileEntry(Entry& entry);
+
+	// Publishes the fast linked pipeline in entry before returning the optimized one
+	VkPipeline compileGraphicsPipeline(Entry& entry);
+
+	VkPipeline compileComputePipeline(const ComputePipelineKey& key);
+
+	// Resolves the names in key and fills every state of the pipeline
+	void resolve(const GraphicsPipelineKey& key, GraphicsState& state);
+
+	// Returns the library cached under libraryKey, creating it on this thread when no other thread is
+	VkPipeline getLibrary(const std::string& libraryKey, const GraphicsState& state, VkGraphicsPipelineLibraryFlagsEXT part);
+
+	VkPipeline createLibrary(const GraphicsState& state, VkGraphicsPipelineLibraryFlagsEXT part);
+
+	VkPipeline linkLibraries(const VkPipeline* parts, VkPipelineLayout layout, bool optimize);
+
+	VkShaderModule getShader(const std::string& name);
+
+	void addPipeline(VkPipeline pipeline);
+
+	// Hands a pipeline no longer returned by get to the deletion queue
+	void retirePipeline(VkPipeline pipeline);
+};
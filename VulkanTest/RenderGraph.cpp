@@ -0,0 +1,926 @@
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	constexpr VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+		| VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+	constexpr VkPipelineStageFlags DEPTH_STAGES = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+	bool hasStencil(VkFormat format) {
+		return format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_S8_UINT;
+	}
+
+	bool isDepthFormat(VkFormat format) {
+		return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT || hasStencil(format);
+	}
+
+	VkImageAspectFlags getAspectMask(VkFormat format) {
+		if (!isDepthFormat(format)) {
+			return VK_IMAGE_ASPECT_COLOR_BIT;
+		}
+		return hasStencil(format) ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_DEPTH_BIT;
+	}
+}
+
+RenderGraphPass& RenderGraphPass::addColorOutput(RenderGraphImage image, VkAttachmentLoadOp loadOp, VkClearColorValue clearValue) {
+	Use use{ UseType::ColorAttachment, image.index, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, true, loadOp };
+	use.clearValue.color = clearValue;
+	this->lastColorUse = static_cast<uint32_t>(this->uses.size());
+	return addUse(use);
+}
+
+RenderGraphPass& RenderGraphPass::addResolveOutput(RenderGraphImage image) {
+	if (this->lastColorUse == UINT32_MAX) {
+		throw std::runtime_error(std::string("Resolve output added before any color output in render graph pass ") + this->name);
+	}
+
+	Use use{ UseType::ResolveAttachment, image.index, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, true };
+	use.resolvedUse = this->lastColorUse;
+	return addUse(use);
+}
+
+RenderGraphPass& RenderGraphPass::setDepthOutput(RenderGraphImage image, VkAttachmentLoadOp loadOp, VkClearDepthStencilValue clearValue) {
+	Use use{ UseType::DepthAttachment, image.index, DEPTH_STAGES, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, true, loadOp };
+	use.clearValue.depthStencil = clearValue;
+	return addUse(use);
+}
+
+RenderGraphPass& RenderGraphPass::setDepthInput(RenderGraphImage image) {
+	return addUse({ UseType::DepthAttachment, image.index, DEPTH_STAGES, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, false, VK_ATTACHMENT_LOAD_OP_LOAD });
+}
+
+RenderGraphPass& RenderGraphPass::addInputAttachment(RenderGraphImage image) {
+	return addUse({ UseType::InputAttachment, image.index, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT, false, VK_ATTACHMENT_LOAD_OP_LOAD });
+}
+
+RenderGraphPass& RenderGraphPass::addSampledImage(RenderGraphImage image, VkPipelineStageFlags stages) {
+	return addUse({ UseType::SampledImage, image.index, stages, VK_ACCESS_SHADER_READ_BIT, false });
+}
+
+RenderGraphPass& RenderGraphPass::addStorageImage(RenderGraphImage image, bool write, VkPipelineStageFlags stages) {
+	VkAccessFlags access = write ? VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+	return addUse({ UseType::StorageImage, image.index, stages, access, write });
+}
+
+RenderGraphPass& RenderGraphPass::addBuffer(RenderGraphBuffer buffer, VkPipelineStageFlags stages, VkAccessFlags access) {
+	return addUse({ UseType::Buffer, buffer.index, stages, access, (access & WRITE_ACCESS) != 0 });
+}
+
+RenderGraphPass& RenderGraphPass::setSideEffects() {
+	this->sideEffects = true;
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::setRecord(RecordFunction record) {
+	this->record = std::move(record);
+	return *this;
+}
+
+RenderGraphPass& RenderGraphPass::addUse(const Use& use) {
+	if (this->compute && use.isAttachment()) {
+		throw std::runtime_error(std::string("Attachment used in render graph compute pass ") + this->name);
+	}
+	for (const Use& other : this->uses) {
+		if (other.resource == use.resource && (other.type == UseType::Buffer) == (use.type == UseType::Buffer)) {
+			throw std::runtime_error(std::string("Resource used twice in render graph pass ") + this->name);
+		}
+	}
+
+	this->uses.push_back(use);
+	return *this;
+}
+
+void RenderGraph::init(VkDevice device, DeviceProfile& profile, DeviceMemoryAllocator& allocator, DeferredDeletionQueue& deletionQueue) {
+	this->device = device;
+	this->profile = &profile;
+	this->allocator = &allocator;
+	this->deletionQueue = &deletionQueue;
+}
+
+void RenderGraph::cleanup() {
+	reset();
+}
+
+void RenderGraph::reset() {
+	retireCompiled();
+	this->images.clear();
+	this->buffers.clear();
+	this->passes.clear();
+}
+
+RenderGraphImage RenderGraph::createImage(const char* name, const RenderGraphImageInfo& info) {
+	ImageResource resource;
+	resource.name = name;
+	resource.info = info;
+	resource.imported = false;
+	this->images.push_back(resource);
+	return { static_cast<uint32_t>(this->images.size() - 1) };
+}
+
+RenderGraphImage RenderGraph::importImage(const char* name, const RenderGraphImageInfo& info, VkImageLayout initialLayout, VkImageLayout finalLayout) {
+	ImageResource resource;
+	resource.name = name;
+	resource.info = info;
+	resource.imported = true;
+	resource.initialLayout = initialLayout;
+	resource.finalLayout = finalLayout;
+	this->images.push_back(resource);
+	return { static_cast<uint32_t>(this->images.size() - 1) };
+}
+
+void RenderGraph::setImportedImage(RenderGraphImage image, VkImage handle, VkImageView view) {
+	ImageResource& resource = this->images[image.index];
+	if (!resource.imported) {
+		throw std::runtime_error(std::string("Render graph image ") + resource.name + " is not imported");
+	}
+	resource.image = handle;
+	resource.view = view;
+}
+
+RenderGraphBuffer RenderGraph::importBuffer(const char* name, VkBuffer buffer) {
+	this->buffers.push_back({ name, buffer });
+	return { static_cast<uint32_t>(this->buffers.size() - 1) };
+}
+
+void RenderGraph::setImportedBuffer(RenderGraphBuffer buffer, VkBuffer handle) {
+	this->buffers[buffer.index].buffer = handle;
+}
+
+RenderGraphPass& RenderGraph::addGraphicsPass(const char* name) {
+	this->passes.push_back(RenderGraphPass(name, static_cast<uint32_t>(this->passes.size()), false));
+	return this->passes.back();
+}
+
+RenderGraphPass& RenderGraph::addComputePass(const char* name) {
+	this->passes.push_back(RenderGraphPass(name, static_cast<uint32_t>(this->passes.size()), true));
+	return this->passes.back();
+}
+
+void RenderGraph::compile() {
+	retireCompiled();
+
+	this->stats.passCount = static_cast<uint32_t>(this->passes.size());
+	std::vector<bool> alive = cullPasses();
+	this->stats.culledPassCount = static_cast<uint32_t>(std::count(alive.begin(), alive.end(), false));
+
+	buildSteps(alive);
+	createTransientImages();
+	for (uint32_t i = 0; i < this->steps.size(); i++) {
+		if (this->steps[i].renderPass) {
+			createRenderPass(i);
+			this->stats.renderPassCount++;
+		}
+	}
+
+	// The first walk only finds the state each image is left in at the end of a frame, which is where the next frame
+	// starts from: the same transient memory is reused every frame
+	std::vector<ResourceState> imageStates(this->images.size());
+	computeBarriers(imageStates, false);
+	computeBarriers(imageStates, true);
+
+	for (const Step& step : this->steps) {
+		if (step.barriers.srcStages != 0) {
+			this->stats.barrierCount++;
+		}
+	}
+	if (this->finalBarriers.srcStages != 0) {
+		this->stats.barrierCount++;
+	}
+
+	this->compiled = true;
+}
+
+std::vector<bool> RenderGraph::cullPasses() {
+	std::vector<bool> alive(this->passes.size(), false);
+	std::vector<bool> imageNeeded(this->images.size(), false); // Read by a live pass later on
+
+	for (size_t i = this->passes.size(); i-- > 0;) {
+		const RenderGraphPass& pass = this->passes[i];
+
+		// Buffers are always imported, writing one is always visible outside
+		bool keep = pass.sideEffects;
+		for (const auto& use : pass.uses) {
+			if (use.write) {
+				keep = keep || use.type == RenderGraphPass::UseType::Buffer || this->images[use.resource].imported || imageNeeded[use.resource];
+			}
+		}
+		if (!keep) continue;
+		alive[i] = true;
+
+		// Attachments written without being loaded hide whatever was there, storage writes may only cover part of it
+		for (const auto& use : pass.uses) {
+			if (use.type == RenderGraphPass::UseType::Buffer) continue;
+			if (use.write && use.isAttachment() && use.loadOp != VK_ATTACHMENT_LOAD_OP_LOAD) {
+				imageNeeded[use.resource] = false;
+			}
+		}
+		for (const auto& use : pass.uses) {
+			if (use.type == RenderGraphPass::UseType::Buffer) continue;
+			if (!use.write || !use.isAttachment() || use.loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+				imageNeeded[use.resource] = true;
+			}
+		}
+	}
+
+	return alive;
+}
+
+VkExtent2D RenderGraph::getPassExtent(const RenderGraphPass& pass) const {
+	VkExtent2D extent = { 0, 0 };
+	for (const auto& use : pass.uses) {
+		if (!use.isAttachment()) continue;
+
+		const VkExtent2D& imageExtent = this->images[use.resource].info.extent;
+		if (extent.width == 0) {
+			extent = imageExtent;
+		}
+		else if (extent.width != imageExtent.width || extent.height != imageExtent.height) {
+			throw std::runtime_error(std::string("Attachments of render graph pass ") + pass.name + " have different sizes");
+		}
+	}
+
+	if (extent.width == 0) {
+		throw std::runtime_error(std::string("Render graph graphics pass ") + pass.name + " has no attachment");
+	}
+	return extent;
+}
+
+bool RenderGraph::canMerge(const Step& step, const RenderGraphPass& pass) const {
+	const VkExtent2D extent = getPassExtent(pass);
+	if (extent.width != step.extent.width || extent.height != step.extent.height) {
+		return false;
+	}
+
+	// Attachment to attachment hazards are framebuffer local, a by region subpass dependency covers them. Anything
+	// else needs the render pass to end first.
+	for (const auto& use : pass.uses) {
+		const bool isBuffer = use.type == RenderGraphPass::UseType::Buffer;
+		for (uint32_t passIndex : step.passes) {
+			for (const auto& other : this->passes[passIndex].uses) {
+				if (other.resource != use.resource || (other.type == RenderGraphPass::UseType::Buffer) != isBuffer) continue;
+				if (use.isAttachment() && other.isAttachment()) continue;
+				if (!use.write && !other.write) continue;
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void RenderGraph::buildSteps(const std::vector<bool>& alive) {
+	this->passSteps.assign(this->passes.size(), UINT32_MAX);
+	this->passSubpasses.assign(this->passes.size(), 0);
+
+	for (uint32_t i = 0; i < this->passes.size(); i++) {
+		if (!alive[i]) continue;
+		const RenderGraphPass& pass = this->passes[i];
+
+		if (!pass.compute && !this->steps.empty() && this->steps.back().renderPass && canMerge(this->steps.back(), pass)) {
+			this->steps.back().passes.push_back(i);
+		}
+		else {
+			Step step;
+			step.renderPass = !pass.compute;
+			if (step.renderPass) {
+				step.extent = getPassExtent(pass);
+			}
+			step.passes.push_back(i);
+			this->steps.push_back(std::move(step));
+		}
+
+		this->passSteps[i] = static_cast<uint32_t>(this->steps.size() - 1);
+		this->passSubpasses[i] = static_cast<uint32_t>(this->steps.back().passes.size() - 1);
+	}
+}
+
+void RenderGraph::createTransientImages() {
+	for (uint32_t stepIndex = 0; stepIndex < this->steps.size(); stepIndex++) {
+		for (uint32_t passIndex : this->steps[stepIndex].passes) {
+			for (const auto& use : this->passes[passIndex].uses) {
+				if (use.type == RenderGraphPass::UseType::Buffer) continue;
+
+				ImageResource& image = this->images[use.resource];
+				image.firstStep = std::min(image.firstStep, stepIndex);
+				image.lastStep = std::max(image.lastStep, stepIndex);
+				switch (use.type) {
+				case RenderGraphPass::UseType::ColorAttachment:
+				case RenderGraphPass::UseType::ResolveAttachment:
+					image.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+					break;
+				case RenderGraphPass::UseType::DepthAttachment:
+					image.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+					break;
+				case RenderGraphPass::UseType::InputAttachment:
+					image.usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+					break;
+				case RenderGraphPass::UseType::SampledImage:
+					image.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+					break;
+				case RenderGraphPass::UseType::StorageImage:
+					image.usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+					break;
+				default:
+					break;
+				}
+			}
+		}
+	}
+
+	uint32_t lazyMemoryTypeBits = 0;
+	const VkPhysicalDeviceMemoryProperties& memoryProperties = this->profile->getMemoryProperties();
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+		if (memoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) {
+			lazyMemoryTypeBits |= 1u << i;
+		}
+	}
+
+	const VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+	std::vector<uint32_t> aliasable;
+
+	for (uint32_t i = 0; i < this->images.size(); i++) {
+		ImageResource& image = this->images[i];
+		if (image.imported || image.firstStep == UINT32_MAX) continue;
+
+		// Only ever touched as attachments of one render pass: never stored, so its memory never needs to be committed
+		image.lazy = lazyMemoryTypeBits != 0 && image.firstStep == image.lastStep && (image.usage & ~attachmentUsage) == 0;
+		if (image.lazy) {
+			image.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		}
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = image.info.extent.width;
+		imageInfo.extent.height = image.info.extent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = image.info.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = image.usage;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.samples = image.info.samples;
+
+		if (vkCreateImage(this->device, &imageInfo, nullptr, &image.image) != VK_SUCCESS) {
+			throw std::runtime_error(std::string("Failed to create render graph image ") + image.name);
+		}
+		vkGetImageMemoryRequirements(this->device, image.image, &image.requirements);
+
+		this->stats.transientImageCount++;
+		this->stats.transientBytes += image.requirements.size;
+
+		if (image.lazy && (image.requirements.memoryTypeBits & lazyMemoryTypeBits) != 0) {
+			MemoryAllocation allocation = this->allocator->allocate(image.requirements,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, true, AllocationStrategy::Dedicated, MemoryCategory::Attachment);
+			vkBindImageMemory(this->device, image.image, allocation.memory, allocation.offset);
+			this->allocations.push_back(allocation);
+			image.aliasPredecessor = i;
+			this->stats.lazyImageCount++;
+		}
+		else {
+			image.lazy = false;
+			aliasable.push_back(i);
+		}
+	}
+
+	// Greedy placement, largest first: each image goes to the first memory whose occupants are never alive at the same time
+	std::stable_sort(aliasable.begin(), aliasable.end(), [this](uint32_t a, uint32_t b) {
+		return this->images[a].requirements.size > this->images[b].requirements.size;
+	});
+
+	struct SharedMemory {
+		VkMemoryRequirements requirements;
+		std::vector<uint32_t> images;
+	};
+	std::vector<SharedMemory> sharedMemories;
+
+	for (uint32_t imageIndex : aliasable) {
+		const ImageResource& image = this->images[imageIndex];
+
+		SharedMemory* target = nullptr;
+		for (auto& memory : sharedMemories) {
+			if ((memory.requirements.memoryTypeBits & image.requirements.memoryTypeBits) == 0) continue;
+
+			bool overlaps = false;
+			for (uint32_t other : memory.images) {
+				overlaps = overlaps || !(this->images[other].lastStep < image.firstStep || this->images[other].firstStep > image.lastStep);
+			}
+			if (!overlaps) {
+				target = &memory;
+				break;
+			}
+		}
+
+		if (target == nullptr) {
+			sharedMemories.push_back({ image.requirements, {} });
+			target = &sharedMemories.back();
+		}
+		else {
+			target->requirements.size = std::max(target->requirements.size, image.requirements.size);
+			target->requirements.alignment = std::max(target->requirements.alignment, image.requirements.alignment);
+			target->requirements.memoryTypeBits &= image.requirements.memoryTypeBits;
+		}
+		target->images.push_back(imageIndex);
+	}
+
+	for (auto& memory : sharedMemories) {
+		MemoryAllocation allocation = this->allocator->allocate(memory.requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true, AllocationStrategy::FreeList, MemoryCategory::Attachment);
+		this->allocations.push_back(allocation);
+		this->stats.aliasedBytes += memory.requirements.size;
+
+		std::sort(memory.images.begin(), memory.images.end(), [this](uint32_t a, uint32_t b) {
+			return this->images[a].firstStep < this->images[b].firstStep;
+		});
+		for (size_t i = 0; i < memory.images.size(); i++) {
+			ImageResource& image = this->images[memory.images[i]];
+			vkBindImageMemory(this->device, image.image, allocation.memory, allocation.offset);
+			// The first occupant follows the last one of the previous frame
+			image.aliasPredecessor = memory.images[(i + memory.images.size() - 1) % memory.images.size()];
+		}
+	}
+
+	for (auto& image : this->images) {
+		if (image.imported || image.image == VK_NULL_HANDLE) continue;
+
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = image.info.format;
+		// Depth only, so that depth stencil images can also be sampled through the same view
+		viewInfo.subresourceRange.aspectMask = isDepthFormat(image.info.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(this->device, &viewInfo, nullptr, &image.view) != VK_SUCCESS) {
+			throw std::runtime_error(std::string("Failed to create render graph image view ") + image.name);
+		}
+	}
+}
+
+VkImageLayout RenderGraph::getLayout(const RenderGraphPass::Use& use) const {
+	const bool depth = isDepthFormat(this->images[use.resource].info.format);
+
+	switch (use.type) {
+	case RenderGraphPass::UseType::ColorAttachment:
+	case RenderGraphPass::UseType::ResolveAttachment:
+		return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	case RenderGraphPass::UseType::DepthAttachment:
+		return use.write ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	case RenderGraphPass::UseType::InputAttachment:
+	case RenderGraphPass::UseType::SampledImage:
+		return depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	case RenderGraphPass::UseType::StorageImage:
+		return VK_IMAGE_LAYOUT_GENERAL;
+	default:
+		return VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+}
+
+void RenderGraph::createRenderPass(uint32_t stepIndex) {
+	Step& step = this->steps[stepIndex];
+	const uint32_t subpassCount = static_cast<uint32_t>(step.passes.size());
+
+	struct AttachmentUses {
+		const RenderGraphPass::Use* firstUse = nullptr;
+		const RenderGraphPass::Use* lastUse = nullptr;
+		uint32_t firstSubpass = 0;
+		uint32_t lastSubpass = 0;
+	};
+	std::vector<AttachmentUses> attachmentUses;
+	std::map<uint32_t, uint32_t> attachmentIndices; // Image index -> attachment index
+
+	std::vector<std::vector<VkAttachmentReference>> colorReferences(subpassCount);
+	std::vector<std::vector<VkAttachmentReference>> resolveReferences(subpassCount);
+	std::vector<std::vector<VkAttachmentReference>> inputReferences(subpassCount);
+	std::vector<VkAttachmentReference> depthReferences(subpassCount, { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED });
+	std::vector<std::vector<uint32_t>> preserveAttachments(subpassCount);
+	std::vector<std::vector<uint32_t>> referencedAttachments(subpassCount);
+
+	for (uint32_t subpass = 0; subpass < subpassCount; subpass++) {
+		const RenderGraphPass& pass = this->passes[step.passes[subpass]];
+
+		for (const auto& use : pass.uses) {
+			if (!use.isAttachment()) continue;
+
+			auto found = attachmentIndices.find(use.resource);
+			if (found == attachmentIndices.end()) {
+				found = attachmentIndices.emplace(use.resource, static_cast<uint32_t>(attachmentUses.size())).first;
+				attachmentUses.push_back({ &use, &use, subpass, subpass });
+				step.attachments.push_back(use.resource);
+			}
+			const uint32_t attachment = found->second;
+			attachmentUses[attachment].lastUse = &use;
+			attachmentUses[attachment].lastSubpass = subpass;
+			referencedAttachments[subpass].push_back(attachment);
+
+			const VkAttachmentReference reference = { attachment, getLayout(use) };
+			switch (use.type) {
+			case RenderGraphPass::UseType::ColorAttachment:
+				colorReferences[subpass].push_back(reference);
+				break;
+			case RenderGraphPass::UseType::DepthAttachment:
+				depthReferences[subpass] = reference;
+				break;
+			case RenderGraphPass::UseType::InputAttachment:
+				inputReferences[subpass].push_back(reference);
+				break;
+			default:
+				break;
+			}
+		}
+
+		// Resolve references line up with the color ones
+		for (const auto& use : pass.uses) {
+			if (use.type != RenderGraphPass::UseType::ResolveAttachment) continue;
+
+			uint32_t colorPosition = 0;
+			for (uint32_t i = 0; i < use.resolvedUse; i++) {
+				colorPosition += pass.uses[i].type == RenderGraphPass::UseType::ColorAttachment ? 1 : 0;
+			}
+			resolveReferences[subpass].resize(colorReferences[subpass].size(), { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED });
+			resolveReferences[subpass][colorPosition] = { attachmentIndices[use.resource], getLayout(use) };
+		}
+	}
+
+	std::vector<VkAttachmentDescription> descriptions;
+	for (uint32_t attachment = 0; attachment < attachmentUses.size(); attachment++) {
+		const AttachmentUses& uses = attachmentUses[attachment];
+		const ImageResource& image = this->images[step.attachments[attachment]];
+
+		// Written back only when something after this render pass, or outside the graph, reads it
+		const bool stored = image.imported || image.lastStep > stepIndex;
+
+		VkAttachmentDescription description{};
+		description.format = image.info.format;
+		description.samples = image.info.samples;
+		description.loadOp = uses.firstUse->loadOp;
+		description.storeOp = stored ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		description.stencilLoadOp = hasStencil(image.info.format) ? description.loadOp : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		description.stencilStoreOp = hasStencil(image.info.format) ? description.storeOp : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		// Barriers before the render pass already put the image in the layout of its first use
+		description.initialLayout = getLayout(*uses.firstUse);
+		description.finalLayout = getLayout(*uses.lastUse);
+		descriptions.push_back(description);
+		step.clearValues.push_back(uses.firstUse->clearValue);
+
+		for (uint32_t subpass = uses.firstSubpass + 1; subpass < uses.lastSubpass; subpass++) {
+			const auto& referenced = referencedAttachments[subpass];
+			if (std::find(referenced.begin(), referenced.end(), attachment) == referenced.end()) {
+				preserveAttachments[subpass].push_back(attachment);
+			}
+		}
+	}
+
+	std::vector<VkSubpassDescription> subpasses(subpassCount);
+	for (uint32_t subpass = 0; subpass < subpassCount; subpass++) {
+		VkSubpassDescription& description = subpasses[subpass];
+		description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		description.colorAttachmentCount = static_cast<uint32_t>(colorReferences[subpass].size());
+		description.pColorAttachments = colorReferences[subpass].data();
+		description.pResolveAttachments = resolveReferences[subpass].empty() ? nullptr : resolveReferences[subpass].data();
+		description.pDepthStencilAttachment = depthReferences[subpass].attachment != VK_ATTACHMENT_UNUSED ? &depthReferences[subpass] : nullptr;
+		description.inputAttachmentCount = static_cast<uint32_t>(inputReferences[subpass].size());
+		description.pInputAttachments = inputReferences[subpass].data();
+		description.preserveAttachmentCount = static_cast<uint32_t>(preserveAttachments[subpass].size());
+		description.pPreserveAttachments = preserveAttachments[subpass].data();
+	}
+
+	// Between subpasses touching the same attachment with at least one write, every such pair being framebuffer local
+	std::map<std::pair<uint32_t, uint32_t>, VkSubpassDependency> dependencies;
+	for (uint32_t dst = 1; dst < subpassCount; dst++) {
+		for (const auto& use : this->passes[step.passes[dst]].uses) {
+			if (!use.isAttachment()) continue;
+
+			for (uint32_t src = 0; src < dst; src++) {
+				for (const auto& other : this->passes[step.passes[src]].uses) {
+					if (!other.isAttachment() || other.resource != use.resource || (!use.write && !other.write)) continue;
+
+					VkSubpassDependency& dependency = dependencies[{ src, dst }];
+					dependency.srcSubpass = src;
+					dependency.dstSubpass = dst;
+					dependency.srcStageMask |= other.stages;
+					dependency.srcAccessMask |= other.access & WRITE_ACCESS;
+					dependency.dstStageMask |= use.stages;
+					dependency.dstAccessMask |= use.access;
+					dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+				}
+			}
+		}
+	}
+	std::vector<VkSubpassDependency> dependencyList;
+	for (const auto& entry : dependencies) {
+		dependencyList.push_back(entry.second);
+	}
+
+	VkRenderPassCreateInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+	renderPassInfo.pAttachments = descriptions.data();
+	renderPassInfo.subpassCount = subpassCount;
+	renderPassInfo.pSubpasses = subpasses.data();
+	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencyList.size());
+	renderPassInfo.pDependencies = dependencyList.data();
+
+	if (vkCreateRenderPass(this->device, &renderPassInfo, nullptr, &step.handle) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create render graph render pass");
+	}
+}
+
+void RenderGraph::computeBarriers(std::vector<ResourceState>& imageStates, bool record) {
+	const std::vector<ResourceState> previousFrame = imageStates;
+	std::vector<ResourceState> bufferStates(this->buffers.size());
+
+	for (uint32_t i = 0; i < this->images.size(); i++) {
+		imageStates[i] = ResourceState{};
+		if (this->images[i].imported) {
+			// Chains with whatever the caller waited on before execute, and orders the initial layout transition after it
+			imageStates[i].layout = this->images[i].initialLayout;
+			imageStates[i].readStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		}
+	}
+
+	for (uint32_t stepIndex = 0; stepIndex < this->steps.size(); stepIndex++) {
+		Step& step = this->steps[stepIndex];
+
+		std::map<uint32_t, StepAccess> imageAccesses;
+		std::map<uint32_t, StepAccess> bufferAccesses;
+		for (uint32_t passIndex : step.passes) {
+			for (const auto& use : this->passes[passIndex].uses) {
+				const bool isBuffer = use.type == RenderGraphPass::UseType::Buffer;
+				StepAccess& access = isBuffer ? bufferAccesses[use.resource] : imageAccesses[use.resource];
+				const VkImageLayout layout = isBuffer ? VK_IMAGE_LAYOUT_UNDEFINED : getLayout(use);
+
+				if (access.stages == 0) {
+					access.firstLayout = layout;
+				}
+				access.lastLayout = layout;
+				access.stages |= use.stages;
+				access.access |= use.access;
+				if (use.write) {
+					access.write = true;
+					access.writeStages |= use.stages;
+					access.writeAccess |= use.access & WRITE_ACCESS;
+				}
+				else {
+					access.readStages |= use.stages;
+				}
+			}
+		}
+
+		BarrierBatch batch;
+		for (const auto& entry : imageAccesses) {
+			const ImageResource& image = this->images[entry.first];
+			if (!image.imported && image.firstStep == stepIndex) {
+				// The memory was last used by the alias predecessor, earlier in this frame or in the previous one
+				const uint32_t predecessor = image.aliasPredecessor;
+				const bool earlierThisFrame = this->images[predecessor].lastStep < stepIndex;
+				const ResourceState& predecessorState = earlierThisFrame ? imageStates[predecessor] : previousFrame[predecessor];
+
+				ResourceState state;
+				state.writeStages = predecessorState.writeStages;
+				state.writeAccess = predecessorState.writeAccess;
+				state.readStages = predecessorState.readStages;
+				imageStates[entry.first] = state;
+			}
+			addBarrier(imageStates[entry.first], entry.second, true, entry.first, batch);
+		}
+		for (const auto& entry : bufferAccesses) {
+			addBarrier(bufferStates[entry.first], entry.second, false, entry.first, batch);
+		}
+
+		if (record) {
+			step.barriers = std::move(batch);
+		}
+	}
+
+	if (!record) return;
+
+	this->finalBarriers = BarrierBatch{};
+	for (uint32_t i = 0; i < this->images.size(); i++) {
+		const ImageResource& image = this->images[i];
+		const ResourceState& state = imageStates[i];
+		if (!image.imported || image.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED || image.finalLayout == state.layout) continue;
+
+		const VkPipelineStageFlags srcStages = state.writeStages | state.readStages;
+		this->finalBarriers.srcStages |= srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		this->finalBarriers.dstStages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		this->finalBarriers.imageBarriers.push_back({ i, state.layout, image.finalLayout, state.writeAccess, 0 });
+	}
+}
+
+void RenderGraph::addBarrier(ResourceState& state, const StepAccess& access, bool isImage, uint32_t resource, BarrierBatch& batch) {
+	const bool layoutChange = isImage && access.firstLayout != state.layout;
+
+	bool needed;
+	VkPipelineStageFlags srcStages;
+	if (layoutChange || access.write) {
+		// Write after write or after read, a layout transition counting as a write
+		srcStages = state.writeStages | state.readStages;
+		needed = layoutChange || srcStages != 0;
+	}
+	else {
+		// Read after write, unless an earlier barrier already made the write visible to these stages
+		srcStages = state.writeStages;
+		needed = state.writeStages != 0 && ((access.stages & ~state.visibleStages) != 0 || (access.access & ~state.visibleAccess) != 0);
+	}
+
+	if (needed) {
+		batch.srcStages |= srcStages != 0 ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		batch.dstStages |= access.stages;
+		if (layoutChange) {
+			batch.imageBarriers.push_back({ resource, state.layout, access.firstLayout, state.writeAccess, access.access });
+		}
+		else {
+			batch.memorySrcAccess |= state.writeAccess;
+			batch.memoryDstAccess |= access.access;
+		}
+	}
+
+	if (access.write) {
+		state.writeStages = access.writeStages;
+		state.writeAccess = access.writeAccess;
+		state.readStages = access.readStages;
+		state.visibleStages = 0;
+		state.visibleAccess = 0;
+	}
+	else if (layoutChange) {
+		// Later reads from other stages must still wait for the transition
+		state.writeStages = access.stages;
+		state.writeAccess = 0;
+		state.readStages = access.stages;
+		state.visibleStages = access.stages;
+		state.visibleAccess = access.access;
+	}
+	else {
+		state.readStages |= access.stages;
+		if (needed) {
+			state.visibleStages |= access.stages;
+			state.visibleAccess |= access.access;
+		}
+	}
+	if (isImage) {
+		state.layout = access.lastLayout;
+	}
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch) {
+	if (batch.srcStages == 0) return;
+
+	this->imageBarrierScratch.clear();
+	for (const auto& barrier : batch.imageBarriers) {
+		const ImageResource& image = this->images[barrier.image];
+
+		VkImageMemoryBarrier imageBarrier{};
+		imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageBarrier.srcAccessMask = barrier.srcAccess;
+		imageBarrier.dstAccessMask = barrier.dstAccess;
+		imageBarrier.oldLayout = barrier.oldLayout;
+		imageBarrier.newLayout = barrier.newLayout;
+		imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image = image.image;
+		imageBarrier.subresourceRange.aspectMask = getAspectMask(image.info.format);
+		imageBarrier.subresourceRange.levelCount = 1;
+		imageBarrier.subresourceRange.layerCount = 1;
+		this->imageBarrierScratch.push_back(imageBarrier);
+	}
+
+	VkMemoryBarrier memoryBarrier{};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.srcAccessMask = batch.memorySrcAccess;
+	memoryBarrier.dstAccessMask = batch.memoryDstAccess;
+	const uint32_t memoryBarrierCount = (batch.memorySrcAccess | batch.memoryDstAccess) != 0 ? 1 : 0;
+
+	vkCmdPipelineBarrier(commandBuffer, batch.srcStages, batch.dstStages, 0, memoryBarrierCount, &memoryBarrier, 0, nullptr,
+		static_cast<uint32_t>(this->imageBarrierScratch.size()), this->imageBarrierScratch.data());
+}
+
+VkFramebuffer RenderGraph::getFramebuffer(Step& step) {
+	this->viewScratch.clear();
+	for (uint32_t image : step.attachments) {
+		this->viewScratch.push_back(this->images[image].view);
+	}
+
+	auto found = step.framebuffers.find(this->viewScratch);
+	if (found != step.framebuffers.end()) {
+		return found->second;
+	}
+
+	VkFramebufferCreateInfo framebufferInfo{};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = step.handle;
+	framebufferInfo.attachmentCount = static_cast<uint32_t>(this->viewScratch.size());
+	framebufferInfo.pAttachments = this->viewScratch.data();
+	framebufferInfo.width = step.extent.width;
+	framebufferInfo.height = step.extent.height;
+	framebufferInfo.layers = 1;
+
+	VkFramebuffer framebuffer;
+	if (vkCreateFramebuffer(this->device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create render graph framebuffer");
+	}
+	step.framebuffers.emplace(this->viewScratch, framebuffer);
+	return framebuffer;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer) {
+	if (!this->compiled) {
+		throw std::runtime_error("Render graph executed before being compiled");
+	}
+
+	for (Step& step : this->steps) {
+		recordBarriers(commandBuffer, step.barriers);
+
+		if (!step.renderPass) {
+			const RenderGraphPass& pass = this->passes[step.passes[0]];
+			if (pass.record) {
+				pass.record(commandBuffer);
+			}
+			continue;
+		}
+
+		VkRenderPassBeginInfo renderPassInfo{};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = step.handle;
+		renderPassInfo.framebuffer = getFramebuffer(step);
+		renderPassInfo.renderArea.extent = step.extent;
+		renderPassInfo.clearValueCount = static_cast<uint32_t>(step.clearValues.size());
+		renderPassInfo.pClearValues = step.clearValues.data();
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+		for (size_t i = 0; i < step.passes.size(); i++) {
+			if (i > 0) {
+				vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+			}
+			const RenderGraphPass& pass = this->passes[step.passes[i]];
+			if (pass.record) {
+				pass.record(commandBuffer);
+			}
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+
+	recordBarriers(commandBuffer, this->finalBarriers);
+}
+
+VkRenderPass RenderGraph::getRenderPass(const RenderGraphPass& pass) const {
+	const uint32_t step = this->passSteps[pass.index];
+	return step != UINT32_MAX ? this->steps[step].handle : VK_NULL_HANDLE;
+}
+
+uint32_t RenderGraph::getSubpass(const RenderGraphPass& pass) const {
+	return this->passSubpasses[pass.index];
+}
+
+bool RenderGraph::isCulled(const RenderGraphPass& pass) const {
+	return this->passSteps[pass.index] == UINT32_MAX;
+}
+
+void RenderGraph::retireCompiled() {
+	for (auto& step : this->steps) {
+		if (step.handle != VK_NULL_HANDLE) {
+			this->deletionQueue->retireRenderPass(step.handle);
+		}
+		for (const auto& entry : step.framebuffers) {
+			this->deletionQueue->retireFramebuffer(entry.second);
+		}
+	}
+
+	for (auto& image : this->images) {
+		if (!image.imported) {
+			if (image.view != VK_NULL_HANDLE) {
+				this->deletionQueue->retireImageView(image.view);
+			}
+			// Aliased images share allocations, retired separately below
+			if (image.image != VK_NULL_HANDLE) {
+				this->deletionQueue->retireImage(image.image);
+			}
+			image.image = VK_NULL_HANDLE;
+			image.view = VK_NULL_HANDLE;
+		}
+		image.usage = 0;
+		image.firstStep = UINT32_MAX;
+		image.lastStep = 0;
+		image.lazy = false;
+		image.aliasPredecessor = UINT32_MAX;
+	}
+	for (auto& allocation : this->allocations) {
+		this->deletionQueue->retireMemory(allocation);
+	}
+	this->allocations.clear();
+
+	this->steps.clear();
+	this->passSteps.clear();
+	this->passSubpasses.clear();
+	this->finalBarriers = BarrierBatch{};
+	this->stats = RenderGraphStats{};
+	this->compiled = false;
+}
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <map>
+#include <functional>
+
+#include "DeviceProfile.hpp"
+#include "DeviceMemoryAllocator.hpp"
+#include "DeferredDeletionQueue.hpp"
+
+// Handles are indices into the graph, valid until RenderGraph::reset
+struct RenderGraphImage {
+	uint32_t index = UINT32_MAX;
+	bool isValid() const { return this->index != UINT32_MAX; }
+};
+
+struct RenderGraphBuffer {
+	uint32_t index = UINT32_MAX;
+	bool isValid() const { return this->index != UINT32_MAX; }
+};
+
+struct RenderGraphImageInfo {
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	VkExtent2D extent = { 0, 0 };
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+struct RenderGraphStats {
+	uint32_t passCount = 0;
+	uint32_t culledPassCount = 0;
+	uint32_t renderPassCount = 0; // Graphics passes merged as subpasses of one render pass count once
+	uint32_t barrierCount = 0; // vkCmdPipelineBarrier calls per execute
+	uint32_t transientImageCount = 0;
+	uint32_t lazyImageCount = 0; // Backed by lazily allocated memory
+	VkDeviceSize transientBytes = 0; // Memory the transient images would take without aliasing
+	VkDeviceSize aliasedBytes = 0; // Memory they actually take, lazily allocated memory excluded
+};
+
+// What a pass reads and writes, everything else (barriers, layouts, load and store ops, render passes) is derived
+// from it by RenderGraph::compile. An image may only be used once per pass.
+class RenderGraphPass
+{
+public:
+	using RecordFunction = std::function<void(VkCommandBuffer commandBuffer)>;
+
+	// Attachments, graphics passes only. All the attachments of a pass must have the same extent.
+	RenderGraphPass& addColorOutput(RenderGraphImage image, VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR, VkClearColorValue clearValue = {});
+
+	// Resolve target of the color output added last
+	RenderGraphPass& addResolveOutput(RenderGraphImage image);
+
+	RenderGraphPass& setDepthOutput(RenderGraphImage image, VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR, VkClearDepthStencilValue clearValue = { 1.0f, 0 });
+
+	// Depth tested against but not written
+	RenderGraphPass& setDepthInput(RenderGraphImage image);
+
+	// Read at the same pixel with subpassLoad, which lets the pass become a subpass of the one writing image
+	RenderGraphPass& addInputAttachment(RenderGraphImage image);
+
+	RenderGraphPass& addSampledImage(RenderGraphImage image, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	RenderGraphPass& addStorageImage(RenderGraphImage image, bool write, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	// Writes are told apart by the write bits of access
+	RenderGraphPass& addBuffer(RenderGraphBuffer buffer, VkPipelineStageFlags stages, VkAccessFlags access);
+
+	// Never culled, for passes whose results leave the graph some other way (readbacks, queries)
+	RenderGraphPass& setSideEffects();
+
+	// Called by RenderGraph::execute, inside the pass' subpass for graphics passes
+	RenderGraphPass& setRecord(RecordFunction record);
+
+private:
+	friend class RenderGraph;
+
+	enum class UseType {
+		ColorAttachment,
+		ResolveAttachment,
+		DepthAttachment,
+		InputAttachment,
+		SampledImage,
+		StorageImage,
+		Buffer
+	};
+
+	struct Use {
+		UseType type;
+		uint32_t resource; // Index of the image, or of the buffer for UseType::Buffer
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		bool write;
+		VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		VkClearValue clearValue{};
+		uint32_t resolvedUse = UINT32_MAX; // For resolve attachments, index of the color output in uses
+
+		bool isAttachment() const { return this->type <= UseType::InputAttachment; }
+	};
+
+	const char* name;
+	uint32_t index;
+	bool compute;
+	bool sideEffects = false;
+	RecordFunction record;
+	std::vector<Use> uses;
+	uint32_t lastColorUse = UINT32_MAX;
+
+	RenderGraphPass(const char* name, uint32_t index, bool compute) : name(name), index(index), compute(compute) {
+	}
+
+	RenderGraphPass& addUse(const Use& use);
+};
+
+// Passes are declared in execution order, then compile:
+// - culls the passes whose writes are never read, unless they write an imported resource or have side effects
+// - merges consecutive graphics passes of the same size into subpasses of one render pass, when whatever they share
+//   is framebuffer local (attachments and input attachments)
+// - derives load and store ops, so attachments nothing reads afterwards are never written back to memory
+// - places transient images whose lifetimes don't overlap in the same memory, and backs the ones living within a
+//   single render pass with lazily allocated memory where the device has it
+// - computes the layout transitions and the barriers between passes, batched into one vkCmdPipelineBarrier per step
+//   and only where there is a hazard: reads after reads and repeated reads in already synchronized stages get none
+// Compiled objects are retired to the deletion queue, destroyed once the frames in flight are done with them, so the graph can be reset, redeclared
+// and recompiled from drawFrame, after a swap chain recreation for instance.
+class RenderGraph
+{
+public:
+	// profile, allocator and deletionQueue must outlive the graph
+	void init(VkDevice device, DeviceProfile& profile, DeviceMemoryAllocator& allocator, DeferredDeletionQueue& deletionQueue);
+
+	// Retires every compiled object, destroyed by the deletion queue
+	void cleanup();
+
+	// Drops every pass and resource
+	void reset();
+
+	// Owned by the graph, their content doesn't survive from one execute to the next
+	RenderGraphImage createImage(const char* name, const RenderGraphImageInfo& info);
+
+	// External images. initialLayout is their layout when execute starts, finalLayout the one they are left in
+	// (VK_IMAGE_LAYOUT_UNDEFINED to leave them as the last pass did). Accesses before execute must be made visible by
+	// the caller, with the semaphore or fence it already has to wait on.
+	RenderGraphImage importImage(const char* name, const RenderGraphImageInfo& info, VkImageLayout initialLayout, VkImageLayout finalLayout);
+
+	// Image behind an imported one, set before each execute (the acquired swap chain image for instance). The view
+	// ends up in cached framebuffers, it must stay alive until the graph is reset or recompiled.
+	void setImportedImage(RenderGraphImage image, VkImage handle, VkImageView view);
+
+	RenderGraphBuffer importBuffer(const char* name, VkBuffer buffer);
+
+	void setImportedBuffer(RenderGraphBuffer buffer, VkBuffer handle);
+
+	// References stay valid until reset
+	RenderGraphPass& addGraphicsPass(const char* name);
+
+	RenderGraphPass& addComputePass(const char* name);
+
+	void compile();
+
+	void execute(VkCommandBuffer commandBuffer);
+
+	// Valid after compile, VK_NULL_HANDLE for culled and compute passes. Compiling the same declarations again gives
+	// compatible render passes, so pipelines created against them can be kept.
+	VkRenderPass getRenderPass(const RenderGraphPass& pass) const;
+
+	uint32_t getSubpass(const RenderGraphPass& pass) const;
+
+	bool isCulled(const RenderGraphPass& pass) const;
+
+	VkImage getImage(RenderGraphImage image) const { return this->images[image.index].image; }
+
+	VkImageView getImageView(RenderGraphImage image) const { return this->images[image.index].view; }
+
+	VkBuffer getBuffer(RenderGraphBuffer buffer) const { return this->buffers[buffer.index].buffer; }
+
+	const RenderGraphStats& getStats() const { return this->stats; }
+
+private:
+	struct ImageResource {
+		const char* name;
+		RenderGraphImageInfo info;
+		bool imported;
+		VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImage image = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		// Derived by compile
+		VkImageUsageFlags usage = 0;
+		uint32_t firstStep = UINT32_MAX;
+		uint32_t lastStep = 0;
+		bool lazy = false;
+		uint32_t aliasPredecessor = UINT32_MAX; // Image last using the same memory before this one, possibly in the previous frame
+		VkMemoryRequirements requirements{};
+	};
+
+	struct BufferResource {
+		const char* name;
+		VkBuffer buffer;
+	};
+
+	// How a step accesses a resource, over all its passes
+	struct StepAccess {
+		VkImageLayout firstLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkImageLayout lastLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags stages = 0;
+		VkAccessFlags access = 0;
+		VkPipelineStageFlags writeStages = 0;
+		VkAccessFlags writeAccess = 0;
+		VkPipelineStageFlags readStages = 0;
+		bool write = false;
+	};
+
+	// Synchronization state of a resource between steps
+	struct ResourceState {
+		VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags writeStages = 0;
+		VkAccessFlags writeAccess = 0;
+		VkPipelineStageFlags readStages = 0; // Since the last write
+		VkPipelineStageFlags visibleStages = 0; // Reached by a barrier since the last write
+		VkAccessFlags visibleAccess = 0;
+	};
+
+	struct ImageBarrier {
+		uint32_t image;
+		VkImageLayout oldLayout;
+		VkImageLayout newLayout;
+		VkAccessFlags srcAccess;
+		VkAccessFlags dstAccess;
+	};
+
+	struct BarrierBatch {
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+		VkAccessFlags memorySrcAccess = 0; // Global memory barrier, for buffers and images keeping their layout
+		VkAccessFlags memoryDstAccess = 0;
+		std::vector<ImageBarrier> imageBarriers;
+	};
+
+	// A compute pass, or graphics passes recorded as the subpasses of one render pass
+	struct Step {
+		std::vector<uint32_t> passes;
+		bool renderPass = false;
+		VkExtent2D extent = { 0, 0 };
+		BarrierBatch barriers; // Recorded before the step
+		VkRenderPass handle = VK_NULL_HANDLE;
+		std::vector<uint32_t> attachments; // Image indices, in attachment order
+		std::vector<VkClearValue> clearValues;
+		std::map<std::vector<VkImageView>, VkFramebuffer> framebuffers; // By attachment views, imported ones vary
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceProfile* profile = nullptr;
+	DeviceMemoryAllocator* allocator = nullptr;
+	DeferredDeletionQueue* deletionQueue = nullptr;
+
+	std::vector<ImageResource> images;
+	std::vector<BufferResource> buffers;
+	std::deque<RenderGraphPass> passes;
+
+	bool compiled = false;
+	std::vector<Step> steps;
+	BarrierBatch finalBarriers; // Imported images to their final layout
+	std::vector<uint32_t> passSteps; // Step of each pass, UINT32_MAX when culled
+	std::vector<uint32_t> passSubpasses;
+	std::vector<MemoryAllocation> allocations;
+	RenderGraphStats stats;
+
+	std::vector<VkImageMemoryBarrier> imageBarrierScratch;
+	std::vector<VkImageView> viewScratch;
+
+	std::vector<bool> cullPasses();
+
+	void buildSteps(const std::vector<bool>& alive);
+
+	bool canMerge(const Step& step, const RenderGraphPass& pass) const;
+
+	VkExtent2D getPassExtent(const RenderGraphPass& pass) const;
+
+	void createTransientImages();
+
+	void createRenderPass(uint32_t stepIndex);
+
+	// Walks the steps once per call, with the state transient images are left in by the previous frame
+	void computeBarriers(std::vector<ResourceState>& imageStates, bool record);
+
+	void addBarrier(ResourceState& state, const StepAccess& access, bool isImage, uint32_t resource, BarrierBatch& batch);
+
+	void recordBarriers(VkCommandBuffer commandBuffer, const BarrierBatch& batch);
+
+	VkFramebuffer getFramebuffer(Step& step);
+
+	VkImageLayout getLayout(const RenderGraphPass::Use& use) const;
+
+	void retireCompiled();
+};
@@ -0,0 +1,129 @@
+#include "ResidencyManager.hpp"
+#include "CpuTrace.hpp"
+
+#include <algorithm>
+
+void ResidencyManager::init(MemoryBudget& budget, DeferredDeletionQueue& deletionQueue, float targetFraction, uint32_t protectedFrames) {
+	this->budget = &budget;
+	this->deletionQueue = &deletionQueue;
+	this->targetFraction = targetFraction;
+	this->protectedFrames = protectedFrames;
+	this->pendingBytes.assign(budget.getHeapCount(), 0);
+	this->stats = ResidencyStats{};
+}
+
+void ResidencyManager::cleanup() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->resources.clear();
+	this->freeHandles.clear();
+}
+
+ResidencyManager::Handle ResidencyManager::add(uint32_t memoryTypeIndex, VkDeviceSize size, ResidencyCallbacks callbacks, uint64_t frameNumber) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Handle handle;
+	if (!this->freeHandles.empty()) {
+		handle = this->freeHandles.back();
+		this->freeHandles.pop_back();
+	}
+	else {
+		handle = static_cast<Handle>(this->resources.size());
+		this->resources.emplace_back();
+	}
+
+	Resource& resource = this->resources[handle];
+	resource.heapIndex = this->budget->getHeapIndex(memoryTypeIndex);
+	resource.size = size;
+	resource.lastUsed = frameNumber;
+	resource.callbacks = std::move(callbacks);
+	resource.live = true;
+	this->stats.resources++;
+	return handle;
+}
+
+void ResidencyManager::remove(Handle handle) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->resources[handle] = Resource{};
+	this->freeHandles.push_back(handle);
+	this->stats.resources--;
+}
+
+void ResidencyManager::touch(Handle handle, uint64_t frameNumber) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Resource& resource = this->resources[handle];
+	resource.lastUsed = std::max(resource.lastUsed, frameNumber);
+}
+
+VkDeviceSize ResidencyManager::update(uint64_t frameNumber) {
+	CPU_TRACE_ZONE("Update residency");
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	VkDeviceSize released = 0;
+	for (uint32_t i = 0; i < this->budget->getHeapCount(); i++) {
+		const HeapBudget& heap = this->budget->getHeap(i);
+		const VkDeviceSize target = static_cast<VkDeviceSize>(heap.budget * this->targetFraction);
+		// What the deletion queue is about to free is still counted in the usage, and so is what it already freed since
+		// the blocks it was suballocated from stay allocated. Without discounting both, every frame would see the same
+		// excess and evict again.
+		const VkDeviceSize reclaimable = this->pendingBytes[i] + heap.freeBlockBytes;
+		const VkDeviceSize usage = heap.usage - std::min(heap.usage, reclaimable);
+		if (usage > target) {
+			released += release(i, usage - target, frameNumber);
+		}
+	}
+	return released;
+}
+
+ResidencyStats ResidencyManager::getStats() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	ResidencyStats result = this->stats;
+	for (VkDeviceSize bytes : this->pendingBytes) {
+		result.pendingBytes += bytes;
+	}
+	return result;
+}
+
+VkDeviceSize ResidencyManager::release(uint32_t heapIndex, VkDeviceSize excess, uint64_t frameNumber) {
+	std::vector<Handle> candidates;
+	for (Handle handle = 0; handle < this->resources.size(); handle++) {
+		const Resource& resource = this->resources[handle];
+		if (resource.live && resource.heapIndex == heapIndex && resource.lastUsed + this->protectedFrames <= frameNumber) {
+			candidates.push_back(handle);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](Handle a, Handle b) {
+		return this->resources[a].lastUsed < this->resources[b].lastUsed;
+	});
+
+	VkDeviceSize released = 0;
+	for (Handle handle : candidates) {
+		if (released >= excess) {
+			break;
+		}
+
+		Resource& resource = this->resources[handle];
+		VkDeviceSize bytes = resource.callbacks.downscale ? resource.callbacks.downscale() : 0;
+		if (bytes > 0) {
+			resource.size -= std::min(resource.size, bytes);
+			this->stats.downscales++;
+		}
+		else {
+			bytes = resource.callbacks.evict();
+			resource = Resource{};
+			this->freeHandles.push_back(handle);
+			this->stats.resources--;
+			this->stats.evictions++;
+		}
+		released += bytes;
+	}
+
+	if (released > 0) {
+		this->stats.releasedBytes += released;
+		this->pendingBytes[heapIndex] += released;
+		// Batched with the objects the callbacks just retired, so this runs once they are destroyed
+		this->deletionQueue->retire([this, heapIndex, released]() {
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->pendingBytes[heapIndex] -= std::min(this->pendingBytes[heapIndex], released);
+		});
+	}
+	return released;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <mutex>
+#include <functional>
+
+#include "MemoryBudget.hpp"
+#include "DeferredDeletionQueue.hpp"
+
+// The owner of a streamed resource releases its memory through these, retiring the objects to the deletion queue
+struct ResidencyCallbacks {
+	// Destroys the resource, returns the bytes released. The handle is invalid afterwards.
+	std::function<VkDeviceSize()> evict;
+	// Optional, replaces the resource with a smaller version (without its top mip level for instance). Returns the
+	// bytes released, 0 once it cannot shrink anymore.
+	std::function<VkDeviceSize()> downscale;
+};
+
+struct ResidencyStats {
+	uint32_t resources = 0;
+	uint32_t evictions = 0; // Since init
+	uint32_t downscales = 0;
+	VkDeviceSize releasedBytes = 0;
+	VkDeviceSize pendingBytes = 0; // Released but still waiting in the deletion queue
+};
+
+// Keeps every heap under targetFraction of its budget by releasing the least recently used streamed resources.
+// Resources are registered with their size and heap and touched by the frames using them. When a heap is over its
+// target, update downscales the least recently used ones that can shrink and evicts the others, oldest first,
+// until the excess is covered. Resources used in the last protectedFrames frames are left alone.
+// Released memory only leaves the heap once the deletion queue destroys it, and even then it stays in the allocator's
+// blocks as free space: update counts both as available.
+// add, remove and touch are thread safe. update must run on the thread calling the deletion queue's collect, the
+// callbacks are called from it and must not call the manager.
+class ResidencyManager
+{
+public:
+	using Handle = uint32_t;
+
+	void init(MemoryBudget& budget, DeferredDeletionQueue& deletionQueue, float targetFraction = 0.85f, uint32_t protectedFrames = 2);
+
+	void cleanup();
+
+	void setTargetFraction(float targetFraction) { this->targetFraction = targetFraction; }
+
+	// memoryTypeIndex of the resource's allocation
+	Handle add(uint32_t memoryTypeIndex, VkDeviceSize size, ResidencyCallbacks callbacks, uint64_t frameNumber);
+
+	// For resources destroyed by their owner, the callbacks are not called
+	void remove(Handle handle);
+
+	// Marks the resource as used by the frame being recorded
+	void touch(Handle handle, uint64_t frameNumber);
+
+	// Releases resources of the heaps over their target, call after MemoryBudget::update. Returns the bytes released.
+	VkDeviceSize update(uint64_t frameNumber);
+
+	ResidencyStats getStats();
+
+private:
+	struct Resource {
+		uint32_t heapIndex = 0;
+		VkDeviceSize size = 0;
+		uint64_t lastUsed = 0;
+		ResidencyCallbacks callbacks;
+		bool live = false;
+	};
+
+	MemoryBudget* budget = nullptr;
+	DeferredDeletionQueue* deletionQueue = nullptr;
+	float targetFraction = 0.85f;
+	uint32_t protectedFrames = 2;
+	std::vector<Resource> resources; // By handle
+	std::vector<Handle> freeHandles;
+	std::vector<VkDeviceSize> pendingBytes; // By heap
+	ResidencyStats stats;
+	std::mutex mutex;
+
+	// Releases up to excess bytes of heapIndex, callers hold mutex
+	VkDeviceSize release(uint32_t heapIndex, VkDeviceSize excess, uint64_t frameNumber);
+};
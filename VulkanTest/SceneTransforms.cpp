@@ -0,0 +1,477 @@
+#include "SceneTransforms.hpp"
+
+#include <cmath>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SCENE_TRANSFORMS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SCENE_TRANSFORMS_NEON
+#include <arm_neon.h>
+#endif
+
+// AVX2 kernels are compiled for AVX2 whatever the compiler flags, they only run when detectSimdLevel found it
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define TARGET_AVX2
+#endif
+
+namespace {
+	struct LocalArrays {
+		const float* rotationX;
+		const float* rotationY;
+		const float* rotationZ;
+		const float* rotationW;
+		const float* scales;
+		float* local[9];
+	};
+
+	struct SphereArrays {
+		const float* x;
+		const float* y;
+		const float* z;
+		const float* radius;
+	};
+
+	inline uint32_t countTrailingZeros(uint32_t value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+		unsigned long index;
+		_BitScanForward(&index, value);
+		return index;
+#else
+		return __builtin_ctz(value);
+#endif
+	}
+
+	// Rotation matrix of a unit quaternion, times the scale
+	void computeLocalScalar(const LocalArrays& arrays, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			const float x = arrays.rotationX[i], y = arrays.rotationY[i], z = arrays.rotationZ[i], w = arrays.rotationW[i];
+			const float s = arrays.scales[i];
+			const float xx = x * x * 2.0f, yy = y * y * 2.0f, zz = z * z * 2.0f;
+			const float xy = x * y * 2.0f, xz = x * z * 2.0f, yz = y * z * 2.0f;
+			const float wx = w * x * 2.0f, wy = w * y * 2.0f, wz = w * z * 2.0f;
+
+			arrays.local[0][i] = (1.0f - (yy + zz)) * s;
+			arrays.local[1][i] = (xy + wz) * s;
+			arrays.local[2][i] = (xz - wy) * s;
+			arrays.local[3][i] = (xy - wz) * s;
+			arrays.local[4][i] = (1.0f - (xx + zz)) * s;
+			arrays.local[5][i] = (yz + wx) * s;
+			arrays.local[6][i] = (xz + wy) * s;
+			arrays.local[7][i] = (yz - wx) * s;
+			arrays.local[8][i] = (1.0f - (xx + yy)) * s;
+		}
+	}
+
+	uint32_t* cullScalar(const SphereArrays& spheres, const Frustum& frustum, size_t begin, size_t end, uint32_t* visible) {
+		for (size_t i = begin; i < end; i++) {
+			bool inside = true;
+			for (const auto& plane : frustum.planes) {
+				inside &= plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w + spheres.radius[i] >= 0.0f;
+			}
+			if (inside) {
+				*visible++ = static_cast<uint32_t>(i);
+			}
+		}
+		return visible;
+	}
+
+#ifdef SCENE_TRANSFORMS_X86
+	void computeLocalSse2(const LocalArrays& arrays, size_t count) {
+		const __m128 one = _mm_set1_ps(1.0f);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const __m128 x = _mm_loadu_ps(arrays.rotationX + i), y = _mm_loadu_ps(arrays.rotationY + i);
+			const __m128 z = _mm_loadu_ps(arrays.rotationZ + i), w = _mm_loadu_ps(arrays.rotationW + i);
+			const __m128 s = _mm_loadu_ps(arrays.scales + i);
+			const __m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+			const __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+			const __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+			const __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+
+			_mm_storeu_ps(arrays.local[0] + i, _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), s));
+			_mm_storeu_ps(arrays.local[1] + i, _mm_mul_ps(_mm_add_ps(xy, wz), s));
+			_mm_storeu_ps(arrays.local[2] + i, _mm_mul_ps(_mm_sub_ps(xz, wy), s));
+			_mm_storeu_ps(arrays.local[3] + i, _mm_mul_ps(_mm_sub_ps(xy, wz), s));
+			_mm_storeu_ps(arrays.local[4] + i, _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), s));
+			_mm_storeu_ps(arrays.local[5] + i, _mm_mul_ps(_mm_add_ps(yz, wx), s));
+			_mm_storeu_ps(arrays.local[6] + i, _mm_mul_ps(_mm_add_ps(xz, wy), s));
+			_mm_storeu_ps(arrays.local[7] + i, _mm_mul_ps(_mm_sub_ps(yz, wx), s));
+			_mm_storeu_ps(arrays.local[8] + i, _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), s));
+		}
+		computeLocalScalar(arrays, i, count);
+	}
+
+	TARGET_AVX2 void computeLocalAvx2(const LocalArrays& arrays, size_t count) {
+		const __m256 one = _mm256_set1_ps(1.0f);
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m256 x = _mm256_loadu_ps(arrays.rotationX + i), y = _mm256_loadu_ps(arrays.rotationY + i);
+			const __m256 z = _mm256_loadu_ps(arrays.rotationZ + i), w = _mm256_loadu_ps(arrays.rotationW + i);
+			const __m256 s = _mm256_loadu_ps(arrays.scales + i);
+			const __m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+			const __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+			const __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+
+			_mm256_storeu_ps(arrays.local[0] + i, _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), s));
+			_mm256_storeu_ps(arrays.local[1] + i, _mm256_mul_ps(_mm256_fmadd_ps(w, z2, xy), s));
+			_mm256_storeu_ps(arrays.local[2] + i, _mm256_mul_ps(_mm256_fnmadd_ps(w, y2, xz), s));
+			_mm256_storeu_ps(arrays.local[3] + i, _mm256_mul_ps(_mm256_fnmadd_ps(w, z2, xy), s));
+			_mm256_storeu_ps(arrays.local[4] + i, _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), s));
+			_mm256_storeu_ps(arrays.local[5] + i, _mm256_mul_ps(_mm256_fmadd_ps(w, x2, yz), s));
+			_mm256_storeu_ps(arrays.local[6] + i, _mm256_mul_ps(_mm256_fmadd_ps(w, y2, xz), s));
+			_mm256_storeu_ps(arrays.local[7] + i, _mm256_mul_ps(_mm256_fnmadd_ps(w, x2, yz), s));
+			_mm256_storeu_ps(arrays.local[8] + i, _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), s));
+		}
+		computeLocalScalar(arrays, i, count);
+	}
+
+	uint32_t* cullSse2(const SphereArrays& spheres, const Frustum& frustum, size_t count, uint32_t* visible) {
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int p = 0; p < 6; p++) {
+			planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+		}
+
+		const __m128 zero = _mm_setzero_ps();
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const __m128 x = _mm_loadu_ps(spheres.x + i), y = _mm_loadu_ps(spheres.y + i), z = _mm_loadu_ps(spheres.z + i);
+			const __m128 radius = _mm_loadu_ps(spheres.radius + i);
+
+			__m128 inside = _mm_cmpeq_ps(zero, zero);
+			for (int p = 0; p < 6; p++) {
+				__m128 distance = _mm_add_ps(_mm_mul_ps(x, planeX[p]), _mm_mul_ps(y, planeY[p]));
+				distance = _mm_add_ps(distance, _mm_add_ps(_mm_mul_ps(z, planeZ[p]), _mm_add_ps(planeW[p], radius)));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, zero));
+			}
+
+			// Compaction: one index per set bit
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+			while (mask != 0) {
+				*visible++ = static_cast<uint32_t>(i) + countTrailingZeros(mask);
+				mask &= mask - 1;
+			}
+		}
+		return cullScalar(spheres, frustum, i, count, visible);
+	}
+
+	TARGET_AVX2 uint32_t* cullAvx2(const SphereArrays& spheres, const Frustum& frustum, size_t count, uint32_t* visible) {
+		__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int p = 0; p < 6; p++) {
+			planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+		}
+
+		const __m256 zero = _mm256_setzero_ps();
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8) {
+			const __m256 x = _mm256_loadu_ps(spheres.x + i), y = _mm256_loadu_ps(spheres.y + i), z = _mm256_loadu_ps(spheres.z + i);
+			const __m256 radius = _mm256_loadu_ps(spheres.radius + i);
+
+			__m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+			for (int p = 0; p < 6; p++) {
+				const __m256 distance = _mm256_fmadd_ps(x, planeX[p], _mm256_fmadd_ps(y, planeY[p], _mm256_fmadd_ps(z, planeZ[p], _mm256_add_ps(planeW[p], radius))));
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_GE_OQ));
+			}
+
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+			while (mask != 0) {
+				*visible++ = static_cast<uint32_t>(i) + countTrailingZeros(mask);
+				mask &= mask - 1;
+			}
+		}
+		return cullScalar(spheres, frustum, i, count, visible);
+	}
+#endif
+
+#ifdef SCENE_TRANSFORMS_NEON
+	void computeLocalNeon(const LocalArrays& arrays, size_t count) {
+		const float32x4_t one = vdupq_n_f32(1.0f);
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const float32x4_t x = vld1q_f32(arrays.rotationX + i), y = vld1q_f32(arrays.rotationY + i);
+			const float32x4_t z = vld1q_f32(arrays.rotationZ + i), w = vld1q_f32(arrays.rotationW + i);
+			const float32x4_t s = vld1q_f32(arrays.scales + i);
+			const float32x4_t x2 = vaddq_f32(x, x), y2 = vaddq_f32(y, y), z2 = vaddq_f32(z, z);
+			const float32x4_t xx = vmulq_f32(x, x2), yy = vmulq_f32(y, y2), zz = vmulq_f32(z, z2);
+			const float32x4_t xy = vmulq_f32(x, y2), xz = vmulq_f32(x, z2), yz = vmulq_f32(y, z2);
+
+			vst1q_f32(arrays.local[0] + i, vmulq_f32(vsubq_f32(one, vaddq_f32(yy, zz)), s));
+			vst1q_f32(arrays.local[1] + i, vmulq_f32(vfmaq_f32(xy, w, z2), s));
+			vst1q_f32(arrays.local[2] + i, vmulq_f32(vfmsq_f32(xz, w, y2), s));
+			vst1q_f32(arrays.local[3] + i, vmulq_f32(vfmsq_f32(xy, w, z2), s));
+			vst1q_f32(arrays.local[4] + i, vmulq_f32(vsubq_f32(one, vaddq_f32(xx, zz)), s));
+			vst1q_f32(arrays.local[5] + i, vmulq_f32(vfmaq_f32(yz, w, x2), s));
+			vst1q_f32(arrays.local[6] + i, vmulq_f32(vfmaq_f32(xz, w, y2), s));
+			vst1q_f32(arrays.local[7] + i, vmulq_f32(vfmsq_f32(yz, w, x2), s));
+			vst1q_f32(arrays.local[8] + i, vmulq_f32(vsubq_f32(one, vaddq_f32(xx, yy)), s));
+		}
+		computeLocalScalar(arrays, i, count);
+	}
+
+	uint32_t* cullNeon(const SphereArrays& spheres, const Frustum& frustum, size_t count, uint32_t* visible) {
+		const uint32x4_t laneBits = { 1, 2, 4, 8 };
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4) {
+			const float32x4_t x = vld1q_f32(spheres.x + i), y = vld1q_f32(spheres.y + i), z = vld1q_f32(spheres.z + i);
+			const float32x4_t radius = vld1q_f32(spheres.radius + i);
+
+			uint32x4_t inside = vdupq_n_u32(UINT32_MAX);
+			for (const auto& plane : frustum.planes) {
+				float32x4_t distance = vaddq_f32(vdupq_n_f32(plane.w), radius);
+				distance = vfmaq_n_f32(distance, x, plane.x);
+				distance = vfmaq_n_f32(distance, y, plane.y);
+				distance = vfmaq_n_f32(distance, z, plane.z);
+				inside = vandq_u32(inside, vcgeq_f32(distance, vdupq_n_f32(0.0f)));
+			}
+
+			uint32_t mask = vaddvq_u32(vandq_u32(inside, laneBits));
+			while (mask != 0) {
+				*visible++ = static_cast<uint32_t>(i) + countTrailingZeros(mask);
+				mask &= mask - 1;
+			}
+		}
+		return cullScalar(spheres, frustum, i, count, visible);
+	}
+#endif
+}
+
+SceneTransforms::SceneTransforms() : simdLevel(detectSimdLevel()) {
+}
+
+SimdLevel SceneTransforms::detectSimdLevel() {
+#if defined(SCENE_TRANSFORMS_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7) {
+		__cpuid(info, 1);
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		__cpuidex(info, 7, 0);
+		const bool avx2 = (info[1] & (1 << 5)) != 0;
+		// The OS must also save the AVX registers
+		if (fma && osxsave && avx2 && (_xgetbv(0) & 6) == 6) {
+			return SimdLevel::Avx2;
+		}
+	}
+#else
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return SimdLevel::Avx2;
+	}
+#endif
+	return SimdLevel::Sse2; // Part of x86-64
+#elif defined(SCENE_TRANSFORMS_NEON)
+	return SimdLevel::Neon; // Part of AArch64
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+const char* SceneTransforms::getSimdLevelName(SimdLevel level) {
+	switch (level) {
+	case SimdLevel::Sse2: return "SSE2";
+	case SimdLevel::Avx2: return "AVX2";
+	case SimdLevel::Neon: return "NEON";
+	default: return "scalar";
+	}
+}
+
+SimdLevel SceneTransforms::setSimdLevel(SimdLevel level) {
+	const SimdLevel best = detectSimdLevel();
+	const bool supported = level == SimdLevel::Scalar || level == best || (level == SimdLevel::Sse2 && best == SimdLevel::Avx2);
+	this->simdLevel = supported ? level : best;
+	return this->simdLevel;
+}
+
+void SceneTransforms::reserve(size_t nodeCount) {
+	this->parents.reserve(nodeCount);
+	for (auto* array : { &this->positionX, &this->positionY, &this->positionZ, &this->rotationX, &this->rotationY, &this->rotationZ, &this->rotationW,
+		&this->scales, &this->sphereX, &this->sphereY, &this->sphereZ, &this->sphereRadius }) {
+		array->reserve(nodeCount);
+	}
+}
+
+void SceneTransforms::clear() {
+	this->parents.clear();
+	for (auto* array : { &this->positionX, &this->positionY, &this->positionZ, &this->rotationX, &this->rotationY, &this->rotationZ, &this->rotationW,
+		&this->scales, &this->sphereX, &this->sphereY, &this->sphereZ, &this->sphereRadius }) {
+		array->clear();
+	}
+}
+
+uint32_t SceneTransforms::addNode(uint32_t parent, const glm::vec3& position, const glm::quat& rotation, float scale, const glm::vec4& boundingSphere) {
+	const uint32_t node = static_cast<uint32_t>(this->parents.size());
+	this->parents.push_back(parent < node ? parent : NO_PARENT);
+	this->positionX.push_back(0.0f);
+	this->positionY.push_back(0.0f);
+	this->positionZ.push_back(0.0f);
+	this->rotationX.push_back(0.0f);
+	this->rotationY.push_back(0.0f);
+	this->rotationZ.push_back(0.0f);
+	this->rotationW.push_back(1.0f);
+	this->scales.push_back(1.0f);
+	setLocalTransform(node, position, rotation, scale);
+
+	this->sphereX.push_back(boundingSphere.x);
+	this->sphereY.push_back(boundingSphere.y);
+	this->sphereZ.push_back(boundingSphere.z);
+	// An infinitely negative radius fails every plane test, whatever the position
+	this->sphereRadius.push_back(boundingSphere.w < 0.0f ? -std::numeric_limits<float>::infinity() : boundingSphere.w);
+	return node;
+}
+
+void SceneTransforms::setLocalTransform(uint32_t node, const glm::vec3& position, const glm::quat& rotation, float scale) {
+	this->positionX[node] = position.x;
+	this->positionY[node] = position.y;
+	this->positionZ[node] = position.z;
+	this->rotationX[node] = rotation.x;
+	this->rotationY[node] = rotation.y;
+	this->rotationZ[node] = rotation.z;
+	this->rotationW[node] = rotation.w;
+	this->scales[node] = scale;
+}
+
+void SceneTransforms::updateWorld() {
+	const size_t count = size();
+	for (auto& array : this->local) {
+		array.resize(count);
+	}
+	this->worldMatrices.resize(count);
+	this->worldScales.resize(count);
+	this->worldSphereX.resize(count);
+	this->worldSphereY.resize(count);
+	this->worldSphereZ.resize(count);
+	this->worldSphereRadius.resize(count);
+
+	computeLocalMatrices();
+	composeWorldMatrices();
+}
+
+void SceneTransforms::computeLocalMatrices() {
+	LocalArrays arrays = { this->rotationX.data(), this->rotationY.data(), this->rotationZ.data(), this->rotationW.data(), this->scales.data(), {} };
+	for (int i = 0; i < 9; i++) {
+		arrays.local[i] = this->local[i].data();
+	}
+
+	switch (this->simdLevel) {
+#ifdef SCENE_TRANSFORMS_X86
+	case SimdLevel::Sse2: computeLocalSse2(arrays, size()); break;
+	case SimdLevel::Avx2: computeLocalAvx2(arrays, size()); break;
+#endif
+#ifdef SCENE_TRANSFORMS_NEON
+	case SimdLevel::Neon: computeLocalNeon(arrays, size()); break;
+#endif
+	default: computeLocalScalar(arrays, 0, size()); break;
+	}
+}
+
+// Parents come first, so a single pass in index order sees every parent already done. Each node depends on its
+// parent, which rules out processing several nodes at once: the vector units work on the 4 rows of a column instead.
+void SceneTransforms::composeWorldMatrices() {
+	static const glm::mat4 identity(1.0f);
+	const size_t count = size();
+
+	for (size_t i = 0; i < count; i++) {
+		const bool root = this->parents[i] == NO_PARENT;
+		const glm::mat4& parent = root ? identity : this->worldMatrices[this->parents[i]];
+		const float parentScale = root ? 1.0f : this->worldScales[this->parents[i]];
+		glm::mat4& world = this->worldMatrices[i];
+		// Columns of the local matrix
+		const float columns[4][4] = {
+			{ this->local[0][i], this->local[1][i], this->local[2][i], 0.0f },
+			{ this->local[3][i], this->local[4][i], this->local[5][i], 0.0f },
+			{ this->local[6][i], this->local[7][i], this->local[8][i], 0.0f },
+			{ this->positionX[i], this->positionY[i], this->positionZ[i], 1.0f },
+		};
+		const float sphere[4] = { this->sphereX[i], this->sphereY[i], this->sphereZ[i], 1.0f };
+		float center[4];
+
+#if defined(SCENE_TRANSFORMS_X86)
+		if (this->simdLevel != SimdLevel::Scalar) {
+			const float* parentColumns = &parent[0][0];
+			const __m128 p0 = _mm_loadu_ps(parentColumns), p1 = _mm_loadu_ps(parentColumns + 4);
+			const __m128 p2 = _mm_loadu_ps(parentColumns + 8), p3 = _mm_loadu_ps(parentColumns + 12);
+			auto transform = [](__m128 c0, __m128 c1, __m128 c2, __m128 c3, const float* v) {
+				return _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(v[0])), _mm_mul_ps(c1, _mm_set1_ps(v[1]))),
+					_mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(v[2])), _mm_mul_ps(c3, _mm_set1_ps(v[3]))));
+			};
+			const __m128 w0 = transform(p0, p1, p2, p3, columns[0]), w1 = transform(p0, p1, p2, p3, columns[1]);
+			const __m128 w2 = transform(p0, p1, p2, p3, columns[2]), w3 = transform(p0, p1, p2, p3, columns[3]);
+			float* worldColumns = &world[0][0];
+			_mm_storeu_ps(worldColumns, w0);
+			_mm_storeu_ps(worldColumns + 4, w1);
+			_mm_storeu_ps(worldColumns + 8, w2);
+			_mm_storeu_ps(worldColumns + 12, w3);
+			_mm_storeu_ps(center, transform(w0, w1, w2, w3, sphere));
+		}
+		else
+#elif defined(SCENE_TRANSFORMS_NEON)
+		if (this->simdLevel != SimdLevel::Scalar) {
+			const float* parentColumns = &parent[0][0];
+			const float32x4_t p0 = vld1q_f32(parentColumns), p1 = vld1q_f32(parentColumns + 4);
+			const float32x4_t p2 = vld1q_f32(parentColumns + 8), p3 = vld1q_f32(parentColumns + 12);
+			auto transform = [](float32x4_t c0, float32x4_t c1, float32x4_t c2, float32x4_t c3, const float* v) {
+				return vfmaq_n_f32(vfmaq_n_f32(vfmaq_n_f32(vmulq_n_f32(c0, v[0]), c1, v[1]), c2, v[2]), c3, v[3]);
+			};
+			const float32x4_t w0 = transform(p0, p1, p2, p3, columns[0]), w1 = transform(p0, p1, p2, p3, columns[1]);
+			const float32x4_t w2 = transform(p0, p1, p2, p3, columns[2]), w3 = transform(p0, p1, p2, p3, columns[3]);
+			float* worldColumns = &world[0][0];
+			vst1q_f32(worldColumns, w0);
+			vst1q_f32(worldColumns + 4, w1);
+			vst1q_f32(worldColumns + 8, w2);
+			vst1q_f32(worldColumns + 12, w3);
+			vst1q_f32(center, transform(w0, w1, w2, w3, sphere));
+		}
+		else
+#endif
+		{
+			for (int column = 0; column < 4; column++) {
+				for (int row = 0; row < 4; row++) {
+					world[column][row] = parent[0][row] * columns[column][0] + parent[1][row] * columns[column][1]
+						+ parent[2][row] * columns[column][2] + parent[3][row] * columns[column][3];
+				}
+			}
+			for (int row = 0; row < 4; row++) {
+				center[row] = world[0][row] * sphere[0] + world[1][row] * sphere[1] + world[2][row] * sphere[2] + world[3][row];
+			}
+		}
+
+		this->worldScales[i] = parentScale * this->scales[i];
+		this->worldSphereX[i] = center[0];
+		this->worldSphereY[i] = center[1];
+		this->worldSphereZ[i] = center[2];
+		this->worldSphereRadius[i] = this->sphereRadius[i] * this->worldScales[i];
+	}
+}
+
+void SceneTransforms::cull(const Frustum& frustum, std::vector<uint32_t>& visible) const {
+	const SphereArrays spheres = { this->worldSphereX.data(), this->worldSphereY.data(), this->worldSphereZ.data(), this->worldSphereRadius.data() };
+	const size_t count = this->worldSphereX.size();
+	visible.resize(count);
+
+	uint32_t* end;
+	switch (this->simdLevel) {
+#ifdef SCENE_TRANSFORMS_X86
+	case SimdLevel::Sse2: end = cullSse2(spheres, frustum, count, visible.data()); break;
+	case SimdLevel::Avx2: end = cullAvx2(spheres, frustum, count, visible.data()); break;
+#endif
+#ifdef SCENE_TRANSFORMS_NEON
+	case SimdLevel::Neon: end = cullNeon(spheres, frustum, count, visible.data()); break;
+#endif
+	default: end = cullScalar(spheres, frustum, 0, count, visible.data()); break;
+	}
+	visible.resize(end - visible.data());
+}
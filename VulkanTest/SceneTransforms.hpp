@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "Frustum.hpp"
+
+// Instruction sets of the SceneTransforms kernels, in order of preference within an architecture
+enum class SimdLevel {
+	Scalar,
+	Sse2,
+	Avx2, // With FMA
+	Neon,
+};
+
+// Transform hierarchy and bounding spheres of a scene in structure of arrays form: every component of every node is
+// stored contiguously, so the kernels stream through exactly the data they need and process 4 (SSE2, NEON) or
+// 8 (AVX2) nodes per instruction. The instruction set is detected at runtime, setSimdLevel overrides it.
+// Nodes are referenced by the index returned by addNode. Parents must be added before their children, world matrices
+// are then computed in a single pass in index order. Scale is uniform, which keeps bounding spheres spheres.
+class SceneTransforms
+{
+public:
+	static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+	SceneTransforms();
+
+	static SimdLevel detectSimdLevel();
+
+	static const char* getSimdLevelName(SimdLevel level);
+
+	// Levels the machine does not support fall back to the best supported one, returns the level actually used
+	SimdLevel setSimdLevel(SimdLevel level);
+
+	SimdLevel getSimdLevel() const { return this->simdLevel; }
+
+	void reserve(size_t nodeCount);
+
+	void clear();
+
+	size_t size() const { return this->parents.size(); }
+
+	// boundingSphere is the center in node space and the radius, a negative radius marks a node without geometry (a pivot), never visible
+	uint32_t addNode(uint32_t parent, const glm::vec3& position, const glm::quat& rotation, float scale, const glm::vec4& boundingSphere);
+
+	void setLocalTransform(uint32_t node, const glm::vec3& position, const glm::quat& rotation, float scale);
+
+	// Smallest sphere around an axis aligned box, for meshes whose bounds are stored as boxes
+	static glm::vec4 sphereFromAabb(const glm::vec3& min, const glm::vec3& max) {
+		return glm::vec4((min + max) * 0.5f, glm::length(max - min) * 0.5f);
+	}
+
+	// Recomputes every world matrix and world bounding sphere from the local transforms
+	void updateWorld();
+
+	// Indices of the nodes whose world bounding sphere intersects frustum, in increasing order. Uses the spheres of
+	// the last updateWorld.
+	void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+	// Column major, ready to be copied to GPU buffers (GpuCulling::getTransforms for instance)
+	const glm::mat4* getWorldMatrices() const { return this->worldMatrices.data(); }
+
+	const glm::mat4& getWorldMatrix(uint32_t node) const { return this->worldMatrices[node]; }
+
+private:
+	SimdLevel simdLevel;
+
+	std::vector<uint32_t> parents;
+	// Local transforms
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+	std::vector<float> scales;
+	// Bounding spheres in node space
+	std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+	// Upper 3x3 of the local matrices, rotation times scale, column major: local[column * 3 + row]
+	std::vector<float> local[9];
+	// Results of updateWorld
+	std::vector<glm::mat4> worldMatrices;
+	std::vector<float> worldScales;
+	std::vector<float> worldSphereX, worldSphereY, worldSphereZ, worldSphereRadius;
+
+	void computeLocalMatrices();
+
+	void composeWorldMatrices();
+};
@@ -0,0 +1,404 @@
+#include "StagingUploader.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// Staging offsets are 16 byte aligned, which satisfies vkCmdCopyBufferToImage for every block compressed format
+static const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+void StagingUploader::init(VkDevice device, DeviceMemoryAllocator& allocator, VkQueue transferQueue, uint32_t transferFamily, uint32_t graphicsFamily, VkDeviceSize ringSize) {
+	this->device = device;
+	this->allocator = &allocator;
+	this->transferQueue = transferQueue;
+	this->transferFamily = transferFamily;
+	this->graphicsFamily = graphicsFamily;
+	this->ringSize = ringSize;
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = ringSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(this->device, &bufferInfo, nullptr, &this->ringBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create staging ring buffer");
+	}
+	this->ringAllocation = this->allocator->allocateForBuffer(this->ringBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, AllocationStrategy::Dedicated);
+
+	for (auto& batch : this->batches) {
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		poolInfo.queueFamilyIndex = this->transferFamily;
+
+		if (vkCreateCommandPool(this->device, &poolInfo, nullptr, &batch.commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create upload command pool");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = batch.commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(this->device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate upload command buffer");
+		}
+
+		VkFenceCreateInfo fenceInfo{};
+		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+		if (vkCreateFence(this->device, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create upload fence");
+		}
+	}
+}
+
+void StagingUploader::cleanup() {
+	for (auto& batch : this->batches) {
+		vkDestroyFence(this->device, batch.fence, nullptr);
+		vkDestroyCommandPool(this->device, batch.commandPool, nullptr);
+		batch = Batch{};
+	}
+	this->pendingBatches.clear();
+
+	vkDestroyBuffer(this->device, this->ringBuffer, nullptr);
+	this->allocator->free(this->ringAllocation);
+}
+
+UploadToken StagingUploader::uploadBuffer(VkBuffer buffer, VkDeviceSize bufferOffset, const void* data, VkDeviceSize size) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	// Large buffers are streamed in chunks, so the ring never needs to be as large as the biggest asset
+	const char* source = static_cast<const char*>(data);
+	const VkDeviceSize maxChunkSize = this->ringSize / 4;
+
+	while (size > 0) {
+		VkDeviceSize chunkSize = std::min(size, maxChunkSize);
+		VkDeviceSize stagingOffset = allocateStaging(chunkSize, STAGING_ALIGNMENT);
+		memcpy(static_cast<char*>(this->ringAllocation.mappedData) + stagingOffset, source, chunkSize);
+
+		Batch& batch = beginBatch();
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = stagingOffset;
+		copyRegion.dstOffset = bufferOffset;
+		copyRegion.size = chunkSize;
+		vkCmdCopyBuffer(batch.commandBuffer, this->ringBuffer, buffer, 1, &copyRegion);
+
+		addBufferRelease(batch, buffer, bufferOffset, chunkSize);
+		batch.empty = false;
+
+		source += chunkSize;
+		bufferOffset += chunkSize;
+		size -= chunkSize;
+	}
+
+	// Earlier chunks may have gone out with full batches, the last one is still in the batch being recorded
+	return this->nextToken;
+}
+
+UploadToken StagingUploader::uploadImage(VkImage image, const VkImageSubresourceRange& range, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& regions, VkImageLayout finalLayout) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	VkDeviceSize stagingOffset = allocateStaging(size, STAGING_ALIGNMENT);
+	memcpy(static_cast<char*>(this->ringAllocation.mappedData) + stagingOffset, data, size);
+
+	Batch& batch = beginBatch();
+
+	VkImageMemoryBarrier toTransferDst{};
+	toTransferDst.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	toTransferDst.srcAccessMask = 0;
+	toTransferDst.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	toTransferDst.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	toTransferDst.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	toTransferDst.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransferDst.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransferDst.image = image;
+	toTransferDst.subresourceRange = range;
+	vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransferDst);
+
+	std::vector<VkBufferImageCopy> stagingRegions = regions;
+	for (auto& region : stagingRegions) {
+		region.bufferOffset += stagingOffset;
+	}
+	vkCmdCopyBufferToImage(batch.commandBuffer, this->ringBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(stagingRegions.size()), stagingRegions.data());
+
+	// The layout transition to finalLayout is part of the ownership transfer, release and acquire must both specify it
+	VkImageMemoryBarrier release{};
+	release.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	release.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	release.newLayout = finalLayout;
+	release.image = image;
+	release.subresourceRange = range;
+
+	if (hasDedicatedTransferQueue()) {
+		release.dstAccessMask = 0;
+		release.srcQueueFamilyIndex = this->transferFamily;
+		release.dstQueueFamilyIndex = this->graphicsFamily;
+
+		VkImageMemoryBarrier acquire = release;
+		acquire.srcAccessMask = 0;
+		acquire.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		batch.imageAcquires.push_back(acquire);
+	}
+	else {
+		release.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		release.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		release.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	}
+	batch.imageReleases.push_back(release);
+	batch.empty = false;
+	return this->nextToken;
+}
+
+UploadToken StagingUploader::flush() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	return submitCurrentBatch();
+}
+
+bool StagingUploader::isComplete(UploadToken token) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	retireCompletedBatches(false);
+	return token <= this->completedToken;
+}
+
+UploadToken StagingUploader::getNextToken() {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	return this->nextToken;
+}
+
+void StagingUploader::wait(UploadToken token) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	if (token > this->nextToken) {
+		throw std::runtime_error("Waiting for an upload token that was never handed out");
+	}
+	// Still in the batch being recorded, which would otherwise never complete
+	if (token == this->nextToken) {
+		submitCurrentBatch();
+	}
+
+	while (this->completedToken < token && !this->pendingBatches.empty()) {
+		retireCompletedBatches(true);
+	}
+}
+
+UploadToken StagingUploader::recordAcquireBarriers(VkCommandBuffer graphicsCommandBuffer) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	retireCompletedBatches(false);
+	if (this->readyBufferAcquires.empty() && this->readyImageAcquires.empty()) {
+		return this->completedToken;
+	}
+
+	// The transfer has already completed on the host side (its fence signaled), so there is nothing to wait for
+	vkCmdPipelineBarrier(
+		graphicsCommandBuffer,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+		0,
+		0, nullptr,
+		static_cast<uint32_t>(this->readyBufferAcquires.size()), this->readyBufferAcquires.data(),
+		static_cast<uint32_t>(this->readyImageAcquires.size()), this->readyImageAcquires.data()
+	);
+
+	this->readyBufferAcquires.clear();
+	this->readyImageAcquires.clear();
+	return this->completedToken;
+}
+
+void StagingUploader::forgetImage(VkImage image) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	auto forget = [image](std::vector<VkImageMemoryBarrier>& acquires) {
+		acquires.erase(std::remove_if(acquires.begin(), acquires.end(),
+			[image](const VkImageMemoryBarrier& acquire) { return acquire.image == image; }), acquires.end());
+	};
+	forget(this->readyImageAcquires);
+	for (auto& batch : this->batches) {
+		forget(batch.imageAcquires);
+	}
+}
+
+StagingUploader::Batch& StagingUploader::beginBatch() {
+	Batch& batch = this->batches[this->currentBatch];
+	if (batch.recording) {
+		return batch;
+	}
+
+	// The slot is reused BATCH_COUNT flushes later, its previous submission may still be in flight
+	while (std::find(this->pendingBatches.begin(), this->pendingBatches.end(), this->currentBatch) != this->pendingBatches.end()) {
+		retireCompletedBatches(true);
+	}
+
+	vkResetCommandPool(this->device, batch.commandPool, 0);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to begin recording upload command buffer");
+	}
+
+	batch.recording = true;
+	batch.empty = true;
+	return batch;
+}
+
+VkDeviceSize StagingUploader::allocateStaging(VkDeviceSize size, VkDeviceSize alignment) {
+	if (size + alignment >= this->ringSize) {
+		throw std::runtime_error("Upload does not fit in the staging ring");
+	}
+
+	VkDeviceSize offset = 0;
+	while (!tryAllocateStaging(size, alignment, offset)) {
+		if (this->pendingBatches.empty()) {
+			// Whatever is left in the ring belongs to the batch being recorded, send it off to make room
+			if (!this->batches[this->currentBatch].recording || this->batches[this->currentBatch].empty) {
+				throw std::runtime_error("Failed to allocate staging memory");
+			}
+			submitCurrentBatch();
+		}
+		retireCompletedBatches(true);
+	}
+
+	return offset;
+}
+
+bool StagingUploader::tryAllocateStaging(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+	// head == tail always means empty, the strict comparisons below keep the head from catching up with the tail
+	VkDeviceSize alignedHead = alignUp(this->ringHead, alignment);
+
+	if (this->ringHead >= this->ringTail) {
+		if (alignedHead + size <= this->ringSize) {
+			offset = alignedHead;
+			this->ringHead = alignedHead + size;
+			return true;
+		}
+		if (size < this->ringTail) {
+			offset = 0;
+			this->ringHead = size;
+			return true;
+		}
+		return false;
+	}
+
+	if (alignedHead + size < this->ringTail) {
+		offset = alignedHead;
+		this->ringHead = alignedHead + size;
+		return true;
+	}
+	return false;
+}
+
+UploadToken StagingUploader::submitCurrentBatch() {
+	Batch& batch = this->batches[this->currentBatch];
+	if (!batch.recording || batch.empty) {
+		return this->nextToken - 1;
+	}
+
+	// All release barriers of the batch go out in a single vkCmdPipelineBarrier
+	VkPipelineStageFlags dstStage = hasDedicatedTransferQueue() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	vkCmdPipelineBarrier(
+		batch.commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		dstStage,
+		0,
+		0, nullptr,
+		static_cast<uint32_t>(batch.bufferReleases.size()), batch.bufferReleases.data(),
+		static_cast<uint32_t>(batch.imageReleases.size()), batch.imageReleases.data()
+	);
+	batch.bufferReleases.clear();
+	batch.imageReleases.clear();
+
+	if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to record upload command buffer");
+	}
+
+	vkResetFences(this->device, 1, &batch.fence);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+	if (vkQueueSubmit(this->transferQueue, 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to submit upload command buffer");
+	}
+
+	batch.token = this->nextToken++;
+	batch.ringEnd = this->ringHead;
+	batch.recording = false;
+
+	this->pendingBatches.push_back(this->currentBatch);
+	this->currentBatch = (this->currentBatch + 1) % BATCH_COUNT;
+
+	return batch.token;
+}
+
+void StagingUploader::retireCompletedBatches(bool waitForOldest) {
+	while (!this->pendingBatches.empty()) {
+		Batch& batch = this->batches[this->pendingBatches.front()];
+
+		if (waitForOldest) {
+			vkWaitForFences(this->device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+			waitForOldest = false;
+		}
+		else if (vkGetFenceStatus(this->device, batch.fence) != VK_SUCCESS) {
+			break;
+		}
+
+		this->ringTail = batch.ringEnd;
+		this->completedToken = batch.token;
+
+		this->readyBufferAcquires.insert(this->readyBufferAcquires.end(), batch.bufferAcquires.begin(), batch.bufferAcquires.end());
+		this->readyImageAcquires.insert(this->readyImageAcquires.end(), batch.imageAcquires.begin(), batch.imageAcquires.end());
+		batch.bufferAcquires.clear();
+		batch.imageAcquires.clear();
+
+		this->pendingBatches.pop_front();
+	}
+
+	// Nothing in flight and nothing staged since: rewind, so the next upload gets the whole ring in one piece
+	if (this->pendingBatches.empty() && this->ringHead == this->ringTail) {
+		this->ringHead = 0;
+		this->ringTail = 0;
+	}
+}
+
+void StagingUploader::addBufferRelease(Batch& batch, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+	VkBufferMemoryBarrier release{};
+	release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	release.buffer = buffer;
+	release.offset = offset;
+	release.size = size;
+
+	if (hasDedicatedTransferQueue()) {
+		release.dstAccessMask = 0;
+		release.srcQueueFamilyIndex = this->transferFamily;
+		release.dstQueueFamilyIndex = this->graphicsFamily;
+
+		VkBufferMemoryBarrier acquire = release;
+		acquire.srcAccessMask = 0;
+		acquire.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		batch.bufferAcquires.push_back(acquire);
+	}
+	else {
+		release.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		release.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		release.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	}
+	batch.bufferReleases.push_back(release);
+}
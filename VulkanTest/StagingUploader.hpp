@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <mutex>
+
+#include "DeviceMemoryAllocator.hpp"
+
+// Identifies a flushed batch of uploads, tokens increase monotonically
+typedef uint64_t UploadToken;
+
+// Streams data to device local buffers and images through a persistently mapped staging ring, on the dedicated
+// transfer queue when the device has one. Uploads are batched into a single submission per flush().
+//
+// With a dedicated transfer family, resources change queue family ownership: the release half is recorded here and
+// the acquire half by recordAcquireBarriers() on the graphics queue, once the upload has completed. Resources must
+// not be used before isComplete() returns true for the token of their batch.
+// Without a dedicated family uploads go to the graphics queue, in that case flush() must be called from the
+// thread that submits frames since VkQueue access has to be externally synchronized.
+class StagingUploader
+{
+public:
+	static constexpr VkDeviceSize DEFAULT_RING_SIZE = 64ull * 1024 * 1024;
+	static constexpr uint32_t BATCH_COUNT = 4;
+
+	void init(VkDevice device, DeviceMemoryAllocator& allocator, VkQueue transferQueue, uint32_t transferFamily, uint32_t graphicsFamily, VkDeviceSize ringSize = DEFAULT_RING_SIZE);
+
+	void cleanup();
+
+	// Upload functions return the token the upload will complete with, once flushed
+	UploadToken uploadBuffer(VkBuffer buffer, VkDeviceSize bufferOffset, const void* data, VkDeviceSize size);
+
+	// The bufferOffset of each region is relative to data. The whole range ends up in finalLayout.
+	UploadToken uploadImage(VkImage image, const VkImageSubresourceRange& range, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& regions, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	// Submits everything recorded since the last flush, returns the token of that batch
+	UploadToken flush();
+
+	bool isComplete(UploadToken token);
+
+	// Lowest token an upload started from now on can return
+	UploadToken getNextToken();
+
+	// Flushes first when token belongs to the batch being recorded, the same threading rules as flush() apply then
+	void wait(UploadToken token);
+
+	// Records the acquire half of the queue family ownership transfers of every completed upload. Returns the last
+	// completed token: every upload up to it can be used after this point of graphicsCommandBuffer.
+	UploadToken recordAcquireBarriers(VkCommandBuffer graphicsCommandBuffer);
+
+	// Drops the acquire barriers still queued for image, call before destroying an image whose upload may not have
+	// been acquired yet
+	void forgetImage(VkImage image);
+
+	bool hasDedicatedTransferQueue() const { return this->transferFamily != this->graphicsFamily; }
+
+private:
+	struct Batch {
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		UploadToken token = 0;
+		VkDeviceSize ringEnd = 0; // Ring offset just past this batch's data, becomes the tail once it completes
+		bool recording = false;
+		bool empty = true;
+		std::vector<VkBufferMemoryBarrier> bufferReleases;
+		std::vector<VkImageMemoryBarrier> imageReleases;
+		std::vector<VkBufferMemoryBarrier> bufferAcquires;
+		std::vector<VkImageMemoryBarrier> imageAcquires;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceMemoryAllocator* allocator = nullptr;
+	VkQueue transferQueue = VK_NULL_HANDLE;
+	uint32_t transferFamily = 0;
+	uint32_t graphicsFamily = 0;
+
+	VkBuffer ringBuffer = VK_NULL_HANDLE;
+	MemoryAllocation ringAllocation;
+	VkDeviceSize ringSize = 0;
+	VkDeviceSize ringHead = 0; // Next free byte
+	VkDeviceSize ringTail = 0; // Oldest byte still in use by the GPU
+
+	Batch batches[BATCH_COUNT];
+	uint32_t currentBatch = 0;
+	std::deque<uint32_t> pendingBatches; // Submitted and not yet retired, oldest first
+	UploadToken nextToken = 1;
+	UploadToken completedToken = 0;
+	std::vector<VkBufferMemoryBarrier> readyBufferAcquires;
+	std::vector<VkImageMemoryBarrier> readyImageAcquires;
+	std::mutex mutex;
+
+	Batch& beginBatch();
+
+	VkDeviceSize allocateStaging(VkDeviceSize size, VkDeviceSize alignment);
+
+	bool tryAllocateStaging(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+
+	UploadToken submitCurrentBatch();
+
+	void retireCompletedBatches(bool waitForOldest);
+
+	void addBufferRelease(Batch& batch, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+};
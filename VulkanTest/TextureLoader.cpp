@@ -0,0 +1,734 @@
+#include "TextureLoader.hpp"
+
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <array>
+
+#include "BlockDecoder.hpp"
+
+#ifdef TEXTURE_LOADER_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+
+	enum Ktx2Supercompression : uint32_t {
+		SUPERCOMPRESSION_NONE = 0,
+		SUPERCOMPRESSION_BASIS_LZ = 1,
+		SUPERCOMPRESSION_ZSTD = 2,
+		SUPERCOMPRESSION_ZLIB = 3,
+	};
+
+	struct Ktx2Header {
+		uint8_t identifier[12];
+		uint32_t vkFormat;
+		uint32_t typeSize;
+		uint32_t pixelWidth;
+		uint32_t pixelHeight;
+		uint32_t pixelDepth;
+		uint32_t layerCount;
+		uint32_t faceCount;
+		uint32_t levelCount; // 0 asks the loader to generate the mip chain
+		uint32_t supercompressionScheme;
+		uint32_t dfdByteOffset;
+		uint32_t dfdByteLength;
+		uint32_t kvdByteOffset;
+		uint32_t kvdByteLength;
+		uint64_t sgdByteOffset;
+		uint64_t sgdByteLength;
+	};
+
+	struct Ktx2Level {
+		uint64_t byteOffset;
+		uint64_t byteLength;
+		uint64_t uncompressedByteLength;
+	};
+
+	static_assert(sizeof(Ktx2Header) == 80, "Ktx2Header must match the file layout");
+	static_assert(sizeof(Ktx2Level) == 24, "Ktx2Level must match the file layout");
+
+	bool isRgba8(VkFormat format) {
+		return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB
+			|| format == VK_FORMAT_B8G8R8A8_UNORM || format == VK_FORMAT_B8G8R8A8_SRGB;
+	}
+
+	bool isSrgb(VkFormat format) {
+		return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_B8G8R8A8_SRGB;
+	}
+
+	struct TexelBlock {
+		uint32_t width;
+		uint32_t height;
+		uint32_t size; // Bytes, 0 for formats the loader does not know
+	};
+
+	// The core VkFormat values of a family are contiguous, e.g. from R8_UNORM to R8_SRGB
+	TexelBlock getTexelBlock(VkFormat format) {
+		auto within = [format](VkFormat first, VkFormat last) { return format >= first && format <= last; };
+
+		if (format == VK_FORMAT_R4G4_UNORM_PACK8 || within(VK_FORMAT_R8_UNORM, VK_FORMAT_R8_SRGB)) {
+			return { 1, 1, 1 };
+		}
+		if (within(VK_FORMAT_R4G4B4A4_UNORM_PACK16, VK_FORMAT_A1R5G5B5_UNORM_PACK16) || within(VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8_SRGB)
+			|| within(VK_FORMAT_R16_UNORM, VK_FORMAT_R16_SFLOAT)) {
+			return { 1, 1, 2 };
+		}
+		if (within(VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_B8G8R8_SRGB)) {
+			return { 1, 1, 3 };
+		}
+		if (within(VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_A2B10G10R10_SINT_PACK32) || within(VK_FORMAT_R16G16_UNORM, VK_FORMAT_R16G16_SFLOAT)
+			|| within(VK_FORMAT_R32_UINT, VK_FORMAT_R32_SFLOAT) || within(VK_FORMAT_B10G11R11_UFLOAT_PACK32, VK_FORMAT_E5B9G9R9_UFLOAT_PACK32)) {
+			return { 1, 1, 4 };
+		}
+		if (within(VK_FORMAT_R16G16B16_UNORM, VK_FORMAT_R16G16B16_SFLOAT)) {
+			return { 1, 1, 6 };
+		}
+		if (within(VK_FORMAT_R16G16B16A16_UNORM, VK_FORMAT_R16G16B16A16_SFLOAT) || within(VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32_SFLOAT)
+			|| within(VK_FORMAT_R64_UINT, VK_FORMAT_R64_SFLOAT)) {
+			return { 1, 1, 8 };
+		}
+		if (within(VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32_SFLOAT)) {
+			return { 1, 1, 12 };
+		}
+		if (within(VK_FORMAT_R32G32B32A32_UINT, VK_FORMAT_R32G32B32A32_SFLOAT) || within(VK_FORMAT_R64G64_UINT, VK_FORMAT_R64G64_SFLOAT)) {
+			return { 1, 1, 16 };
+		}
+		if (within(VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGBA_SRGB_BLOCK) || within(VK_FORMAT_BC4_UNORM_BLOCK, VK_FORMAT_BC4_SNORM_BLOCK)
+			|| within(VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK) || within(VK_FORMAT_EAC_R11_UNORM_BLOCK, VK_FORMAT_EAC_R11_SNORM_BLOCK)) {
+			return { 4, 4, 8 };
+		}
+		if (within(VK_FORMAT_BC2_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK) || within(VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK)
+			|| within(VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK, VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK) || within(VK_FORMAT_EAC_R11G11_UNORM_BLOCK, VK_FORMAT_EAC_R11G11_SNORM_BLOCK)) {
+			return { 4, 4, 16 };
+		}
+		if (within(VK_FORMAT_ASTC_4x4_UNORM_BLOCK, VK_FORMAT_ASTC_12x12_SRGB_BLOCK)) {
+			// UNORM and SRGB pairs, in this order
+			const uint32_t ASTC_BLOCKS[14][2] = {
+				{ 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+				{ 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 },
+			};
+			const uint32_t* block = ASTC_BLOCKS[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+			return { block[0], block[1], 16 };
+		}
+		return { 0, 0, 0 };
+	}
+
+	// Bytes of a width x height level, partial blocks at the edges included
+	VkDeviceSize getLevelSize(const TexelBlock& block, uint32_t width, uint32_t height) {
+		return static_cast<VkDeviceSize>((width + block.width - 1) / block.width) * ((height + block.height - 1) / block.height) * block.size;
+	}
+
+	// Region offsets within the staging data must be multiples of the texel block size, 16 covers every format
+	VkDeviceSize alignLevel(VkDeviceSize offset) {
+		return (offset + 15) & ~VkDeviceSize(15);
+	}
+}
+
+uint32_t TextureLoader::getMipLevelCount(uint32_t width, uint32_t height) {
+	return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+}
+
+void TextureLoader::init(VkDevice device, DeviceProfile& profile, DeviceMemoryAllocator& allocator, StagingUploader& uploader, DeferredDeletionQueue& deletionQueue, ResidencyManager& residencyManager) {
+	this->device = device;
+	this->profile = &profile;
+	this->allocator = &allocator;
+	this->uploader = &uploader;
+	this->deletionQueue = &deletionQueue;
+	this->residencyManager = &residencyManager;
+}
+
+void TextureLoader::cleanup() {
+	// Images are owned by their textures, mips of textures destroyed before their upload completed are simply dropped
+	this->pendingMips.clear();
+
+	// Streamed textures are the loader's own, the device is idle by now
+	for (auto& entry : this->streamed) {
+		if (entry.live && entry.texture.image != VK_NULL_HANDLE) {
+			vkDestroyImageView(this->device, entry.texture.view, nullptr);
+			vkDestroyImage(this->device, entry.texture.image, nullptr);
+			this->allocator->free(entry.texture.allocation);
+		}
+	}
+	this->streamed.clear();
+	this->freeStreamedIds.clear();
+	this->pendingDownscales.clear();
+}
+
+bool TextureLoader::canBlitMips(VkFormat format) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (this->profile->getFormatProperties(format).optimalTilingFeatures & required) == required;
+}
+
+bool TextureLoader::canSample(VkFormat format) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	return (this->profile->getFormatProperties(format).optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+Texture TextureLoader::createTexture(const void* pixels, uint32_t width, uint32_t height, VkFormat format, bool generateMips) {
+	if (!isRgba8(format)) {
+		throw std::runtime_error("Textures created from pixels must be 8 bit RGBA or BGRA");
+	}
+
+	const VkDeviceSize size = static_cast<VkDeviceSize>(width) * height * 4;
+	const uint32_t mipLevels = generateMips ? getMipLevelCount(width, height) : 1;
+
+	if (mipLevels > 1 && canBlitMips(format)) {
+		Texture texture = createImage(format, width, height, mipLevels, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+		uploadForBlit(texture, pixels, size);
+		return texture;
+	}
+
+	Texture texture = createImage(format, width, height, mipLevels, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	if (mipLevels == 1) {
+		uploadLevels(texture, static_cast<const uint8_t*>(pixels), size, { 0 });
+	}
+	else {
+		std::vector<uint8_t> levels(static_cast<const uint8_t*>(pixels), static_cast<const uint8_t*>(pixels) + size);
+		std::vector<VkDeviceSize> levelOffsets = downsampleOnCpu(levels, width, height, mipLevels, isSrgb(format));
+		uploadLevels(texture, levels.data(), levels.size(), levelOffsets);
+	}
+	return texture;
+}
+
+Texture TextureLoader::loadKtx2(const std::string& path) {
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("Failed to open " + path);
+	}
+
+	std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(data.data()), data.size());
+
+	return loadKtx2(data.data(), data.size(), path);
+}
+
+Texture TextureLoader::loadKtx2(const uint8_t* data, size_t size, const std::string& name) {
+	Ktx2Header header;
+	if (size < sizeof(header) || memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+		throw std::runtime_error(name + " is not a KTX2 file");
+	}
+	memcpy(&header, data, sizeof(header));
+
+	VkFormat format = static_cast<VkFormat>(header.vkFormat);
+	if (format == VK_FORMAT_UNDEFINED) {
+		throw std::runtime_error(name + " holds Basis Universal data, which needs a transcoder");
+	}
+	if (header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 || header.layerCount > 1 || header.faceCount != 1) {
+		throw std::runtime_error("Only 2D KTX2 textures are supported, " + name + " is not one");
+	}
+
+	const uint32_t storedLevelCount = std::max(header.levelCount, 1u);
+	if (storedLevelCount > getMipLevelCount(header.pixelWidth, header.pixelHeight) || sizeof(header) + storedLevelCount * sizeof(Ktx2Level) > size) {
+		throw std::runtime_error(name + " is corrupted");
+	}
+	std::vector<Ktx2Level> levels(storedLevelCount);
+	memcpy(levels.data(), data + sizeof(header), storedLevelCount * sizeof(Ktx2Level));
+	for (const auto& level : levels) {
+		if (level.byteOffset > size || level.byteLength > size - level.byteOffset) {
+			throw std::runtime_error(name + " is corrupted");
+		}
+	}
+
+	const bool decode = !canSample(format);
+	if (decode && !BlockDecoder::canDecode(format)) {
+		throw std::runtime_error("The device cannot sample the format of " + name + " and there is no CPU decoder for it");
+	}
+	if (header.supercompressionScheme != SUPERCOMPRESSION_NONE && header.supercompressionScheme != SUPERCOMPRESSION_ZSTD) {
+		throw std::runtime_error("Unsupported supercompression in " + name);
+	}
+	const TexelBlock texelBlock = getTexelBlock(format);
+	if (texelBlock.size == 0) {
+		throw std::runtime_error("Unsupported format in " + name);
+	}
+
+	// Level i ends up at levelOffsets[i] in levelData, levelSizes[i] bytes long
+	const uint8_t* levelData = data;
+	VkDeviceSize levelDataSize = 0;
+	std::vector<uint8_t> ownedData;
+	std::vector<VkDeviceSize> levelOffsets(storedLevelCount);
+	std::vector<VkDeviceSize> levelSizes(storedLevelCount);
+
+	if (header.supercompressionScheme == SUPERCOMPRESSION_NONE && !decode) {
+		// The common case: upload straight from the file data
+		VkDeviceSize begin = size;
+		VkDeviceSize end = 0;
+		for (const auto& level : levels) {
+			begin = std::min<VkDeviceSize>(begin, level.byteOffset);
+			end = std::max<VkDeviceSize>(end, level.byteOffset + level.byteLength);
+		}
+		levelData = data + begin;
+		levelDataSize = end - begin;
+		for (uint32_t i = 0; i < storedLevelCount; i++) {
+			levelOffsets[i] = levels[i].byteOffset - begin;
+			levelSizes[i] = getLevelSize(texelBlock, std::max(header.pixelWidth >> i, 1u), std::max(header.pixelHeight >> i, 1u));
+			if (levels[i].byteLength < levelSizes[i]) {
+				throw std::runtime_error(name + " is corrupted");
+			}
+		}
+	}
+	else {
+		std::vector<uint8_t> scratch;
+		for (uint32_t i = 0; i < storedLevelCount; i++) {
+			const Ktx2Level& level = levels[i];
+			const uint8_t* source = data + level.byteOffset;
+			size_t sourceSize = level.byteLength;
+			const uint32_t levelWidth = std::max(header.pixelWidth >> i, 1u);
+			const uint32_t levelHeight = std::max(header.pixelHeight >> i, 1u);
+			const VkDeviceSize levelSize = getLevelSize(texelBlock, levelWidth, levelHeight);
+
+			if (header.supercompressionScheme == SUPERCOMPRESSION_ZSTD) {
+#ifdef TEXTURE_LOADER_ZSTD
+				// A 2D level is exactly levelSize bytes, anything else would have the header size the allocation
+				if (level.uncompressedByteLength != levelSize) {
+					throw std::runtime_error(name + " is corrupted");
+				}
+				scratch.resize(level.uncompressedByteLength);
+				size_t result = ZSTD_decompress(scratch.data(), scratch.size(), source, sourceSize);
+				if (ZSTD_isError(result) || result != scratch.size()) {
+					throw std::runtime_error("Failed to decompress " + name);
+				}
+				source = scratch.data();
+				sourceSize = scratch.size();
+#else
+				throw std::runtime_error(name + " is Zstandard supercompressed, build with TEXTURE_LOADER_ZSTD to load it");
+#endif
+			}
+
+			if (sourceSize < levelSize) {
+				throw std::runtime_error(name + " is corrupted");
+			}
+			levelOffsets[i] = alignLevel(ownedData.size());
+			if (decode) {
+				levelSizes[i] = static_cast<VkDeviceSize>(levelWidth) * levelHeight * 4;
+				ownedData.resize(levelOffsets[i] + levelSizes[i]);
+				BlockDecoder::decode(format, source, levelWidth, levelHeight, ownedData.data() + levelOffsets[i]);
+			}
+			else {
+				levelSizes[i] = levelSize;
+				ownedData.resize(levelOffsets[i] + levelSizes[i]);
+				memcpy(ownedData.data() + levelOffsets[i], source, levelSize);
+			}
+		}
+
+		levelData = ownedData.data();
+		levelDataSize = ownedData.size();
+		if (decode) {
+			format = BlockDecoder::getDecodedFormat(format);
+		}
+	}
+
+	const uint32_t width = header.pixelWidth;
+	const uint32_t height = header.pixelHeight;
+	if (header.levelCount != 0) {
+		Texture texture = createImage(format, width, height, storedLevelCount, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+		uploadLevels(texture, levelData, levelDataSize, levelOffsets);
+		return texture;
+	}
+
+	const uint32_t mipLevels = getMipLevelCount(width, height);
+	if (canBlitMips(format)) {
+		Texture texture = createImage(format, width, height, mipLevels, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+		uploadForBlit(texture, levelData + levelOffsets[0], levelSizes[0]);
+		return texture;
+	}
+	if (isRgba8(format)) {
+		std::vector<uint8_t> pixels(levelData + levelOffsets[0], levelData + levelOffsets[0] + levelSizes[0]);
+		std::vector<VkDeviceSize> mipOffsets = downsampleOnCpu(pixels, width, height, mipLevels, isSrgb(format));
+		Texture texture = createImage(format, width, height, mipLevels, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+		uploadLevels(texture, pixels.data(), pixels.size(), mipOffsets);
+		return texture;
+	}
+
+	// Block compressed formats can be neither blit to nor filtered here, the texture keeps its only level
+	Texture texture = createImage(format, width, height, 1, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	uploadLevels(texture, levelData + levelOffsets[0], levelSizes[0], { 0 });
+	return texture;
+}
+
+void TextureLoader::destroyTexture(Texture& texture) {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->pendingMips.erase(std::remove_if(this->pendingMips.begin(), this->pendingMips.end(),
+			[&texture](const PendingMips& pending) { return pending.image == texture.image; }), this->pendingMips.end());
+	}
+	// Its acquire barrier would otherwise be recorded on the destroyed image
+	this->uploader->forgetImage(texture.image);
+
+	vkDestroyImageView(this->device, texture.view, nullptr);
+	vkDestroyImage(this->device, texture.image, nullptr);
+	this->allocator->free(texture.allocation);
+	texture = Texture{};
+}
+
+uint32_t TextureLoader::addStreamed(const Texture& texture) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+
+	uint32_t id;
+	if (!this->freeStreamedIds.empty()) {
+		id = this->freeStreamedIds.back();
+		this->freeStreamedIds.pop_back();
+	}
+	else {
+		id = static_cast<uint32_t>(this->streamed.size());
+		this->streamed.emplace_back();
+	}
+
+	// Registered by recordPendingMips once ready, an upload in flight can be neither copied nor destroyed
+	StreamedTexture& entry = this->streamed[id];
+	entry.texture = texture;
+	entry.registered = false;
+	entry.live = true;
+	return id;
+}
+
+Texture TextureLoader::useStreamed(uint32_t id, uint64_t frameNumber) {
+	Texture texture;
+	bool registered;
+	ResidencyManager::Handle residency;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		const StreamedTexture& entry = this->streamed[id];
+		texture = entry.texture;
+		registered = entry.registered;
+		residency = entry.residency;
+	}
+
+	if (registered) {
+		this->residencyManager->touch(residency, frameNumber);
+	}
+	return texture;
+}
+
+void TextureLoader::removeStreamed(uint32_t id) {
+	bool registered;
+	ResidencyManager::Handle residency;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		StreamedTexture& entry = this->streamed[id];
+		registered = entry.registered;
+		residency = entry.residency;
+
+		Texture& texture = entry.texture;
+		if (texture.image != VK_NULL_HANDLE) {
+			this->pendingDownscales.erase(std::remove_if(this->pendingDownscales.begin(), this->pendingDownscales.end(),
+				[&texture](const PendingDownscale& pending) { return pending.destination == texture.image; }), this->pendingDownscales.end());
+			this->deletionQueue->retireImageView(texture.view);
+			this->deletionQueue->retireImage(texture.image, texture.allocation);
+		}
+		entry = StreamedTexture{};
+		this->freeStreamedIds.push_back(id);
+	}
+
+	if (registered) {
+		this->residencyManager->remove(residency);
+	}
+}
+
+void TextureLoader::recordPendingMips(VkCommandBuffer graphicsCommandBuffer, UploadToken acquiredToken, uint64_t frameNumber) {
+	std::unique_lock<std::mutex> lock(this->mutex);
+
+	recordDownscales(graphicsCommandBuffer);
+
+	for (const auto& pending : this->pendingMips) {
+		if (pending.uploadToken > acquiredToken) continue;
+
+		// Level 0 arrived in TRANSFER_SRC_OPTIMAL, the others are still undefined
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = pending.image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, pending.mipLevels - 1, 0, 1 };
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		vkCmdPipelineBarrier(graphicsCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		int32_t width = static_cast<int32_t>(pending.width);
+		int32_t height = static_cast<int32_t>(pending.height);
+		for (uint32_t level = 1; level < pending.mipLevels; level++) {
+			const int32_t levelWidth = std::max(width / 2, 1);
+			const int32_t levelHeight = std::max(height / 2, 1);
+
+			VkImageBlit blit{};
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level - 1, 0, 1 };
+			blit.srcOffsets[1] = { width, height, 1 };
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+			blit.dstOffsets[1] = { levelWidth, levelHeight, 1 };
+			vkCmdBlitImage(graphicsCommandBuffer, pending.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pending.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+			// The level just written is the source of the next one
+			barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			vkCmdPipelineBarrier(graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			width = levelWidth;
+			height = levelHeight;
+		}
+
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pending.mipLevels, 0, 1 };
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vkCmdPipelineBarrier(graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	this->pendingMips.erase(std::remove_if(this->pendingMips.begin(), this->pendingMips.end(),
+		[acquiredToken](const PendingMips& pending) { return pending.uploadToken <= acquiredToken; }), this->pendingMips.end());
+
+	// A blit upload still in progress may have completed already, its mips are not recorded yet
+	UploadToken readyToken = acquiredToken;
+	if (!this->blitUploads.empty()) {
+		readyToken = std::min(readyToken, *this->blitUploads.begin() - 1);
+	}
+	this->readyToken = std::max(this->readyToken.load(), readyToken);
+
+	std::vector<uint32_t> ready;
+	for (uint32_t id = 0; id < this->streamed.size(); id++) {
+		const StreamedTexture& entry = this->streamed[id];
+		if (entry.live && !entry.registered && entry.texture.image != VK_NULL_HANDLE && isReady(entry.texture)) {
+			ready.push_back(id);
+		}
+	}
+	lock.unlock();
+
+	// The residency manager calls back into the loader with its own mutex held, it is never called with the loader's
+	for (uint32_t id : ready) {
+		const Texture& texture = this->streamed[id].texture;
+		ResidencyCallbacks callbacks;
+		callbacks.evict = [this, id]() { return evictStreamed(id); };
+		callbacks.downscale = [this, id]() { return downscaleStreamed(id); };
+		ResidencyManager::Handle residency = this->residencyManager->add(texture.allocation.memoryTypeIndex, texture.allocation.size, std::move(callbacks), frameNumber);
+
+		lock.lock();
+		this->streamed[id].residency = residency;
+		this->streamed[id].registered = true;
+		lock.unlock();
+	}
+}
+
+Texture TextureLoader::createImage(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, VkImageUsageFlags usage) {
+	Texture texture;
+	texture.format = format;
+	texture.width = width;
+	texture.height = height;
+	texture.mipLevels = mipLevels;
+
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.extent = { width, height, 1 };
+	imageInfo.mipLevels = mipLevels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.format = format;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageInfo.usage = usage | VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // Source of the copy when it is downscaled
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+
+	if (vkCreateImage(this->device, &imageInfo, nullptr, &texture.image) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create texture image");
+	}
+	texture.allocation = this->allocator->allocateForImage(texture.image, VK_IMAGE_TILING_OPTIMAL, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = texture.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 };
+
+	if (vkCreateImageView(this->device, &viewInfo, nullptr, &texture.view) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create texture image view");
+	}
+
+	return texture;
+}
+
+VkDeviceSize TextureLoader::evictStreamed(uint32_t id) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	StreamedTexture& entry = this->streamed[id];
+	Texture& texture = entry.texture;
+
+	this->pendingDownscales.erase(std::remove_if(this->pendingDownscales.begin(), this->pendingDownscales.end(),
+		[&texture](const PendingDownscale& pending) { return pending.destination == texture.image; }), this->pendingDownscales.end());
+	this->deletionQueue->retireImageView(texture.view);
+	this->deletionQueue->retireImage(texture.image, texture.allocation);
+
+	const VkDeviceSize released = texture.allocation.size;
+	texture = Texture{};
+	entry.registered = false;
+	return released;
+}
+
+VkDeviceSize TextureLoader::downscaleStreamed(uint32_t id) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	Texture& texture = this->streamed[id].texture;
+	if (texture.mipLevels <= 1) {
+		return 0;
+	}
+
+	Texture smaller = createImage(texture.format, std::max(texture.width >> 1, 1u), std::max(texture.height >> 1, 1u), texture.mipLevels - 1,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	smaller.uploadToken = texture.uploadToken;
+	this->pendingDownscales.push_back({ texture.image, smaller.image, smaller.width, smaller.height, smaller.mipLevels });
+
+	// Retired with the frame being recorded, the one recordPendingMips records the copy in
+	this->deletionQueue->retireImageView(texture.view);
+	this->deletionQueue->retireImage(texture.image, texture.allocation);
+
+	// 0 when alignment ate the difference, the manager evicts it then
+	const VkDeviceSize released = texture.allocation.size - std::min(texture.allocation.size, smaller.allocation.size);
+	texture = smaller;
+	return released;
+}
+
+void TextureLoader::recordDownscales(VkCommandBuffer graphicsCommandBuffer) {
+	const VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	// In order: a texture downscaled twice before a frame got recorded copies from the result of the first copy
+	for (const auto& pending : this->pendingDownscales) {
+		std::array<VkImageMemoryBarrier, 2> barriers{};
+		for (auto& barrier : barriers) {
+			barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		}
+		// Earlier frames may still sample the source, the copy has to wait for them
+		barriers[0].srcAccessMask = 0;
+		barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barriers[0].image = pending.source;
+		barriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 1, pending.mipLevels, 0, 1 };
+		barriers[1].srcAccessMask = 0;
+		barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[1].image = pending.destination;
+		barriers[1].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, pending.mipLevels, 0, 1 };
+		vkCmdPipelineBarrier(graphicsCommandBuffer, shaderStages | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+		// Level i + 1 of the source has exactly the extent of level i of the destination
+		std::vector<VkImageCopy> regions(pending.mipLevels);
+		for (uint32_t level = 0; level < pending.mipLevels; level++) {
+			regions[level].srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level + 1, 0, 1 };
+			regions[level].dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+			regions[level].extent = { std::max(pending.width >> level, 1u), std::max(pending.height >> level, 1u), 1 };
+		}
+		vkCmdCopyImage(graphicsCommandBuffer, pending.source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, pending.destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(regions.size()), regions.data());
+
+		barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+		barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		vkCmdPipelineBarrier(graphicsCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, shaderStages | VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, 1, &barriers[1]);
+	}
+	this->pendingDownscales.clear();
+}
+
+void TextureLoader::uploadForBlit(Texture& texture, const void* pixels, VkDeviceSize size) {
+	VkBufferImageCopy region{};
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageExtent = { texture.width, texture.height, 1 };
+
+	// The upload may wait for staging space, it runs unlocked. Until its mips are pending, recordPendingMips keeps
+	// readyToken below the token it can complete with.
+	std::multiset<UploadToken>::iterator blitUpload;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		blitUpload = this->blitUploads.insert(this->uploader->getNextToken());
+	}
+
+	UploadToken uploadToken = 0;
+	try {
+		uploadToken = this->uploader->uploadImage(texture.image, { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }, pixels, size, { region }, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->blitUploads.erase(blitUpload);
+		throw;
+	}
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->blitUploads.erase(blitUpload);
+	texture.uploadToken = uploadToken;
+	this->pendingMips.push_back({ texture.image, texture.width, texture.height, texture.mipLevels, texture.uploadToken });
+}
+
+void TextureLoader::uploadLevels(Texture& texture, const uint8_t* data, VkDeviceSize size, const std::vector<VkDeviceSize>& levelOffsets) {
+	std::vector<VkBufferImageCopy> regions(levelOffsets.size());
+	for (uint32_t level = 0; level < regions.size(); level++) {
+		regions[level].bufferOffset = levelOffsets[level];
+		regions[level].imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+		regions[level].imageExtent = { std::max(texture.width >> level, 1u), std::max(texture.height >> level, 1u), 1 };
+	}
+
+	texture.uploadToken = this->uploader->uploadImage(texture.image, { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1 }, data, size, regions);
+}
+
+std::vector<VkDeviceSize> TextureLoader::downsampleOnCpu(std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, uint32_t mipLevels, bool srgb) {
+	// sRGB texels are averaged in linear space, as the GPU blit does
+	float toLinear[256];
+	for (int i = 0; i < 256; i++) {
+		float value = i / 255.0f;
+		toLinear[i] = srgb ? (value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f)) : value;
+	}
+	auto fromLinear = [srgb](float value) {
+		if (srgb) {
+			value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+		}
+		return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+	};
+
+	std::vector<VkDeviceSize> levelOffsets = { 0 };
+	for (uint32_t level = 1; level < mipLevels; level++) {
+		const VkDeviceSize sourceOffset = levelOffsets.back();
+		const uint32_t levelWidth = std::max(width / 2, 1u);
+		const uint32_t levelHeight = std::max(height / 2, 1u);
+		levelOffsets.push_back(sourceOffset + static_cast<VkDeviceSize>(width) * height * 4);
+		pixels.resize(levelOffsets.back() + static_cast<VkDeviceSize>(levelWidth) * levelHeight * 4);
+
+		const uint8_t* source = pixels.data() + sourceOffset;
+		uint8_t* destination = pixels.data() + levelOffsets.back();
+		for (uint32_t y = 0; y < levelHeight; y++) {
+			for (uint32_t x = 0; x < levelWidth; x++) {
+				// Odd sizes clamp, the last row or column is used twice
+				const uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+				const uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+				const uint8_t* texels[4] = {
+					source + (static_cast<size_t>(y0) * width + x0) * 4, source + (static_cast<size_t>(y0) * width + x1) * 4,
+					source + (static_cast<size_t>(y1) * width + x0) * 4, source + (static_cast<size_t>(y1) * width + x1) * 4,
+				};
+				uint8_t* out = destination + (static_cast<size_t>(y) * levelWidth + x) * 4;
+				for (int c = 0; c < 3; c++) {
+					out[c] = fromLinear((toLinear[texels[0][c]] + toLinear[texels[1][c]] + toLinear[texels[2][c]] + toLinear[texels[3][c]]) * 0.25f);
+				}
+				// Alpha is always linear
+				out[3] = static_cast<uint8_t>((texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3] + 2) / 4);
+			}
+		}
+
+		width = levelWidth;
+		height = levelHeight;
+	}
+	return levelOffsets;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <set>
+#include <string>
+#include <mutex>
+#include <atomic>
+
+#include "DeviceProfile.hpp"
+#include "DeviceMemoryAllocator.hpp"
+#include "StagingUploader.hpp"
+#include "DeferredDeletionQueue.hpp"
+#include "ResidencyManager.hpp"
+
+struct Texture {
+	VkImage image = VK_NULL_HANDLE;
+	MemoryAllocation allocation;
+	VkImageView view = VK_NULL_HANDLE;
+	VkFormat format = VK_FORMAT_UNDEFINED; // May differ from the source format when it had to be decoded on the CPU
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t mipLevels = 1;
+	UploadToken uploadToken = 0;
+};
+
+// Creates sampled 2D textures through the StagingUploader:
+// - Uncompressed 8 bit RGBA data, with its mip chain generated on the GPU by successive linear blits on the graphics
+//   queue. Formats that cannot be blit with linear filtering get their mips box filtered on the CPU instead.
+// - KTX2 files, uploaded as stored (block compressed formats included) with their mip levels. Zstandard
+//   supercompression is decoded when built with TEXTURE_LOADER_ZSTD. BC1 to BC5 data the device cannot sample is
+//   decoded to RGBA8 on the CPU, other unsupported formats throw.
+// Textures are in SHADER_READ_ONLY_OPTIMAL and may be sampled once isReady returns true.
+// Textures handed over with addStreamed are registered with the residency manager once ready: over budget, the least
+// recently used ones lose their top mip level (copied on the graphics queue by recordPendingMips) or are evicted.
+class TextureLoader
+{
+public:
+	static uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+
+	void init(VkDevice device, DeviceProfile& profile, DeviceMemoryAllocator& allocator, StagingUploader& uploader, DeferredDeletionQueue& deletionQueue, ResidencyManager& residencyManager);
+
+	void cleanup();
+
+	// pixels holds width * height texels of format, one of the R8G8B8A8 and B8G8R8A8 UNORM and SRGB formats.
+	// Returns once the data is in the staging ring, call uploader.flush() to start the transfer.
+	Texture createTexture(const void* pixels, uint32_t width, uint32_t height, VkFormat format, bool generateMips = true);
+
+	// Mips are generated for files that ask for it (levelCount of 0), the others keep the levels they store
+	Texture loadKtx2(const std::string& path);
+
+	Texture loadKtx2(const uint8_t* data, size_t size, const std::string& name);
+
+	// The texture must not be in use by the GPU anymore
+	void destroyTexture(Texture& texture);
+
+	// The loader owns texture from then on and may downscale or evict it, returns its id. The streamed functions must be
+	// called from the frame thread, the one running ResidencyManager::update.
+	uint32_t addStreamed(const Texture& texture);
+
+	// The texture to bind in frame frameNumber, marks it as used. Its image and view change when it is downscaled and
+	// are null once it has been evicted.
+	Texture useStreamed(uint32_t id, uint64_t frameNumber);
+
+	// Retires the texture, evicted or not, its upload must have completed. The id is invalid afterwards.
+	void removeStreamed(uint32_t id);
+
+	// Records the mip generation of the textures whose upload completed and the copies of downscaled textures, call
+	// right after StagingUploader::recordAcquireBarriers with the token it returned. frameNumber is the frame being
+	// recorded, streamed textures that became ready count as used by it.
+	void recordPendingMips(VkCommandBuffer graphicsCommandBuffer, UploadToken acquiredToken, uint64_t frameNumber);
+
+	// Whether texture can be sampled by commands recorded after the last recordPendingMips
+	bool isReady(const Texture& texture) const { return texture.uploadToken <= this->readyToken.load(); }
+
+	// Linear blits from and to format, the requirement of GPU mip generation
+	bool canBlitMips(VkFormat format);
+
+	bool canSample(VkFormat format);
+
+private:
+	struct PendingMips {
+		VkImage image;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevels;
+		UploadToken uploadToken;
+	};
+
+	struct StreamedTexture {
+		Texture texture;
+		ResidencyManager::Handle residency = 0;
+		bool registered = false; // With the residency manager, once ready
+		bool live = false;
+	};
+
+	// Copy of the levels 1 and up of source to a new image, one level smaller
+	struct PendingDownscale {
+		VkImage source; // Retired already, destroyed once the frame recording the copy completed
+		VkImage destination;
+		uint32_t width; // Of destination
+		uint32_t height;
+		uint32_t mipLevels;
+	};
+
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceProfile* profile = nullptr;
+	DeviceMemoryAllocator* allocator = nullptr;
+	StagingUploader* uploader = nullptr;
+	DeferredDeletionQueue* deletionQueue = nullptr;
+	ResidencyManager* residencyManager = nullptr;
+	std::vector<PendingMips> pendingMips;
+	std::multiset<UploadToken> blitUploads; // Lowest token each blit upload not yet in pendingMips may complete with
+	std::vector<StreamedTexture> streamed; // By id
+	std::vector<uint32_t> freeStreamedIds;
+	std::vector<PendingDownscale> pendingDownscales;
+	std::mutex mutex; // Guards everything above and the format queries, textures may be created from loading threads
+	std::atomic<UploadToken> readyToken{ 0 };
+
+	Texture createImage(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, VkImageUsageFlags usage);
+
+	// Residency callbacks, called with mutex unlocked
+	VkDeviceSize evictStreamed(uint32_t id);
+
+	VkDeviceSize downscaleStreamed(uint32_t id);
+
+	// Callers hold mutex
+	void recordDownscales(VkCommandBuffer graphicsCommandBuffer);
+
+	// Uploads level 0 in TRANSFER_SRC_OPTIMAL, the rest of the chain is blit by recordPendingMips
+	void uploadForBlit(Texture& texture, const void* pixels, VkDeviceSize size);
+
+	// Uploads every level, levels[i] being the offset of level i in data
+	void uploadLevels(Texture& texture, const uint8_t* data, VkDeviceSize size, const std::vector<VkDeviceSize>& levelOffsets);
+
+	// Appends the box filtered levels 1 to mipLevels - 1 of an 8 bit RGBA image to pixels, returns the level offsets
+	static std::vector<VkDeviceSize> downsampleOnCpu(std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, uint32_t mipLevels, bool srgb);
+};
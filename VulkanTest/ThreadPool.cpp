@@ -0,0 +1,133 @@
+#include "ThreadPool.hpp"
+#include "CpuTrace.hpp"
+
+#include <atomic>
+#include <algorithm>
+#include <utility>
+
+void ThreadPool::init(uint32_t workerCount) {
+	if (workerCount == 0) {
+		workerCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+	}
+
+	this->stopping = false;
+	for (uint32_t i = 0; i < workerCount; i++) {
+		this->workers.emplace_back(&ThreadPool::workerLoop, this, i + 1);
+	}
+}
+
+void ThreadPool::cleanup() {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->jobAvailable.notify_all();
+
+	for (auto& worker : this->workers) {
+		worker.join();
+	}
+	this->workers.clear();
+	this->jobs.clear();
+}
+
+void ThreadPool::submit(std::function<void(uint32_t)> job) {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->jobs.push_back(std::move(job));
+	}
+	this->jobAvailable.notify_one();
+}
+
+void ThreadPool::waitIdle() {
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->jobsDone.wait(lock, [this] { return this->jobs.empty() && this->runningJobs == 0; });
+
+	if (this->jobException) {
+		std::rethrow_exception(std::exchange(this->jobException, nullptr));
+	}
+}
+
+void ThreadPool::workerLoop(uint32_t threadIndex) {
+	CPU_TRACE_THREAD_NAME(("Worker " + std::to_string(threadIndex)).c_str());
+	while (true) {
+		std::function<void(uint32_t)> job;
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->jobAvailable.wait(lock, [this] { return this->stopping || !this->jobs.empty(); });
+			if (this->jobs.empty()) {
+				return;
+			}
+
+			job = std::move(this->jobs.front());
+			this->jobs.pop_front();
+			this->runningJobs++;
+		}
+
+		// Escaping the thread would terminate the process
+		std::exception_ptr exception;
+		try {
+			job(threadIndex);
+		}
+		catch (...) {
+			exception = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->runningJobs--;
+			if (exception && !this->jobException) {
+				this->jobException = exception;
+			}
+		}
+		this->jobsDone.notify_all();
+	}
+}
+
+void ThreadPool::parallelFor(uint32_t count, uint32_t chunkSize, const RangeFunction& function, uint32_t maxThreads) {
+	chunkSize = std::max(1u, chunkSize);
+	const uint32_t chunkCount = (count + chunkSize - 1) / chunkSize;
+	const uint32_t helperCount = std::min({ chunkCount, getThreadCount(), std::max(1u, maxThreads) }) - (chunkCount > 0 ? 1 : 0);
+
+	// Helpers reference this stack frame, so wait for all of them to leave, not just for the last chunk to finish
+	std::mutex helpersMutex;
+	std::condition_variable helpersDone;
+	uint32_t activeHelpers = helperCount;
+	std::exception_ptr firstException; // Guarded by helpersMutex
+
+	std::atomic<uint32_t> nextChunk{ 0 };
+	auto runChunks = [&](uint32_t threadIndex) {
+		try {
+			for (uint32_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++) {
+				const uint32_t begin = chunk * chunkSize;
+				function(begin, std::min(count, begin + chunkSize), threadIndex);
+			}
+		}
+		catch (...) {
+			// The remaining chunks are skipped, the caller rethrows once every thread left
+			nextChunk = chunkCount;
+			std::lock_guard<std::mutex> lock(helpersMutex);
+			if (!firstException) {
+				firstException = std::current_exception();
+			}
+		}
+	};
+	for (uint32_t i = 0; i < helperCount; i++) {
+		submit([&](uint32_t threadIndex) {
+			runChunks(threadIndex);
+
+			std::lock_guard<std::mutex> lock(helpersMutex);
+			if (--activeHelpers == 0) {
+				helpersDone.notify_one();
+			}
+		});
+	}
+
+	runChunks(0);
+
+	std::unique_lock<std::mutex> lock(helpersMutex);
+	helpersDone.wait(lock, [&] { return activeHelpers == 0; });
+
+	if (firstException) {
+		std::rethrow_exception(firstException);
+	}
+}
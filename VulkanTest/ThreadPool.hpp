@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+// Fixed set of worker threads. Every thread has a stable index, 0 being the thread calling parallelFor, so callers can
+// keep per thread state (command pools, scratch memory) in arrays of getThreadCount() entries.
+class ThreadPool
+{
+public:
+	// (begin, end, threadIndex)
+	typedef std::function<void(uint32_t, uint32_t, uint32_t)> RangeFunction;
+
+	// workerCount = 0 starts one worker per hardware thread besides the calling one
+	void init(uint32_t workerCount = 0);
+
+	void cleanup();
+
+	// Workers plus the calling thread
+	uint32_t getThreadCount() const { return static_cast<uint32_t>(this->workers.size()) + 1; }
+
+	// Runs function over [0, count) in chunks of chunkSize on at most maxThreads threads, the calling thread included,
+	// and returns once every chunk is done. Chunks are handed out dynamically, which chunk runs on which thread varies.
+	// Call it from one thread at a time, and not from inside function, since the caller always takes index 0.
+	// If function throws, the chunks not started yet are skipped and the first exception is rethrown here once every
+	// thread is done.
+	void parallelFor(uint32_t count, uint32_t chunkSize, const RangeFunction& function, uint32_t maxThreads = UINT32_MAX);
+
+	// Runs job on a worker thread, with that worker's index
+	void submit(std::function<void(uint32_t)> job);
+
+	// Waits until every submitted job has completed, then rethrows the first exception a job threw since the last call
+	void waitIdle();
+
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void(uint32_t)>> jobs;
+	uint32_t runningJobs = 0;
+	std::exception_ptr jobException; // First one thrown by a submitted job, for waitIdle
+	bool stopping = false;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable jobsDone;
+
+	void workerLoop(uint32_t threadIndex);
+};
@@ -0,0 +1,66 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+
+#include "MeshPacker.hpp"
+
+// Usage: MeshPackTool output.mpack input.obj...
+// Packs every OBJ file as one mesh, in argument order, then maps the result back to check it and compares the time
+// it takes with parsing and indexing the OBJ files
+
+namespace {
+	double millisecondsSince(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		std::cerr << "Usage: MeshPackTool output.mpack input.obj..." << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try {
+		MeshPacker packer;
+		double parseMilliseconds = 0.0;
+		double indexMilliseconds = 0.0;
+		for (int i = 2; i < argc; i++) {
+			auto start = std::chrono::steady_clock::now();
+			std::vector<Vertex> triangles = MeshPacker::loadObj(argv[i]);
+			parseMilliseconds += millisecondsSince(start);
+
+			start = std::chrono::steady_clock::now();
+			uint32_t meshIndex = packer.addMesh(triangles);
+			indexMilliseconds += millisecondsSince(start);
+
+			const MeshPackMesh& mesh = packer.getMeshes()[meshIndex];
+			std::cout << argv[i] << ": " << mesh.indexCount / 3 << " triangles, " << mesh.vertexCount << " vertices, "
+				<< mesh.meshletCount << " meshlets" << std::endl;
+		}
+		packer.write(argv[1]);
+
+		auto start = std::chrono::steady_clock::now();
+		MeshPack pack;
+		pack.open(argv[1]);
+		// Touch every page, as the staging copies would
+		uint64_t checksum = 0;
+		const uint32_t* indices = pack.getIndices();
+		for (size_t i = 0; i < pack.getIndexCount(); i++) {
+			checksum += indices[i];
+		}
+		const uint8_t* vertexBytes = reinterpret_cast<const uint8_t*>(pack.getVertices());
+		for (size_t i = 0; i < pack.getVertexDataSize(); i += 64) {
+			checksum += vertexBytes[i];
+		}
+		double packMilliseconds = millisecondsSince(start);
+
+		std::cout << "OBJ parse " << parseMilliseconds << " ms + indexing " << indexMilliseconds << " ms, pack map and read "
+			<< packMilliseconds << " ms (" << pack.getMeshCount() << " meshes, checksum " << checksum << ")" << std::endl;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
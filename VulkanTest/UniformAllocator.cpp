@@ -0,0 +1,130 @@
+#include "UniformAllocator.hpp"
+
+#include <array>
+#include <algorithm>
+#include <stdexcept>
+
+void UniformAllocator::init(VkDevice device, const DeviceProfile& profile, DeviceMemoryAllocator& allocator, uint32_t frameCount, VkDeviceSize bytesPerFrame) {
+	this->device = device;
+	this->allocator = &allocator;
+	this->alignment = std::max<VkDeviceSize>(profile.getProperties().limits.minUniformBufferOffsetAlignment, 16);
+	this->frameSize = (bytesPerFrame + this->alignment - 1) / this->alignment * this->alignment;
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	// Bound ranges may run past a small allocation at the very end of the last region
+	bufferInfo.size = this->frameSize * frameCount + std::max(sizeof(FrameUniforms), sizeof(ObjectUniforms));
+	bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(this->device, &bufferInfo, nullptr, &this->buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create uniform buffer");
+	}
+	this->allocation = this->allocator->allocateForBuffer(this->buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+	createDescriptorSet();
+	beginFrame(0);
+}
+
+void UniformAllocator::cleanup() {
+	vkDestroyDescriptorPool(this->device, this->descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(this->device, this->descriptorSetLayout, nullptr);
+	if (this->buffer != VK_NULL_HANDLE) {
+		vkDestroyBuffer(this->device, this->buffer, nullptr);
+		this->allocator->free(this->allocation);
+	}
+	this->descriptorPool = VK_NULL_HANDLE;
+	this->descriptorSetLayout = VK_NULL_HANDLE;
+	this->descriptorSet = VK_NULL_HANDLE;
+	this->buffer = VK_NULL_HANDLE;
+}
+
+void UniformAllocator::createDescriptorSet() {
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+	bindings[0].binding = FRAME_BINDING;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[1].binding = OBJECT_BINDING;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(this->device, &layoutInfo, nullptr, &this->descriptorSetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create uniform descriptor set layout");
+	}
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSize.descriptorCount = static_cast<uint32_t>(bindings.size());
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	if (vkCreateDescriptorPool(this->device, &poolInfo, nullptr, &this->descriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create uniform descriptor pool");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &this->descriptorSetLayout;
+
+	if (vkAllocateDescriptorSets(this->device, &allocInfo, &this->descriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to allocate uniform descriptor set");
+	}
+
+	// Both bindings start at the beginning of the buffer, the dynamic offsets select the actual data
+	std::array<VkDescriptorBufferInfo, 2> bufferInfos{};
+	bufferInfos[0].buffer = this->buffer;
+	bufferInfos[0].range = sizeof(FrameUniforms);
+	bufferInfos[1].buffer = this->buffer;
+	bufferInfos[1].range = sizeof(ObjectUniforms);
+
+	std::array<VkWriteDescriptorSet, 2> writes{};
+	for (uint32_t i = 0; i < writes.size(); i++) {
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = this->descriptorSet;
+		writes[i].dstBinding = bindings[i].binding;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(this->device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+void UniformAllocator::beginFrame(uint32_t frameIndex) {
+	this->frameBegin = this->frameSize * frameIndex;
+	this->frameEnd = this->frameBegin + this->frameSize;
+	this->head.store(this->frameBegin, std::memory_order_relaxed);
+}
+
+UniformAllocation UniformAllocator::allocate(VkDeviceSize size) {
+	// head always stays aligned, so rounding the size up is enough
+	const VkDeviceSize alignedSize = (size + this->alignment - 1) / this->alignment * this->alignment;
+	const VkDeviceSize offset = this->head.fetch_add(alignedSize, std::memory_order_relaxed);
+	if (offset + size > this->frameEnd) {
+		throw std::runtime_error("Uniform allocator ran out of space for the frame");
+	}
+
+	UniformAllocation result;
+	result.data = static_cast<char*>(this->allocation.mappedData) + offset;
+	result.offset = static_cast<uint32_t>(offset);
+	return result;
+}
+
+void UniformAllocator::bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstSet, uint32_t frameOffset, uint32_t objectOffset) const {
+	// Dynamic offsets are consumed in binding order
+	const uint32_t dynamicOffsets[] = { frameOffset, objectOffset };
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, firstSet, 1, &this->descriptorSet, 2, dynamicOffsets);
+}
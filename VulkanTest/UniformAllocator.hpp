@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstring>
+
+#include "DeviceProfile.hpp"
+#include "DeviceMemoryAllocator.hpp"
+
+struct UniformAllocation {
+	void* data = nullptr; // Persistently mapped, write the uniforms here before the frame is submitted
+	uint32_t offset = 0; // Dynamic offset to bind the allocation with
+};
+
+// Linear allocator over one persistently mapped uniform buffer split into a region per frame slot. Every allocation is
+// aligned to minUniformBufferOffsetAlignment and referenced through a dynamic offset, so the single descriptor set is
+// written once in init and never updated afterwards. Binding 0 holds FrameUniforms and binding 1 ObjectUniforms.
+// allocate may be called from several threads at once (ParallelRecorder workers), beginFrame from the frame thread only.
+class UniformAllocator
+{
+public:
+	static constexpr uint32_t FRAME_BINDING = 0;
+	static constexpr uint32_t OBJECT_BINDING = 1;
+
+	void init(VkDevice device, const DeviceProfile& profile, DeviceMemoryAllocator& allocator, uint32_t frameCount, VkDeviceSize bytesPerFrame);
+
+	void cleanup();
+
+	// Recycles the region of a frame slot, call after waiting on the slot's fence and before recording
+	void beginFrame(uint32_t frameIndex);
+
+	// Throws when the frame region is exhausted, raise bytesPerFrame then
+	UniformAllocation allocate(VkDeviceSize size);
+
+	template<typename T>
+	uint32_t push(const T& value) {
+		UniformAllocation allocation = allocate(sizeof(T));
+		memcpy(allocation.data, &value, sizeof(T));
+		return allocation.offset;
+	}
+
+	// Binds the descriptor set at firstSet with the offsets returned by allocate/push
+	void bind(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t firstSet, uint32_t frameOffset, uint32_t objectOffset) const;
+
+	VkDescriptorSetLayout getDescriptorSetLayout() const { return this->descriptorSetLayout; }
+
+	VkDescriptorSet getDescriptorSet() const { return this->descriptorSet; }
+
+	VkBuffer getBuffer() const { return this->buffer; }
+
+	// Bytes handed out during the current frame, alignment padding included
+	VkDeviceSize getFrameBytesUsed() const { return this->head.load(std::memory_order_relaxed) - this->frameBegin; }
+
+private:
+	VkDevice device = VK_NULL_HANDLE;
+	DeviceMemoryAllocator* allocator = nullptr;
+	VkBuffer buffer = VK_NULL_HANDLE;
+	MemoryAllocation allocation;
+	VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+	VkDeviceSize alignment = 256;
+	VkDeviceSize frameSize = 0;
+	VkDeviceSize frameBegin = 0;
+	VkDeviceSize frameEnd = 0;
+	std::atomic<VkDeviceSize> head{ 0 };
+
+	void createDescriptorSet();
+};
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "types.hpp"
+
+// Compile-time vertex layouts: a layout is a list of streams (one binding each), a stream a list of fields, and the
+// Vulkan binding and attribute descriptions are generated from them. Vertex keeps working as is, the packed layouts
+// trade the 44 bytes of Vertex for 20, and split positions into their own stream for depth-only passes.
+
+// The semantic also gives the shader location, matching the locations used by Vertex
+enum class VertexSemantic : uint32_t {
+	Position = 0,
+	Normal = 1,
+	Color = 2,
+	TexCoord = 3
+};
+
+// Per mesh dequantization of packed positions, the vertex shader computes position = packed * scale + offset
+struct VertexQuantization {
+	glm::vec3 offset = glm::vec3(0.0f);
+	glm::vec3 scale = glm::vec3(1.0f);
+
+	static VertexQuantization fromBounds(const glm::vec3& min, const glm::vec3& max) {
+		VertexQuantization quantization;
+		quantization.offset = (min + max) * 0.5f;
+		// Flat meshes still need a non zero scale along their flat axis
+		quantization.scale = glm::max((max - min) * 0.5f, glm::vec3(1e-6f));
+		return quantization;
+	}
+};
+
+// Encodings: the storage type, its format and how to fill it from the value of the field in Vertex
+
+struct Float2Encoding {
+	typedef float Storage[2];
+	static constexpr VkFormat format = VK_FORMAT_R32G32_SFLOAT;
+
+	static void encode(const glm::vec4& value, const VertexQuantization&, Storage& out) {
+		out[0] = value.x;
+		out[1] = value.y;
+	}
+};
+
+struct Float3Encoding {
+	typedef float Storage[3];
+	static constexpr VkFormat format = VK_FORMAT_R32G32B32_SFLOAT;
+
+	static void encode(const glm::vec4& value, const VertexQuantization&, Storage& out) {
+		out[0] = value.x;
+		out[1] = value.y;
+		out[2] = value.z;
+	}
+};
+
+// Positions normalized to [-1, 1] over the mesh bounds, w is padding (RGB16 formats are rarely supported for vertices)
+struct QuantizedHalf4Encoding {
+	typedef uint16_t Storage[4];
+	static constexpr VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+	static void encode(const glm::vec4& value, const VertexQuantization& quantization, Storage& out) {
+		glm::vec3 normalized = (glm::vec3(value) - quantization.offset) / quantization.scale;
+		out[0] = glm::packHalf1x16(normalized.x);
+		out[1] = glm::packHalf1x16(normalized.y);
+		out[2] = glm::packHalf1x16(normalized.z);
+		out[3] = glm::packHalf1x16(1.0f);
+	}
+};
+
+// Unit vectors mapped onto an octahedron and unfolded to a square. Decoding in the shader:
+//   vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+//   if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * sign(n.xy);
+//   n = normalize(n);
+struct OctahedralSnorm16Encoding {
+	typedef int16_t Storage[2];
+	static constexpr VkFormat format = VK_FORMAT_R16G16_SNORM;
+
+	static void encode(const glm::vec4& value, const VertexQuantization&, Storage& out) {
+		glm::vec3 normal = glm::vec3(value);
+		normal = normal / (std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z));
+		float x = normal.x;
+		float y = normal.y;
+		if (normal.z < 0.0f) {
+			x = (1.0f - std::abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+			y = (1.0f - std::abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
+		}
+		out[0] = static_cast<int16_t>(glm::packSnorm1x16(x));
+		out[1] = static_cast<int16_t>(glm::packSnorm1x16(y));
+	}
+};
+
+struct Unorm8x4Encoding {
+	typedef uint8_t Storage[4];
+	static constexpr VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+
+	static void encode(const glm::vec4& value, const VertexQuantization&, Storage& out) {
+		out[0] = glm::packUnorm1x8(value.x);
+		out[1] = glm::packUnorm1x8(value.y);
+		out[2] = glm::packUnorm1x8(value.z);
+		out[3] = glm::packUnorm1x8(value.w);
+	}
+};
+
+struct Half2Encoding {
+	typedef uint16_t Storage[2];
+	static constexpr VkFormat format = VK_FORMAT_R16G16_SFLOAT;
+
+	static void encode(const glm::vec4& value, const VertexQuantization&, Storage& out) {
+		out[0] = glm::packHalf1x16(value.x);
+		out[1] = glm::packHalf1x16(value.y);
+	}
+};
+
+template<VertexSemantic Semantic, typename Encoding>
+struct VertexField {
+	static constexpr VertexSemantic semantic = Semantic;
+	static constexpr uint32_t location = static_cast<uint32_t>(Semantic);
+	static constexpr VkFormat format = Encoding::format;
+	static constexpr uint32_t size = sizeof(typename Encoding::Storage);
+
+	static glm::vec4 read(const Vertex& vertex) {
+		switch (Semantic) {
+		case VertexSemantic::Position: return glm::vec4(vertex.pos, 1.0f);
+		case VertexSemantic::Normal: return glm::vec4(vertex.normal, 0.0f);
+		case VertexSemantic::Color: return glm::vec4(vertex.color, 1.0f);
+		case VertexSemantic::TexCoord: return glm::vec4(vertex.texCoord.x, vertex.texCoord.y, 0.0f, 0.0f);
+		}
+		return glm::vec4(0.0f);
+	}
+
+	static void write(const Vertex& vertex, const VertexQuantization& quantization, uint8_t* out) {
+		typename Encoding::Storage storage;
+		Encoding::encode(read(vertex), quantization, storage);
+		memcpy(out, storage, sizeof(storage));
+	}
+};
+
+// Fields are tightly packed in declaration order, every encoding above keeps 4 byte alignment
+template<typename... Fields>
+struct VertexStream {
+	static constexpr uint32_t fieldCount = sizeof...(Fields);
+	static constexpr uint32_t stride = (Fields::size + ...);
+
+	static constexpr std::array<uint32_t, fieldCount> getOffsets() {
+		std::array<uint32_t, fieldCount> offsets{};
+		const uint32_t sizes[] = { Fields::size... };
+		uint32_t offset = 0;
+		for (uint32_t i = 0; i < fieldCount; i++) {
+			offsets[i] = offset;
+			offset += sizes[i];
+		}
+		return offsets;
+	}
+
+	static constexpr std::array<VkVertexInputAttributeDescription, fieldCount> getAttributeDescriptions(uint32_t binding) {
+		std::array<VkVertexInputAttributeDescription, fieldCount> attributeDescriptions{};
+		const uint32_t locations[] = { Fields::location... };
+		const VkFormat formats[] = { Fields::format... };
+		const auto offsets = getOffsets();
+		for (uint32_t i = 0; i < fieldCount; i++) {
+			attributeDescriptions[i].binding = binding;
+			attributeDescriptions[i].location = locations[i];
+			attributeDescriptions[i].format = formats[i];
+			attributeDescriptions[i].offset = offsets[i];
+		}
+		return attributeDescriptions;
+	}
+
+	static void write(const Vertex& vertex, const VertexQuantization& quantization, uint8_t* out) {
+		const auto offsets = getOffsets();
+		uint32_t i = 0;
+		(Fields::write(vertex, quantization, out + offsets[i++]), ...);
+	}
+};
+
+// Stream i is bound to binding i
+template<typename... Streams>
+struct VertexLayout {
+	static constexpr uint32_t bindingCount = sizeof...(Streams);
+	static constexpr uint32_t attributeCount = (Streams::fieldCount + ...);
+	static constexpr uint32_t vertexSize = (Streams::stride + ...);
+
+	static constexpr std::array<VkVertexInputBindingDescription, bindingCount> getBindingDescriptions() {
+		std::array<VkVertexInputBindingDescription, bindingCount> bindingDescriptions{};
+		const uint32_t strides[] = { Streams::stride... };
+		for (uint32_t i = 0; i < bindingCount; i++) {
+			bindingDescriptions[i].binding = i;
+			bindingDescriptions[i].stride = strides[i];
+			bindingDescriptions[i].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		}
+		return bindingDescriptions;
+	}
+
+	static constexpr std::array<VkVertexInputAttributeDescription, attributeCount> getAttributeDescriptions() {
+		std::array<VkVertexInputAttributeDescription, attributeCount> attributeDescriptions{};
+		uint32_t binding = 0;
+		uint32_t count = 0;
+		auto append = [&](const auto& streamDescriptions) {
+			for (const auto& description : streamDescriptions) {
+				attributeDescriptions[count++] = description;
+			}
+			binding++;
+		};
+		(append(Streams::getAttributeDescriptions(binding)), ...);
+		return attributeDescriptions;
+	}
+};
+
+// One tightly packed buffer per binding, ready to be uploaded
+template<typename Layout>
+struct PackedVertices {
+	std::array<std::vector<uint8_t>, Layout::bindingCount> streams;
+	VertexQuantization quantization;
+};
+
+template<typename Stream, typename... Streams>
+void packVertexStreams(const std::vector<Vertex>& vertices, const VertexQuantization& quantization, std::vector<uint8_t>* out) {
+	out->resize(vertices.size() * Stream::stride);
+	for (size_t i = 0; i < vertices.size(); i++) {
+		Stream::write(vertices[i], quantization, out->data() + i * Stream::stride);
+	}
+
+	if constexpr (sizeof...(Streams) > 0) {
+		packVertexStreams<Streams...>(vertices, quantization, out + 1);
+	}
+}
+
+template<typename... Streams>
+PackedVertices<VertexLayout<Streams...>> packVertices(const std::vector<Vertex>& vertices, VertexLayout<Streams...> = {}) {
+	PackedVertices<VertexLayout<Streams...>> packed;
+
+	if (!vertices.empty()) {
+		glm::vec3 min = vertices[0].pos;
+		glm::vec3 max = vertices[0].pos;
+		for (const auto& vertex : vertices) {
+			min = glm::min(min, vertex.pos);
+			max = glm::max(max, vertex.pos);
+		}
+		packed.quantization = VertexQuantization::fromBounds(min, max);
+	}
+
+	packVertexStreams<Streams...>(vertices, packed.quantization, packed.streams.data());
+	return packed;
+}
+
+// Same memory layout as Vertex
+typedef VertexLayout<VertexStream<
+	VertexField<VertexSemantic::Position, Float3Encoding>,
+	VertexField<VertexSemantic::Normal, Float3Encoding>,
+	VertexField<VertexSemantic::Color, Float3Encoding>,
+	VertexField<VertexSemantic::TexCoord, Float2Encoding>>> FloatVertexLayout;
+
+typedef VertexStream<VertexField<VertexSemantic::Position, QuantizedHalf4Encoding>> PackedPositionStream;
+
+typedef VertexStream<
+	VertexField<VertexSemantic::Normal, OctahedralSnorm16Encoding>,
+	VertexField<VertexSemantic::Color, Unorm8x4Encoding>,
+	VertexField<VertexSemantic::TexCoord, Half2Encoding>> PackedAttributeStream;
+
+// Positions on binding 0, everything else on binding 1
+typedef VertexLayout<PackedPositionStream, PackedAttributeStream> PackedVertexLayout;
+
+// Binds only the position stream of a PackedVertexLayout mesh, 8 bytes per vertex for depth and shadow passes
+typedef VertexLayout<PackedPositionStream> PackedDepthLayout;
+
+static_assert(FloatVertexLayout::vertexSize == sizeof(Vertex), "FloatVertexLayout must match Vertex");
+static_assert(PackedVertexLayout::vertexSize == 20, "Unexpected packed vertex size");
@@ -28,41 +28,101 @@ void VulkanBaseGLFW::initWindow(const char* applicationName, const int width, co
 }
 
 void VulkanBaseGLFW::cleanup() {
+	vkDeviceWaitIdle(this->device);
+
 	cleanupSwapChain();
+	cleanupFrameResources();
 	if (enableValidationLayers) {
 		DestroyDebugUtilsMessengerEXT(this->instance, debugMessenger, nullptr);
 	}
 	vkDestroyRenderPass(this->device, this->renderPass, nullptr);
-
+	vkDestroyRenderPass(this->device, this->scaledRenderPass, nullptr);
+
+	this->renderGraph.cleanup();
+	this->descriptorHeap.cleanup();
+	this->residencyManager.cleanup();
+	this->memoryBudget.cleanup();
+	this->gpuProfiler.cleanup();
+	this->parallelRecorder.cleanup();
+	this->threadPool.cleanup();
+	this->pipelineManager.cleanup();
+	this->pipelineCache.cleanup();
+	this->textureLoader.cleanup();
+	this->deletionQueue.cleanup();
+	this->uploader.cleanup();
+	this->memoryAllocator.cleanup();
 	vkDestroyDevice(this->device, nullptr);
-	vkDestroySurfaceKHR(this->instance, this->surface, nullptr);
+	if (!this->headless) {
+		vkDestroySurfaceKHR(this->instance, this->surface, nullptr);
+	}
 	vkDestroyInstance(this->instance, nullptr);
 
-	glfwDestroyWindow(this->window);
-	glfwTerminate();
+	if (!this->headless) {
+		glfwDestroyWindow(this->window);
+		glfwTerminate();
+	}
 }
 
 void VulkanBaseGLFW::initVulkan(const char* applicationName) {
+	CPU_TRACE_ZONE("Init Vulkan");
 	createVulkanInstance(applicationName);
 	setupDebugMessenger();
-	createSurface();
+	if (!this->headless) {
+		createSurface();
+	}
 	pickPhysicalDevice();
 	createLogicalDevice();
-	createSwapChain();
-	createImageViews();
-	createRenderPass();
-	createColorResources();
-	createDepthResources();
+	this->memoryAllocator.init(this->deviceProfile, this->device);
+	this->memoryBudget.init(this->deviceProfile, this->memoryAllocator, this->memoryBudgetEnabled);
+	this->pipelineCache.init(this->physicalDevice, this->device);
+	createUploader();
+	if (this->headless) {
+		createOffscreenImages();
+	}
+	else {
+		createSwapChain();
+		createImageViews();
+		createRenderFinishedSemaphores();
+	}
+	this->renderPass = createRenderPass(this->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	this->scaledRenderPass = createRenderPass(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+	createAttachments();
+	createFramebuffers();
+	this->renderExtent = this->dynamicResolution.scaleExtent(this->swapChainExtent);
+	createFrameResources();
+	if (this->descriptorIndexingEnabled) {
+		this->descriptorHeap.init(this->device, this->deviceProfile, this->deletionQueue);
+	}
+	this->residencyManager.init(this->memoryBudget, this->deletionQueue);
+	this->threadPool.init();
+	this->pipelineManager.init(this->device, this->pipelineCache, this->deletionQueue, this->graphicsPipelineLibraryEnabled);
+	this->pipelineManager.registerRenderPass("main", this->renderPass, 0, this->msaaSamples);
+	this->parallelRecorder.init(this->device, this->threadPool, this->deviceProfile.getQueueFamilies().graphicsFamily.value(), MAX_FRAMES_IN_FLIGHT);
+	this->gpuProfiler.init(this->device, this->deviceProfile, this->deviceProfile.getQueueFamilies().graphicsFamily.value(), MAX_FRAMES_IN_FLIGHT);
+	this->renderGraph.init(this->device, this->deviceProfile, this->memoryAllocator, this->deletionQueue);
 }
 
 void VulkanBaseGLFW::createVulkanInstance(const char* applicationName) {
+	CPU_TRACE_ZONE("Create instance");
 	VkApplicationInfo appInfo{};
 	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
 	appInfo.pApplicationName = applicationName;
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+
+	// 1.2 is required for timeline semaphores, 1.3 is used when the loader has it. A 1.0 loader has no
+	// vkEnumerateInstanceVersion.
+	uint32_t loaderVersion = VK_API_VERSION_1_0;
+	auto enumerateInstanceVersion = (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion");
+	if (enumerateInstanceVersion != nullptr) {
+		enumerateInstanceVersion(&loaderVersion);
+	}
+	if (loaderVersion < VK_API_VERSION_1_2) {
+		throw std::runtime_error("Vulkan 1.2 is required, the Vulkan loader only supports " + std::to_string(VK_API_VERSION_MAJOR(loaderVersion)) + "." + std::to_string(VK_API_VERSION_MINOR(loaderVersion)));
+	}
+	this->apiVersion = std::min(loaderVersion, VK_API_VERSION_1_3);
+	appInfo.apiVersion = this->apiVersion;
 
 	VkInstanceCreateInfo createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -145,28 +205,26 @@ bool VulkanBaseGLFW::checkValidationLayerSupport() {
 }
 
 
-bool VulkanBaseGLFW::checkDeviceExtensionSupport(VkPhysicalDevice device) {
-	uint32_t extensionCount;
-	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
-	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
-
-	std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
-
-	for (const auto& extension : availableExtensions) {
-		requiredExtensions.erase(extension.extensionName);
+std::vector<const char*> VulkanBaseGLFW::getRequiredDeviceExtensions() {
+	// Without a surface there is nothing to present to, so the swap chain extension is not needed
+	if (this->headless) {
+		return {};
 	}
 
-	return requiredExtensions.empty();
+	return deviceExtensions;
 }
 
 std::vector<const char*> VulkanBaseGLFW::getRequiredExtensions() {
-	uint32_t glfwExtensionCount = 0;
-	const char** glfwExtensions;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char*> extensions;
 
-	std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	if (!this->headless) {
+		uint32_t glfwExtensionCount = 0;
+		const char** glfwExtensions;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	if (enableValidationLayers) {
 		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -195,6 +253,7 @@ void VulkanBaseGLFW::setupDebugMessenger() {
 }
 
 void VulkanBaseGLFW::pickPhysicalDevice() {
+	CPU_TRACE_ZONE("Pick physical device");
 	uint32_t deviceCount = 0;
 	vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
 
@@ -205,79 +264,49 @@ void VulkanBaseGLFW::pickPhysicalDevice() {
 	std::vector<VkPhysicalDevice> devices(deviceCount);
 	vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
+	// Every suitable device is a candidate, integrated GPUs and CPU implementations included, the best scoring one wins
+	uint64_t bestScore = 0;
 	for (const auto& device : devices) {
-		if (isDeviceSuitable(device)) {
+		DeviceProfile profile;
+		profile.init(device, this->surface, this->apiVersion);
+
+		if (isDeviceSuitable(profile) && (this->physicalDevice == VK_NULL_HANDLE || profile.score() > bestScore)) {
+			bestScore = profile.score();
 			this->physicalDevice = device;
-			this->msaaSamples = getMaxUsableSampleCount();
-			break;
+			this->deviceProfile = std::move(profile);
 		}
 	}
 
 	if (this->physicalDevice == VK_NULL_HANDLE) {
 		throw std::runtime_error("Failed to find a suitable GPU");
 	}
-}
-
-bool VulkanBaseGLFW::isDeviceSuitable(VkPhysicalDevice device) {
-	VkPhysicalDeviceProperties physicalDeviceProperties;
-	VkPhysicalDeviceFeatures physicalDeviceFeatures;
 
-	vkGetPhysicalDeviceProperties(device, &physicalDeviceProperties);
-	vkGetPhysicalDeviceFeatures(device, &physicalDeviceFeatures);
+	this->apiVersion = this->deviceProfile.getApiVersion();
+	this->msaaSamples = this->deviceProfile.getMaxUsableSampleCount();
+}
 
-	QueueFamilyIndices indices = findQueueFamilies(device);
+bool VulkanBaseGLFW::isDeviceSuitable(const DeviceProfile& profile) {
+	QueueFamilyIndices indices = profile.getQueueFamilies();
 
-	bool extensionsSupported = checkDeviceExtensionSupport(device);
+	bool extensionsSupported = profile.supportsExtensions(getRequiredDeviceExtensions());
 
-	bool swapChainAdequate = false;
-	if (extensionsSupported) {
-		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
-		swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
-	}
+	bool swapChainAdequate = this->headless
+		|| (!profile.getSwapChainSupport().formats.empty() && !profile.getSwapChainSupport().presentModes.empty());
 
-	return (physicalDeviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
-		&& physicalDeviceFeatures.tessellationShader
-		&& physicalDeviceFeatures.samplerAnisotropy
+	return profile.getApiVersion() >= VK_API_VERSION_1_2
+		&& profile.getFeatureChain().vulkan12().timelineSemaphore
+		&& profile.getFeatures().samplerAnisotropy
 		&& indices.isComplete()
 		&& extensionsSupported
 		&& swapChainAdequate;
 }
 
-QueueFamilyIndices VulkanBaseGLFW::findQueueFamilies(VkPhysicalDevice device) {
-	QueueFamilyIndices indices;
-
-	uint32_t queueFamilyCount = 0;
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
-
-	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
-
-	int i = 0;
-	for (const auto& queueFamily : queueFamilies) {
-		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-			indices.graphicsFamily = i;
-		}
-
-		if (presentSupport) {
-			indices.presentFamily = i;
-		}
-
-		if (indices.isComplete()) break;
-
-		i++;
-	}
-
-	return indices;
-}
-
 void VulkanBaseGLFW::createLogicalDevice() {
-	QueueFamilyIndices indices = findQueueFamilies(this->physicalDevice);
+	CPU_TRACE_ZONE("Create logical device");
+	QueueFamilyIndices indices = this->deviceProfile.getQueueFamilies();
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), indices.transferFamily.value() };
 	float queuePriority = 1.0f;
 
 	for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -290,17 +319,77 @@ void VulkanBaseGLFW::createLogicalDevice() {
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
-	VkPhysicalDeviceFeatures deviceFeatures{};
-	deviceFeatures.samplerAnisotropy = VK_TRUE;
-	deviceFeatures.sampleRateShading = VK_TRUE;
+	const FeatureChain& supportedFeatures = this->deviceProfile.getFeatureChain();
+	FeatureChain enabled;
+	enabled.setApiVersion(this->apiVersion);
+	enabled.core().samplerAnisotropy = VK_TRUE;
+	// Optional, not every integrated or CPU device has it and nothing depends on it yet
+	enabled.core().sampleRateShading = supportedFeatures.core().sampleRateShading;
+	enabled.vulkan12().timelineSemaphore = VK_TRUE;
+	// Optional, used by GPU driven rendering (GpuCulling) when available
+	enabled.core().multiDrawIndirect = supportedFeatures.core().multiDrawIndirect;
+	enabled.core().drawIndirectFirstInstance = supportedFeatures.core().drawIndirectFirstInstance;
+	const VkPhysicalDeviceVulkan12Features& supported12 = supportedFeatures.vulkan12();
+	// Core since 1.2, enabled as a Vulkan12Features feature rather than through VK_KHR_draw_indirect_count
+	this->drawIndirectCountEnabled = supported12.drawIndirectCount == VK_TRUE;
+	enabled.vulkan12().drawIndirectCount = supported12.drawIndirectCount;
+
+	// Optional, backs descriptorHeap
+	this->descriptorIndexingEnabled = supported12.descriptorIndexing
+		&& supported12.runtimeDescriptorArray
+		&& supported12.descriptorBindingPartiallyBound
+		&& supported12.descriptorBindingSampledImageUpdateAfterBind
+		&& supported12.descriptorBindingStorageBufferUpdateAfterBind
+		&& supported12.shaderSampledImageArrayNonUniformIndexing
+		&& supported12.shaderStorageBufferArrayNonUniformIndexing;
+	if (this->descriptorIndexingEnabled) {
+		VkPhysicalDeviceVulkan12Features& enabled12 = enabled.vulkan12();
+		enabled12.descriptorIndexing = VK_TRUE;
+		enabled12.runtimeDescriptorArray = VK_TRUE;
+		enabled12.descriptorBindingPartiallyBound = VK_TRUE;
+		enabled12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		enabled12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+		enabled12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		enabled12.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+	}
+
+	std::vector<const char*> requiredDeviceExtensions = getRequiredDeviceExtensions();
+	// Optional, lets framePacer wait for presents and measure the latency until them
+	auto presentId = supportedFeatures.find<VkPhysicalDevicePresentIdFeaturesKHR>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR);
+	auto presentWait = supportedFeatures.find<VkPhysicalDevicePresentWaitFeaturesKHR>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR);
+	this->presentWaitEnabled = !this->headless && presentId != nullptr && presentId->presentId && presentWait != nullptr && presentWait->presentWait;
+	if (this->presentWaitEnabled) {
+		enabled.add<VkPhysicalDevicePresentIdFeaturesKHR>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR).presentId = VK_TRUE;
+		enabled.add<VkPhysicalDevicePresentWaitFeaturesKHR>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR).presentWait = VK_TRUE;
+		requiredDeviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+		requiredDeviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+	}
+	// Optional, memoryBudget falls back to a fraction of the heap sizes
+	this->memoryBudgetEnabled = this->deviceProfile.supportsExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (this->memoryBudgetEnabled) {
+		requiredDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+
+	// Optional, lets pipelineManager link pipelines from separately compiled parts
+	auto graphicsPipelineLibrary = supportedFeatures.find<VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT);
+	this->graphicsPipelineLibraryEnabled = graphicsPipelineLibrary != nullptr && graphicsPipelineLibrary->graphicsPipelineLibrary
+		&& this->deviceProfile.supportsExtension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+	if (this->graphicsPipelineLibraryEnabled) {
+		enabled.add<VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>(VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT).graphicsPipelineLibrary = VK_TRUE;
+		requiredDeviceExtensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+		requiredDeviceExtensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+	}
+
+	this->enabledFeatureChain = enabled;
+	this->enabledFeatures = enabled.core();
 
 	VkDeviceCreateInfo deviceCreateInfo{};
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceCreateInfo.pNext = this->enabledFeatureChain.get(); // pEnabledFeatures stays null, the core features are chained
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
 	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-	deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
-	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions.data();
+	deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(requiredDeviceExtensions.size());
+	deviceCreateInfo.ppEnabledExtensionNames = requiredDeviceExtensions.data();
 
 	if (enableValidationLayers) {
 		deviceCreateInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -316,7 +405,16 @@ void VulkanBaseGLFW::createLogicalDevice() {
 
 	vkGetDeviceQueue(this->device, indices.graphicsFamily.value(), 0, &this->graphicsQueue);
 	vkGetDeviceQueue(this->device, indices.presentFamily.value(), 0, &this->presentQueue);
+	vkGetDeviceQueue(this->device, indices.transferFamily.value(), 0, &this->transferQueue);
+
+}
+
+void VulkanBaseGLFW::createUploader() {
+	CPU_TRACE_ZONE("Create uploader");
+	QueueFamilyIndices indices = this->deviceProfile.getQueueFamilies();
 
+	this->uploader.init(this->device, this->memoryAllocator, this->transferQueue, indices.transferFamily.value(), indices.graphicsFamily.value());
+	this->textureLoader.init(this->device, this->deviceProfile, this->memoryAllocator, this->uploader, this->deletionQueue, this->residencyManager);
 }
 
 void VulkanBaseGLFW::createSurface() {
@@ -325,30 +423,6 @@ void VulkanBaseGLFW::createSurface() {
 	}
 }
 
-SwapChainSupportDetails VulkanBaseGLFW::querySwapChainSupport(VkPhysicalDevice device) {
-	SwapChainSupportDetails details;
-
-	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, this->surface, &details.capabilities);
-
-	uint32_t formatCount;
-	vkGetPhysicalDeviceSurfaceFormatsKHR(device, this->surface, &formatCount, nullptr);
-
-	if (formatCount != 0) {
-		details.formats.resize(formatCount);
-		vkGetPhysicalDeviceSurfaceFormatsKHR(device, this->surface, &formatCount, details.formats.data());
-	}
-
-	uint32_t presentModeCount;
-	vkGetPhysicalDeviceSurfacePresentModesKHR(device, this->surface, &presentModeCount, nullptr);
-
-	if (presentModeCount != 0) {
-		details.presentModes.resize(presentModeCount);
-		vkGetPhysicalDeviceSurfacePresentModesKHR(device, this->surface, &presentModeCount, details.presentModes.data());
-	}
-
-	return details;
-}
-
 VkSurfaceFormatKHR VulkanBaseGLFW::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats) {
 	for (const auto& availableFormat : availableFormats) {
 		if (availableFormat.format == VK_FORMAT_B8G8R8A8_SRGB && availableFormat.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
@@ -361,7 +435,7 @@ VkSurfaceFormatKHR VulkanBaseGLFW::chooseSwapSurfaceFormat(const std::vector<VkS
 
 VkPresentModeKHR VulkanBaseGLFW::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
 	for (const auto& availablePresentMode : availablePresentModes) {
-		if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) { // Mailbox is commonly known as "triple buffering" - so may be better for PCs (high energy usage)
+		if (availablePresentMode == this->presentationPolicy.presentMode) {
 			return availablePresentMode;
 		}
 	}
@@ -390,14 +464,17 @@ VkExtent2D VulkanBaseGLFW::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capa
 }
 
 void VulkanBaseGLFW::createSwapChain() {
-	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(this->physicalDevice);
+	CPU_TRACE_ZONE("Create swap chain");
+	// Formats and present modes don't change, the capabilities do (currentExtent follows the window)
+	this->deviceProfile.refreshSurfaceCapabilities();
+	const SwapChainSupportDetails& swapChainSupport = this->deviceProfile.getSwapChainSupport();
 
 	VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-	VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+	this->presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
 	VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-	uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-
+	uint32_t imageCount = this->presentationPolicy.imageCount > 0 ? this->presentationPolicy.imageCount : swapChainSupport.capabilities.minImageCount + 1;
+	imageCount = std::max(imageCount, swapChainSupport.capabilities.minImageCount);
 	if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
 		imageCount = swapChainSupport.capabilities.maxImageCount;
 	}
@@ -415,8 +492,12 @@ void VulkanBaseGLFW::createSwapChain() {
 	// It is also possible to render images to a separate image first to perform operations like post-processing. 
 	// In that case we may use a value like VK_IMAGE_USAGE_TRANSFER_DST_BIT instead and use a memory operation to transfer the rendered image to a swap chain image.
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	// Dynamic resolution does the latter, it may be turned on at any time
+	if (swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) {
+		createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
 
-	QueueFamilyIndices indices = findQueueFamilies(this->physicalDevice);
+	QueueFamilyIndices indices = this->deviceProfile.getQueueFamilies();
 	uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
 	if (indices.areSameFamily()) {
@@ -430,9 +511,10 @@ void VulkanBaseGLFW::createSwapChain() {
 
 	createInfo.preTransform = swapChainSupport.capabilities.currentTransform;
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-	createInfo.presentMode = presentMode;
+	createInfo.presentMode = this->presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	// Handing over the previous swap chain lets the presentation engine reuse its resources, recreateSwapChain retires it
+	createInfo.oldSwapchain = this->swapChain;
 
 	if (vkCreateSwapchainKHR(this->device, &createInfo, nullptr, &this->swapChain) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create Swap Chain");
@@ -447,6 +529,7 @@ void VulkanBaseGLFW::createSwapChain() {
 }
 
 void VulkanBaseGLFW::createImageViews() {
+	CPU_TRACE_ZONE("Create image views");
 	this->swapChainImageViews.resize(this->swapChainImages.size());
 
 	for (size_t i = 0; i < this->swapChainImages.size(); i++) {
@@ -454,7 +537,52 @@ void VulkanBaseGLFW::createImageViews() {
 	}
 }
 
-void VulkanBaseGLFW::createRenderPass() {
+void VulkanBaseGLFW::createRenderFinishedSemaphores() {
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	this->renderFinishedSemaphores.resize(this->swapChainImages.size());
+	for (auto& semaphore : this->renderFinishedSemaphores) {
+		if (vkCreateSemaphore(this->device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create render finished semaphore");
+		}
+	}
+}
+
+void VulkanBaseGLFW::createOffscreenImages() {
+	CPU_TRACE_ZONE("Create offscreen images");
+	// Same role as the swap chain images, but owned by us. They end up in TRANSFER_SRC layout so they can be read back.
+	this->swapChainImageFormat = findSupportedFormat(
+		{VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM},
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT
+	);
+
+	this->swapChainImages.resize(OFFSCREEN_IMAGE_COUNT);
+	this->offscreenImagesAllocations.resize(OFFSCREEN_IMAGE_COUNT);
+	this->swapChainImageViews.resize(OFFSCREEN_IMAGE_COUNT);
+
+	for (uint32_t i = 0; i < OFFSCREEN_IMAGE_COUNT; i++) {
+		createImage(
+			this->swapChainExtent.width,
+			this->swapChainExtent.height,
+			1,
+			VK_SAMPLE_COUNT_1_BIT,
+			this->swapChainImageFormat,
+			VK_IMAGE_TILING_OPTIMAL,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+			this->swapChainImages[i],
+			this->offscreenImagesAllocations[i],
+			AllocationStrategy::FreeList,
+			MemoryCategory::Attachment
+		);
+		this->swapChainImageViews[i] = createImageView(this->swapChainImages[i], this->swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	}
+}
+
+VkRenderPass VulkanBaseGLFW::createRenderPass(VkImageLayout resolveFinalLayout) {
+	CPU_TRACE_ZONE("Create render pass");
 	VkAttachmentDescription colorAttachment{};
 	colorAttachment.format = this->swapChainImageFormat;
 	colorAttachment.samples = this->msaaSamples;
@@ -491,7 +619,7 @@ void VulkanBaseGLFW::createRenderPass() {
 	colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachmentResolve.finalLayout = resolveFinalLayout;
 
 	VkAttachmentReference colorAttachmentResolveRef{};
 	colorAttachmentResolveRef.attachment = 2;
@@ -506,13 +634,23 @@ void VulkanBaseGLFW::createRenderPass() {
 
 	std::array<VkAttachmentDescription, 3> attachments{colorAttachment, depthAttachment, colorAttachmentResolve};
 
-	VkSubpassDependency dependency{};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-	dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	std::array<VkSubpassDependency, 2> dependencies{};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	// Transfer too: the previous frame may still be reading the resolve target (upscale blit, headless read back)
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	// Orders transfers reading the resolve target in TRANSFER_SRC after its final layout transition. Every render pass
+	// gets it, whatever resolveFinalLayout is, so that they all stay compatible with the pipelines of renderPass.
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
 	VkRenderPassCreateInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -520,12 +658,15 @@ void VulkanBaseGLFW::createRenderPass() {
 	renderPassInfo.pAttachments = attachments.data();
 	renderPassInfo.subpassCount = 1;
 	renderPassInfo.pSubpasses = &subpass;
-	renderPassInfo.dependencyCount = 1;
-	renderPassInfo.pDependencies = &dependency;
+	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassInfo.pDependencies = dependencies.data();
 
-	if (vkCreateRenderPass(this->device, &renderPassInfo, nullptr, &this->renderPass) != VK_SUCCESS) {
+	VkRenderPass renderPass;
+	if (vkCreateRenderPass(this->device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
 		throw std::runtime_error("Failed to create render pass");
 	}
+
+	return renderPass;
 }
 
 VkImageView VulkanBaseGLFW::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
@@ -559,8 +700,8 @@ void VulkanBaseGLFW::createDepthResources() {
 	VkFormat depthFormat = findDepthFormat();
 
 	createImage(
-		this->swapChainExtent.width,
-		this->swapChainExtent.height,
+		this->attachmentExtent.width,
+		this->attachmentExtent.height,
 		1,
 		this->msaaSamples,
 		depthFormat,
@@ -568,17 +709,56 @@ void VulkanBaseGLFW::createDepthResources() {
 		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		this->depthImage,
-		this->depthImageMemory
+		this->depthImageAllocation,
+		AllocationStrategy::FreeList,
+		MemoryCategory::Attachment
 	);
 	this->depthImageView = createImageView(this->depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 }
 
+void VulkanBaseGLFW::createAttachments() {
+	CPU_TRACE_ZONE("Create attachments");
+	const VkExtent2D requiredExtent = this->swapChainExtent;
+
+	bool compatible = this->colorImage != VK_NULL_HANDLE
+		&& this->attachmentSamples == this->msaaSamples
+		&& this->attachmentColorFormat == this->swapChainImageFormat
+		&& (this->sceneColorImage != VK_NULL_HANDLE) == this->dynamicResolution.isEnabled();
+	bool fits = compatible
+		&& requiredExtent.width <= this->attachmentExtent.width
+		&& requiredExtent.height <= this->attachmentExtent.height;
+	// Shrink once less than a quarter of the pool is used, so a single huge resize doesn't pin that memory forever
+	bool wasteful = 4ull * requiredExtent.width * requiredExtent.height < static_cast<uint64_t>(this->attachmentExtent.width) * this->attachmentExtent.height;
+
+	if (fits && !wasteful) {
+		return;
+	}
+
+	if (this->colorImage != VK_NULL_HANDLE) {
+		retireAttachments();
+	}
+
+	if (compatible && !wasteful) {
+		// Grow to the largest recent extent, so alternating between wider and taller sizes doesn't reallocate every time
+		this->attachmentExtent.width = std::max(this->attachmentExtent.width, requiredExtent.width);
+		this->attachmentExtent.height = std::max(this->attachmentExtent.height, requiredExtent.height);
+	}
+	else {
+		this->attachmentExtent = requiredExtent;
+	}
+	this->attachmentSamples = this->msaaSamples;
+	this->attachmentColorFormat = this->swapChainImageFormat;
+
+	createColorResources();
+	createDepthResources();
+}
+
 void VulkanBaseGLFW::createColorResources() {
 	VkFormat colorFormat = this->swapChainImageFormat;
 
 	createImage(
-		this->swapChainExtent.width,
-		this->swapChainExtent.height,
+		this->attachmentExtent.width,
+		this->attachmentExtent.height,
 		1,
 		this->msaaSamples,
 		colorFormat,
@@ -586,9 +766,31 @@ void VulkanBaseGLFW::createColorResources() {
 		VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		this->colorImage,
-		this->colorImageMemory
+		this->colorImageAllocation,
+		AllocationStrategy::FreeList,
+		MemoryCategory::Attachment
 	);
 	this->colorImageView = createImageView(this->colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+	if (!this->dynamicResolution.isEnabled()) {
+		return;
+	}
+
+	createImage(
+		this->attachmentExtent.width,
+		this->attachmentExtent.height,
+		1,
+		VK_SAMPLE_COUNT_1_BIT,
+		colorFormat,
+		VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		this->sceneColorImage,
+		this->sceneColorImageAllocation,
+		AllocationStrategy::FreeList,
+		MemoryCategory::Attachment
+	);
+	this->sceneColorImageView = createImageView(this->sceneColorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 }
 
 VKAPI_ATTR VkBool32 VKAPI_CALL VulkanBaseGLFW::debugCallback(
@@ -603,43 +805,119 @@ VKAPI_ATTR VkBool32 VKAPI_CALL VulkanBaseGLFW::debugCallback(
 }
 
 VkShaderModule VulkanBaseGLFW::createShaderModule(const std::vector<char>& code) {
-	VkShaderModuleCreateInfo createInfo{};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+	return this->pipelineCache.getShaderModule(code);
+}
 
-	VkShaderModule shaderModule;
-	if (vkCreateShaderModule(this->device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to create shader module");
+void VulkanBaseGLFW::recreateSwapChain() {
+	CPU_TRACE_ZONE("Recreate swap chain");
+	if (!this->headless) {
+		// A minimized window has a zero sized framebuffer, wait until it is visible again
+		int width = 0, height = 0;
+		glfwGetFramebufferSize(this->window, &width, &height);
+		while (width == 0 || height == 0) {
+			glfwGetFramebufferSize(this->window, &width, &height);
+			glfwWaitEvents();
+		}
 	}
 
-	return shaderModule;
+	// Nothing is destroyed and the device is not drained: frames in flight may still use the old swap chain, its views
+	// and framebuffers, so they go to deletionQueue and are destroyed once frameTimeline shows those frames completed
+	retireSwapChain();
+	this->framePacer.onSwapChainRecreated();
+
+	if (this->headless) {
+		createOffscreenImages();
+	}
+	else {
+		createSwapChain();
+		createImageViews();
+		createRenderFinishedSemaphores();
+	}
+	createAttachments();
+	createFramebuffers();
+	this->renderExtent = this->dynamicResolution.scaleExtent(this->swapChainExtent);
+
+	onSwapChainRecreated();
 }
 
-void VulkanBaseGLFW::recreateSwapChain() {
-	cleanupSwapChain();
+void VulkanBaseGLFW::retireSwapChain() {
+	for (auto framebuffer : this->swapChainFramebuffers) {
+		this->deletionQueue.retireFramebuffer(framebuffer);
+	}
+	for (auto imageView : this->swapChainImageViews) {
+		this->deletionQueue.retireImageView(imageView);
+	}
+	if (this->headless) {
+		for (size_t i = 0; i < this->swapChainImages.size(); i++) {
+			this->deletionQueue.retireImage(this->swapChainImages[i], this->offscreenImagesAllocations[i]);
+		}
+	}
+	else {
+		// Still used as oldSwapchain by createSwapChain, the handle stays valid until the frames in flight complete
+		this->deletionQueue.retireSwapchain(this->swapChain);
+		for (auto semaphore : this->renderFinishedSemaphores) {
+			this->deletionQueue.retireSemaphore(semaphore);
+		}
+		this->renderFinishedSemaphores.clear();
+	}
 
-	createSwapChain();
-	createImageViews();
-	createColorResources();
-	createDepthResources();
+	this->swapChainFramebuffers.clear();
+	this->swapChainImageViews.clear();
+	this->swapChainImages.clear();
+	this->offscreenImagesAllocations.clear();
+}
+
+void VulkanBaseGLFW::retireAttachments() {
+	this->deletionQueue.retireImageView(this->colorImageView);
+	this->deletionQueue.retireImageView(this->depthImageView);
+	this->deletionQueue.retireImage(this->colorImage, this->colorImageAllocation);
+	this->deletionQueue.retireImage(this->depthImage, this->depthImageAllocation);
+
+	this->colorImage = VK_NULL_HANDLE;
+	this->colorImageAllocation = MemoryAllocation{};
+	this->depthImage = VK_NULL_HANDLE;
+	this->depthImageAllocation = MemoryAllocation{};
+
+	if (this->sceneColorImage != VK_NULL_HANDLE) {
+		this->deletionQueue.retireImageView(this->sceneColorImageView);
+		this->deletionQueue.retireImage(this->sceneColorImage, this->sceneColorImageAllocation);
+		this->sceneColorImage = VK_NULL_HANDLE;
+		this->sceneColorImageAllocation = MemoryAllocation{};
+		this->sceneColorImageView = VK_NULL_HANDLE;
+	}
 }
 
 void VulkanBaseGLFW::cleanupSwapChain() {
+	for (auto framebuffer : this->swapChainFramebuffers) {
+		vkDestroyFramebuffer(this->device, framebuffer, nullptr);
+	}
+
 	vkDestroyImageView(this->device, this->colorImageView, nullptr);
-	vkDestroyImage(this->device, this->colorImage, nullptr);
-	vkFreeMemory(this->device, this->colorImageMemory, nullptr);
+	destroyImage(this->colorImage, this->colorImageAllocation);
 	vkDestroyImageView(this->device, this->depthImageView, nullptr);
-	vkDestroyImage(this->device, this->depthImage, nullptr);
-	vkFreeMemory(this->device, this->depthImageMemory, nullptr);
+	destroyImage(this->depthImage, this->depthImageAllocation);
+	if (this->sceneColorImage != VK_NULL_HANDLE) {
+		vkDestroyImageView(this->device, this->sceneColorImageView, nullptr);
+		destroyImage(this->sceneColorImage, this->sceneColorImageAllocation);
+	}
 	for (auto imageView : this->swapChainImageViews) {
 		vkDestroyImageView(this->device, imageView, nullptr);
 	}
 
+	if (this->headless) {
+		for (size_t i = 0; i < this->swapChainImages.size(); i++) {
+			destroyImage(this->swapChainImages[i], this->offscreenImagesAllocations[i]);
+		}
+		return;
+	}
+
 	vkDestroySwapchainKHR(this->device, this->swapChain, nullptr);
+	for (auto semaphore : this->renderFinishedSemaphores) {
+		vkDestroySemaphore(this->device, semaphore, nullptr);
+	}
 }
 
-void VulkanBaseGLFW::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSample, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+void VulkanBaseGLFW::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSample, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageAllocation, AllocationStrategy strategy, MemoryCategory category) {
 	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 	imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -659,47 +937,42 @@ void VulkanBaseGLFW::createImage(uint32_t width, uint32_t height, uint32_t mipLe
 		throw std::runtime_error("Failed to create image");
 	}
 
-	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(this->device, image, &memRequirements);
+	imageAllocation = this->memoryAllocator.allocateForImage(image, tiling, properties, strategy, category);
+}
+
+void VulkanBaseGLFW::destroyImage(VkImage& image, MemoryAllocation& imageAllocation) {
+	vkDestroyImage(this->device, image, nullptr);
+	this->memoryAllocator.free(imageAllocation);
+	image = VK_NULL_HANDLE;
+}
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+void VulkanBaseGLFW::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferAllocation, AllocationStrategy strategy) {
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	if (vkAllocateMemory(this->device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("Failed to allocate image memory");
+	if (vkCreateBuffer(this->device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create buffer");
 	}
 
-	vkBindImageMemory(this->device, image, imageMemory, 0);
+	bufferAllocation = this->memoryAllocator.allocateForBuffer(buffer, properties, strategy);
 }
 
+void VulkanBaseGLFW::destroyBuffer(VkBuffer& buffer, MemoryAllocation& bufferAllocation) {
+	vkDestroyBuffer(this->device, buffer, nullptr);
+	this->memoryAllocator.free(bufferAllocation);
+	buffer = VK_NULL_HANDLE;
+}
 
-uint32_t VulkanBaseGLFW::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-	VkPhysicalDeviceMemoryProperties memoryProperties;
-	vkGetPhysicalDeviceMemoryProperties(this->physicalDevice, &memoryProperties);
 
-	for (int i = 0; i < memoryProperties.memoryTypeCount; i++) {
-		if ((typeFilter && (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)) {
-			return i;
-		}
-	}
+uint32_t VulkanBaseGLFW::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+	return this->deviceProfile.findMemoryType(typeFilter, properties);
 }
 
 VkFormat VulkanBaseGLFW::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
-	for (VkFormat format : candidates) {
-		VkFormatProperties props;
-		vkGetPhysicalDeviceFormatProperties(this->physicalDevice, format, &props);
-
-		if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
-			return format;
-		}
-		else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
-			return format;
-		}
-	}
-
-	throw std::runtime_error("Failed to find supported format");
+	return this->deviceProfile.findSupportedFormat(candidates, tiling, features);
 }
 
 VkFormat VulkanBaseGLFW::findDepthFormat() {
@@ -720,18 +993,381 @@ void VulkanBaseGLFW::framebufferResizeCallback(GLFWwindow* window, int width, in
 	app->framebufferResized = true;
 }
 
-VkSampleCountFlagBits VulkanBaseGLFW::getMaxUsableSampleCount() {
-	VkPhysicalDeviceProperties properties;
-	vkGetPhysicalDeviceProperties(this->physicalDevice, &properties);
+void VulkanBaseGLFW::createFramebuffers() {
+	CPU_TRACE_ZONE("Create framebuffers");
+	this->swapChainFramebuffers.resize(this->swapChainImageViews.size());
+
+	for (size_t i = 0; i < this->swapChainImageViews.size(); i++) {
+		// Same order as the attachments of createRenderPass: multisampled color, depth, resolve target. With dynamic
+		// resolution every framebuffer resolves into sceneColorImage, they stay one per image for imageIndex lookups.
+		VkImageView resolveView = this->dynamicResolution.isEnabled() ? this->sceneColorImageView : this->swapChainImageViews[i];
+		std::array<VkImageView, 3> attachments = { this->colorImageView, this->depthImageView, resolveView };
+
+		VkFramebufferCreateInfo framebufferInfo{};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = this->dynamicResolution.isEnabled() ? this->scaledRenderPass : this->renderPass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebufferInfo.pAttachments = attachments.data();
+		framebufferInfo.width = this->swapChainExtent.width;
+		framebufferInfo.height = this->swapChainExtent.height;
+		framebufferInfo.layers = 1;
+
+		if (vkCreateFramebuffer(this->device, &framebufferInfo, nullptr, &this->swapChainFramebuffers[i]) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create framebuffer");
+		}
+	}
+
+	this->imagesInFlight.assign(this->swapChainImages.size(), 0);
+}
+
+void VulkanBaseGLFW::createFrameResources() {
+	CPU_TRACE_ZONE("Create frame resources");
+	QueueFamilyIndices indices = this->deviceProfile.getQueueFamilies();
+
+	this->frames.resize(MAX_FRAMES_IN_FLIGHT);
+
+	for (auto& frame : this->frames) {
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // Reset as a whole every time the slot comes around
+		poolInfo.queueFamilyIndex = indices.graphicsFamily.value();
+
+		if (vkCreateCommandPool(this->device, &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create command pool");
+		}
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.commandPool = frame.commandPool;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+
+		if (vkAllocateCommandBuffers(this->device, &allocInfo, &frame.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to allocate command buffer");
+		}
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+		// Binary, the swap chain cannot wait on or signal timeline semaphores
+		if (vkCreateSemaphore(this->device, &semaphoreInfo, nullptr, &frame.imageAvailableSemaphore) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to create frame synchronization objects");
+		}
+		frame.timelineValue = 0;
+	}
+
+	VkSemaphoreTypeCreateInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	timelineInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &timelineInfo;
+
+	if (vkCreateSemaphore(this->device, &semaphoreInfo, nullptr, &this->frameTimeline) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to create frame timeline semaphore");
+	}
+	this->deletionQueue.init(this->device, this->memoryAllocator, this->frameTimeline);
+
+	this->uniformAllocator.init(this->device, this->deviceProfile, this->memoryAllocator, MAX_FRAMES_IN_FLIGHT, this->frameUniformSize);
+	this->frameDescriptors.init(this->device, MAX_FRAMES_IN_FLIGHT);
+	this->framePacer.init(this->device, this->frameTimeline, this->presentWaitEnabled);
+	this->framePacer.setPolicy(this->presentationPolicy);
+}
+
+void VulkanBaseGLFW::cleanupFrameResources() {
+	this->framePacer.cleanup();
+	this->frameDescriptors.cleanup();
+	this->uniformAllocator.cleanup();
+	vkDestroySemaphore(this->device, this->frameTimeline, nullptr);
+	for (auto& frame : this->frames) {
+		vkDestroySemaphore(this->device, frame.imageAvailableSemaphore, nullptr);
+		vkDestroyCommandPool(this->device, frame.commandPool, nullptr);
+	}
+	this->frames.clear();
+}
+
+void VulkanBaseGLFW::run(uint64_t maxFrames) {
+	for (uint64_t i = 0; i < maxFrames; i++) {
+		// Before polling, so the input is as recent as possible once the frame starts
+		this->framePacer.waitForNextFrame(this->headless ? VK_NULL_HANDLE : this->swapChain);
+		if (!this->headless) {
+			if (glfwWindowShouldClose(this->window)) break;
+			glfwPollEvents();
+		}
+		drawFrame();
+	}
+
+	// Only the frames, uploads on the transfer queue may still be running
+	waitForFrameTimeline(this->frameNumber);
+}
+
+void VulkanBaseGLFW::setPresentationPolicy(const PresentationPolicy& policy) {
+	const bool swapChainChanged = policy.presentMode != this->presentationPolicy.presentMode || policy.imageCount != this->presentationPolicy.imageCount;
+	this->presentationPolicy = policy;
+	this->presentationPolicy.framesInFlight = std::clamp(policy.framesInFlight, 1u, MAX_FRAMES_IN_FLIGHT);
+
+	// With every slot idle the frames can restart from the first one whatever their count
+	waitForFrameTimeline(this->frameNumber);
+	this->framesInFlight = this->presentationPolicy.framesInFlight;
+	this->currentFrame = 0;
+	this->framePacer.setPolicy(this->presentationPolicy);
+
+	if (swapChainChanged && !this->headless) {
+		recreateSwapChain();
+	}
+}
+
+void VulkanBaseGLFW::setDynamicResolution(const DynamicResolutionSettings& settings) {
+	if (settings.enabled && !canUpscale()) {
+		throw std::runtime_error("Dynamic resolution needs swap chain images that can be blit to");
+	}
+
+	const bool toggled = settings.enabled != this->dynamicResolution.isEnabled();
+	this->dynamicResolution.setSettings(settings, this->frameNumber);
+
+	// Allocates or releases sceneColorImage and points the framebuffers at the right resolve target
+	if (toggled) {
+		recreateSwapChain();
+	}
+	this->renderExtent = this->dynamicResolution.scaleExtent(this->swapChainExtent);
+}
+
+void VulkanBaseGLFW::waitForFrameTimeline(uint64_t timelineValue) {
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &this->frameTimeline;
+	waitInfo.pValues = &timelineValue;
+
+	if (vkWaitSemaphores(this->device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+		throw std::runtime_error("Failed to wait for the frame timeline semaphore");
+	}
+}
+
+bool VulkanBaseGLFW::drawFrame() {
+	CPU_TRACE_ZONE("Frame");
+	FrameResources& frame = this->frames[this->currentFrame];
+	this->framePacer.beginFrame();
+
+	{
+		CPU_TRACE_ZONE("Wait for frame slot");
+		// Only waits for the GPU work submitted framesInFlight frames ago
+		waitForFrameTimeline(frame.timelineValue);
+		this->deletionQueue.collect();
+		this->framePacer.collect(this->swapChain);
+		this->memoryBudget.update();
+		this->residencyManager.update(this->frameNumber);
+	}
 
-	VkSampleCountFlags counts = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+	uint32_t imageIndex;
+	{
+		CPU_TRACE_ZONE("Acquire");
+		if (this->headless) {
+			imageIndex = static_cast<uint32_t>(this->frameNumber % this->swapChainImages.size());
+		}
+		else {
+			VkResult result = vkAcquireNextImageKHR(this->device, this->swapChain, UINT64_MAX, frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+			if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+				recreateSwapChain();
+				return false;
+			}
+			else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+				throw std::runtime_error("Failed to acquire swap chain image");
+			}
+		}
 
-	VkSampleCountFlagBits alternatives[6] { VK_SAMPLE_COUNT_64_BIT, VK_SAMPLE_COUNT_32_BIT, VK_SAMPLE_COUNT_16_BIT, VK_SAMPLE_COUNT_8_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_2_BIT };
-	for (auto& flag : alternatives) {
-		if (counts & flag) {
-			return flag;
+		// The image may still be in use by a frame recorded in another slot
+		if (this->imagesInFlight[imageIndex] > frame.timelineValue) {
+			waitForFrameTimeline(this->imagesInFlight[imageIndex]);
 		}
+		this->imagesInFlight[imageIndex] = this->frameNumber + 1;
 	}
 
-	return VK_SAMPLE_COUNT_1_BIT;
+	{
+		CPU_TRACE_ZONE("Record");
+		vkResetCommandPool(this->device, frame.commandPool, 0);
+		this->parallelRecorder.beginFrame(this->currentFrame);
+		this->uniformAllocator.beginFrame(this->currentFrame);
+		this->frameDescriptors.beginFrame(this->currentFrame);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if (vkBeginCommandBuffer(frame.commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to begin recording command buffer");
+		}
+
+		this->gpuProfiler.beginFrame(frame.commandBuffer, this->currentFrame, this->frameNumber);
+		if (this->dynamicResolution.isEnabled()) {
+			const GpuFrameResult& gpuFrame = this->gpuProfiler.getLastFrame();
+			if (!gpuFrame.scopes.empty()) {
+				this->dynamicResolution.addSample(gpuFrame.frameNumber, gpuFrame.scopes[0].durationMilliseconds);
+			}
+			this->dynamicResolution.update(this->frameNumber);
+			this->renderExtent = this->dynamicResolution.scaleExtent(this->swapChainExtent);
+		}
+		UploadToken acquiredToken = this->uploader.recordAcquireBarriers(frame.commandBuffer);
+		this->textureLoader.recordPendingMips(frame.commandBuffer, acquiredToken, this->frameNumber);
+		recordCommandBuffer(frame, imageIndex);
+		if (this->dynamicResolution.isEnabled()) {
+			recordUpscale(frame.commandBuffer, imageIndex);
+		}
+		this->gpuProfiler.endFrame(frame.commandBuffer);
+
+		if (vkEndCommandBuffer(frame.commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to record command buffer");
+		}
+	}
+
+	{
+		CPU_TRACE_ZONE("Submit");
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		frame.timelineValue = this->frameNumber + 1;
+
+		// The binary render finished semaphore ignores its value
+		VkSemaphore signalSemaphores[] = { this->frameTimeline, this->headless ? VK_NULL_HANDLE : this->renderFinishedSemaphores[imageIndex] };
+		uint64_t signalValues[] = { frame.timelineValue, 0 };
+
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = this->headless ? 1 : 2;
+		timelineInfo.pSignalSemaphoreValues = signalValues;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = &timelineInfo;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &frame.commandBuffer;
+		submitInfo.signalSemaphoreCount = this->headless ? 1 : 2;
+		submitInfo.pSignalSemaphores = signalSemaphores;
+		if (!this->headless) {
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &frame.imageAvailableSemaphore;
+			submitInfo.pWaitDstStageMask = &waitStage;
+		}
+
+		if (vkQueueSubmit(this->graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+			throw std::runtime_error("Failed to submit draw command buffer");
+		}
+	}
+
+	this->currentFrame = (this->currentFrame + 1) % this->framesInFlight;
+	this->frameNumber++;
+	// Objects retired from now on may be used by the next frame
+	this->deletionQueue.setRetireValue(this->frameNumber + 1);
+	const uint64_t presentId = this->framePacer.endFrame(frame.timelineValue);
+
+	if (this->headless) {
+		return true;
+	}
+
+	VkPresentIdKHR presentIdInfo{};
+	presentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+	presentIdInfo.swapchainCount = 1;
+	presentIdInfo.pPresentIds = &presentId;
+
+	VkPresentInfoKHR presentInfo{};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+	presentInfo.pNext = this->framePacer.usesPresentWait() ? &presentIdInfo : nullptr;
+	presentInfo.waitSemaphoreCount = 1;
+	presentInfo.pWaitSemaphores = &this->renderFinishedSemaphores[imageIndex];
+	presentInfo.swapchainCount = 1;
+	presentInfo.pSwapchains = &this->swapChain;
+	presentInfo.pImageIndices = &imageIndex;
+
+	CPU_TRACE_ZONE("Present");
+	VkResult result = vkQueuePresentKHR(this->presentQueue, &presentInfo);
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || this->framebufferResized) {
+		this->framebufferResized = false;
+		recreateSwapChain();
+	}
+	else if (result != VK_SUCCESS) {
+		throw std::runtime_error("Failed to present swap chain image");
+	}
+
+	return true;
+}
+
+void VulkanBaseGLFW::recordCommandBuffer(FrameResources& frame, uint32_t imageIndex) {
+	// Subclasses override this, by default the frame is just cleared
+	GpuScope scope(this->gpuProfiler, frame.commandBuffer, "Main pass");
+	beginRenderPass(frame.commandBuffer, imageIndex);
+	vkCmdEndRenderPass(frame.commandBuffer);
+}
+
+void VulkanBaseGLFW::recordParallel(FrameResources& frame, uint32_t imageIndex, uint32_t itemCount, uint32_t chunkSize, const ParallelRecorder::RecordFunction& function) {
+	GpuScope scope(this->gpuProfiler, frame.commandBuffer, "Main pass");
+	beginRenderPass(frame.commandBuffer, imageIndex, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	this->parallelRecorder.record(frame.commandBuffer, this->renderPass, 0, this->swapChainFramebuffers[imageIndex], itemCount, chunkSize, function);
+	vkCmdEndRenderPass(frame.commandBuffer);
+}
+
+void VulkanBaseGLFW::beginRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkSubpassContents contents) {
+	std::array<VkClearValue, 2> clearValues{};
+	clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+	clearValues[1].depthStencil = { 1.0f, 0 };
+
+	VkRenderPassBeginInfo renderPassInfo{};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassInfo.renderPass = this->dynamicResolution.isEnabled() ? this->scaledRenderPass : this->renderPass;
+	renderPassInfo.framebuffer = this->swapChainFramebuffers[imageIndex];
+	renderPassInfo.renderArea.offset = { 0, 0 };
+	renderPassInfo.renderArea.extent = this->renderExtent;
+	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+	renderPassInfo.pClearValues = clearValues.data();
+
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+}
+
+bool VulkanBaseGLFW::canUpscale() {
+	const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+	if ((this->deviceProfile.getFormatProperties(this->swapChainImageFormat).optimalTilingFeatures & blitFeatures) != blitFeatures) {
+		return false;
+	}
+	// Offscreen images are always created as transfer destinations
+	return this->headless || (this->deviceProfile.getSwapChainSupport().capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) != 0;
+}
+
+void VulkanBaseGLFW::recordUpscale(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+	GpuScope scope(this->gpuProfiler, commandBuffer, "Upscale");
+	VkImage swapChainImage = this->swapChainImages[imageIndex];
+
+	// The scene is already in TRANSFER_SRC and the render pass dependency to the transfer stage made it readable. The
+	// acquire semaphore is waited on at the color attachment output stage, which the barrier chains with.
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.image = swapChainImage;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkImageBlit blit{};
+	blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	blit.srcOffsets[1] = { static_cast<int32_t>(this->renderExtent.width), static_cast<int32_t>(this->renderExtent.height), 1 };
+	blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	blit.dstOffsets[1] = { static_cast<int32_t>(this->swapChainExtent.width), static_cast<int32_t>(this->swapChainExtent.height), 1 };
+
+	// Bilinear when the format allows it
+	const bool linear = (this->deviceProfile.getFormatProperties(this->swapChainImageFormat).optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) != 0;
+	vkCmdBlitImage(commandBuffer, this->sceneColorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapChainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, linear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST);
+
+	// Same final layout as renderPass gives the resolve target
+	VkImageMemoryBarrier present = barrier;
+	present.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	present.dstAccessMask = 0;
+	present.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	present.newLayout = this->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &present);
 }
\ No newline at end of file
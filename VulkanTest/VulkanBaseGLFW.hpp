@@ -11,6 +11,26 @@
 #include <algorithm>
 
 #include "types.hpp"
+#include "DeviceProfile.hpp"
+#include "DeviceMemoryAllocator.hpp"
+#include "MemoryBudget.hpp"
+#include "ResidencyManager.hpp"
+#include "PipelineCache.hpp"
+#include "StagingUploader.hpp"
+#include "TextureLoader.hpp"
+#include "ThreadPool.hpp"
+#include "PipelineManager.hpp"
+#include "FeatureChain.hpp"
+#include "DeferredDeletionQueue.hpp"
+#include "ParallelRecorder.hpp"
+#include "GpuProfiler.hpp"
+#include "UniformAllocator.hpp"
+#include "DescriptorHeap.hpp"
+#include "FrameDescriptorAllocator.hpp"
+#include "RenderGraph.hpp"
+#include "FramePacer.hpp"
+#include "DynamicResolution.hpp"
+#include "CpuTrace.hpp"
 
 const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
 const std::vector<const char*> deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
@@ -25,50 +45,175 @@ VkResult CreateDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMes
 
 void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT debugMessenger, const VkAllocationCallbacks* pAllocator);
 
+// Everything a frame slot owns, so that recording frame N+1 never touches resources the GPU may still be using for frame N
+struct FrameResources {
+	VkCommandPool commandPool;
+	VkCommandBuffer commandBuffer;
+	uint64_t timelineValue = 0; // frameTimeline value signaled by the last frame submitted from this slot
+	VkSemaphore imageAvailableSemaphore;
+};
+
 class VulkanBaseGLFW
 {
 public:
-	VulkanBaseGLFW(const char* applicationName, const int width, const int height) {
-		this->initWindow(applicationName, width, height);
+	static constexpr VkDeviceSize DEFAULT_FRAME_UNIFORM_SIZE = 256 * 1024;
+
+	// In headless mode no window or surface is created: rendering goes to a ring of offscreen images
+	// exposed through swapChainImages/swapChainImageViews, so it also works on machines without a display
+	// and on CPU implementations such as lavapipe or SwiftShader.
+	// frameUniformSize is the uniform bytes each frame can allocate from uniformAllocator.
+	VulkanBaseGLFW(const char* applicationName, const int width, const int height, const bool headless = false, const VkDeviceSize frameUniformSize = DEFAULT_FRAME_UNIFORM_SIZE)
+		: headless(headless), frameUniformSize(frameUniformSize) {
+		if (this->headless) {
+			this->swapChainExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+		}
+		else {
+			this->initWindow(applicationName, width, height);
+		}
 		this->initVulkan(applicationName);
 	}
 	~VulkanBaseGLFW() {
 		this->cleanup();
 	}
 
+	// Draws frames until the window is closed or maxFrames frames have been submitted
+	void run(uint64_t maxFrames = UINT64_MAX);
+
+	// Waits for the frames in flight, then recreates the swap chain if its present mode or image count changed.
+	// framesInFlight is clamped to [1, MAX_FRAMES_IN_FLIGHT].
+	void setPresentationPolicy(const PresentationPolicy& policy);
+
+	const PresentationPolicy& getPresentationPolicy() const { return this->presentationPolicy; }
+
+	const LatencyStats& getLatencyStats() const { return this->framePacer.getLatencyStats(); }
+
+	// Renders the scene at a scale of swapChainExtent picked from the measured GPU frame time, then blits it to the
+	// swap chain image. The attachments stay allocated at full size, only renderExtent changes with the scale. Turning
+	// it on or off recreates the swap chain. Without GPU timestamps the scale stays at maxScale. Throws when the swap
+	// chain images can't be blit to.
+	void setDynamicResolution(const DynamicResolutionSettings& settings);
+
+	const DynamicResolutionSettings& getDynamicResolution() const { return this->dynamicResolution.getSettings(); }
+
+	float getRenderScale() const { return this->dynamicResolution.getScale(); }
+
 protected:
-	GLFWwindow* window;
+	static constexpr uint32_t OFFSCREEN_IMAGE_COUNT = 3;
+	static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 3; // Per frame resources are sized for it, framesInFlight are used
+
+	const bool headless;
+	GLFWwindow* window = nullptr;
 	VkInstance instance;
 	VkDebugUtilsMessengerEXT debugMessenger;
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE; // This is destroyed when VkInstance is destroyed, therefore we don't need to destroy it in the cleanUp function
+	DeviceProfile deviceProfile; // Cached capabilities of physicalDevice, prefer it over querying the device again
 	VkDevice device;
+	uint32_t apiVersion = VK_API_VERSION_1_2; // Negotiated with the loader, then with the device: 1.2 or 1.3
+	FeatureChain enabledFeatureChain; // Features device was created with, a subset of deviceProfile.getFeatureChain()
+	VkPhysicalDeviceFeatures enabledFeatures{}; // Core part of enabledFeatureChain
+	bool drawIndirectCountEnabled = false; // The Vulkan 1.2 drawIndirectCount feature is enabled on device
+	bool graphicsPipelineLibraryEnabled = false; // VK_EXT_graphics_pipeline_library is enabled on device, used by pipelineManager
+	bool presentWaitEnabled = false; // VK_KHR_present_id and VK_KHR_present_wait are enabled on device, used by framePacer
+	bool memoryBudgetEnabled = false; // VK_EXT_memory_budget is enabled on device, used by memoryBudget
+	bool descriptorIndexingEnabled = false; // Update after bind descriptor indexing is enabled on device, descriptorHeap is usable
 	VkQueue graphicsQueue;
-	VkSurfaceKHR surface;
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
 	VkQueue presentQueue;
-	VkSwapchainKHR swapChain;
+	VkQueue transferQueue;
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR; // Of swapChain, presentationPolicy's when supported
 	std::vector<VkImage> swapChainImages;
 	std::vector<VkImageView> swapChainImageViews;
+	// One per swap chain image, not per frame slot: nothing tells when a present stopped waiting on its semaphore,
+	// only that the image was acquired again. Empty in headless mode.
+	std::vector<VkSemaphore> renderFinishedSemaphores;
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
+	std::vector<MemoryAllocation> offscreenImagesAllocations; // Only used in headless mode, backs swapChainImages
 	VkRenderPass renderPass;
-	VkImage depthImage;
-	VkDeviceMemory depthImageMemory;
+	// Same as renderPass but resolving into sceneColorImage for the upscale blit, the two are compatible
+	VkRenderPass scaledRenderPass = VK_NULL_HANDLE;
+	std::vector<VkFramebuffer> swapChainFramebuffers;
+	VkImage depthImage = VK_NULL_HANDLE;
+	MemoryAllocation depthImageAllocation;
 	VkImageView depthImageView;
-	VkImage colorImage;
-	VkDeviceMemory colorImageMemory;
+	VkImage colorImage = VK_NULL_HANDLE;
+	MemoryAllocation colorImageAllocation;
 	VkImageView colorImageView;
+	// Resolve target of the scene, only allocated with dynamic resolution. It is blit to the swap chain image.
+	VkImage sceneColorImage = VK_NULL_HANDLE;
+	MemoryAllocation sceneColorImageAllocation;
+	VkImageView sceneColorImageView = VK_NULL_HANDLE;
+	// colorImage/depthImage are pooled: they are only reallocated when the swap chain outgrows them, so they can be
+	// larger than swapChainExtent
+	VkExtent2D attachmentExtent = { 0, 0 };
+	VkSampleCountFlagBits attachmentSamples = VK_SAMPLE_COUNT_1_BIT;
+	VkFormat attachmentColorFormat = VK_FORMAT_UNDEFINED;
+	// Scene passes render at it, at the top left of the attachments: swapChainExtent, scaled down by dynamic
+	// resolution. Set viewports and scissors to it.
+	VkExtent2D renderExtent = { 0, 0 };
 	bool framebufferResized = false;
 	VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
-
+	DeviceMemoryAllocator memoryAllocator;
+	MemoryBudget memoryBudget; // Updated every frame, add pressure listeners to react to it
+	ResidencyManager residencyManager; // Add streamed resources and touch them when drawn, the LRU ones are released over budget
+	PipelineCache pipelineCache; // Pass pipelineCache.getHandle() to vkCreate*Pipelines
+	StagingUploader uploader; // Asynchronous uploads, acquire barriers are recorded at the start of every frame
+	TextureLoader textureLoader; // Uploads through uploader, mip chains are blit at the start of the first frame after
+	ThreadPool threadPool;
+	PipelineManager pipelineManager; // Compiles on its own threads, the main render pass is registered as "main"
+	ParallelRecorder parallelRecorder; // Secondary command buffers recorded on threadPool, see recordParallel
+	GpuProfiler gpuProfiler; // Every frame is a scope, add nested ones with GpuScope around passes and dispatches
+	RenderGraph renderGraph; // Empty unless a subclass declares passes, execute it from recordCommandBuffer
+	UniformAllocator uniformAllocator; // Reset every frame, push FrameUniforms once and ObjectUniforms per draw
+	DescriptorHeap descriptorHeap; // Bindless textures, buffers and samplers, only initialized when descriptorIndexingEnabled
+	FrameDescriptorAllocator frameDescriptors; // Sets for the current frame only, recycled with the frame slot
+	std::vector<FrameResources> frames;
+	VkSemaphore frameTimeline = VK_NULL_HANDLE; // Timeline semaphore, every frame submit signals frameNumber + 1
+	DeferredDeletionQueue deletionQueue; // Retire objects in use by recorded frames here instead of waiting for the device
+	std::vector<uint64_t> imagesInFlight; // frameTimeline value of the last frame rendering to each swap chain image
+	PresentationPolicy presentationPolicy;
+	FramePacer framePacer; // Frame limiter and input to present latency, see presentationPolicy
+	DynamicResolution dynamicResolution; // Render scale of each frame, fed the GPU time of the "Frame" scope
+	uint32_t framesInFlight = 2; // Frame slots in use, presentationPolicy.framesInFlight
+	uint32_t currentFrame = 0;
+	uint64_t frameNumber = 0; // Frames submitted so far
+	const VkDeviceSize frameUniformSize; // Uniform bytes each frame can allocate from uniformAllocator, given to the constructor
+
+	// Called once per frame between vkBeginCommandBuffer and vkEndCommandBuffer on frame.commandBuffer
+	virtual void recordCommandBuffer(FrameResources& frame, uint32_t imageIndex);
+
+	// Acquires an image, records and submits the current frame slot and presents it.
+	// Returns false when the swap chain was out of date and the frame had to be skipped.
+	bool drawFrame();
+
+	void beginRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+
+	// Begins the render pass, records [0, itemCount) in chunks of chunkSize items on every thread of threadPool and
+	// ends the render pass. function sets its own viewport and scissor, secondaries don't inherit them.
+	void recordParallel(FrameResources& frame, uint32_t imageIndex, uint32_t itemCount, uint32_t chunkSize, const ParallelRecorder::RecordFunction& function);
+
+	// Modules are deduplicated by content and owned by pipelineCache, they are destroyed in cleanup
 	VkShaderModule createShaderModule(const std::vector<char>& code);
 
-	QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
-
 	void recreateSwapChain();
 
+	// Blocks until frameTimeline reaches timelineValue, i.e. until the first timelineValue frames have completed
+	void waitForFrameTimeline(uint64_t timelineValue);
+
+	// Called at the end of recreateSwapChain, to rebuild what depends on the swap chain size (render graph passes...)
+	virtual void onSwapChainRecreated() {}
+
 	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
-	void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSample, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+	void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSample, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageAllocation, AllocationStrategy strategy = AllocationStrategy::FreeList, MemoryCategory category = MemoryCategory::Texture);
+
+	void destroyImage(VkImage& image, MemoryAllocation& imageAllocation);
+
+	// Host visible buffers are persistently mapped, see MemoryAllocation::mappedData
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation& bufferAllocation, AllocationStrategy strategy = AllocationStrategy::FreeList);
+
+	void destroyBuffer(VkBuffer& buffer, MemoryAllocation& bufferAllocation);
 
 	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
 
@@ -80,6 +225,10 @@ private:
 
 	void cleanupSwapChain();
 
+	void retireSwapChain();
+
+	void retireAttachments();
+
 	void initVulkan(const char* applicationName);
 
 	void createVulkanInstance(const char* applicationName);
@@ -88,7 +237,7 @@ private:
 
 	bool checkValidationLayerSupport();
 
-	bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+	std::vector<const char*> getRequiredDeviceExtensions();
 
 	std::vector<const char*> getRequiredExtensions();
 
@@ -98,13 +247,13 @@ private:
 
 	void pickPhysicalDevice();
 
-	bool isDeviceSuitable(VkPhysicalDevice device);
+	bool isDeviceSuitable(const DeviceProfile& profile);
 
 	void createLogicalDevice();
 
-	void createSurface();
+	void createUploader();
 
-	SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
+	void createSurface();
 
 	VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 
@@ -116,12 +265,31 @@ private:
 
 	void createImageViews();
 
-	void createRenderPass();
+	void createRenderFinishedSemaphores();
+
+	void createOffscreenImages();
+
+	// Only the final layout of the resolve target differs between renderPass and scaledRenderPass
+	VkRenderPass createRenderPass(VkImageLayout resolveFinalLayout);
 
 	void createDepthResources();
 
 	void createColorResources();
 
+	void createAttachments();
+
+	void createFramebuffers();
+
+	// Whether the swap chain images can be blit to, which dynamic resolution needs
+	bool canUpscale();
+
+	// Blits renderExtent of sceneColorImage to the whole swap chain image and leaves it ready to present
+	void recordUpscale(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+	void createFrameResources();
+
+	void cleanupFrameResources();
+
 	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
 	VkFormat findDepthFormat();
@@ -135,7 +303,5 @@ private:
 		void* pUserData);
 
 	static void framebufferResizeCallback(GLFWwindow* window, int width, int height);
-
-	VkSampleCountFlagBits getMaxUsableSampleCount();
 };
 
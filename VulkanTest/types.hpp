@@ -1,5 +1,8 @@
+#pragma once
+
 #include <array>
 #include <optional>
+#include <cstring>
 #include <glm/glm.hpp>
 
 #define GLM_ENABLE_EXPERIMENTAL
@@ -8,6 +11,7 @@
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily;
 	std::optional<uint32_t> presentFamily;
+	std::optional<uint32_t> transferFamily; // Transfer-only (DMA) family if there is one, the graphics family otherwise
 
 	bool isComplete() {
 		return graphicsFamily.has_value() && presentFamily.has_value();
@@ -71,18 +75,49 @@ struct Vertex {
 
 namespace std {
 	template<> struct hash<Vertex> {
+		// Mixes the bits of every component. Adding 0.0f maps -0.0f to 0.0f, which operator== considers equal
 		size_t operator()(Vertex const& vertex) const {
-			return ((hash<glm::vec3>()(vertex.pos) ^
-					(hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^
-					(hash<glm::vec2>()(vertex.texCoord) << 1);
+			const float components[] = {
+				vertex.pos.x, vertex.pos.y, vertex.pos.z,
+				vertex.normal.x, vertex.normal.y, vertex.normal.z,
+				vertex.color.x, vertex.color.y, vertex.color.z,
+				vertex.texCoord.x, vertex.texCoord.y
+			};
+
+			uint64_t value = 0x9e3779b97f4a7c15ull;
+			for (float component : components) {
+				float normalized = component + 0.0f;
+				uint32_t bits;
+				memcpy(&bits, &normalized, sizeof(bits));
+				value = (value ^ bits) * 0xff51afd7ed558ccdull;
+				value ^= value >> 32;
+			}
+			return static_cast<size_t>(value);
 		}
 	};
 }
 
-struct UniformBufferObject {
-	alignas(16) glm::mat4 model;
+// Written once per frame, bound through UniformAllocator::FRAME_BINDING
+struct FrameUniforms {
 	alignas(16) glm::mat4 view;
 	alignas(16) glm::mat4 projection;
+	alignas(16) glm::mat4 viewProjection;
+};
+
+// Written once per draw, bound through UniformAllocator::OBJECT_BINDING. At 64 bytes it also fits in the 128 bytes of
+// push constants every device supports, which skips the allocation entirely: use getPushConstantRange in the pipeline
+// layout and vkCmdPushConstants instead.
+struct ObjectUniforms {
+	alignas(16) glm::mat4 model;
+
+	static VkPushConstantRange getPushConstantRange() {
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(ObjectUniforms);
+
+		return pushConstantRange;
+	}
 };
 
 /* format